@@ -14,6 +14,7 @@
 #include <cctype>
 #include <algorithm>
 #include <cmath>
+#include <thread>
 
 #include <sys/stat.h>
 
@@ -31,6 +32,8 @@
 namespace imgui_addons
 {
     static const char *ALL_VALID_FILES_EXT_TXT = "All valid files";
+    static const size_t DIR_CACHE_SIZE = 32;      // Directories whose listing is kept while the dialog is open
+    static const size_t DIR_LISTING_BATCH = 256;  // Entries handed over by the reading thread at once
 
     ImGuiFileBrowser::ImGuiFileBrowser()
     {
@@ -66,11 +69,14 @@ namespace imgui_addons
 
     ImGuiFileBrowser::~ImGuiFileBrowser()
     {
-
+        cancelDIR();
     }
 
     void ImGuiFileBrowser::clearFileList()
     {
+        cancelDIR();
+        last_filter.clear();
+
         //Clear pointer references to subdirs and subfiles
         filtered_dirs.clear();
         filtered_files.clear();
@@ -109,6 +115,12 @@ namespace imgui_addons
         subdirs.clear();
         subfiles.clear();
 
+        //Listings may be stale the next time the dialog is opened
+        cancelDIR();
+        dir_cache.clear();
+        dir_cache_order.clear();
+        last_filter.clear();
+
         if (opened)
             *(opened) = false;
 
@@ -164,6 +176,8 @@ namespace imgui_addons
                 is_appearing = false;
             }
 
+            pollDIR();
+
             show_error |= renderNavAndSearchBarRegion();
             show_error |= renderFileListRegion();
             show_error |= renderInputTextAndExtRegion();
@@ -484,7 +498,7 @@ namespace imgui_addons
             if(dialog_mode == DialogMode::OPEN || dialog_mode == DialogMode::SAVE)
             {
                 inputcb_filter_files.clear();
-                for(std::vector<Info>::size_type i = 0; i < subfiles.size(); i++)
+                for(std::deque<Info>::size_type i = 0; i < subfiles.size(); i++)
                 {
                     if(ImStristr(subfiles[i].name.c_str(), nullptr, input_fn, nullptr) != nullptr)
                         inputcb_filter_files.push_back(std::ref(subfiles[i].name));
@@ -495,7 +509,7 @@ namespace imgui_addons
             else if(dialog_mode == DialogMode::SELECT)
             {
                 inputcb_filter_files.clear();
-                for(std::vector<Info>::size_type i = 0; i < subdirs.size(); i++)
+                for(std::deque<Info>::size_type i = 0; i < subdirs.size(); i++)
                 {
                     if(ImStristr(subdirs[i].name.c_str(), nullptr, input_fn, nullptr) != nullptr)
                         inputcb_filter_files.push_back(std::ref(subdirs[i].name));
@@ -691,6 +705,7 @@ namespace imgui_addons
                             input_fn[idx++] = valid_exts[selected_ext_idx][j];
                         input_fn[idx++] = '\0';
                     }
+                    last_filter.clear();
                     filterFiles(FilterMode_Files);
                 }
             }
@@ -791,7 +806,14 @@ namespace imgui_addons
     bool ImGuiFileBrowser::readDIR(std::string pathdir)
     {
         DIR* dir;
-        struct dirent *ent;
+
+        auto cached = dir_cache.find(pathdir);
+        if(cached != dir_cache.end() && !is_appearing)
+        {
+            clearFileList();
+            addEntries(cached->second.dirs, cached->second.files);
+            return true;
+        }
 
         /* If the current directory doesn't exist, and we are opening the dialog for the first time, reset to defaults to avoid looping of showing error modal.
          * An example case is when user closes the dialog in a folder. Then deletes the folder outside. On reopening the dialog the current path (previous) would be invalid.
@@ -829,102 +851,235 @@ namespace imgui_addons
             }
             #endif // OSWIN
 
-            // store all the files and directories within directory and clear previous entries
+            // clear previous entries and read the new ones in the background, they are picked up by pollDIR
             clearFileList();
-            while ((ent = readdir (dir)) != nullptr)
+            dir_listing = std::make_shared<DirListing>();
+            dir_listing->path = pathdir;
+            dir_listing->dirs_only = (dialog_mode == DialogMode::SELECT);
+            dir_listing->notify = on_entries_read;
+            std::thread(listDIR, dir_listing, static_cast<void*>(dir)).detach();
+        }
+        else
+        {
+            error_title = "Error!";
+            error_msg = "Error opening directory! Make sure the directory exists and you have the proper rights to access the directory.";
+            return false;
+        }
+        return true;
+    }
+
+    /* Runs on its own thread: reads the directory and hands the entries over in batches.
+     * The attributes are queried here too, they are what makes listing a network share slow.
+     */
+    void ImGuiFileBrowser::listDIR(std::shared_ptr<DirListing> listing, void* dir_handle)
+    {
+        DIR* dir = static_cast<DIR*>(dir_handle);
+        struct dirent *ent;
+        std::vector<Info> dirs, files;
+        const std::string& pathdir = listing->path;
+
+        auto flush = [&]()
+        {
             {
-                bool is_hidden = false;
-                std::string name(ent->d_name);
+                std::lock_guard<std::mutex> lock(listing->mutex);
+                listing->dirs.insert(listing->dirs.end(), dirs.begin(), dirs.end());
+                listing->files.insert(listing->files.end(), files.begin(), files.end());
+            }
+            dirs.clear();
+            files.clear();
+            notifyDIR(*listing);
+        };
 
-                //Ignore current directory
-                if(name == ".")
-                    continue;
+        while (!listing->cancelled && (ent = readdir (dir)) != nullptr)
+        {
+            bool is_hidden = false;
+            std::string name(ent->d_name);
+
+            //Ignore current directory
+            if(name == ".")
+                continue;
+
+            //Somehow there is a '..' present in root directory in linux.
+            #ifndef OSWIN
+            if(name == ".." && pathdir == "/")
+                continue;
+            #endif // OSWIN
 
-                //Somehow there is a '..' present in root directory in linux.
-                #ifndef OSWIN
-                if(name == ".." && pathdir == "/")
+            if(name != "..")
+            {
+                #ifdef OSWIN
+                std::string dir = pathdir + std::string(ent->d_name);
+                // IF system file skip it...
+                if (FILE_ATTRIBUTE_SYSTEM & GetFileAttributesA(dir.c_str()))
                     continue;
+                if (FILE_ATTRIBUTE_HIDDEN & GetFileAttributesA(dir.c_str()))
+                    is_hidden = true;
+                #else
+                if(name[0] == '.')
+                    is_hidden = true;
                 #endif // OSWIN
+            }
+            //Store directories and files in separate vectors
+            if(ent->d_type == DT_DIR)
+                dirs.push_back(Info(name, is_hidden));
+            else if(ent->d_type == DT_REG && !listing->dirs_only)
+                files.push_back(Info(name, is_hidden));
+
+            if(dirs.size() + files.size() >= DIR_LISTING_BATCH)
+                flush();
+        }
+        closedir (dir);
 
-                if(name != "..")
+        flush();
+        notifyDIR(*listing, true);
+    }
+
+    /* Called under the listing mutex, so once cancelDIR returns, or once the listing is seen done and
+     * its entries taken, the callback is neither running nor called again.
+     */
+    void ImGuiFileBrowser::notifyDIR(DirListing& listing, bool done)
+    {
+        std::lock_guard<std::mutex> lock(listing.mutex);
+        if(done)
+            listing.done = true;
+        if(!listing.cancelled && listing.notify)
+            listing.notify();
+    }
+
+    // Move the entries read by the background thread into the file list, called once per frame
+    void ImGuiFileBrowser::pollDIR()
+    {
+        if(!dir_listing)
+            return;
+
+        bool done = dir_listing->done;
+        std::vector<Info> dirs, files;
+        {
+            std::lock_guard<std::mutex> lock(dir_listing->mutex);
+            dirs.swap(dir_listing->dirs);
+            files.swap(dir_listing->files);
+        }
+
+        if(!dirs.empty() || !files.empty())
+            addEntries(dirs, files);
+
+        if(done)
+        {
+            //Remember the complete listing, evicting the oldest one if the cache is full
+            if(dir_cache.find(dir_listing->path) == dir_cache.end())
+            {
+                if(dir_cache.size() >= DIR_CACHE_SIZE)
                 {
-                    #ifdef OSWIN
-                    std::string dir = pathdir + std::string(ent->d_name);
-                    // IF system file skip it...
-                    if (FILE_ATTRIBUTE_SYSTEM & GetFileAttributesA(dir.c_str()))
-                        continue;
-                    if (FILE_ATTRIBUTE_HIDDEN & GetFileAttributesA(dir.c_str()))
-                        is_hidden = true;
-                    #else
-                    if(name[0] == '.')
-                        is_hidden = true;
-                    #endif // OSWIN
+                    dir_cache.erase(dir_cache_order.front());
+                    dir_cache_order.pop_front();
                 }
-                //Store directories and files in separate vectors
-                if(ent->d_type == DT_DIR)
-                    subdirs.push_back(Info(name, is_hidden));
-                else if(ent->d_type == DT_REG && dialog_mode != DialogMode::SELECT)
-                    subfiles.push_back(Info(name, is_hidden));
+                dir_cache_order.push_back(dir_listing->path);
             }
-            closedir (dir);
-            std::sort(subdirs.begin(), subdirs.end(), alphaSortComparator);
-            std::sort(subfiles.begin(), subfiles.end(), alphaSortComparator);
+            CachedDir& cached = dir_cache[dir_listing->path];
+            cached.dirs.assign(subdirs.begin(), subdirs.end());
+            cached.files.assign(subfiles.begin(), subfiles.end());
+            dir_listing.reset();
+        }
+    }
 
-            //Initialize Filtered dirs and files
-            filterFiles(filter_mode);
+    // Abandon the listing in progress, the thread stops at the next entry and frees the shared state
+    void ImGuiFileBrowser::cancelDIR()
+    {
+        if(dir_listing)
+        {
+            {
+                std::lock_guard<std::mutex> lock(dir_listing->mutex);
+                dir_listing->cancelled = true;
+                dir_listing->notify = nullptr;
+            }
+            dir_listing.reset();
         }
-        else
+    }
+
+    // Append entries to the file list and merge the ones passing the filter into the sorted filtered lists
+    void ImGuiFileBrowser::addEntries(const std::vector<Info>& dirs, const std::vector<Info>& files)
+    {
+        auto pointer_comparator = [](const Info* a, const Info* b) { return alphaSortComparator(*a, *b); };
+        auto merge = [&](std::deque<Info>& entries, std::vector<const Info*>& filtered, const std::vector<Info>& added, bool is_file)
         {
-            error_title = "Error!";
-            error_msg = "Error opening directory! Make sure the directory exists and you have the proper rights to access the directory.";
+            size_t sorted_size = filtered.size();
+            for(const Info& info : added)
+            {
+                entries.push_back(info);
+                if(passFilter(entries.back(), is_file))
+                    filtered.push_back(&entries.back());
+            }
+            std::sort(filtered.begin() + sorted_size, filtered.end(), pointer_comparator);
+            std::inplace_merge(filtered.begin(), filtered.begin() + sorted_size, filtered.end(), pointer_comparator);
+        };
+
+        merge(subdirs, filtered_dirs, dirs, false);
+        merge(subfiles, filtered_files, files, true);
+        last_filter = filter.InputBuf;
+        filter_dirty = false;
+    }
+
+    bool ImGuiFileBrowser::passFilter(const Info& info, bool is_file)
+    {
+        if(!filter.PassFilter(info.name.c_str()))
             return false;
+        if(!is_file)
+            return true;
+
+        // If the option to show all supported formats is selected, filter all files supported
+        if (show_all_valid_files)
+        {
+            std::string ext = info.name.find_last_of('.') == std::string::npos ? "" : info.name.substr(info.name.find_last_of('.'));
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return std::tolower(c); });
+            return ext.length() > 0 && find(valid_exts.begin(), valid_exts.end(), ext) != valid_exts.end();
         }
-        return true;
+        // If the option to show all files is selected, filter all files
+        if(valid_exts.empty() || valid_exts[selected_ext_idx] == "*.*")
+            return true;
+        //If any other extension is selected, filter files having only that extension
+        return ImStristr(info.name.c_str(), nullptr, valid_exts[selected_ext_idx].c_str(), nullptr) != nullptr;
     }
 
     void ImGuiFileBrowser::filterFiles(int filter_mode)
     {
         filter_dirty = false;
+        std::string filter_text(filter.InputBuf);
+
+        /* Appending characters to a single search term can only drop matches,
+         * so only the previous matches need to be checked again.
+         */
+        bool narrowing = !last_filter.empty() && last_filter[0] != '-' && filter_text.size() > last_filter.size() &&
+                         filter_text.compare(0, last_filter.size(), last_filter) == 0 && filter_text.find(',') == std::string::npos;
+        last_filter = filter_text;
+
+        if(narrowing)
+        {
+            auto rejected = [this](const Info* info) { return !filter.PassFilter(info->name.c_str()); };
+            filtered_dirs.erase(std::remove_if(filtered_dirs.begin(), filtered_dirs.end(), rejected), filtered_dirs.end());
+            filtered_files.erase(std::remove_if(filtered_files.begin(), filtered_files.end(), rejected), filtered_files.end());
+            return;
+        }
+
+        auto pointer_comparator = [](const Info* a, const Info* b) { return alphaSortComparator(*a, *b); };
         if(filter_mode | FilterMode_Dirs)
         {
             filtered_dirs.clear();
-            for (std::vector<Info>::size_type i = 0; i < subdirs.size(); ++i)
+            for (std::deque<Info>::size_type i = 0; i < subdirs.size(); ++i)
             {
-                if(filter.PassFilter(subdirs[i].name.c_str()))
+                if(passFilter(subdirs[i], false))
                     filtered_dirs.push_back(&subdirs[i]);
             }
+            std::sort(filtered_dirs.begin(), filtered_dirs.end(), pointer_comparator);
         }
         if(filter_mode | FilterMode_Files)
         {
             filtered_files.clear();
-            for (std::vector<Info>::size_type i = 0; i < subfiles.size(); ++i)
+            for (std::deque<Info>::size_type i = 0; i < subfiles.size(); ++i)
             {
-                // If the option to show all supported formats is selected, filter all files supported
-                if (show_all_valid_files)
-                {
-                    if(filter.PassFilter(subfiles[i].name.c_str()))
-                    {
-                        std::string ext = subfiles[i].name.find_last_of('.') == std::string::npos ? "" : subfiles[i].name.substr(subfiles[i].name.find_last_of('.'));
-                        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){ return std::tolower(c); });
-                        if (ext.length() > 0 && find(valid_exts.begin(), valid_exts.end(), ext) != valid_exts.end())
-                        {
-                            filtered_files.push_back(&subfiles[i]);
-                        }
-                    }
-                }
-                // If the option to show all files is selected, filter all files
-                else if(valid_exts[selected_ext_idx] == "*.*")
-                {
-                    if(filter.PassFilter(subfiles[i].name.c_str()))
-                        filtered_files.push_back(&subfiles[i]);
-                }
-                //If any other extension is selected, filter files having only that extension
-                else
-                {
-                    if(filter.PassFilter(subfiles[i].name.c_str()) && (ImStristr(subfiles[i].name.c_str(), nullptr, valid_exts[selected_ext_idx].c_str(), nullptr)) != nullptr)
-                        filtered_files.push_back(&subfiles[i]);
-                }
+                if(passFilter(subfiles[i], true))
+                    filtered_files.push_back(&subfiles[i]);
             }
+            std::sort(filtered_files.begin(), filtered_files.end(), pointer_comparator);
         }
     }
 
@@ -1086,7 +1241,7 @@ namespace imgui_addons
         {
             if(dialog_mode == DialogMode::SELECT)
             {
-                for(std::vector<Info>::size_type i = 0; i < subdirs.size(); i++)
+                for(std::deque<Info>::size_type i = 0; i < subdirs.size(); i++)
                 {
                     if(subdirs[i].name == selected_fn)
                     {
@@ -1098,7 +1253,7 @@ namespace imgui_addons
             }
             else
             {
-                for(std::vector<Info>::size_type i = 0; i < subfiles.size(); i++)
+                for(std::deque<Info>::size_type i = 0; i < subfiles.size(); i++)
                 {
                     if(subfiles[i].name == selected_fn)
                     {
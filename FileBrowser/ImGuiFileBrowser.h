@@ -2,6 +2,13 @@
 #define IMGUIFILEBROWSER_H
 
 #include <imgui.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -33,6 +40,11 @@ namespace imgui_addons
             std::string selected_path;
             std::string ext;    // Store the saved file extension
 
+            /* Called from the directory reading thread whenever new entries are available,
+             * use it to wake up the render loop. Must be thread safe.
+             */
+            std::function<void()> on_entries_read;
+
 
         private:
             struct Info
@@ -44,6 +56,28 @@ namespace imgui_addons
                 bool is_hidden;
             };
 
+            /* Entries read by the background thread and not yet moved into subdirs/subfiles.
+             * Shared with the thread, so an abandoned listing can finish on its own without blocking the UI.
+             */
+            struct DirListing
+            {
+                std::mutex mutex;
+                std::vector<Info> dirs;
+                std::vector<Info> files;
+                std::string path;
+                bool dirs_only = false;
+                std::function<void()> notify;
+                std::atomic<bool> done{false};
+                std::atomic<bool> cancelled{false};
+            };
+
+            // Complete listings of the directories visited while the dialog is open
+            struct CachedDir
+            {
+                std::vector<Info> dirs;
+                std::vector<Info> files;
+            };
+
             //Enum used as bit flags.
             enum FilterMode
             {
@@ -67,6 +101,8 @@ namespace imgui_addons
             void showHelpMarker(std::string desc);
             void parsePathTabs(std::string str);
             void filterFiles(int filter_mode);
+            bool passFilter(const Info& info, bool is_file);
+            void addEntries(const std::vector<Info>& dirs, const std::vector<Info>& files);
 
             /* Core Functions that render the 4 different regions making up
              * a simple file dialog
@@ -82,6 +118,10 @@ namespace imgui_addons
              * reading directories/files
              */
             bool readDIR(std::string path);
+            void pollDIR();
+            void cancelDIR();
+            static void listDIR(std::shared_ptr<DirListing> listing, void* dir_handle);
+            static void notifyDIR(DirListing& listing, bool done = false);
             bool onNavigationButtonClick(int idx);
             bool onDirClick(int idx);
 
@@ -106,8 +146,8 @@ namespace imgui_addons
 
             std::vector<std::string> valid_exts;
             std::vector<std::string> current_dirlist;
-            std::vector<Info> subdirs;
-            std::vector<Info> subfiles;
+            std::deque<Info> subdirs;  // Deques keep the pointers in filtered_dirs/filtered_files valid while entries stream in
+            std::deque<Info> subfiles;
             std::string current_path, error_msg, error_title, invfile_modal_id, repfile_modal_id;
 
             ImGuiTextFilter filter;
@@ -115,6 +155,11 @@ namespace imgui_addons
             std::vector<const Info*> filtered_dirs; // Note: We don't need to call delete. It's just for storing filtered items from subdirs and subfiles so we don't use PassFilter every frame.
             std::vector<const Info*> filtered_files;
             std::vector< std::reference_wrapper<std::string> > inputcb_filter_files;
+            std::string last_filter;    // Search string the filtered lists were built with
+
+            std::shared_ptr<DirListing> dir_listing;
+            std::map<std::string, CachedDir> dir_cache;
+            std::list<std::string> dir_cache_order;
 
             bool* opened = NULL;
     };
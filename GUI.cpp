@@ -35,6 +35,18 @@ GUI::GUI()
     glfwMakeContextCurrent(window);
     glfwSwapInterval(0);
 
+    // Installed before the ImGui backend, which chains to them, so every input wakes the render loop
+    glfwSetWindowUserPointer(window, this);
+    glfwSetCursorPosCallback(window, [](GLFWwindow* w, double, double) { OnWindowEvent(w); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int, int, int) { OnWindowEvent(w); });
+    glfwSetScrollCallback(window, [](GLFWwindow* w, double, double) { OnWindowEvent(w); });
+    glfwSetKeyCallback(window, [](GLFWwindow* w, int, int, int, int) { OnWindowEvent(w); });
+    glfwSetCharCallback(window, [](GLFWwindow* w, unsigned int) { OnWindowEvent(w); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow* w, int) { OnWindowEvent(w); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow* w, int) { OnWindowEvent(w); });
+    glfwSetWindowSizeCallback(window, [](GLFWwindow* w, int, int) { OnWindowEvent(w); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) { OnWindowEvent(w); });
+
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImPlot::CreateContext();
@@ -62,7 +74,7 @@ GUI::GUI()
  */
 void GUI::Prepare()
 {
-    glfwPollEvents();
+    WaitForFrame();
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -127,3 +139,77 @@ GLFWwindow* GUI::GetWindow()
 {
     return window;
 }
+
+/**
+ * Blocks until there is something new to draw, processing the window events meanwhile
+ */
+void GUI::WaitForFrame()
+{
+    glfwPollEvents();
+
+    while (!glfwWindowShouldClose(window))
+    {
+        if (redrawRequested.exchange(false))
+            framesToRender = FRAMES_AFTER_EVENT;
+
+        if (framesToRender > 0 && !IsMinimized())
+            break;
+
+        glfwWaitEventsTimeout(waitTimeout);
+        // A timeout without any event still produces one frame, this keeps progress and timers moving
+        if (framesToRender <= 0)
+            framesToRender = 1;
+    }
+
+    if (frameRateLimit > 0)
+    {
+        double frameTime = 1.0 / frameRateLimit;
+        double remaining = lastFrameTime + frameTime - glfwGetTime();
+        while (remaining > 0.0 && !glfwWindowShouldClose(window))
+        {
+            glfwWaitEventsTimeout(remaining);
+            remaining = lastFrameTime + frameTime - glfwGetTime();
+        }
+    }
+
+    framesToRender--;
+    lastFrameTime = glfwGetTime();
+}
+
+void GUI::OnWindowEvent(GLFWwindow* window)
+{
+    static_cast<GUI*>(glfwGetWindowUserPointer(window))->RequestRedraw();
+}
+
+/**
+ * Marks the GUI as dirty and wakes the render loop, can be called from any thread
+ */
+void GUI::RequestRedraw()
+{
+    redrawRequested = true;
+    glfwPostEmptyEvent();
+}
+
+/**
+ * Sets the longest time the render loop sleeps when nothing happens
+ */
+void GUI::SetWaitTimeout(double seconds)
+{
+    waitTimeout = seconds;
+}
+
+/**
+ * Limits the number of frames drawn per second, 0 disables the limit
+ */
+void GUI::SetFrameRateLimit(int framesPerSecond)
+{
+    frameRateLimit = framesPerSecond;
+}
+
+/**
+ * Returns the frame rate limit, 0 if there is none
+ */
+int GUI::GetFrameRateLimit()
+{
+    return frameRateLimit;
+}
@@ -7,6 +7,14 @@
 #include <stdio.h>
 #include <GLFW/glfw3.h>
 #include <utility>
+#include <atomic>
+
+// Frames rendered after an event so that ImGui can settle hover, focus and layout changes
+#define FRAMES_AFTER_EVENT 3
+// Longest time the GUI sleeps without any event
+#define IDLE_WAIT_SECONDS 1.0
+// Longest time the GUI sleeps while a background analysis reports progress
+#define BUSY_WAIT_SECONDS 0.1
 
 class GUI {
 public:
@@ -17,7 +25,20 @@ public:
 	bool IsMinimized();
 	bool WindowShouldClose();
 	GLFWwindow* GetWindow();
+
+	void RequestRedraw();
+	void SetWaitTimeout(double seconds);
+	void SetFrameRateLimit(int framesPerSecond);
+	int GetFrameRateLimit();
 private:
+	void WaitForFrame();
+	static void OnWindowEvent(GLFWwindow* window);
+
 	GLFWwindow* window = NULL;
+	std::atomic<bool> redrawRequested = true;
+	int framesToRender = FRAMES_AFTER_EVENT;
+	double waitTimeout = IDLE_WAIT_SECONDS;
+	int frameRateLimit = 0;
+	double lastFrameTime = 0.0;
 };
 
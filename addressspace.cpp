@@ -0,0 +1,846 @@
+#include "addressspace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+
+/**
+ * @param file: dump reader, it must outlive the address space
+ * @param directoryTableBase: DirectoryTableBase of the process
+ * @param profile: offsets of the kernel structures
+ * @param counters: optional counters shared by the address spaces of the dump
+ * @param physical: optional physical address space of the dump, its holes aren't read
+ */
+AddressSpace::AddressSpace(std::ifstream& file, uint64_t directoryTableBase, const OffsetsProfile& profile,
+                           AccessCounters *counters, std::shared_ptr<const PhysicalAddressSpace> physical)
+    : file(file), dirTableBase(directoryTableBase), offsets(profile), counters(counters), physical(std::move(physical))
+{
+}
+
+/**
+ * @param processDirectoryTableBase: DirectoryTableBase of the other process
+ * @return: address space of another process of the same dump, with an empty translation cache
+ */
+AddressSpace AddressSpace::forProcess(uint64_t processDirectoryTableBase) const
+{
+    return AddressSpace(file, processDirectoryTableBase, offsets, counters, physical);
+}
+
+uint64_t AddressSpace::directoryTableBase() const
+{
+    return dirTableBase;
+}
+
+const OffsetsProfile& AddressSpace::profile() const
+{
+    return offsets;
+}
+
+std::ifstream& AddressSpace::reader()
+{
+    return file;
+}
+
+/**
+ * Read physical memory from the dump.
+ *
+ * @param physicalAddress: physical address to read from
+ * @param buffer: buffer to store the read data
+ * @param size: size of the buffer
+ * @param quiet: don't report failures, for callers probing addresses that may be garbage
+ * @return: true if the physicalAddress was read successfully, false otherwise
+ */
+bool AddressSpace::readPhysical(uint64_t physicalAddress, void *buffer, size_t size, bool quiet)
+{
+    if (counters != nullptr) {
+        counters->physicalReads++;
+    }
+
+    // Pages missing from the dump fail silently, they are common in dumps with holes
+    if (physical && size != 0) {
+        bool present = size - 1 <= UINT64_MAX - physicalAddress;
+        uint64_t lastPage = present ? (physicalAddress + size - 1) >> PAGE_4KB_SHIFT : 0;
+        for (uint64_t page = physicalAddress >> PAGE_4KB_SHIFT; present && page <= lastPage; page++) {
+            present = physical->isPagePresent(page);
+        }
+        if (!present) {
+            if (counters != nullptr) {
+                counters->failedReads++;
+            }
+            return false;
+        }
+    }
+
+    file.seekg(physicalAddress, std::ios::beg);
+
+    if (file.fail()) {
+        if (!quiet) {
+            std::cerr << "Failed to seek to the physicalAddress position in the file\n";
+        }
+        file.clear();
+        if (counters != nullptr) {
+            counters->failedReads++;
+        }
+        return false;
+    }
+
+    file.read(reinterpret_cast<char *>(buffer), size);
+
+    if (file.fail()) {
+        if (!quiet) {
+            std::cerr << "Failed to read the physicalAddress from the file\n";
+        }
+        file.clear();
+        if (counters != nullptr) {
+            counters->failedReads++;
+        }
+        return false;
+    }
+
+    if (counters != nullptr) {
+        counters->bytesRead += size;
+    }
+    return true;
+}
+
+/**
+ * Convert virtual address to physical address.
+ *
+ * @param virtualAddress: virtual address to convert
+ * @param quiet: don't report pages that aren't present, for callers probing many addresses
+ * @return: physical address, 0 if the address isn't mapped
+ */
+uint64_t AddressSpace::translate(uint64_t virtualAddress, bool quiet)
+{
+    uint64_t physicalAddress;
+    if (!lookup(virtualAddress, quiet, physicalAddress)) {
+        return 0;
+    }
+
+    return physicalAddress;
+}
+
+bool AddressSpace::lookup(uint64_t virtualAddress, bool quiet, uint64_t& physicalAddress)
+{
+    if (counters != nullptr) {
+        counters->translations++;
+    }
+
+    uint64_t virtualPage = virtualAddress >> PAGE_4KB_SHIFT;
+    if (!translations.empty()) {
+        TranslationEntry& entry = translations[virtualPage & (TRANSLATION_CACHE_ENTRIES - 1)];
+        if (entry.virtualPage == virtualPage) {
+            if (counters != nullptr) {
+                counters->translationCacheHits++;
+            }
+            physicalAddress = (entry.physicalPage << PAGE_4KB_SHIFT) + PAGE_4KB_OFFSET(virtualAddress);
+            return true;
+        }
+    }
+
+    if (!walkTranslation(virtualAddress, quiet, physicalAddress)) {
+        return false;
+    }
+
+    if (translations.empty()) {
+        translations.assign(TRANSLATION_CACHE_ENTRIES, TranslationEntry{UINT64_MAX, 0});
+    }
+    translations[virtualPage & (TRANSLATION_CACHE_ENTRIES - 1)] = {virtualPage, physicalAddress >> PAGE_4KB_SHIFT};
+
+    return true;
+}
+
+/**
+ * Read virtual memory, the range may span several pages.
+ *
+ * @param virtualAddress: virtual address to read from
+ * @param buffer: buffer to store the read data
+ * @param size: size of the buffer
+ * @return: true if every page of the range is mapped and was read, false otherwise
+ */
+bool AddressSpace::read(uint64_t virtualAddress, void *buffer, size_t size)
+{
+    char *output = static_cast<char *>(buffer);
+
+    while (size != 0) {
+        size_t chunk = std::min<uint64_t>(size, PAGE_SIZE - PAGE_4KB_OFFSET(virtualAddress));
+        uint64_t physicalAddress;
+        if (!lookup(virtualAddress, true, physicalAddress) || !readPhysical(physicalAddress, output, chunk)) {
+            return false;
+        }
+
+        virtualAddress += chunk;
+        output += chunk;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+/**
+ * Drop the cached translations, e.g. after the page tables were modified.
+ */
+void AddressSpace::flushTranslations()
+{
+    translations.clear();
+}
+
+bool AddressSpace::walkTranslation(uint64_t virtualAddress, bool quiet, uint64_t& physicalAddress)
+{
+    VIRTUAL_ADDRESS virtAddr = {0};
+
+    DIR_TABLE_BASE dirTableBaseEntry = {0};
+    PML4E pml4e = {0};
+    PDPTE pdpte = {0};
+    PDPTE_LARGE pdpteLarge = {0};
+    PDE pde = {0};
+    PDE_LARGE pdeLarge = {0};
+    PTE pte = {0};
+
+    virtAddr.All = virtualAddress;
+    dirTableBaseEntry.All = dirTableBase;
+
+    if (!readPhysical(
+            (dirTableBaseEntry.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.Pml4Index * 8),
+            &pml4e,
+            sizeof(PML4E),
+            quiet)) {
+        return false;
+    }
+
+    if (pml4e.Bits.Present == 0) {
+        if (!quiet) {
+            std::cerr << "PML4E not present\n";
+        }
+        return false;
+    }
+
+    if (!readPhysical(
+            (pml4e.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.PdptIndex * 8),
+            &pdpte,
+            sizeof(PDPTE),
+            quiet)) {
+        return false;
+    }
+
+    if (pdpte.Bits.Present == 0) {
+        if (!quiet) {
+            std::cerr << "PDPTE not present\n";
+        }
+        return false;
+    }
+
+    if (IS_LARGE_PAGE(pdpte.All)) {
+        pdpteLarge.All = pdpte.All;
+        physicalAddress = (pdpteLarge.Bits.PhysicalAddress << PAGE_1GB_SHIFT) + PAGE_1GB_OFFSET(virtualAddress);
+        return true;
+    }
+
+    if (!readPhysical(
+            (pdpte.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.PdIndex * 8),
+            &pde,
+            sizeof(PDE),
+            quiet)) {
+        return false;
+    }
+
+    if (pde.Bits.Present == 0) {
+        if (!quiet) {
+            std::cerr << "PDE not present\n";
+        }
+        return false;
+    }
+
+    if (IS_LARGE_PAGE(pde.All)) {
+        pdeLarge.All = pde.All;
+        physicalAddress = (pdeLarge.Bits.PhysicalAddress << PAGE_2MB_SHIFT) + PAGE_2MB_OFFSET(virtualAddress);
+        return true;
+    }
+
+    if (!readPhysical(
+            (pde.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.PtIndex * 8),
+            &pte,
+            sizeof(PTE),
+            quiet)) {
+        return false;
+    }
+
+    if (pte.Bits.Present == 0) {
+        if (!quiet) {
+            std::cerr << "PTE not present\n";
+        }
+        return false;
+    }
+
+    physicalAddress = (pte.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + virtAddr.Bits.PageIndex;
+    return true;
+}
+
+void AddressSpace::walkTableLevel(uint64_t tableAddress, int level, uint64_t baseAddress, uint64_t startAddress,
+                                  uint64_t lastAddress, uint64_t fileSize, const PageMappingCallback& onMapping,
+                                  const PageTableCallback& onTable)
+{
+    uint64_t entries[PAGE_TABLE_ENTRIES];
+    if (tableAddress + PAGE_SIZE > fileSize || !readPhysical(tableAddress, entries, sizeof(entries))) {
+        return;
+    }
+
+    if (onTable) {
+        onTable(tableAddress);
+    }
+
+    int shift = PAGE_4KB_SHIFT + level * 9;
+    uint64_t span = 1ULL << shift;
+
+    for (uint64_t i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        uint64_t virtualAddress = baseAddress + i * span;
+        // Canonical form: the upper half of the PML4 maps the sign extended kernel space
+        if (level == 3 && i >= PAGE_TABLE_ENTRIES / 2) {
+            virtualAddress |= 0xffff000000000000;
+        }
+
+        if (virtualAddress > lastAddress || virtualAddress + (span - 1) < startAddress) {
+            continue;
+        }
+
+        uint64_t entry = entries[i];
+        if (!IS_PAGE_PRESENT(entry)) {
+            continue;
+        }
+
+        if (level == 0) {
+            PTE pte = {0};
+            pte.All = entry;
+            onMapping({virtualAddress, static_cast<uint64_t>(pte.Bits.PhysicalAddress) << PAGE_4KB_SHIFT, span});
+        } else if (level == 2 && IS_LARGE_PAGE(entry)) {
+            PDPTE_LARGE pdpteLarge = {0};
+            pdpteLarge.All = entry;
+            onMapping({virtualAddress, static_cast<uint64_t>(pdpteLarge.Bits.PhysicalAddress) << PAGE_1GB_SHIFT, span});
+        } else if (level == 1 && IS_LARGE_PAGE(entry)) {
+            PDE_LARGE pdeLarge = {0};
+            pdeLarge.All = entry;
+            onMapping({virtualAddress, static_cast<uint64_t>(pdeLarge.Bits.PhysicalAddress) << PAGE_2MB_SHIFT, span});
+        } else {
+            PML4E next = {0};
+            next.All = entry;
+            uint64_t nextTable = next.Bits.PhysicalAddress << PAGE_4KB_SHIFT;
+
+            // The self-referencing PML4 entry maps the paging structures themselves, they are visited anyway
+            if (level == 3 && nextTable == tableAddress) {
+                continue;
+            }
+
+            walkTableLevel(nextTable, level - 1, virtualAddress, startAddress, lastAddress, fileSize, onMapping, onTable);
+        }
+    }
+}
+
+/**
+ * Walk the page tables and report every present page in a range of the address space.
+ *
+ * @param startAddress: first virtual address of the range
+ * @param endAddress: end of the range (exclusive), 0 for the end of the address space
+ * @param onMapping: called for every present page, in ascending virtual address order
+ * @param onTable: called with the physical address of every paging structure that was read
+ */
+void AddressSpace::walk(uint64_t startAddress, uint64_t endAddress, const PageMappingCallback& onMapping,
+                        const PageTableCallback& onTable)
+{
+    if (endAddress != 0 && endAddress <= startAddress) {
+        return;
+    }
+
+    file.clear();
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    if (file.fail()) {
+        file.clear();
+        return;
+    }
+
+    DIR_TABLE_BASE dirTableBaseEntry = {0};
+    dirTableBaseEntry.All = dirTableBase;
+
+    walkTableLevel(dirTableBaseEntry.Bits.PhysicalAddress << PAGE_4KB_SHIFT, 3, 0, startAddress, endAddress - 1,
+                   fileSize, onMapping, onTable);
+}
+
+/**
+ * Validate _KPROCESS structure by checking if its DirectoryTableBase is the one of System.
+ *
+ * @param kProcessAddress: offset of _KPROCESS structure from the beginning of the file
+ * @return: true if _KPROCESS is valid, false otherwise
+ */
+bool AddressSpace::validateKProcess(uint64_t kProcessAddress)
+{
+    uint64_t directoryTableBase;
+    if (!readPhysical(kProcessAddress + offsets.directoryTableBase, &directoryTableBase, sizeof(uint64_t))) {
+        return false;
+    }
+
+    return directoryTableBase == offsets.systemDirectoryTableBase;
+}
+
+/**
+ * Check that a _KPROCESS candidate is laid out as the profile says. It's valid when its DirectoryTableBase
+ * is the one of System, or when its ActiveProcessLinks lead to another process with a DirectoryTableBase
+ * and a printable name.
+ *
+ * @param kProcessAddress: offset of the candidate _KPROCESS structure
+ * @return: true if the candidate is a _KPROCESS with the layout of the profile, false otherwise
+ */
+bool AddressSpace::probeKProcess(uint64_t kProcessAddress)
+{
+    uint64_t directoryTableBase;
+    if (!readPhysical(kProcessAddress + offsets.directoryTableBase, &directoryTableBase, sizeof(uint64_t), true)
+        || directoryTableBase == 0) {
+        return false;
+    }
+
+    if (directoryTableBase == offsets.systemDirectoryTableBase) {
+        return true;
+    }
+
+    uint64_t flink;
+    if (!readPhysical(kProcessAddress + offsets.activeProcessLinksFlink, &flink, sizeof(uint64_t), true)
+        || flink < KERNEL_SPACE_START) {
+        return false;
+    }
+
+    uint64_t nextLinks = forProcess(directoryTableBase).translate(flink, true);
+    if (nextLinks <= offsets.activeProcessLinksFlink) {
+        return false;
+    }
+
+    uint64_t nextKProcess = nextLinks - offsets.activeProcessLinksFlink;
+    uint64_t nextDirectoryTableBase;
+    char name[16] = {0};
+    if (!readPhysical(nextKProcess + offsets.directoryTableBase, &nextDirectoryTableBase, sizeof(uint64_t), true)
+        || nextDirectoryTableBase == 0
+        || !readPhysical(nextKProcess + offsets.imageFileName, name, 15, true)) {
+        return false;
+    }
+
+    size_t length = strnlen(name, 15);
+    return length != 0 && std::all_of(name, name + length, [](char c) {
+        return std::isprint(static_cast<unsigned char>(c));
+    });
+}
+
+/**
+ * Find the offset of _KPROCESS structure of System process.
+ *
+ * @param progress: optional token receiving the scanned bytes, the scan stops when it is cancelled
+ * @return: offset of _KPROCESS structure of System process, 0 if not found or cancelled
+ */
+std::ptrdiff_t AddressSpace::findSystemKProcess(AnalysisProgress *progress)
+{
+    SystemProcessScanner scanner({WindowsProfile{"", 0, offsets}});
+    return scanForSystem(scanner, progress);
+}
+
+/**
+ * Read the runs of the dump in order and feed them to the scanner until it finds System. Holes
+ * between the runs are skipped.
+ *
+ * @param scanner: scanner with the candidate profiles
+ * @param progress: optional token receiving the scanned bytes, the scan stops when it is cancelled
+ * @param physical: runs of the dump, the whole reader from address 0 when null
+ * @return: offset of _KPROCESS structure of System process, 0 if not found or cancelled
+ */
+std::ptrdiff_t AddressSpace::scanForSystem(SystemProcessScanner& scanner, AnalysisProgress *progress,
+                                           const PhysicalAddressSpace *physical)
+{
+    std::vector<PhysicalRun> runs;
+    if (physical != nullptr) {
+        runs = physical->runs();
+    } else {
+        file.clear();
+        file.seekg(0, std::ios::end);
+        std::streamoff end = file.tellg();
+        file.clear();
+        if (end > 0) {
+            runs.push_back(PhysicalRun{0, static_cast<uint64_t>(end), 0});
+        }
+    }
+
+    if (progress != nullptr) {
+        uint64_t totalBytes = 0;
+        for (auto& run : runs) {
+            totalBytes += run.size;
+        }
+        progress->totalBytes = totalBytes;
+    }
+
+    std::vector<char> buffer(SCAN_CHUNK_SIZE + SCAN_CHUNK_OVERLAP);
+
+    for (auto& run : runs) {
+        uint64_t runEnd = run.start + run.size;
+        for (uint64_t offset = run.start; offset < runEnd; offset += SCAN_CHUNK_SIZE) {
+            if (progress != nullptr && progress->cancelled) {
+                return 0;
+            }
+
+            // Pages the format fails to read (e.g. corrupted blocks) read as zeros
+            size_t readSize = std::min<uint64_t>(buffer.size(), runEnd - offset);
+            if (!readPhysical(offset, buffer.data(), readSize, true)) {
+                for (size_t page = 0; page < readSize; page += PAGE_SIZE) {
+                    size_t pageSize = std::min<size_t>(PAGE_SIZE, readSize - page);
+                    if (!readPhysical(offset + page, buffer.data() + page, pageSize, true)) {
+                        std::memset(buffer.data() + page, 0, pageSize);
+                    }
+                }
+            }
+
+            size_t chunkSize = std::min<size_t>(readSize, SCAN_CHUNK_SIZE);
+            scanner.scanChunk(DumpChunk{offset, buffer.data(), chunkSize, readSize});
+
+            if (progress != nullptr) {
+                progress->bytesScanned += chunkSize;
+            }
+
+            // Chunks are scanned in order, so the first chunk with a match holds the lowest one.
+            if (!scanner.validated.empty() || !scanner.deferred.empty()) {
+                std::ptrdiff_t address = scanner.result(file);
+                if (address != 0) {
+                    return address;
+                }
+            }
+        }
+    }
+
+    std::cerr << "'System' _EPROCESS not found\n";
+    return 0;
+}
+
+/**
+ * Get the name of the process.
+ * @param kProcessAddress: offset of _KPROCESS structure of the process
+ * @return: name of the process
+ */
+std::string AddressSpace::processName(uint64_t kProcessAddress)
+{
+    char name[16] = {0};
+    readPhysical(kProcessAddress + offsets.imageFileName, name, 15);
+
+    std::string nameStr{name};
+
+    if (nameStr.empty()) {
+        nameStr = "###";
+    }
+
+    return nameStr;
+}
+
+/**
+ * Get the offset of _KPROCESS structure of the next process in ActiveProcessLinks.
+ * @param kProcessAddress: offset of _KPROCESS structure of the current process
+ * @return: offset of _KPROCESS structure of the next process
+ */
+uint64_t AddressSpace::nextProcess(uint64_t kProcessAddress)
+{
+    uint64_t flinkVirtAddr;
+    readPhysical(kProcessAddress + offsets.activeProcessLinksFlink, &flinkVirtAddr, sizeof(uint64_t));
+    uint64_t flinkPhysAddr = translate(flinkVirtAddr);
+
+    return flinkPhysAddr - offsets.activeProcessLinksFlink;
+}
+
+/**
+ * Get the offset of _KPROCESS structure of the previous process in ActiveProcessLinks.
+ * @param kProcessAddress: offset of _KPROCESS structure of the current process
+ * @return: offset of _KPROCESS structure of the previous process
+ */
+uint64_t AddressSpace::previousProcess(uint64_t kProcessAddress)
+{
+    uint64_t blinkVirtAddr;
+    readPhysical(kProcessAddress + offsets.activeProcessLinksBlink, &blinkVirtAddr, sizeof(uint64_t));
+    uint64_t blinkPhysAddr = translate(blinkVirtAddr);
+
+    return blinkPhysAddr - offsets.activeProcessLinksFlink;
+}
+
+/**
+ * Walk ActiveProcessLinks starting from the system process and report every process as soon as it is read.
+ * The address space must be the one of the system process.
+ * @param systemKProcessAddress: offset of _KPROCESS structure of the system process
+ * @param callback: called for every process in list order
+ * @param readVadTrees: read the VAD tree of every process, otherwise Process::VadTree is left empty
+ * @param progress: optional token counting the processes, the walk stops when it is cancelled
+ */
+void AddressSpace::walkProcessList(uint64_t systemKProcessAddress, const ProcessCallback& callback, bool readVadTrees,
+                                   AnalysisProgress *progress)
+{
+    uint64_t curProcessKProcess = systemKProcessAddress;
+    uint64_t curProcessDirectoryTableBase = dirTableBase;
+
+    auto report = [&]() {
+        std::vector<VadNode> curVadTree;
+        if (readVadTrees) {
+            curVadTree = forProcess(curProcessDirectoryTableBase).readProcessVadTree(curProcessKProcess);
+        }
+
+        callback(Process{curProcessKProcess,
+                         curProcessDirectoryTableBase,
+                         processName(curProcessKProcess),
+                         std::move(curVadTree)});
+
+        if (progress != nullptr) {
+            progress->processesFound++;
+        }
+    };
+
+    report();
+
+    do {
+        if (progress != nullptr && progress->cancelled) {
+            return;
+        }
+
+        curProcessKProcess = nextProcess(curProcessKProcess);
+        // A dump missing the next _EPROCESS ends the list there
+        if (!readPhysical(curProcessKProcess + offsets.directoryTableBase, &curProcessDirectoryTableBase, sizeof(uint64_t))) {
+            return;
+        }
+        report();
+    } while (curProcessDirectoryTableBase != dirTableBase);
+}
+
+/**
+ * Get the list of processes, the address space must be the one of the system process.
+ * @param systemKProcessAddress: offset of _KPROCESS structure of the system process
+ * @param progress: optional token counting the processes, the walk stops when it is cancelled
+ * @return: list of processes
+ */
+std::vector<Process> AddressSpace::processList(uint64_t systemKProcessAddress, AnalysisProgress *progress)
+{
+    std::vector<Process> processes;
+
+    walkProcessList(systemKProcessAddress, [&](const Process& process) {
+        processes.push_back(process);
+    }, true, progress);
+
+    return processes;
+}
+
+/**
+ * Get the offset of _RTL_AVL_TREE structure of the process.
+ * @param kProcessPhysicalAddress: offset of _KPROCESS structure of the process
+ * @return: offset of _RTL_AVL_TREE structure of the process
+ */
+uint64_t AddressSpace::vadRoot(uint64_t kProcessPhysicalAddress)
+{
+    uint64_t vadRootVirtAddr;
+    readPhysical(kProcessPhysicalAddress + offsets.vadRoot, &vadRootVirtAddr, sizeof(uint64_t));
+
+    return translate(vadRootVirtAddr);
+}
+
+uint64_t AddressSpace::readNodeLink(uint64_t address)
+{
+    uint64_t linkVirtAddr;
+    readPhysical(address, &linkVirtAddr, sizeof(uint64_t));
+
+    if (linkVirtAddr == 0x0)
+    {
+        return 0;
+    }
+
+    return translate(linkVirtAddr);
+}
+
+/**
+ * Get the offset of _RTL_BALANCED_NODE structure of the left node.
+ * @param nodePhysicalAddress: offset of _RTL_BALANCED_NODE structure of the current node
+ * @return: offset of _RTL_BALANCED_NODE structure of the left node, 0 if there is none
+ */
+uint64_t AddressSpace::leftNode(uint64_t nodePhysicalAddress)
+{
+    return readNodeLink(nodePhysicalAddress);
+}
+
+/**
+ * Get the offset of _RTL_BALANCED_NODE structure of the right node.
+ * @param nodePhysicalAddress: offset of _RTL_BALANCED_NODE structure of the current node
+ * @return: offset of _RTL_BALANCED_NODE structure of the right node, 0 if there is none
+ */
+uint64_t AddressSpace::rightNode(uint64_t nodePhysicalAddress)
+{
+    return readNodeLink(nodePhysicalAddress + offsets.rightChild);
+}
+
+/**
+ * Get the offset of _RTL_BALANCED_NODE structure of the parent node.
+ * @param nodePhysicalAddress: offset of _RTL_BALANCED_NODE structure of the current node
+ * @return: offset of _RTL_BALANCED_NODE structure of the parent node
+ */
+uint64_t AddressSpace::parentNode(uint64_t nodePhysicalAddress)
+{
+    uint64_t parentValueVirtAddr;
+    readPhysical(nodePhysicalAddress + offsets.parentValue, &parentValueVirtAddr, sizeof(uint64_t));
+    parentValueVirtAddr = parentValueVirtAddr & (~0x7);
+
+    return translate(parentValueVirtAddr);
+}
+
+/**
+ * Read the _MMVAD_SHORT structure of the node and calculate the start and end of the page assigned to node.
+ * @param nodePhysicalAddress: offset of _MMVAD_SHORT structure of the node
+ * @return: VadNode structure containing the start and end of the page assigned to node
+ */
+VadNode AddressSpace::readVadNode(uint64_t nodePhysicalAddress)
+{
+    ULONG StartingVpn, EndingVpn;
+    UCHAR StartingVpnHigh, EndingVpnHigh;
+
+    readPhysical(nodePhysicalAddress + offsets.startingVpn, &StartingVpn, sizeof(ULONG));
+    readPhysical(nodePhysicalAddress + offsets.endingVpn, &EndingVpn, sizeof(ULONG));
+    readPhysical(nodePhysicalAddress + offsets.startingVpnHigh, &StartingVpnHigh, sizeof(UCHAR));
+    readPhysical(nodePhysicalAddress + offsets.endingVpnHigh, &EndingVpnHigh, sizeof(UCHAR));
+
+    uint64_t start = ((uint64_t)StartingVpn << 12) | ((uint64_t)StartingVpnHigh << 44);
+    uint64_t end = (((uint64_t)EndingVpn + 1ll) << 12) | ((uint64_t)EndingVpnHigh << 44);
+
+    return VadNode{start, end};
+}
+
+/**
+ * Read all nodes in the _RTL_AVL_TREE structure of the process, in address order.
+ * @param nodePhysicalAddress: offset of _MMVAD_SHORT structure of the root node
+ * @return: vector of VadNode structures
+ */
+std::vector<VadNode> AddressSpace::readVadTree(uint64_t nodePhysicalAddress)
+{
+    uint64_t left = leftNode(nodePhysicalAddress);
+    uint64_t right = rightNode(nodePhysicalAddress);
+
+    std::vector<VadNode> nodes;
+
+    if (left != 0x0)
+    {
+        std::vector<VadNode> leftNodes = readVadTree(left);
+        nodes.insert(nodes.end(), leftNodes.begin(), leftNodes.end());
+    }
+
+    nodes.push_back(readVadNode(nodePhysicalAddress));
+
+    if (right != 0x0)
+    {
+        std::vector<VadNode> rightNodes = readVadTree(right);
+        nodes.insert(nodes.end(), rightNodes.begin(), rightNodes.end());
+    }
+
+    return nodes;
+}
+
+/**
+ * Read all nodes in the _RTL_AVL_TREE structure of the process.
+ * @param kProcessPhysicalAddress: offset of _EPROCESS structure of the process
+ * @return: vector of VadNode structures
+ */
+std::vector<VadNode> AddressSpace::readProcessVadTree(uint64_t kProcessPhysicalAddress)
+{
+    return readVadTree(vadRoot(kProcessPhysicalAddress));
+}
+
+static std::ptrdiff_t scanProfiles(std::ifstream& file, const std::vector<WindowsProfile>& candidates,
+                                   WindowsProfile& detected, AnalysisProgress *progress,
+                                   const PhysicalAddressSpace *physical)
+{
+    SystemProcessScanner scanner(candidates);
+    std::ptrdiff_t systemKProcessAddress = AddressSpace(file, 0).scanForSystem(scanner, progress, physical);
+    if (systemKProcessAddress != 0) {
+        detected = scanner.detected;
+    }
+    return systemKProcessAddress;
+}
+
+/**
+ * Find System and the profile matching the layout of its _EPROCESS.
+ *
+ * @param file: file stream
+ * @param candidates: profiles to probe, in order of preference
+ * @param detected: receives the matching profile with the DirectoryTableBase of System
+ * @param progress: optional token receiving the scanned bytes, the scan stops when it is cancelled
+ * @return: offset of _KPROCESS structure of System process, 0 if not found or cancelled
+ */
+std::ptrdiff_t detectProfile(std::ifstream& file, const std::vector<WindowsProfile>& candidates, WindowsProfile& detected,
+                             AnalysisProgress *progress)
+{
+    return scanProfiles(file, candidates, detected, progress, nullptr);
+}
+
+/**
+ * Find System by following PsActiveProcessHead, System is the first process of the list.
+ * The translations use the DirectoryTableBase of the header, the kernel is mapped in every process.
+ *
+ * @param file: file stream
+ * @param layout: layout of the dump, with the DirectoryTableBase and PsActiveProcessHead of its header
+ * @param candidates: profiles to probe, in order of preference
+ * @param detected: receives the matching profile with the DirectoryTableBase of System
+ * @return: offset of _KPROCESS structure of System process, 0 if not found
+ */
+static std::ptrdiff_t detectProfileFromHeader(std::ifstream& file, const DumpLayout& layout,
+                                              const std::vector<WindowsProfile>& candidates, WindowsProfile& detected)
+{
+    AddressSpace kernelSpace(file, layout.directoryTableBase, OffsetsProfile(), nullptr, layout.physical);
+    uint64_t head = kernelSpace.translate(layout.activeProcessHead, true);
+    uint64_t firstLinks;
+    if (head == 0 || !kernelSpace.readPhysical(head, &firstLinks, sizeof(uint64_t), true)) {
+        return 0;
+    }
+
+    uint64_t links = kernelSpace.translate(firstLinks, true);
+    for (const WindowsProfile& candidate : candidates) {
+        if (links <= candidate.offsets.activeProcessLinksFlink) {
+            continue;
+        }
+
+        uint64_t kProcess = links - candidate.offsets.activeProcessLinksFlink;
+        uint64_t directoryTableBase;
+        char name[16] = {0};
+        if (kernelSpace.readPhysical(kProcess + candidate.offsets.imageFileName, name, 15, true)
+            && std::strcmp(name, "System") == 0
+            && kernelSpace.readPhysical(kProcess + candidate.offsets.directoryTableBase, &directoryTableBase,
+                                        sizeof(uint64_t), true)
+            && directoryTableBase != 0) {
+            detected = candidate;
+            detected.offsets.systemDirectoryTableBase = directoryTableBase;
+            return static_cast<std::ptrdiff_t>(kProcess);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Find System and the profile matching the layout of its _EPROCESS. When the dump header records
+ * the kernel DirectoryTableBase, it is used directly instead of scanning the dump.
+ *
+ * @param file: file stream
+ * @param layout: layout of the dump
+ * @param candidates: profiles to probe, in order of preference
+ * @param detected: receives the matching profile with the DirectoryTableBase of System
+ * @param progress: optional token receiving the scanned bytes, the scan stops when it is cancelled
+ * @return: offset of _KPROCESS structure of System process, 0 if not found or cancelled
+ */
+std::ptrdiff_t detectProfile(std::ifstream& file, const DumpLayout& layout, const std::vector<WindowsProfile>& candidates,
+                             WindowsProfile& detected, AnalysisProgress *progress)
+{
+    if (layout.directoryTableBase != 0 && layout.activeProcessHead != 0) {
+        std::ptrdiff_t systemKProcessAddress = detectProfileFromHeader(file, layout, candidates, detected);
+        if (systemKProcessAddress != 0) {
+            return systemKProcessAddress;
+        }
+    }
+
+    // Without the list head, System is the process whose DirectoryTableBase is the one of the header
+    std::vector<WindowsProfile> seeded = candidates;
+    if (layout.directoryTableBase != 0) {
+        for (WindowsProfile& candidate : seeded) {
+            candidate.offsets.systemDirectoryTableBase = layout.directoryTableBase;
+        }
+    }
+    return scanProfiles(file, seeded, detected, progress, layout.physical.get());
+}
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dumpformat.h"
+#include "memory.h"
+#include "physicalspace.h"
+
+#ifndef DUDEDUMPER_ADDRESSSPACE_H
+#define DUDEDUMPER_ADDRESSSPACE_H
+
+// Must be a power of two
+#define TRANSLATION_CACHE_ENTRIES 256
+
+/*
+ * Reads and translations done through the AddressSpaces of a dump, they may be shared by several threads.
+ */
+struct AccessCounters {
+    std::atomic<uint64_t> physicalReads{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> failedReads{0};
+    std::atomic<uint64_t> translations{0};
+    std::atomic<uint64_t> translationCacheHits{0};
+};
+
+/*
+ * Virtual address space of one process (or the physical memory alone) backed by a dump reader.
+ * Given the physical address space of the dump, reads of its holes fail without touching the reader.
+ * It remembers the last translations in a small direct mapped cache and reads the kernel
+ * structures with the offsets of its profile. It isn't thread safe, every thread needs its own.
+ */
+class AddressSpace {
+public:
+    AddressSpace(std::ifstream& file, uint64_t directoryTableBase, const OffsetsProfile& profile = OffsetsProfile(),
+                 AccessCounters *counters = nullptr, std::shared_ptr<const PhysicalAddressSpace> physical = nullptr);
+
+    AddressSpace forProcess(uint64_t processDirectoryTableBase) const;
+    uint64_t directoryTableBase() const;
+    const OffsetsProfile& profile() const;
+    std::ifstream& reader();
+
+    bool readPhysical(uint64_t physicalAddress, void *buffer, size_t size, bool quiet = false);
+    uint64_t translate(uint64_t virtualAddress, bool quiet = false);
+    bool read(uint64_t virtualAddress, void *buffer, size_t size);
+    void walk(uint64_t startAddress, uint64_t endAddress, const PageMappingCallback& onMapping,
+              const PageTableCallback& onTable = nullptr);
+    void flushTranslations();
+
+    bool validateKProcess(uint64_t kProcessAddress);
+    bool probeKProcess(uint64_t kProcessAddress);
+    std::ptrdiff_t findSystemKProcess(AnalysisProgress *progress = nullptr);
+    std::ptrdiff_t scanForSystem(SystemProcessScanner& scanner, AnalysisProgress *progress = nullptr,
+                                 const PhysicalAddressSpace *physical = nullptr);
+    std::string processName(uint64_t kProcessAddress);
+    uint64_t nextProcess(uint64_t kProcessAddress);
+    uint64_t previousProcess(uint64_t kProcessAddress);
+    void walkProcessList(uint64_t systemKProcessAddress, const ProcessCallback& callback, bool readVadTrees = true,
+                         AnalysisProgress *progress = nullptr);
+    std::vector<Process> processList(uint64_t systemKProcessAddress, AnalysisProgress *progress = nullptr);
+
+    uint64_t vadRoot(uint64_t kProcessPhysicalAddress);
+    uint64_t leftNode(uint64_t nodePhysicalAddress);
+    uint64_t rightNode(uint64_t nodePhysicalAddress);
+    uint64_t parentNode(uint64_t nodePhysicalAddress);
+    VadNode readVadNode(uint64_t nodePhysicalAddress);
+    std::vector<VadNode> readVadTree(uint64_t nodePhysicalAddress);
+    std::vector<VadNode> readProcessVadTree(uint64_t kProcessPhysicalAddress);
+
+private:
+    struct TranslationEntry {
+        uint64_t virtualPage;
+        uint64_t physicalPage;
+    };
+
+    bool lookup(uint64_t virtualAddress, bool quiet, uint64_t& physicalAddress);
+    bool walkTranslation(uint64_t virtualAddress, bool quiet, uint64_t& physicalAddress);
+    uint64_t readNodeLink(uint64_t address);
+    void walkTableLevel(uint64_t tableAddress, int level, uint64_t baseAddress, uint64_t startAddress,
+                        uint64_t lastAddress, uint64_t fileSize, const PageMappingCallback& onMapping,
+                        const PageTableCallback& onTable);
+
+    std::ifstream& file;
+    uint64_t dirTableBase;
+    OffsetsProfile offsets;
+    AccessCounters *counters;
+    std::shared_ptr<const PhysicalAddressSpace> physical;
+    // Allocated on the first translation, AddressSpaces are often made for a single call
+    std::vector<TranslationEntry> translations;
+};
+
+std::ptrdiff_t detectProfile(std::ifstream& file, const std::vector<WindowsProfile>& candidates, WindowsProfile& detected,
+                             AnalysisProgress *progress = nullptr);
+std::ptrdiff_t detectProfile(std::ifstream& file, const DumpLayout& layout, const std::vector<WindowsProfile>& candidates,
+                             WindowsProfile& detected, AnalysisProgress *progress = nullptr);
+
+#endif //DUDEDUMPER_ADDRESSSPACE_H
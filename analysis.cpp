@@ -0,0 +1,386 @@
+#include "analysis.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+
+#include "addressspace.h"
+#include "batch.h"
+#include "fingerprint.h"
+#include "hashing.h"
+#include "memory.h"
+#include "pagecache.h"
+#include "streaming.h"
+
+
+/**
+ * Select the stages to run. Every stage also enables the ones it is built on.
+ *
+ * @param stages: comma separated list of fingerprint, hash, system, processes and vads
+ * @param options: receives the selected stages
+ * @return: true if all the stages are known, false otherwise
+ */
+bool parseAnalysisStages(const std::string& stages, AnalysisOptions& options)
+{
+    options.fingerprint = options.hash = options.system = options.processes = options.vads = false;
+
+    std::stringstream stageList(stages);
+    std::string stage;
+    while (std::getline(stageList, stage, ',')) {
+        if (stage == "fingerprint") {
+            options.fingerprint = true;
+        } else if (stage == "hash") {
+            options.hash = true;
+        } else if (stage == "system") {
+            options.system = true;
+        } else if (stage == "processes") {
+            options.processes = true;
+        } else if (stage == "vads") {
+            options.vads = true;
+        } else {
+            std::cerr << "Unknown stage: " << stage << "\n";
+            return false;
+        }
+    }
+
+    options.processes = options.processes || options.vads;
+    options.system = options.system || options.processes;
+
+    return true;
+}
+
+/*
+ * Measures one stage of the analysis and appends it to the result when it goes out of scope.
+ */
+class StageTimer {
+public:
+    StageTimer(const std::string& stage, AnalysisResult& result)
+        : stage(stage), result(result), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~StageTimer()
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        result.stages.push_back(StageTiming{stage, elapsed.count()});
+    }
+
+private:
+    std::string stage;
+    AnalysisResult& result;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @return: the VAD nodes as a JSON array of {start, end}
+ */
+static std::string vadTreeJson(const std::vector<VadNode>& vadTree)
+{
+    std::string nodes = "[";
+    for (size_t i = 0; i < vadTree.size(); i++) {
+        if (i != 0) {
+            nodes += ",";
+        }
+        nodes += "{\"start\":" + jsonHex(vadTree[i].startAddress) + ",\"end\":" + jsonHex(vadTree[i].endAddress) + "}";
+    }
+    nodes += "]";
+    return nodes;
+}
+
+/**
+ * @return: record of the given type, tagged with options.dumpId if it is set
+ */
+static JsonRecord analysisRecord(const AnalysisOptions& options, const std::string& type)
+{
+    JsonRecord json(type);
+    if (!options.dumpId.empty()) {
+        json.add("dump", options.dumpId);
+    }
+    return json;
+}
+
+/**
+ * Stages following the System scan, shared by dumps read from a file and from a stream: the System and
+ * profile records, the process list and the VAD trees, read in parallel.
+ *
+ * @param systemKProcessAddress: System found by the scan, 0 if it wasn't found
+ * @param profile: profile detected with System
+ * @param openStream: makes a reader of the dump, each thread reading the VAD trees gets its own
+ * @param physical: physical address space of the dump, null if it isn't known
+ * @param options: stages to run
+ * @param writer: receives the records
+ * @param pool: pool the VAD trees are read on
+ * @param result: receives System, the profile, the process count and the stage timings
+ * @param processList: receives the processes
+ * @return: false if the System stage is selected and System wasn't found, true otherwise
+ */
+static bool analyzeProcesses(std::ptrdiff_t systemKProcessAddress, const WindowsProfile& profile,
+                             const std::function<std::unique_ptr<std::ifstream>()>& openStream,
+                             const std::shared_ptr<const PhysicalAddressSpace>& physical, const AnalysisOptions& options,
+                             NdjsonWriter& writer, ThreadPool& pool, AnalysisResult& result,
+                             std::vector<Process>& processList)
+{
+    if (options.system) {
+        if (systemKProcessAddress == 0) {
+            return false;
+        }
+        result.systemKProcessAddress = systemKProcessAddress;
+        result.profile = profile.name;
+        writer.write(analysisRecord(options, "system").addHex("kProcessAddress", systemKProcessAddress));
+        writer.write(analysisRecord(options, "profile")
+                             .add("name", profile.name)
+                             .add("build", static_cast<uint64_t>(profile.build))
+                             .addHex("directoryTableBase", profile.offsets.systemDirectoryTableBase));
+    }
+
+    if (options.processes) {
+        StageTimer timer("processes", result);
+        std::unique_ptr<std::ifstream> file = openStream();
+        AddressSpace systemSpace(*file, profile.offsets.systemDirectoryTableBase, profile.offsets, nullptr, physical);
+        systemSpace.walkProcessList(systemKProcessAddress, [&](const Process& process) {
+            writer.write(analysisRecord(options, "process")
+                                 .add("index", static_cast<uint64_t>(processList.size()))
+                                 .add("name", process.ProcessName)
+                                 .addHex("kProcessAddress", process.KProcessAddress)
+                                 .addHex("directoryTableBase", process.DirectoryTableBase));
+            processList.push_back(process);
+        }, false);
+        result.processCount = processList.size();
+    }
+
+    if (options.vads) {
+        StageTimer timer("vads", result);
+        pool.parallelFor(processList.size(), [&](size_t index) {
+            std::unique_ptr<std::ifstream> processFile = openStream();
+            const Process& process = processList[index];
+            AddressSpace processSpace(*processFile, process.DirectoryTableBase, profile.offsets, nullptr, physical);
+            std::vector<VadNode> vadTree = processSpace.readProcessVadTree(process.KProcessAddress);
+
+            writer.write(analysisRecord(options, "vads")
+                                 .add("process", static_cast<uint64_t>(index))
+                                 .add("name", process.ProcessName)
+                                 .add("count", static_cast<uint64_t>(vadTree.size()))
+                                 .addRaw("nodes", vadTreeJson(vadTree)));
+        });
+    }
+
+    return true;
+}
+
+/**
+ * Run the selected stages on one dump and stream every result to the writer as soon as it is produced.
+ * Stages which read the whole dump hold a slot of options.ioLimiter while they run.
+ *
+ * @param path: path to the dump
+ * @param options: stages to run and their settings
+ * @param writer: receives the records, tagged with options.dumpId if it is set
+ * @param pool: pool the parallel parts of the stages run on
+ * @return: outcome and timings of the analysis
+ */
+AnalysisResult analyzeDump(const std::string& path, const AnalysisOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    AnalysisResult result;
+
+    auto record = [&](const std::string& type) {
+        return analysisRecord(options, type);
+    };
+
+    auto fail = [&](const std::string& stage, const std::string& message) {
+        result.failedStage = stage;
+        result.error = message;
+        writer.write(record("error").add("stage", stage).add("message", message));
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        result.elapsedMs = elapsed.count();
+        return result;
+    };
+
+    auto cache = std::make_shared<PageCache>(options.cacheSize);
+    DumpLayout layout = openDumpLayout(path);
+    CachedDumpStream file(path, cache, layout);
+    if (!file.is_open()) {
+        return fail("open", "Failed to open file: " + path);
+    }
+
+    writer.write(record("start")
+                         .add("path", path)
+                         .add("format", dumpFormatName(layout.format))
+                         .add("threads", static_cast<uint64_t>(pool.size()))
+                         .add("cacheSize", static_cast<uint64_t>(cache->capacity())));
+
+    if (options.fingerprint) {
+        StageTimer timer("fingerprint", result);
+        DumpFingerprint fingerprint = computeDumpFingerprint(path, pool);
+        writer.write(record("fingerprint")
+                             .add("fileSize", fingerprint.fileSize)
+                             .add("modificationTime", fingerprint.modificationTime)
+                             .addHex("sampleDigest", fingerprint.sampleDigest)
+                             .add("sampledPages", static_cast<uint64_t>(fingerprint.sampledPages))
+                             .add("key", fingerprint.toString()));
+    }
+
+    std::ptrdiff_t systemKProcessAddress = 0;
+    WindowsProfile profile;
+
+    if (options.hash || options.system) {
+        StageTimer timer(options.hash ? "hash" : "system", result);
+        DeviceIoSlot ioSlot(options.ioLimiter, path);
+
+        if (options.hash) {
+            SystemProcessScanner scanner(options.profiles);
+            DumpHashManifest manifest;
+            ChunkVisitor visitor = nullptr;
+            // The hash pass reads file offsets, they are physical addresses only in raw dumps
+            bool scanWhileHashing = options.system && layout.format == DumpFormat::Raw;
+            if (scanWhileHashing) {
+                visitor = [&](const DumpChunk& chunk) { scanner.scanChunk(chunk); };
+            }
+
+            if (hashDump(path, manifest, visitor, pool)) {
+                writer.write(record("hash")
+                                     .add("fileSize", manifest.fileSize)
+                                     .add("chunkSize", manifest.chunkSize)
+                                     .add("chunks", static_cast<uint64_t>(manifest.chunks.size()))
+                                     .add("sha256Root", digestToHex(manifest.sha256Root()))
+                                     .add("blake3Root", digestToHex(manifest.blake3Root())));
+            } else {
+                writer.write(record("error").add("stage", "hash").add("message", "Failed to read the dump"));
+            }
+
+            if (scanWhileHashing) {
+                systemKProcessAddress = scanner.result(file);
+                profile = scanner.detected;
+            } else if (options.system) {
+                systemKProcessAddress = detectProfile(file, layout, options.profiles, profile);
+            }
+        } else {
+            systemKProcessAddress = detectProfile(file, layout, options.profiles, profile);
+        }
+    }
+
+    std::vector<Process> processList;
+    auto openStream = [&]() -> std::unique_ptr<std::ifstream> {
+        return std::make_unique<CachedDumpStream>(path, cache, layout);
+    };
+    if (!analyzeProcesses(systemKProcessAddress, profile, openStream, layout.physical, options, writer, pool, result,
+                          processList)) {
+        return fail("system", "'System' _EPROCESS not found");
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    result.elapsedMs = elapsed.count();
+    result.succeeded = true;
+
+    writer.write(record("summary")
+                         .add("processes", static_cast<uint64_t>(processList.size()))
+                         .add("elapsedMs", result.elapsedMs)
+                         .add("cacheHits", cache->hits())
+                         .add("cacheMisses", cache->misses()));
+
+    return result;
+}
+
+/**
+ * Run the selected stages on a dump read once from a stream that can't seek, such as stdin.
+ * Hashing, the System scan and page classification share the single read pass (see streamDump), the
+ * process list and the VAD trees are then resolved from the retained pages and stop where a page is missing.
+ * The fingerprint stage needs a file and is skipped.
+ *
+ * @param input: the dump
+ * @param name: name of the input in the records, e.g. "-" for stdin
+ * @param options: stages to run and their settings
+ * @param writer: receives the records, tagged with options.dumpId if it is set
+ * @param pool: pool the pass and the VAD trees run on
+ * @return: outcome and timings of the analysis
+ */
+AnalysisResult analyzeStream(std::istream& input, const std::string& name, const AnalysisOptions& options,
+                             NdjsonWriter& writer, ThreadPool& pool)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    AnalysisResult result;
+
+    auto record = [&](const std::string& type) {
+        return analysisRecord(options, type);
+    };
+
+    auto fail = [&](const std::string& stage, const std::string& message) {
+        result.failedStage = stage;
+        result.error = message;
+        writer.write(record("error").add("stage", stage).add("message", message));
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        result.elapsedMs = elapsed.count();
+        return result;
+    };
+
+    writer.write(record("start")
+                         .add("path", name)
+                         .add("format", "stream")
+                         .add("threads", static_cast<uint64_t>(pool.size()))
+                         .add("retainLimit", static_cast<uint64_t>(options.retainLimit)));
+
+    SystemProcessScanner scanner(options.profiles);
+    StreamedDump dump;
+    {
+        StageTimer timer("stream", result);
+        StreamOptions streamOptions;
+        streamOptions.hash = options.hash;
+        streamOptions.retainLimit = options.retainLimit;
+
+        if (!streamDump(input, streamOptions, scanner, dump, pool)) {
+            return fail("stream", "Failed to read the dump from " + name);
+        }
+    }
+
+    auto pageCount = [&](PageClass pageClass) {
+        return dump.pageClasses[static_cast<size_t>(pageClass)];
+    };
+
+    writer.write(record("stream")
+                         .add("bytes", dump.size)
+                         .add("zeroPages", pageCount(PageClass::Zero))
+                         .add("pageTablePages", pageCount(PageClass::PageTable))
+                         .add("highEntropyPages", pageCount(PageClass::HighEntropy))
+                         .add("dataPages", pageCount(PageClass::Data))
+                         .add("retainedPages", static_cast<uint64_t>(dump.pages->size()))
+                         .add("droppedPages", dump.pages->dropped()));
+
+    if (options.hash) {
+        writer.write(record("hash")
+                             .add("fileSize", dump.manifest.fileSize)
+                             .add("chunkSize", dump.manifest.chunkSize)
+                             .add("chunks", static_cast<uint64_t>(dump.manifest.chunks.size()))
+                             .add("sha256Root", digestToHex(dump.manifest.sha256Root()))
+                             .add("blake3Root", digestToHex(dump.manifest.blake3Root())));
+    }
+
+    RetainedPageStream file(dump.pages);
+    std::ptrdiff_t systemKProcessAddress = 0;
+    WindowsProfile profile;
+
+    if (options.system) {
+        systemKProcessAddress = scanner.result(file);
+        profile = scanner.detected;
+    }
+
+    std::vector<Process> processList;
+    auto openStream = [&]() -> std::unique_ptr<std::ifstream> {
+        return std::make_unique<RetainedPageStream>(dump.pages);
+    };
+    if (!analyzeProcesses(systemKProcessAddress, profile, openStream, nullptr, options, writer, pool, result,
+                          processList)) {
+        return fail("system", "'System' _EPROCESS not found");
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    result.elapsedMs = elapsed.count();
+    result.succeeded = true;
+
+    writer.write(record("summary")
+                         .add("processes", static_cast<uint64_t>(processList.size()))
+                         .add("elapsedMs", result.elapsedMs)
+                         .add("bytes", dump.size)
+                         .add("retainedPages", static_cast<uint64_t>(dump.pages->size())));
+
+    return result;
+}
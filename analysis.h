@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "ndjson.h"
+#include "profile.h"
+#include "streaming.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_ANALYSIS_H
+#define DUDEDUMPER_ANALYSIS_H
+
+#define DEFAULT_CACHE_SIZE 0x10000000
+
+class DeviceIoLimiter;
+
+struct AnalysisOptions {
+    size_t cacheSize = DEFAULT_CACHE_SIZE;
+    size_t retainLimit = STREAM_RETAIN_LIMIT;
+    bool fingerprint = false;
+    bool hash = false;
+    bool system = true;
+    bool processes = true;
+    bool vads = true;
+    std::string dumpId;
+    std::vector<WindowsProfile> profiles = builtinProfiles();
+    DeviceIoLimiter *ioLimiter = nullptr;
+};
+
+struct StageTiming {
+    std::string stage;
+    double elapsedMs;
+};
+
+struct AnalysisResult {
+    bool succeeded = false;
+    std::string failedStage;
+    std::string error;
+    uint64_t systemKProcessAddress = 0;
+    std::string profile;
+    size_t processCount = 0;
+    std::vector<StageTiming> stages;
+    double elapsedMs = 0;
+};
+
+bool parseAnalysisStages(const std::string& stages, AnalysisOptions& options);
+AnalysisResult analyzeDump(const std::string& path, const AnalysisOptions& options, NdjsonWriter& writer,
+                           ThreadPool& pool = ThreadPool::global());
+AnalysisResult analyzeStream(std::istream& input, const std::string& name, const AnalysisOptions& options,
+                             NdjsonWriter& writer, ThreadPool& pool = ThreadPool::global());
+
+#endif //DUDEDUMPER_ANALYSIS_H
@@ -0,0 +1,247 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+
+DeviceIoLimiter::DeviceIoLimiter(size_t readsPerDevice)
+    : readsPerDevice(std::max<size_t>(readsPerDevice, 1))
+{
+}
+
+/**
+ * Wait until the device has a free read slot and take it.
+ *
+ * @param device: device id from storageDeviceId
+ */
+void DeviceIoLimiter::acquire(const std::string& device)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [&]() { return activeReads[device] < readsPerDevice; });
+    activeReads[device]++;
+}
+
+/**
+ * Give back a slot taken with acquire.
+ *
+ * @param device: device id from storageDeviceId
+ */
+void DeviceIoLimiter::release(const std::string& device)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        activeReads[device]--;
+    }
+    released.notify_all();
+}
+
+DeviceIoSlot::DeviceIoSlot(DeviceIoLimiter *limiter, const std::string& path)
+    : limiter(limiter)
+{
+    if (limiter != nullptr) {
+        device = storageDeviceId(path);
+        limiter->acquire(device);
+    }
+}
+
+DeviceIoSlot::~DeviceIoSlot()
+{
+    if (limiter != nullptr) {
+        limiter->release(device);
+    }
+}
+
+/**
+ * Identify the storage device a file lives on.
+ *
+ * @param path: path to the file
+ * @return: the drive (e.g. "C:") on Windows, the st_dev number elsewhere, empty if unknown
+ */
+std::string storageDeviceId(const std::string& path)
+{
+#ifdef _WIN32
+    std::error_code error;
+    return std::filesystem::absolute(path, error).root_name().string();
+#else
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0) {
+        return "";
+    }
+    return std::to_string(static_cast<unsigned long long>(status.st_dev));
+#endif
+}
+
+/**
+ * Read the list of dumps to analyze: one path per line, blank lines and lines starting with '#' are skipped.
+ * Relative paths are resolved against the directory of the manifest.
+ *
+ * @param manifestPath: path to the manifest
+ * @return: paths of the dumps in manifest order
+ */
+std::vector<std::string> readBatchManifest(const std::string& manifestPath)
+{
+    std::vector<std::string> paths;
+
+    std::ifstream manifest(manifestPath);
+    if (!manifest.is_open()) {
+        std::cerr << "Failed to open manifest: " << manifestPath << "\n";
+        return paths;
+    }
+
+    std::filesystem::path baseDirectory = std::filesystem::path(manifestPath).parent_path();
+
+    std::string line;
+    while (std::getline(manifest, line)) {
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::filesystem::path dumpPath(line);
+        if (dumpPath.is_relative()) {
+            dumpPath = baseDirectory / dumpPath;
+        }
+        paths.push_back(dumpPath.string());
+    }
+
+    return paths;
+}
+
+/**
+ * Number of dumps to analyze at the same time. Every dump mostly waits on I/O or on its inner parallel
+ * stages, which all run on the shared pool, so a quarter of the hardware threads keeps the pool busy
+ * without oversubscribing it.
+ *
+ * @param dumpCount: number of dumps in the batch
+ * @return: number of concurrent jobs
+ */
+size_t defaultBatchJobs(size_t dumpCount)
+{
+    size_t jobs = std::max<size_t>(std::thread::hardware_concurrency() / 4, 1);
+    return std::max<size_t>(std::min(jobs, dumpCount), 1);
+}
+
+/**
+ * Analyze all the dumps. Up to options.jobs dumps run at the same time on their own job threads,
+ * their parallel stages share the pool, and their whole-dump reads are limited per storage device.
+ * Records are tagged with the index of their dump, a progress record follows every finished dump.
+ *
+ * @param paths: dumps to analyze
+ * @param options: analysis stages and scheduling limits
+ * @param writer: receives the records of all the dumps
+ * @param pool: pool shared by the parallel stages of all the dumps
+ * @return: per-dump outcome and timings
+ */
+BatchReport runBatch(const std::vector<std::string>& paths, const BatchOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    BatchReport report;
+    report.jobs.resize(paths.size());
+    report.concurrentJobs = options.jobs != 0 ? std::min(options.jobs, std::max<size_t>(paths.size(), 1))
+                                              : defaultBatchJobs(paths.size());
+    report.threads = pool.size();
+
+    DeviceIoLimiter ioLimiter(options.readsPerDevice);
+    std::atomic<size_t> nextDump{0};
+    std::atomic<size_t> completed{0};
+
+    // Job threads are not pool workers: a job blocking on its stages never holds a worker the stages need.
+    auto runJobs = [&]() {
+        for (size_t index = nextDump++; index < paths.size(); index = nextDump++) {
+            BatchJobReport& job = report.jobs[index];
+            job.path = paths[index];
+            job.device = storageDeviceId(paths[index]);
+
+            std::chrono::duration<double, std::milli> queued = std::chrono::steady_clock::now() - startTime;
+            job.queuedMs = queued.count();
+
+            AnalysisOptions analysisOptions = options.analysis;
+            analysisOptions.dumpId = std::to_string(index);
+            analysisOptions.ioLimiter = &ioLimiter;
+            job.result = analyzeDump(paths[index], analysisOptions, writer, pool);
+
+            writer.write(JsonRecord("progress")
+                                 .add("dump", std::to_string(index))
+                                 .add("path", paths[index])
+                                 .add("succeeded", job.result.succeeded)
+                                 .add("elapsedMs", job.result.elapsedMs)
+                                 .add("completed", static_cast<uint64_t>(++completed))
+                                 .add("total", static_cast<uint64_t>(paths.size())));
+        }
+    };
+
+    std::vector<std::thread> jobThreads;
+    for (size_t i = 0; i < report.concurrentJobs; i++) {
+        jobThreads.emplace_back(runJobs);
+    }
+    for (auto& thread : jobThreads) {
+        thread.join();
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    report.elapsedMs = elapsed.count();
+
+    return report;
+}
+
+/**
+ * @return: the report as a JSON document
+ */
+std::string BatchReport::toJson() const
+{
+    std::ostringstream json;
+
+    size_t succeeded = std::count_if(jobs.begin(), jobs.end(), [](const BatchJobReport& job) {
+        return job.result.succeeded;
+    });
+
+    json << "{\"dumps\":" << jobs.size()
+         << ",\"succeeded\":" << succeeded
+         << ",\"concurrentJobs\":" << concurrentJobs
+         << ",\"threads\":" << threads
+         << ",\"elapsedMs\":" << elapsedMs
+         << ",\"jobs\":[";
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const BatchJobReport& job = jobs[i];
+        if (i != 0) {
+            json << ",";
+        }
+
+        json << "{\"path\":" << jsonEscape(job.path)
+             << ",\"device\":" << jsonEscape(job.device)
+             << ",\"succeeded\":" << (job.result.succeeded ? "true" : "false")
+             << ",\"failedStage\":" << jsonEscape(job.result.failedStage)
+             << ",\"error\":" << jsonEscape(job.result.error)
+             << ",\"profile\":" << jsonEscape(job.result.profile)
+             << ",\"processes\":" << job.result.processCount
+             << ",\"queuedMs\":" << job.queuedMs
+             << ",\"elapsedMs\":" << job.result.elapsedMs
+             << ",\"stages\":{";
+
+        for (size_t j = 0; j < job.result.stages.size(); j++) {
+            if (j != 0) {
+                json << ",";
+            }
+            json << jsonEscape(job.result.stages[j].stage) << ":" << job.result.stages[j].elapsedMs;
+        }
+
+        json << "}}";
+    }
+
+    json << "]}";
+    return json.str();
+}
@@ -0,0 +1,77 @@
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "ndjson.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_BATCH_H
+#define DUDEDUMPER_BATCH_H
+
+/*
+ * Bounds the number of whole-dump reads running at the same time on every storage device,
+ * so concurrent jobs on one disk don't turn its sequential reads into seeks.
+ */
+class DeviceIoLimiter {
+public:
+    explicit DeviceIoLimiter(size_t readsPerDevice);
+
+    void acquire(const std::string& device);
+    void release(const std::string& device);
+
+private:
+    size_t readsPerDevice;
+    std::map<std::string, size_t> activeReads;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+/*
+ * Holds a DeviceIoLimiter slot for the device of a path while in scope. Does nothing without a limiter.
+ */
+class DeviceIoSlot {
+public:
+    DeviceIoSlot(DeviceIoLimiter *limiter, const std::string& path);
+    ~DeviceIoSlot();
+
+    DeviceIoSlot(const DeviceIoSlot&) = delete;
+    DeviceIoSlot& operator=(const DeviceIoSlot&) = delete;
+
+private:
+    DeviceIoLimiter *limiter;
+    std::string device;
+};
+
+struct BatchOptions {
+    AnalysisOptions analysis;
+    size_t jobs = 0;
+    size_t readsPerDevice = 1;
+};
+
+struct BatchJobReport {
+    std::string path;
+    std::string device;
+    AnalysisResult result;
+    double queuedMs = 0;
+};
+
+struct BatchReport {
+    std::vector<BatchJobReport> jobs;
+    size_t concurrentJobs = 0;
+    size_t threads = 0;
+    double elapsedMs = 0;
+
+    std::string toJson() const;
+};
+
+std::string storageDeviceId(const std::string& path);
+std::vector<std::string> readBatchManifest(const std::string& manifestPath);
+size_t defaultBatchJobs(size_t dumpCount);
+BatchReport runBatch(const std::vector<std::string>& paths, const BatchOptions& options, NdjsonWriter& writer,
+                     ThreadPool& pool = ThreadPool::global());
+
+#endif //DUDEDUMPER_BATCH_H
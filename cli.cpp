@@ -0,0 +1,418 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "analysis.h"
+#include "batch.h"
+#include "compresseddump.h"
+#include "ndjson.h"
+#include "pagestore.h"
+#include "pdb.h"
+#include "profile.h"
+#include "threadpool.h"
+#include "triage.h"
+
+#define STDIN_BUFFER_SIZE 0x100000
+
+struct CliOptions {
+    std::string path;
+    std::string batchManifest;
+    std::string reportPath;
+    std::string profileDirectory = PROFILE_DIRECTORY;
+    std::string profileName;
+    std::string pdbPath;
+    std::string compressPath;
+    std::string triagePath;
+    std::vector<std::string> triageProcesses;
+    std::string storeDirectory;
+    std::string storeName;
+    size_t threads = 0;
+    bool stream = false;
+    BatchOptions batch;
+};
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] <dump>\n"
+              << "       " << program << " [options] -              (read the dump from stdin)\n"
+              << "       " << program << " [options] --batch <manifest>\n"
+              << "Analyze physical memory dumps and write the results to stdout as NDJSON.\n\n"
+              << "  -t, --threads <n>       worker threads (default: hardware threads)\n"
+              << "  -c, --cache-size <size> page cache size per dump, K/M/G suffixes allowed (default: 256M)\n"
+              << "  -s, --stages <list>     comma separated stages to run (default: system,processes,vads)\n"
+              << "                          fingerprint  sampled dump fingerprint\n"
+              << "                          hash         SHA-256/BLAKE3 Merkle manifest, shares the read with system\n"
+              << "                          system       System _EPROCESS discovery\n"
+              << "                          processes    process list\n"
+              << "                          vads         VAD tree of every process\n"
+              << "  -b, --batch <manifest>  analyze every dump listed in the manifest, one path per line\n"
+              << "  -j, --jobs <n>          dumps analyzed at the same time in batch mode (default: threads / 4)\n"
+              << "  --reads-per-device <n>  concurrent whole-dump reads per storage device (default: 1)\n"
+              << "  -r, --report <file>     write the batch summary report to the file\n"
+              << "  -p, --profiles <dir>    directory of JSON structure profiles, probed before the built-in ones\n"
+              << "                          (default: " PROFILE_DIRECTORY ")\n"
+              << "  --profile <name>        use this profile instead of detecting it\n"
+              << "  --pdb <file>            make a profile from an ntoskrnl PDB and save it in the profile directory,\n"
+              << "                          without a dump the profile is written to stdout\n"
+              << "  --compress <file>       convert the dump to a seekable compressed dump and exit\n"
+              << "  --triage <file>         export the processes given with --triage-processes as a bitmap crash\n"
+              << "                          dump holding their pages and the structures to walk them, and exit\n"
+              << "  --triage-processes <list>\n"
+              << "                          comma separated process names or indexes in the process list\n"
+              << "  --ingest <dir>          add the dump to the deduplicated page store in the directory and exit,\n"
+              << "                          the stored dump is opened from <dir>/<name>.ddpages\n"
+              << "  --name <name>           name of the dump in the page store (default: file name of the dump)\n"
+              << "  --stream                read the dump once, front to back, as for stdin and pipes;\n"
+              << "                          the fingerprint stage is skipped\n"
+              << "  --retain-limit <size>   memory kept for the structure walks in stream mode (default: 1G)\n"
+              << "  -h, --help              show this help\n";
+}
+
+/**
+ * Parse a size such as "512M".
+ *
+ * @param text: number with an optional K, M or G suffix
+ * @param size: receives the size in bytes
+ * @return: true if the text is a valid size, false otherwise
+ */
+static bool parseSize(const std::string& text, size_t& size)
+{
+    char *end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) {
+        return false;
+    }
+
+    std::string suffix(end);
+    if (suffix == "K" || suffix == "k") {
+        value <<= 10;
+    } else if (suffix == "M" || suffix == "m") {
+        value <<= 20;
+    } else if (suffix == "G" || suffix == "g") {
+        value <<= 30;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+
+    size = static_cast<size_t>(value);
+    return true;
+}
+
+/**
+ * @param text: comma separated list
+ * @return: the non-empty entries of the list
+ */
+static std::vector<std::string> splitList(const std::string& text)
+{
+    std::vector<std::string> entries;
+    std::stringstream list(text);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        if (!entry.empty()) {
+            entries.push_back(entry);
+        }
+    }
+    return entries;
+}
+
+static bool parseArguments(int argc, char **argv, CliOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (argument == "-h" || argument == "--help") {
+            return false;
+        } else if ((argument == "-t" || argument == "--threads") && hasValue) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((argument == "-c" || argument == "--cache-size") && hasValue) {
+            if (!parseSize(argv[++i], options.batch.analysis.cacheSize)) {
+                std::cerr << "Invalid cache size: " << argv[i] << "\n";
+                return false;
+            }
+        } else if ((argument == "-s" || argument == "--stages") && hasValue) {
+            if (!parseAnalysisStages(argv[++i], options.batch.analysis)) {
+                return false;
+            }
+        } else if ((argument == "-b" || argument == "--batch") && hasValue) {
+            options.batchManifest = argv[++i];
+        } else if ((argument == "-j" || argument == "--jobs") && hasValue) {
+            options.batch.jobs = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argument == "--reads-per-device" && hasValue) {
+            options.batch.readsPerDevice = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((argument == "-r" || argument == "--report") && hasValue) {
+            options.reportPath = argv[++i];
+        } else if ((argument == "-p" || argument == "--profiles") && hasValue) {
+            options.profileDirectory = argv[++i];
+        } else if (argument == "--profile" && hasValue) {
+            options.profileName = argv[++i];
+        } else if (argument == "--pdb" && hasValue) {
+            options.pdbPath = argv[++i];
+        } else if (argument == "--compress" && hasValue) {
+            options.compressPath = argv[++i];
+        } else if (argument == "--triage" && hasValue) {
+            options.triagePath = argv[++i];
+        } else if (argument == "--triage-processes" && hasValue) {
+            options.triageProcesses = splitList(argv[++i]);
+        } else if (argument == "--ingest" && hasValue) {
+            options.storeDirectory = argv[++i];
+        } else if (argument == "--name" && hasValue) {
+            options.storeName = argv[++i];
+        } else if (argument == "--stream") {
+            options.stream = true;
+        } else if (argument == "--retain-limit" && hasValue) {
+            if (!parseSize(argv[++i], options.batch.analysis.retainLimit)) {
+                std::cerr << "Invalid retain limit: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (argument == "-" && options.path.empty()) {
+            options.path = argument;
+            options.stream = true;
+        } else if (!argument.empty() && argument[0] != '-' && options.path.empty()) {
+            options.path = argument;
+        } else {
+            std::cerr << "Unexpected argument: " << argument << "\n";
+            return false;
+        }
+    }
+
+    if (options.path.empty() && options.batchManifest.empty()) {
+        return !options.pdbPath.empty();
+    }
+    if (!options.compressPath.empty()) {
+        return !options.path.empty() && !options.stream && options.batchManifest.empty();
+    }
+    if (!options.storeDirectory.empty()) {
+        return !options.path.empty() && !options.stream && options.batchManifest.empty();
+    }
+    if (!options.triagePath.empty()) {
+        return !options.path.empty() && !options.stream && options.batchManifest.empty()
+               && !options.triageProcesses.empty();
+    }
+    return options.path.empty() != options.batchManifest.empty();
+}
+
+static int runCompressMode(const CliOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    if (!compressDump(options.path, options.compressPath, pool)) {
+        writer.write(JsonRecord("error").add("stage", "compress").add("message", "Failed to compress " + options.path));
+        return 1;
+    }
+
+    std::error_code error;
+    uint64_t inputSize = std::filesystem::file_size(options.path, error);
+    uint64_t outputSize = std::filesystem::file_size(options.compressPath, error);
+    writer.write(JsonRecord("compress")
+                     .add("path", options.path)
+                     .add("output", options.compressPath)
+                     .add("inputBytes", inputSize)
+                     .add("outputBytes", outputSize));
+    return 0;
+}
+
+static int runTriageMode(const CliOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    TriageOptions triage;
+    triage.processes = options.triageProcesses;
+    triage.profiles = options.batch.analysis.profiles;
+    triage.cacheSize = options.batch.analysis.cacheSize;
+
+    TriageSummary summary;
+    if (!writeTriageDump(options.path, options.triagePath, triage, summary, pool)) {
+        writer.write(JsonRecord("error").add("stage", "triage").add("message", "Failed to export " + options.path));
+        return 1;
+    }
+
+    std::string names = "[";
+    for (size_t i = 0; i < summary.processes.size(); i++) {
+        names += (i == 0 ? "" : ",") + jsonEscape(summary.processes[i]);
+    }
+    names += "]";
+
+    std::error_code error;
+    uint64_t inputSize = std::filesystem::file_size(options.path, error);
+    uint64_t outputSize = std::filesystem::file_size(options.triagePath, error);
+    writer.write(JsonRecord("triage")
+                     .add("path", options.path)
+                     .add("output", options.triagePath)
+                     .addRaw("processes", names)
+                     .add("structurePages", summary.structurePages)
+                     .add("dataPages", summary.dataPages)
+                     .add("missingPages", summary.missingPages)
+                     .add("inputBytes", inputSize)
+                     .add("outputBytes", outputSize));
+    return 0;
+}
+
+static int runIngestMode(const CliOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    std::string name = options.storeName;
+    if (name.empty()) {
+        name = std::filesystem::path(options.path).filename().string();
+    }
+
+    IngestSummary summary;
+    if (!ingestDump(options.path, options.storeDirectory, name, summary, pool)) {
+        writer.write(JsonRecord("error").add("stage", "ingest").add("message", "Failed to store " + options.path));
+        return 1;
+    }
+
+    writer.write(JsonRecord("ingest")
+                     .add("path", options.path)
+                     .add("index", summary.indexPath)
+                     .add("dumpPages", summary.dumpPages)
+                     .add("newPages", summary.newPages)
+                     .add("packPages", summary.packPages)
+                     .add("packBytes", summary.packPages * PAGE_SIZE));
+    return 0;
+}
+
+/*
+ * Stream buffer reading stdin in binary mode, STDIN_BUFFER_SIZE bytes per fread. std::cin may translate
+ * line endings (and stop at 0x1a) on Windows, and reads it unbuffered while synced with stdio.
+ */
+class StdinBuf : public std::streambuf {
+public:
+    StdinBuf()
+        : buffer(STDIN_BUFFER_SIZE)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    }
+
+protected:
+    int_type underflow() override
+    {
+        size_t size = std::fread(buffer.data(), 1, buffer.size(), stdin);
+        if (size == 0) {
+            return traits_type::eof();
+        }
+        setg(buffer.data(), buffer.data(), buffer.data() + size);
+        return traits_type::to_int_type(buffer[0]);
+    }
+
+private:
+    std::vector<char> buffer;
+};
+
+static int runStreamMode(const CliOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    AnalysisResult result;
+    if (options.path == "-") {
+        StdinBuf stdinBuffer;
+        std::istream input(&stdinBuffer);
+        result = analyzeStream(input, options.path, options.batch.analysis, writer, pool);
+    } else {
+        std::ifstream input(options.path, std::ios::binary);
+        if (!input.is_open()) {
+            writer.write(JsonRecord("error").add("stage", "open").add("message", "Failed to open file: " + options.path));
+            return 1;
+        }
+        result = analyzeStream(input, options.path, options.batch.analysis, writer, pool);
+    }
+
+    return result.succeeded ? 0 : 2;
+}
+
+static int runBatchMode(const CliOptions& options, NdjsonWriter& writer, ThreadPool& pool)
+{
+    std::vector<std::string> paths = readBatchManifest(options.batchManifest);
+    if (paths.empty()) {
+        writer.write(JsonRecord("error").add("stage", "batch").add("message", "No dumps in " + options.batchManifest));
+        return 1;
+    }
+
+    BatchReport report = runBatch(paths, options.batch, writer, pool);
+    writer.write(JsonRecord("batch").addRaw("report", report.toJson()));
+
+    if (!options.reportPath.empty()) {
+        std::ofstream reportFile(options.reportPath, std::ios::trunc);
+        if (!reportFile.is_open()) {
+            std::cerr << "Failed to write the report to " << options.reportPath << "\n";
+            return 1;
+        }
+        reportFile << report.toJson() << "\n";
+    }
+
+    for (auto& job : report.jobs) {
+        if (!job.result.succeeded) {
+            return 2;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    CliOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!options.pdbPath.empty()) {
+        WindowsProfile pdbProfile;
+        if (!profileFromPdb(options.pdbPath, pdbProfile, options.profileDirectory)) {
+            return 1;
+        }
+        if (options.path.empty() && options.batchManifest.empty()) {
+            std::cout << profileToJson(pdbProfile) << "\n";
+            return 0;
+        }
+    }
+
+    options.batch.analysis.profiles = candidateProfiles(options.profileDirectory);
+    if (!options.profileName.empty()) {
+        const WindowsProfile *profile = findProfile(options.batch.analysis.profiles, options.profileName);
+        if (profile == nullptr) {
+            std::cerr << "Unknown profile: " << options.profileName << "\n";
+            return 1;
+        }
+        options.batch.analysis.profiles = {*profile};
+    }
+
+    ThreadPool::configureGlobal(options.threads);
+    ThreadPool& pool = ThreadPool::global();
+    NdjsonWriter writer(std::cout);
+
+    if (!options.compressPath.empty()) {
+        return runCompressMode(options, writer, pool);
+    }
+
+    if (!options.storeDirectory.empty()) {
+        return runIngestMode(options, writer, pool);
+    }
+
+    if (!options.triagePath.empty()) {
+        return runTriageMode(options, writer, pool);
+    }
+
+    if (!options.batchManifest.empty()) {
+        return runBatchMode(options, writer, pool);
+    }
+
+    // Pipes can only be read once
+    std::error_code error;
+    if (options.stream || std::filesystem::is_fifo(options.path, error)) {
+        return runStreamMode(options, writer, pool);
+    }
+
+    AnalysisResult result = analyzeDump(options.path, options.batch.analysis, writer, pool);
+    if (!result.succeeded) {
+        return result.failedStage == "open" ? 1 : 2;
+    }
+
+    return 0;
+}
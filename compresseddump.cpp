@@ -0,0 +1,488 @@
+#include "compresseddump.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <zstd.h>
+
+#include "pagecache.h"
+#include "physicalspace.h"
+
+
+static ZSTD_DCtx *decompressionContext()
+{
+    struct Context {
+        ZSTD_DCtx *context = ZSTD_createDCtx();
+        ~Context() { ZSTD_freeDCtx(context); }
+    };
+    thread_local Context threadContext;
+    return threadContext.context;
+}
+
+static ZSTD_CCtx *compressionContext()
+{
+    struct Context {
+        ZSTD_CCtx *context = ZSTD_createCCtx();
+        ~Context() { ZSTD_freeCCtx(context); }
+    };
+    thread_local Context threadContext;
+    return threadContext.context;
+}
+
+static bool readFooter(const uint8_t *data, uint64_t fileSize, CompressedDumpFooter& footer)
+{
+    if (fileSize < sizeof(CompressedDumpFooter)) {
+        return false;
+    }
+    std::memcpy(&footer, data + fileSize - sizeof(CompressedDumpFooter), sizeof(CompressedDumpFooter));
+    return std::memcmp(footer.magic, COMPRESSED_DUMP_MAGIC, COMPRESSED_DUMP_MAGIC_SIZE) == 0;
+}
+
+/**
+ * @param file: file stream
+ * @return: true if the file ends with the footer of a compressed dump
+ */
+bool isCompressedDump(std::istream& file)
+{
+    file.clear();
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    if (fileSize < static_cast<std::streamoff>(sizeof(CompressedDumpFooter))) {
+        return false;
+    }
+
+    uint8_t footer[sizeof(CompressedDumpFooter)];
+    file.seekg(fileSize - static_cast<std::streamoff>(sizeof(footer)), std::ios::beg);
+    CompressedDumpFooter parsed;
+    return file.read(reinterpret_cast<char *>(footer), sizeof(footer)) && readFooter(footer, sizeof(footer), parsed);
+}
+
+/**
+ * @return: true if the dump's block index is valid
+ */
+bool BlockCompressedDump::isOpen() const
+{
+    return valid;
+}
+
+/**
+ * @return: size of the decompressed dump
+ */
+uint64_t BlockCompressedDump::size() const
+{
+    return decompressedSize;
+}
+
+/**
+ * @return: distance between the starts of two blocks in the decompressed dump
+ */
+uint64_t BlockCompressedDump::blockSize() const
+{
+    return stride;
+}
+
+/**
+ * Called by derived classes once their index is valid.
+ *
+ * @param blockSize: distance between the starts of two blocks in the decompressed dump
+ * @param blockCount: number of blocks
+ * @param decompressedSize: size of the decompressed dump
+ * @param cacheSize: upper bound of the decompressed blocks kept in memory
+ */
+void BlockCompressedDump::initializeCache(uint64_t blockSize, uint64_t blockCount, uint64_t decompressedSize,
+                                          size_t cacheSize)
+{
+    stride = blockSize;
+    this->blockCount = blockCount;
+    this->decompressedSize = decompressedSize;
+    capacityBlocks = std::max<size_t>(cacheSize / blockSize, 1);
+    valid = true;
+}
+
+/**
+ * @param index: block missing from the cache
+ * @return: number of blocks to decompress from it on, 1 by default
+ */
+uint64_t BlockCompressedDump::readAheadBlocks([[maybe_unused]] uint64_t index) const
+{
+    return 1;
+}
+
+DecompressedBlock BlockCompressedDump::insert(uint64_t index, DecompressedBlock data)
+{
+    auto found = cached.find(index);
+    if (found != cached.end()) {
+        return found->second->second;
+    }
+
+    lru.emplace_front(index, std::move(data));
+    cached[index] = lru.begin();
+    while (lru.size() > capacityBlocks) {
+        cached.erase(lru.back().first);
+        lru.pop_back();
+    }
+
+    return lru.front().second;
+}
+
+/**
+ * Decompressed content of a block, from the cache or decompressed without holding the lock. On a miss the
+ * blocks read ahead with it are decompressed in parallel.
+ *
+ * @param index: index of the block
+ * @return: the block, null if it's past the end or can't be decompressed
+ */
+DecompressedBlock BlockCompressedDump::block(uint64_t index)
+{
+    if (!valid || index >= blockCount) {
+        return nullptr;
+    }
+
+    std::vector<uint64_t> missing;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = cached.find(index);
+        if (found != cached.end()) {
+            lru.splice(lru.begin(), lru, found->second);
+            hitCount++;
+            return found->second->second;
+        }
+
+        uint64_t count = std::min<uint64_t>(std::min<uint64_t>(readAheadBlocks(index), capacityBlocks),
+                                            blockCount - index);
+        missing.push_back(index);
+        for (uint64_t next = index + 1; next < index + count; next++) {
+            if (!cached.contains(next)) {
+                missing.push_back(next);
+            }
+        }
+    }
+
+    missCount += missing.size();
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> blocks(missing.size());
+    std::vector<uint8_t> decompressed(missing.size(), false);
+    auto decompressOne = [&](size_t i) {
+        blocks[i] = std::make_shared<std::vector<uint8_t>>();
+        decompressed[i] = decompress(missing[i], *blocks[i]);
+    };
+    if (missing.size() == 1) {
+        decompressOne(0);
+    } else {
+        ThreadPool::global().parallelFor(missing.size(), decompressOne);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // The requested block goes in last, so it's the most recently used
+    for (size_t i = missing.size(); i-- > 1;) {
+        if (decompressed[i]) {
+            insert(missing[i], blocks[i]);
+        }
+    }
+    return decompressed[0] ? insert(index, blocks[0]) : nullptr;
+}
+
+/**
+ * @return: number of blocks served from the cache
+ */
+uint64_t BlockCompressedDump::hits() const
+{
+    return hitCount;
+}
+
+/**
+ * @return: number of blocks which had to be decompressed
+ */
+uint64_t BlockCompressedDump::misses() const
+{
+    return missCount;
+}
+
+/**
+ * Check the footer, the index and the runs of a mapped compressed dump, isOpen tells whether they are valid.
+ *
+ * @param file: mapping of the compressed dump
+ * @param cacheSize: upper bound of the decompressed blocks kept in memory
+ */
+CompressedDump::CompressedDump(std::shared_ptr<const MappedFile> file, size_t cacheSize)
+    : file(std::move(file))
+{
+    if (!this->file || !this->file->isOpen() || !readFooter(this->file->data(), this->file->size(), footer)) {
+        return;
+    }
+
+    uint64_t blockSize = footer.blockSize;
+    uint64_t indexSize = (footer.blockCount + 1) * sizeof(uint64_t);
+    uint64_t runsSize = footer.runCount * sizeof(CompressedDumpRun);
+    if (footer.version != COMPRESSED_DUMP_VERSION || blockSize < PAGE_SIZE || (blockSize & (blockSize - 1)) != 0
+        || footer.blockCount != (footer.uncompressedSize + blockSize - 1) / blockSize
+        || footer.runCount > this->file->size() / sizeof(CompressedDumpRun)
+        || footer.indexOffset + indexSize + runsSize + sizeof(CompressedDumpFooter) != this->file->size()) {
+        std::cerr << "Invalid compressed dump index\n";
+        return;
+    }
+
+    auto table = std::make_shared<RunTable>();
+    if (!readRuns(*table)) {
+        std::cerr << "Invalid compressed dump runs\n";
+        return;
+    }
+    runTable = table;
+
+    initializeCache(blockSize, footer.blockCount, footer.uncompressedSize, cacheSize);
+}
+
+/**
+ * @param runTable: receives the runs stored after the index, finalized
+ * @return: true if the runs are stored one after the other and fill the decompressed dump, false otherwise
+ */
+bool CompressedDump::readRuns(RunTable& runTable) const
+{
+    const uint8_t *runs = file->data() + footer.indexOffset + (footer.blockCount + 1) * sizeof(uint64_t);
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < footer.runCount; i++) {
+        CompressedDumpRun run;
+        std::memcpy(&run, runs + i * sizeof(CompressedDumpRun), sizeof(CompressedDumpRun));
+        if (run.offset != offset || run.size > footer.uncompressedSize - offset) {
+            return false;
+        }
+        runTable.add(run.start, run.size, run.offset);
+        offset += run.size;
+    }
+
+    runTable.finalize();
+    return offset == footer.uncompressedSize;
+}
+
+/**
+ * @return: physical memory of the source dump, mapped to offsets in the decompressed dump
+ */
+std::shared_ptr<const RunTable> CompressedDump::runs() const
+{
+    return runTable;
+}
+
+/**
+ * @return: DirectoryTableBase recorded by the source dump, 0 if it had none
+ */
+uint64_t CompressedDump::directoryTableBase() const
+{
+    return footer.directoryTableBase;
+}
+
+/**
+ * @return: PsActiveProcessHead recorded by the source dump, 0 if it had none
+ */
+uint64_t CompressedDump::activeProcessHead() const
+{
+    return footer.activeProcessHead;
+}
+
+uint64_t CompressedDump::blockOffset(uint64_t index) const
+{
+    uint64_t offset;
+    std::memcpy(&offset, file->data() + footer.indexOffset + index * sizeof(uint64_t), sizeof(uint64_t));
+    return offset;
+}
+
+bool CompressedDump::decompress(uint64_t index, std::vector<uint8_t>& data) const
+{
+    uint64_t start = blockOffset(index);
+    uint64_t end = blockOffset(index + 1);
+    uint64_t size = std::min<uint64_t>(footer.blockSize, footer.uncompressedSize - index * footer.blockSize);
+    if (start > end || end > footer.indexOffset) {
+        std::cerr << "Invalid offset of compressed block " << index << "\n";
+        return false;
+    }
+
+    data.resize(size);
+    // Blocks which didn't compress are stored as is
+    if (end - start == size) {
+        std::memcpy(data.data(), file->data() + start, size);
+        return true;
+    }
+
+    size_t result = ZSTD_decompressDCtx(decompressionContext(), data.data(), size, file->data() + start, end - start);
+    if (ZSTD_isError(result) || result != size) {
+        std::cerr << "Failed to decompress block " << index << ": "
+                  << (ZSTD_isError(result) ? ZSTD_getErrorName(result) : "wrong size") << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read physical memory of a run, pages failing to read read as zeros.
+ */
+static void readRange(std::ifstream& input, uint64_t physicalAddress, uint8_t *buffer, size_t size)
+{
+    input.clear();
+    input.seekg(static_cast<std::streamoff>(physicalAddress), std::ios::beg);
+    if (input.read(reinterpret_cast<char *>(buffer), static_cast<std::streamsize>(size))) {
+        return;
+    }
+
+    for (size_t page = 0; page < size; page += PAGE_SIZE) {
+        size_t pageSize = std::min<size_t>(PAGE_SIZE, size - page);
+        input.clear();
+        input.seekg(static_cast<std::streamoff>(physicalAddress + page), std::ios::beg);
+        if (!input.read(reinterpret_cast<char *>(buffer + page), static_cast<std::streamsize>(pageSize))) {
+            std::memset(buffer + page, 0, pageSize);
+        }
+    }
+}
+
+/**
+ * Read a block of the decompressed dump, the bytes of the runs follow each other in it.
+ *
+ * @param input: source dump
+ * @param runs: runs of the source dump, in order of offset
+ * @param offset: offset of the block in the decompressed dump
+ * @param block: receives the block, already sized
+ */
+static void readBlock(std::ifstream& input, const std::vector<CompressedDumpRun>& runs, uint64_t offset,
+                      std::vector<uint8_t>& block)
+{
+    auto run = std::upper_bound(runs.begin(), runs.end(), offset, [](uint64_t value, const CompressedDumpRun& candidate) {
+        return value < candidate.offset + candidate.size;
+    });
+
+    size_t done = 0;
+    for (; done < block.size() && run != runs.end(); ++run) {
+        uint64_t skip = offset + done - run->offset;
+        size_t size = std::min<uint64_t>(block.size() - done, run->size - skip);
+        readRange(input, run->start + skip, block.data() + done, size);
+        done += size;
+    }
+}
+
+/**
+ * Convert a dump of any supported format to a compressed dump of its physical memory. Only the runs of
+ * the dump are stored, with the fields its header recorded. Batches of blocks are read in order,
+ * compressed in parallel and written in order.
+ *
+ * @param inputPath: path to the dump
+ * @param outputPath: path of the compressed dump, overwritten if it exists
+ * @param pool: pool the blocks are compressed on
+ * @param progress: optional token receiving the converted bytes, the conversion stops when it is cancelled
+ * @return: true if the compressed dump was written, false otherwise
+ */
+bool compressDump(const std::string& inputPath, const std::string& outputPath, ThreadPool& pool, AnalysisProgress *progress)
+{
+    DumpLayout layout = openDumpLayout(inputPath);
+    CachedDumpStream input(inputPath, std::make_shared<PageCache>(0), layout);
+    if (!input.is_open()) {
+        std::cerr << "Failed to open file: " << inputPath << "\n";
+        return false;
+    }
+
+    std::vector<CompressedDumpRun> runs;
+    uint64_t dumpSize = 0;
+    for (auto& run : layout.physical->runs()) {
+        runs.push_back(CompressedDumpRun{run.start, run.size, dumpSize});
+        dumpSize += run.size;
+    }
+    if (dumpSize == 0) {
+        std::cerr << "Empty dump: " << inputPath << "\n";
+        return false;
+    }
+
+    // Written aside and renamed, a cancelled or failed run doesn't leave a truncated dump behind
+    std::string partialPath = outputPath + ".partial";
+    std::ofstream output(partialPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        std::cerr << "Failed to write " << partialPath << "\n";
+        return false;
+    }
+    auto discard = [&]() {
+        output.close();
+        std::error_code error;
+        std::filesystem::remove(partialPath, error);
+        return false;
+    };
+
+    if (progress != nullptr) {
+        progress->totalBytes = dumpSize;
+    }
+
+    uint64_t blockCount = (dumpSize + COMPRESSED_BLOCK_SIZE - 1) / COMPRESSED_BLOCK_SIZE;
+    std::vector<uint64_t> offsets;
+    offsets.reserve(blockCount + 1);
+    uint64_t written = 0;
+
+    std::vector<std::vector<uint8_t>> blocks(COMPRESSED_BATCH_BLOCKS);
+    std::vector<std::vector<uint8_t>> compressed(COMPRESSED_BATCH_BLOCKS);
+    for (uint64_t first = 0; first < blockCount; first += COMPRESSED_BATCH_BLOCKS) {
+        if (progress != nullptr && progress->cancelled) {
+            return discard();
+        }
+
+        size_t count = std::min<uint64_t>(COMPRESSED_BATCH_BLOCKS, blockCount - first);
+        for (size_t i = 0; i < count; i++) {
+            uint64_t offset = (first + i) * COMPRESSED_BLOCK_SIZE;
+            blocks[i].resize(std::min<uint64_t>(COMPRESSED_BLOCK_SIZE, dumpSize - offset));
+            readBlock(input, runs, offset, blocks[i]);
+        }
+
+        pool.parallelFor(count, [&](size_t i) {
+            compressed[i].resize(ZSTD_compressBound(blocks[i].size()));
+            size_t size = ZSTD_compressCCtx(compressionContext(), compressed[i].data(), compressed[i].size(),
+                                            blocks[i].data(), blocks[i].size(), COMPRESSION_LEVEL);
+            // Blocks which don't shrink are stored as is, which also tells them apart from frames
+            if (ZSTD_isError(size) || size >= blocks[i].size()) {
+                compressed[i] = blocks[i];
+            } else {
+                compressed[i].resize(size);
+            }
+        });
+
+        uint64_t batchBytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            offsets.push_back(written);
+            output.write(reinterpret_cast<const char *>(compressed[i].data()),
+                         static_cast<std::streamsize>(compressed[i].size()));
+            written += compressed[i].size();
+            batchBytes += blocks[i].size();
+        }
+        if (!output.good()) {
+            std::cerr << "Failed to write " << partialPath << "\n";
+            return discard();
+        }
+
+        if (progress != nullptr) {
+            progress->bytesScanned += batchBytes;
+        }
+    }
+    offsets.push_back(written);
+
+    CompressedDumpFooter footer{};
+    std::memcpy(footer.magic, COMPRESSED_DUMP_MAGIC, COMPRESSED_DUMP_MAGIC_SIZE);
+    footer.version = COMPRESSED_DUMP_VERSION;
+    footer.blockSize = COMPRESSED_BLOCK_SIZE;
+    footer.uncompressedSize = dumpSize;
+    footer.blockCount = blockCount;
+    footer.indexOffset = written;
+    footer.runCount = runs.size();
+    footer.directoryTableBase = layout.directoryTableBase;
+    footer.activeProcessHead = layout.activeProcessHead;
+
+    output.write(reinterpret_cast<const char *>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+    output.write(reinterpret_cast<const char *>(runs.data()), static_cast<std::streamsize>(runs.size() * sizeof(CompressedDumpRun)));
+    output.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    output.close();
+    if (!output.good()) {
+        std::cerr << "Failed to write " << partialPath << "\n";
+        return discard();
+    }
+
+    std::error_code error;
+    std::filesystem::rename(partialPath, outputPath, error);
+    if (error) {
+        std::cerr << "Failed to write " << outputPath << ": " << error.message() << "\n";
+        return discard();
+    }
+
+    return true;
+}
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dumpformat.h"
+#include "mappedfile.h"
+#include "memory.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_COMPRESSEDDUMP_H
+#define DUDEDUMPER_COMPRESSEDDUMP_H
+
+#define COMPRESSED_DUMP_MAGIC "DDZSEEK1"
+#define COMPRESSED_DUMP_MAGIC_SIZE 8
+#define COMPRESSED_DUMP_VERSION 2
+#define COMPRESSED_BLOCK_SIZE 0x10000
+#define COMPRESSED_CACHE_SIZE 0x4000000
+#define COMPRESSED_BATCH_BLOCKS 64
+#define COMPRESSION_LEVEL 3
+
+/*
+ * Last bytes of a compressed dump. The index at indexOffset holds blockCount + 1 file offsets: block i is
+ * stored in [offsets[i], offsets[i + 1]), as a zstd frame, or as is when it didn't compress. The runCount
+ * runs of the source dump follow the index, the dump fields are the ones its format recorded.
+ */
+struct CompressedDumpFooter {
+    char magic[COMPRESSED_DUMP_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t uncompressedSize;
+    uint64_t blockCount;
+    uint64_t indexOffset;
+    uint64_t runCount;
+    uint64_t directoryTableBase;
+    uint64_t activeProcessHead;
+};
+
+/*
+ * size bytes of physical memory from start, stored at offset in the decompressed dump. The runs of the
+ * source dump are stored one after the other, its holes aren't stored.
+ */
+struct CompressedDumpRun {
+    uint64_t start;
+    uint64_t size;
+    uint64_t offset;
+};
+
+using DecompressedBlock = std::shared_ptr<const std::vector<uint8_t>>;
+
+/*
+ * Dump stored as independently compressed blocks. Blocks are decompressed on demand into an LRU shared by
+ * every reader of the dump, a read only decompresses the blocks it touches. Block i holds the bytes at
+ * i * blockSize() of the decompressed dump; the run table of the layout, if any, maps physical addresses
+ * to these offsets.
+ */
+class BlockCompressedDump {
+public:
+    virtual ~BlockCompressedDump() = default;
+
+    bool isOpen() const;
+    uint64_t size() const;
+    uint64_t blockSize() const;
+    DecompressedBlock block(uint64_t index);
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+protected:
+    void initializeCache(uint64_t blockSize, uint64_t blockCount, uint64_t decompressedSize, size_t cacheSize);
+    virtual bool decompress(uint64_t index, std::vector<uint8_t>& data) const = 0;
+    virtual uint64_t readAheadBlocks(uint64_t index) const;
+
+private:
+    DecompressedBlock insert(uint64_t index, DecompressedBlock data);
+
+    bool valid = false;
+    uint64_t stride = 0;
+    uint64_t blockCount = 0;
+    uint64_t decompressedSize = 0;
+    size_t capacityBlocks = 1;
+    std::mutex mutex;
+    std::list<std::pair<uint64_t, DecompressedBlock>> lru;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, DecompressedBlock>>::iterator> cached;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
+
+/*
+ * Seekable compressed dump written by compressDump, blocks are zstd frames of fixed size. The run table
+ * maps the physical memory of the source dump to the decompressed dump.
+ */
+class CompressedDump : public BlockCompressedDump {
+public:
+    explicit CompressedDump(std::shared_ptr<const MappedFile> file, size_t cacheSize = COMPRESSED_CACHE_SIZE);
+
+    std::shared_ptr<const RunTable> runs() const;
+    uint64_t directoryTableBase() const;
+    uint64_t activeProcessHead() const;
+
+protected:
+    bool decompress(uint64_t index, std::vector<uint8_t>& data) const override;
+
+private:
+    uint64_t blockOffset(uint64_t index) const;
+    bool readRuns(RunTable& runTable) const;
+
+    std::shared_ptr<const MappedFile> file;
+    std::shared_ptr<const RunTable> runTable;
+    CompressedDumpFooter footer{};
+};
+
+bool isCompressedDump(std::istream& file);
+bool compressDump(const std::string& inputPath, const std::string& outputPath, ThreadPool& pool,
+                  AnalysisProgress *progress = nullptr);
+
+#endif //DUDEDUMPER_COMPRESSEDDUMP_H
@@ -0,0 +1,166 @@
+#include "crashdump.h"
+
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "structs.h"
+
+// 2^36 pages, 256TB of physical memory
+#define SUMMARY_DUMP_MAX_BITMAP_SIZE 0x1000000000
+
+
+template<typename T>
+static T headerField(const std::vector<uint8_t>& header, size_t offset)
+{
+    T value;
+    std::memcpy(&value, header.data() + offset, sizeof(T));
+    return value;
+}
+
+static bool readAt(std::istream& file, uint64_t offset, void *buffer, size_t size)
+{
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    return static_cast<bool>(file.read(static_cast<char *>(buffer), static_cast<std::streamsize>(size)));
+}
+
+/**
+ * @param file: file stream
+ * @return: true if the file starts with the header of a 64-bit crash dump
+ */
+bool isCrashDump(std::istream& file)
+{
+    uint32_t signature[2];
+    return readAt(file, 0, signature, sizeof(signature))
+           && signature[0] == DUMP_SIGNATURE && signature[1] == DUMP_VALID_DUMP64;
+}
+
+/**
+ * Runs of full dumps, listed in the PhysicalMemoryBlock of the header and stored one after the other.
+ */
+static bool readPhysicalMemoryBlock(const std::vector<uint8_t>& header, RunTable& runs)
+{
+    uint32_t runCount = headerField<uint32_t>(header, DUMP_PHYSICAL_MEMORY_BLOCK);
+    if (runCount > DUMP_MAX_PHYSICAL_RUNS) {
+        std::cerr << "Invalid number of physical memory runs: " << runCount << "\n";
+        return false;
+    }
+
+    uint64_t fileOffset = DUMP_HEADER64_SIZE;
+    for (uint32_t i = 0; i < runCount; i++) {
+        uint64_t basePage = headerField<uint64_t>(header, DUMP_PHYSICAL_MEMORY_RUNS + i * 16);
+        uint64_t pageCount = headerField<uint64_t>(header, DUMP_PHYSICAL_MEMORY_RUNS + i * 16 + 8);
+        runs.add(basePage << PAGE_4KB_SHIFT, pageCount << PAGE_4KB_SHIFT, fileOffset);
+        fileOffset += pageCount << PAGE_4KB_SHIFT;
+    }
+
+    return true;
+}
+
+/**
+ * Runs of bitmap dumps: one bit per physical page, the pages whose bit is set are stored in order.
+ */
+static bool readSummaryBitmap(std::istream& file, RunTable& runs)
+{
+    uint8_t summary[SUMMARY_DUMP_BITMAP];
+    if (!readAt(file, DUMP_HEADER64_SIZE, summary, sizeof(summary))) {
+        std::cerr << "Truncated bitmap dump header\n";
+        return false;
+    }
+
+    uint32_t signature, validDump;
+    uint64_t firstPageOffset, bitmapSize, pageCount;
+    std::memcpy(&signature, summary, sizeof(uint32_t));
+    std::memcpy(&validDump, summary + 4, sizeof(uint32_t));
+    std::memcpy(&firstPageOffset, summary + SUMMARY_DUMP_HEADER_SIZE, sizeof(uint64_t));
+    std::memcpy(&bitmapSize, summary + SUMMARY_DUMP_BITMAP_SIZE, sizeof(uint64_t));
+    std::memcpy(&pageCount, summary + SUMMARY_DUMP_PAGES, sizeof(uint64_t));
+
+    if ((signature != SUMMARY_DUMP_SIGNATURE && signature != FULL_DUMP_SIGNATURE)
+        || validDump != SUMMARY_DUMP_VALID_DUMP || bitmapSize > SUMMARY_DUMP_MAX_BITMAP_SIZE) {
+        std::cerr << "Invalid bitmap dump header\n";
+        return false;
+    }
+
+    std::vector<uint64_t> bitmap((bitmapSize + 63) / 64, 0);
+    if (!readAt(file, DUMP_HEADER64_SIZE + SUMMARY_DUMP_BITMAP, bitmap.data(), (bitmapSize + 7) / 8)) {
+        std::cerr << "Truncated bitmap dump bitmap\n";
+        return false;
+    }
+    if (bitmapSize % 64 != 0) {
+        bitmap.back() &= (1ULL << (bitmapSize % 64)) - 1;
+    }
+
+    // Whole words are skipped, set bits are taken a run at a time
+    uint64_t fileOffset = firstPageOffset;
+    uint64_t storedPages = 0;
+    for (size_t word = 0; word < bitmap.size(); word++) {
+        uint64_t bits = bitmap[word];
+        while (bits != 0) {
+            int first = std::countr_zero(bits);
+            int count = std::countr_one(bits >> first);
+            uint64_t page = word * 64 + first;
+
+            runs.add(page << PAGE_4KB_SHIFT, static_cast<uint64_t>(count) << PAGE_4KB_SHIFT, fileOffset);
+            fileOffset += static_cast<uint64_t>(count) << PAGE_4KB_SHIFT;
+            storedPages += count;
+
+            bits = first + count >= 64 ? 0 : bits & (~0ULL << (first + count));
+        }
+    }
+
+    if (storedPages != pageCount) {
+        std::cerr << "Bitmap dump holds " << storedPages << " pages, its header says " << pageCount << "\n";
+    }
+
+    return true;
+}
+
+/**
+ * Read the header of a 64-bit crash dump and index where every physical page is stored.
+ *
+ * @param file: file stream
+ * @param info: receives the fields of the header
+ * @param runs: receives the physical memory runs, finalized
+ * @return: true if the dump is a full or bitmap crash dump, false otherwise
+ */
+bool readCrashDump(std::istream& file, CrashDumpInfo& info, RunTable& runs)
+{
+    std::vector<uint8_t> header(DUMP_HEADER64_SIZE);
+    if (!readAt(file, 0, header.data(), header.size())
+        || headerField<uint32_t>(header, 0) != DUMP_SIGNATURE
+        || headerField<uint32_t>(header, 4) != DUMP_VALID_DUMP64) {
+        std::cerr << "Not a 64-bit crash dump\n";
+        return false;
+    }
+
+    info.dumpType = headerField<uint32_t>(header, DUMP_TYPE);
+    info.machineImageType = headerField<uint32_t>(header, DUMP_MACHINE_IMAGE_TYPE);
+    info.numberProcessors = headerField<uint32_t>(header, DUMP_NUMBER_PROCESSORS);
+    info.bugCheckCode = headerField<uint32_t>(header, DUMP_BUGCHECK_CODE);
+    info.directoryTableBase = headerField<uint64_t>(header, DUMP_DIRECTORY_TABLE_BASE);
+    info.pfnDataBase = headerField<uint64_t>(header, DUMP_PFN_DATABASE);
+    info.psLoadedModuleList = headerField<uint64_t>(header, DUMP_PS_LOADED_MODULE_LIST);
+    info.psActiveProcessHead = headerField<uint64_t>(header, DUMP_PS_ACTIVE_PROCESS_HEAD);
+    info.kdDebuggerDataBlock = headerField<uint64_t>(header, DUMP_KD_DEBUGGER_DATA_BLOCK);
+
+    bool read;
+    switch (info.dumpType) {
+        case DUMP_TYPE_FULL:
+            read = readPhysicalMemoryBlock(header, runs);
+            break;
+        case DUMP_TYPE_SUMMARY:
+        case DUMP_TYPE_BITMAP_FULL:
+        case DUMP_TYPE_BITMAP_KERNEL:
+            read = readSummaryBitmap(file, runs);
+            break;
+        default:
+            std::cerr << "Unsupported crash dump type: " << info.dumpType << "\n";
+            return false;
+    }
+
+    runs.finalize();
+    return read;
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <istream>
+
+#include "dumpformat.h"
+
+#ifndef DUDEDUMPER_CRASHDUMP_H
+#define DUDEDUMPER_CRASHDUMP_H
+
+// DUMP_HEADER64, the physical memory follows it
+#define DUMP_SIGNATURE 0x45474150           // "PAGE"
+#define DUMP_VALID_DUMP64 0x34365544        // "DU64"
+#define DUMP_HEADER64_SIZE 0x2000
+#define DUMP_DIRECTORY_TABLE_BASE 0x10
+#define DUMP_PFN_DATABASE 0x18
+#define DUMP_PS_LOADED_MODULE_LIST 0x20
+#define DUMP_PS_ACTIVE_PROCESS_HEAD 0x28
+#define DUMP_MACHINE_IMAGE_TYPE 0x30
+#define DUMP_MACHINE_AMD64 0x8664
+#define DUMP_NUMBER_PROCESSORS 0x34
+#define DUMP_BUGCHECK_CODE 0x38
+#define DUMP_KD_DEBUGGER_DATA_BLOCK 0x80
+#define DUMP_PHYSICAL_MEMORY_BLOCK 0x88
+#define DUMP_PHYSICAL_MEMORY_RUNS 0x98
+#define DUMP_MAX_PHYSICAL_RUNS 43
+#define DUMP_TYPE 0xf98
+
+#define DUMP_TYPE_FULL 1
+#define DUMP_TYPE_SUMMARY 2
+#define DUMP_TYPE_BITMAP_FULL 5
+#define DUMP_TYPE_BITMAP_KERNEL 6
+
+// SUMMARY_DUMP64 header of the bitmap dumps, at DUMP_HEADER64_SIZE
+#define SUMMARY_DUMP_SIGNATURE 0x504d4453   // "SDMP"
+#define FULL_DUMP_SIGNATURE 0x504d4446      // "FDMP"
+#define SUMMARY_DUMP_VALID_DUMP 0x504d5544  // "DUMP"
+#define SUMMARY_DUMP_HEADER_SIZE 0x20
+#define SUMMARY_DUMP_BITMAP_SIZE 0x28
+#define SUMMARY_DUMP_PAGES 0x30
+#define SUMMARY_DUMP_BITMAP 0x38
+
+/*
+ * Fields of the DUMP_HEADER64 of a Windows crash dump used by the analysis.
+ */
+struct CrashDumpInfo {
+    uint32_t dumpType = 0;
+    uint32_t machineImageType = 0;
+    uint32_t numberProcessors = 0;
+    uint32_t bugCheckCode = 0;
+    uint64_t directoryTableBase = 0;
+    uint64_t pfnDataBase = 0;
+    uint64_t psLoadedModuleList = 0;
+    uint64_t psActiveProcessHead = 0;
+    uint64_t kdDebuggerDataBlock = 0;
+};
+
+bool isCrashDump(std::istream& file);
+bool readCrashDump(std::istream& file, CrashDumpInfo& info, RunTable& runs);
+
+#endif //DUDEDUMPER_CRASHDUMP_H
@@ -0,0 +1,211 @@
+#include "dumpformat.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "compresseddump.h"
+#include "crashdump.h"
+#include "elfcore.h"
+#include "hiberfil.h"
+#include "lime.h"
+#include "pagestore.h"
+#include "physicalspace.h"
+#include "segmented.h"
+
+
+/**
+ * Append a run, merged with the previous one when it continues it in memory and in the same file.
+ *
+ * @param start: physical address of the run
+ * @param size: size of the run in bytes
+ * @param fileOffset: offset of the run in the dump file
+ * @param source: index of the file holding the run
+ */
+void RunTable::add(uint64_t start, uint64_t size, uint64_t fileOffset, uint32_t source)
+{
+    if (size == 0) {
+        return;
+    }
+
+    if (!entries.empty()) {
+        PhysicalRun& last = entries.back();
+        if (last.start + last.size == start && last.fileOffset + last.size == fileOffset && last.source == source) {
+            last.size += size;
+            return;
+        }
+    }
+
+    entries.push_back(PhysicalRun{start, size, fileOffset, source});
+}
+
+/**
+ * Sort the runs and build the search index, must be called once all the runs are added.
+ */
+void RunTable::finalize()
+{
+    std::sort(entries.begin(), entries.end(), [](const PhysicalRun& a, const PhysicalRun& b) {
+        return a.start < b.start;
+    });
+
+    starts.resize(entries.size());
+    std::transform(entries.begin(), entries.end(), starts.begin(), [](const PhysicalRun& run) {
+        return run.start;
+    });
+}
+
+/**
+ * @param physicalAddress: physical address to look up
+ * @param fileOffset: receives the offset of the address in the dump file
+ * @param available: receives the number of bytes left in the run from the address
+ * @param source: optionally receives the index of the file holding the run
+ * @return: true if the address is in a run, false if it's in a hole
+ */
+bool RunTable::locate(uint64_t physicalAddress, uint64_t& fileOffset, uint64_t& available, uint32_t *source) const
+{
+    if (starts.empty() || physicalAddress < starts[0]) {
+        return false;
+    }
+
+    // Keeps the last start <= physicalAddress in [base, base + length), the select compiles to a cmov
+    const uint64_t *base = starts.data();
+    size_t length = starts.size();
+    while (length > 1) {
+        size_t half = length / 2;
+        base += base[half] <= physicalAddress ? half : 0;
+        length -= half;
+    }
+
+    const PhysicalRun& run = entries[base - starts.data()];
+    uint64_t offset = physicalAddress - run.start;
+    if (offset >= run.size) {
+        return false;
+    }
+
+    fileOffset = run.fileOffset + offset;
+    available = run.size - offset;
+    if (source != nullptr) {
+        *source = run.source;
+    }
+    return true;
+}
+
+/**
+ * @return: physical address following the last run
+ */
+uint64_t RunTable::end() const
+{
+    return entries.empty() ? 0 : entries.back().start + entries.back().size;
+}
+
+const std::vector<PhysicalRun>& RunTable::runs() const
+{
+    return entries;
+}
+
+const char *dumpFormatName(DumpFormat format)
+{
+    switch (format) {
+        case DumpFormat::CrashDump:
+            return "crashdump";
+        case DumpFormat::Lime:
+            return "lime";
+        case DumpFormat::ElfCore:
+            return "elfcore";
+        case DumpFormat::Compressed:
+            return "compressed";
+        case DumpFormat::Hibernation:
+            return "hiberfil";
+        case DumpFormat::Segmented:
+            return "segmented";
+        case DumpFormat::PageStore:
+            return "pagestore";
+        default:
+            return "raw";
+    }
+}
+
+/**
+ * Recognize the format of a dump from its header, or from its name for segmented dumps.
+ * Files of unknown formats are raw dumps.
+ *
+ * @param path: path to the dump
+ * @return: layout of the dump
+ */
+DumpLayout openDumpLayout(const std::string& path)
+{
+    DumpLayout layout;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        layout.physical = std::make_shared<PhysicalAddressSpace>(layout, 0);
+        return layout;
+    }
+
+    auto runs = std::make_shared<RunTable>();
+    if (isSegmentedDump(path)) {
+        if (openSegmentedDump(path, *runs, layout.mappings)) {
+            layout.format = DumpFormat::Segmented;
+        } else {
+            // Read the file alone when the segments can't all be mapped
+            *runs = RunTable();
+            layout.mappings.clear();
+        }
+    } else if (isCompressedDump(file)) {
+        auto compressed = std::make_shared<CompressedDump>(std::make_shared<MappedFile>(path));
+        if (compressed->isOpen()) {
+            layout.format = DumpFormat::Compressed;
+            layout.compressed = compressed;
+            layout.runs = compressed->runs();
+            layout.directoryTableBase = compressed->directoryTableBase();
+            layout.activeProcessHead = compressed->activeProcessHead();
+        }
+    } else if (isPageIndex(file)) {
+        PageIndexHeader header;
+        if (openPageIndex(path, *runs, layout.mappings, header)) {
+            layout.format = DumpFormat::PageStore;
+            layout.directoryTableBase = header.directoryTableBase;
+            layout.activeProcessHead = header.activeProcessHead;
+        } else {
+            *runs = RunTable();
+            layout.mappings.clear();
+        }
+    } else if (isHiberFile(file)) {
+        auto hiberFile = std::make_shared<HiberFile>(std::make_shared<MappedFile>(path));
+        if (hiberFile->isOpen()) {
+            layout.format = DumpFormat::Hibernation;
+            layout.compressed = hiberFile;
+            layout.runs = hiberFile->runs();
+        }
+    } else if (isCrashDump(file)) {
+        CrashDumpInfo info;
+        if (readCrashDump(file, info, *runs)) {
+            layout.format = DumpFormat::CrashDump;
+            layout.directoryTableBase = info.directoryTableBase;
+            layout.activeProcessHead = info.psActiveProcessHead;
+        }
+    } else if (isLimeDump(file)) {
+        if (readLimeDump(file, *runs)) {
+            layout.format = DumpFormat::Lime;
+        }
+    } else if (isElfCore(file)) {
+        if (readElfCore(file, *runs)) {
+            layout.format = DumpFormat::ElfCore;
+        }
+    }
+
+    if (layout.format == DumpFormat::Segmented || layout.format == DumpFormat::PageStore) {
+        layout.runs = runs;
+    } else if (layout.format != DumpFormat::Raw && !layout.compressed) {
+        layout.runs = runs;
+        auto mapping = std::make_shared<MappedFile>(path);
+        if (mapping->isOpen()) {
+            layout.mappings.push_back(mapping);
+        }
+    }
+
+    file.clear();
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    layout.physical = std::make_shared<PhysicalAddressSpace>(layout, fileSize > 0 ? static_cast<uint64_t>(fileSize) : 0);
+
+    return layout;
+}
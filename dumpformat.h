@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+#ifndef DUDEDUMPER_DUMPFORMAT_H
+#define DUDEDUMPER_DUMPFORMAT_H
+
+/*
+ * Range of physical memory stored contiguously in the dump. source is the file holding it, for dumps
+ * made of several files.
+ */
+struct PhysicalRun {
+    uint64_t start;
+    uint64_t size;
+    uint64_t fileOffset;
+    uint32_t source = 0;
+};
+
+/*
+ * Sorted, non-overlapping runs of a dump whose file offsets aren't the physical addresses.
+ * Lookups are a branchless binary search over the run starts.
+ */
+class RunTable {
+public:
+    void add(uint64_t start, uint64_t size, uint64_t fileOffset, uint32_t source = 0);
+    void finalize();
+
+    bool locate(uint64_t physicalAddress, uint64_t& fileOffset, uint64_t& available, uint32_t *source = nullptr) const;
+    uint64_t end() const;
+    const std::vector<PhysicalRun>& runs() const;
+
+private:
+    std::vector<PhysicalRun> entries;
+    std::vector<uint64_t> starts;
+};
+
+enum class DumpFormat {
+    Raw,
+    CrashDump,
+    Lime,
+    ElfCore,
+    Compressed,
+    Hibernation,
+    Segmented,
+    PageStore,
+};
+
+class BlockCompressedDump;
+class PhysicalAddressSpace;
+
+/*
+ * How the physical memory is laid out in a dump file. Raw dumps have no run table, the file offset
+ * is the physical address. Dumps with a run table are mapped, so their runs are read in place from
+ * mappings[source]; segmented dumps have one mapping per file, dumps of a page store the mapping of its pack,
+ * the other formats a single one.
+ * Compressed dumps are read through their shared decompressed block cache, their run table (if any) maps
+ * physical addresses to offsets in the decompressed blocks.
+ * physical is the run map of every format, raw dumps included.
+ * directoryTableBase and activeProcessHead are known when the format records them, 0 otherwise.
+ */
+struct DumpLayout {
+    DumpFormat format = DumpFormat::Raw;
+    std::shared_ptr<const RunTable> runs;
+    std::vector<std::shared_ptr<const MappedFile>> mappings;
+    std::shared_ptr<BlockCompressedDump> compressed;
+    std::shared_ptr<const PhysicalAddressSpace> physical;
+    uint64_t directoryTableBase = 0;
+    uint64_t activeProcessHead = 0;
+};
+
+const char *dumpFormatName(DumpFormat format);
+DumpLayout openDumpLayout(const std::string& path);
+
+#endif //DUDEDUMPER_DUMPFORMAT_H
@@ -0,0 +1,90 @@
+#include "elfcore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+static bool readElfHeader(std::istream& file, Elf64Header& header)
+{
+    file.clear();
+    file.seekg(0, std::ios::beg);
+    return file.read(reinterpret_cast<char *>(&header), sizeof(header))
+           && std::memcmp(header.ident, "\x7f" "ELF", 4) == 0
+           && header.ident[4] == ELF_CLASS_64
+           && header.ident[5] == ELF_DATA_LITTLE_ENDIAN
+           && header.type == ELF_TYPE_CORE;
+}
+
+/**
+ * @param file: file stream
+ * @return: true if the file is a 64-bit little endian ELF core, e.g. made by QEMU dump-guest-memory
+ */
+bool isElfCore(std::istream& file)
+{
+    Elf64Header header;
+    return readElfHeader(file, header);
+}
+
+/**
+ * Index the PT_LOAD segments of an ELF core by physical address. The part of a segment beyond
+ * its file size isn't in the file and stays a hole.
+ *
+ * @param file: file stream
+ * @param runs: receives the physical memory runs, finalized
+ * @return: true if the program headers were read, false otherwise
+ */
+bool readElfCore(std::istream& file, RunTable& runs)
+{
+    Elf64Header header;
+    if (!readElfHeader(file, header) || header.programHeaderSize != sizeof(Elf64ProgramHeader)) {
+        std::cerr << "Invalid ELF core header\n";
+        return false;
+    }
+
+    uint64_t programHeaderCount = header.programHeaderCount;
+    if (programHeaderCount == ELF_PN_XNUM) {
+        Elf64SectionHeader section;
+        file.seekg(static_cast<std::streamoff>(header.sectionHeaderOffset), std::ios::beg);
+        if (header.sectionHeaderSize != sizeof(Elf64SectionHeader)
+            || !file.read(reinterpret_cast<char *>(&section), sizeof(section))) {
+            std::cerr << "Invalid ELF section header holding the program header count\n";
+            return false;
+        }
+        programHeaderCount = section.info;
+    }
+
+    // The count comes from the file, don't allocate more headers than it can hold
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    if (header.programHeaderOffset > fileSize
+        || programHeaderCount > (fileSize - header.programHeaderOffset) / sizeof(Elf64ProgramHeader)) {
+        std::cerr << "Truncated ELF program headers\n";
+        return false;
+    }
+
+    std::vector<Elf64ProgramHeader> segments(programHeaderCount);
+    file.seekg(static_cast<std::streamoff>(header.programHeaderOffset), std::ios::beg);
+    if (!file.read(reinterpret_cast<char *>(segments.data()), segments.size() * sizeof(Elf64ProgramHeader))) {
+        std::cerr << "Truncated ELF program headers\n";
+        return false;
+    }
+
+    // Cores whose segments have no physical address (e.g. some conversions) are indexed by virtual address
+    bool hasPhysicalAddresses = false;
+    for (const Elf64ProgramHeader& segment : segments) {
+        hasPhysicalAddresses |= segment.type == ELF_PT_LOAD && segment.physicalAddress != 0;
+    }
+
+    for (const Elf64ProgramHeader& segment : segments) {
+        if (segment.type != ELF_PT_LOAD) {
+            continue;
+        }
+        uint64_t start = hasPhysicalAddresses ? segment.physicalAddress : segment.virtualAddress;
+        runs.add(start, std::min(segment.fileSize, segment.memorySize), segment.offset);
+    }
+
+    runs.finalize();
+    return true;
+}
@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <istream>
+
+#include "dumpformat.h"
+
+#ifndef DUDEDUMPER_ELFCORE_H
+#define DUDEDUMPER_ELFCORE_H
+
+#define ELF_CLASS_64 2
+#define ELF_DATA_LITTLE_ENDIAN 1
+#define ELF_TYPE_CORE 4
+#define ELF_PT_LOAD 1
+// e_phnum of a core with more program headers, the count is then in sh_info of the first section header
+#define ELF_PN_XNUM 0xffff
+
+struct Elf64Header {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t programHeaderOffset;
+    uint64_t sectionHeaderOffset;
+    uint32_t flags;
+    uint16_t headerSize;
+    uint16_t programHeaderSize;
+    uint16_t programHeaderCount;
+    uint16_t sectionHeaderSize;
+    uint16_t sectionHeaderCount;
+    uint16_t sectionNameIndex;
+};
+
+struct Elf64ProgramHeader {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t virtualAddress;
+    uint64_t physicalAddress;
+    uint64_t fileSize;
+    uint64_t memorySize;
+    uint64_t align;
+};
+
+struct Elf64SectionHeader {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t address;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t align;
+    uint64_t entrySize;
+};
+
+bool isElfCore(std::istream& file);
+bool readElfCore(std::istream& file, RunTable& runs);
+
+#endif //DUDEDUMPER_ELFCORE_H
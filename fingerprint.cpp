@@ -0,0 +1,195 @@
+#include "fingerprint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <xxhash.h>
+
+#include "memory.h"
+
+
+/**
+ * Collect the page-aligned offsets which make up the fingerprint sample: the file header pages,
+ * the System PML4 page and the PDPT pages it references, and pages at a fixed stride over the whole file.
+ *
+ * @param fileSize: size of the dump in bytes
+ * @param file: file stream
+ * @return: sorted offsets of the sampled pages
+ */
+static std::vector<uint64_t> selectSamplePages(uint64_t fileSize, std::ifstream& file)
+{
+    std::vector<uint64_t> offsets;
+    uint64_t pageCount = fileSize / PAGE_SIZE;
+
+    for (uint64_t page = 0; page < std::min<uint64_t>(FINGERPRINT_HEADER_PAGES, pageCount); page++) {
+        offsets.push_back(page * PAGE_SIZE);
+    }
+
+    if (pageCount > 0) {
+        offsets.push_back((pageCount - 1) * PAGE_SIZE);
+    }
+
+    PML4E pml4[PAGE_SIZE / sizeof(PML4E)];
+    if (_CR3 + PAGE_SIZE <= fileSize && readPhysicalMemory(_CR3, pml4, PAGE_SIZE, file)) {
+        offsets.push_back(_CR3);
+
+        size_t pageTablePages = 0;
+        for (auto& entry : pml4) {
+            if (pageTablePages == FINGERPRINT_PAGE_TABLE_PAGES) {
+                break;
+            }
+
+            uint64_t tableAddress = entry.Bits.PhysicalAddress << PAGE_4KB_SHIFT;
+            if (entry.Bits.Present && tableAddress + PAGE_SIZE <= fileSize) {
+                offsets.push_back(tableAddress);
+                pageTablePages++;
+            }
+        }
+    }
+
+    if (pageCount > 0) {
+        uint64_t stride = std::max<uint64_t>(pageCount / FINGERPRINT_STRIDED_PAGES, 1);
+        for (uint64_t page = 0; page < pageCount; page += stride) {
+            offsets.push_back(page * PAGE_SIZE);
+        }
+    }
+
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    return offsets;
+}
+
+/**
+ * Compute a cheap identity of the dump from its size, modification time and
+ * the XXH3 digests of a deterministic sample of pages.
+ *
+ * @param path: path to the dump
+ * @param pool: pool the sampled pages are read and hashed on
+ * @return: fingerprint of the dump, zeroed if the file can't be opened
+ */
+DumpFingerprint computeDumpFingerprint(const std::string& path, ThreadPool& pool)
+{
+    DumpFingerprint fingerprint{0, 0, 0, 0};
+
+    std::error_code error;
+    fingerprint.fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        std::cerr << "Failed to get the size of " << path << "\n";
+        return fingerprint;
+    }
+
+    auto writeTime = std::filesystem::last_write_time(path, error);
+    if (!error) {
+        fingerprint.modificationTime = std::chrono::duration_cast<std::chrono::seconds>(
+                writeTime.time_since_epoch()).count();
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return fingerprint;
+    }
+
+    std::vector<uint64_t> offsets = selectSamplePages(fingerprint.fileSize, file);
+    std::vector<uint64_t> digests(offsets.size(), 0);
+
+    size_t partitions = std::min(offsets.size(), pool.size() + 1);
+    pool.parallelFor(partitions, [&](size_t partition) {
+        std::ifstream partitionFile(path, std::ios::binary);
+        uint8_t page[PAGE_SIZE];
+
+        for (size_t i = partition; i < offsets.size(); i += partitions) {
+            if (readPhysicalMemory(offsets[i], page, PAGE_SIZE, partitionFile)) {
+                digests[i] = XXH3_64bits(page, PAGE_SIZE);
+            }
+        }
+    });
+
+    std::vector<uint64_t> combined;
+    combined.reserve(offsets.size() * 2 + 1);
+    combined.push_back(fingerprint.fileSize);
+    for (size_t i = 0; i < offsets.size(); i++) {
+        combined.push_back(offsets[i]);
+        combined.push_back(digests[i]);
+    }
+
+    fingerprint.sampleDigest = XXH3_64bits(combined.data(), combined.size() * sizeof(uint64_t));
+    fingerprint.sampledPages = static_cast<uint32_t>(offsets.size());
+
+    return fingerprint;
+}
+
+/**
+ * Hash the whole dump with XXH3. The file is split into FULL_HASH_CHUNK_SIZE chunks which are hashed
+ * in parallel, the result is the XXH3 of the chunk digests in file order.
+ *
+ * @param path: path to the dump
+ * @param pool: pool the chunks are hashed on
+ * @return: digest of the dump, 0 if the file can't be read
+ */
+uint64_t computeFullDumpHash(const std::string& path, ThreadPool& pool)
+{
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        std::cerr << "Failed to get the size of " << path << "\n";
+        return 0;
+    }
+
+    uint64_t chunkCount = (fileSize + FULL_HASH_CHUNK_SIZE - 1) / FULL_HASH_CHUNK_SIZE;
+    std::vector<uint64_t> digests(chunkCount, 0);
+    std::atomic<bool> failed{false};
+
+    pool.parallelFor(chunkCount, [&](size_t chunk) {
+        std::ifstream chunkFile(path, std::ios::binary);
+
+        uint64_t offset = chunk * FULL_HASH_CHUNK_SIZE;
+        uint64_t size = std::min<uint64_t>(FULL_HASH_CHUNK_SIZE, fileSize - offset);
+        // Allocated per chunk, the pool threads outlive the call and shouldn't keep a chunk each
+        std::vector<char> buffer(size);
+
+        if (!readPhysicalMemory(offset, buffer.data(), size, chunkFile)) {
+            failed = true;
+            return;
+        }
+
+        digests[chunk] = XXH3_64bits(buffer.data(), size);
+    });
+
+    if (failed) {
+        return 0;
+    }
+
+    digests.push_back(fileSize);
+    return XXH3_64bits(digests.data(), digests.size() * sizeof(uint64_t));
+}
+
+/**
+ * @return: "<size>-<mtime>-<digest>" in hex, usable as a cache key
+ */
+std::string DumpFingerprint::toString() const
+{
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%llx-%llx-%016llx",
+                  static_cast<unsigned long long>(fileSize),
+                  static_cast<unsigned long long>(modificationTime),
+                  static_cast<unsigned long long>(sampleDigest));
+    return buffer;
+}
+
+/**
+ * Compare the sampled content of two dumps, ignoring the modification time.
+ *
+ * @param other: fingerprint to compare with
+ * @return: true if the size and the sampled pages match
+ */
+bool DumpFingerprint::sameContent(const DumpFingerprint& other) const
+{
+    return fileSize == other.fileSize && sampleDigest == other.sampleDigest;
+}
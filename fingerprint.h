@@ -0,0 +1,27 @@
+#include <cstdint>
+#include <string>
+
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_FINGERPRINT_H
+#define DUDEDUMPER_FINGERPRINT_H
+
+#define FINGERPRINT_HEADER_PAGES 16
+#define FINGERPRINT_STRIDED_PAGES 1024
+#define FINGERPRINT_PAGE_TABLE_PAGES 64
+#define FULL_HASH_CHUNK_SIZE 0x1000000
+
+struct DumpFingerprint {
+    uint64_t fileSize;
+    int64_t modificationTime;
+    uint64_t sampleDigest;
+    uint32_t sampledPages;
+
+    std::string toString() const;
+    bool sameContent(const DumpFingerprint& other) const;
+};
+
+DumpFingerprint computeDumpFingerprint(const std::string& path, ThreadPool& pool = ThreadPool::global());
+uint64_t computeFullDumpHash(const std::string& path, ThreadPool& pool = ThreadPool::global());
+
+#endif //DUDEDUMPER_FINGERPRINT_H
@@ -0,0 +1,121 @@
+#include "growingfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * Start watching the file, it must exist.
+ *
+ * @param path: path to the file
+ */
+GrowingFile::GrowingFile(const std::string& path)
+    : path(path)
+{
+#ifdef __linux__
+    inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyDescriptor >= 0 && inotify_add_watch(inotifyDescriptor, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+        close(inotifyDescriptor);
+        inotifyDescriptor = -1;
+    }
+#endif
+}
+
+GrowingFile::~GrowingFile()
+{
+#ifdef __linux__
+    if (inotifyDescriptor >= 0) {
+        close(inotifyDescriptor);
+    }
+#endif
+}
+
+/**
+ * @return: current size of the file, 0 if it can't be read
+ */
+uint64_t GrowingFile::size() const
+{
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    return error ? 0 : fileSize;
+}
+
+/**
+ * Wait until the file is larger than knownSize, its writer is done with it or the timeout expired.
+ *
+ * @param knownSize: size the caller has already seen
+ * @param timeoutMs: longest wait in milliseconds
+ * @return: size of the file
+ */
+uint64_t GrowingFile::waitForGrowth(uint64_t knownSize, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    for (;;) {
+        uint64_t current = size();
+        // Written since the close, e.g. through another handle
+        if (closed && current != closedSize) {
+            closed = false;
+        }
+        if (current > knownSize || writerClosed()) {
+            return current;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+        if (remaining.count() <= 0) {
+            return current;
+        }
+
+#ifdef __linux__
+        if (inotifyDescriptor >= 0) {
+            // Wake up once the close is confirmed
+            if (closed) {
+                auto confirmed = closedAt + std::chrono::milliseconds(GROWING_FILE_POLL_MS);
+                remaining = std::min(remaining, std::chrono::ceil<std::chrono::milliseconds>(confirmed - now));
+            }
+            pollfd descriptor{inotifyDescriptor, POLLIN, 0};
+            if (poll(&descriptor, 1, static_cast<int>(std::max<int64_t>(remaining.count(), 0))) <= 0) {
+                continue;
+            }
+
+            alignas(inotify_event) char events[4096];
+            ssize_t length;
+            while ((length = read(inotifyDescriptor, events, sizeof(events))) > 0) {
+                for (char *next = events; next < events + length;) {
+                    auto *event = reinterpret_cast<inotify_event *>(next);
+                    if ((event->mask & IN_MODIFY) != 0) {
+                        closed = false;
+                    }
+                    if ((event->mask & IN_CLOSE_WRITE) != 0) {
+                        closed = true;
+                        closedSize = size();
+                        closedAt = std::chrono::steady_clock::now();
+                    }
+                    next += sizeof(inotify_event) + event->len;
+                }
+            }
+            continue;
+        }
+#endif
+        std::this_thread::sleep_for(std::min(remaining, std::chrono::milliseconds(GROWING_FILE_POLL_MS)));
+    }
+}
+
+/**
+ * @return: true once a writer closed the file and it wasn't written for GROWING_FILE_POLL_MS since,
+ * never true without inotify
+ */
+bool GrowingFile::writerClosed() const
+{
+    return closed && size() == closedSize
+           && std::chrono::steady_clock::now() - closedAt >= std::chrono::milliseconds(GROWING_FILE_POLL_MS);
+}
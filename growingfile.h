@@ -0,0 +1,39 @@
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#ifndef DUDEDUMPER_GROWINGFILE_H
+#define DUDEDUMPER_GROWINGFILE_H
+
+#define GROWING_FILE_POLL_MS 500
+#define GROWING_FILE_IDLE_MS 60000
+
+/*
+ * File another process is still writing, e.g. a dump during its acquisition. waitForGrowth sleeps until
+ * the file grows or its writer closes it: inotify tells on Linux, elsewhere the size is polled and only
+ * the caller's idle timeout tells the writer is done. Acquisition tools may reopen the file or write it
+ * through several handles, so a close only counts once the file isn't written for GROWING_FILE_POLL_MS more.
+ */
+class GrowingFile {
+public:
+    explicit GrowingFile(const std::string& path);
+    ~GrowingFile();
+
+    GrowingFile(const GrowingFile&) = delete;
+    GrowingFile& operator=(const GrowingFile&) = delete;
+
+    uint64_t size() const;
+    uint64_t waitForGrowth(uint64_t knownSize, int timeoutMs);
+    bool writerClosed() const;
+
+private:
+    std::string path;
+    bool closed = false;
+    uint64_t closedSize = 0;
+    std::chrono::steady_clock::time_point closedAt;
+#ifdef __linux__
+    int inotifyDescriptor = -1;
+#endif
+};
+
+#endif //DUDEDUMPER_GROWINGFILE_H
@@ -0,0 +1,285 @@
+#include "hashing.h"
+
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#include <blake3.h>
+#include <openssl/evp.h>
+
+#include "memory.h"
+
+
+/**
+ * @param digest: digest to format
+ * @return: lowercase hex representation of the digest
+ */
+std::string digestToHex(const Digest& digest)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (uint8_t byte : digest) {
+        hex.push_back(hexDigits[byte >> 4]);
+        hex.push_back(hexDigits[byte & 0xf]);
+    }
+
+    return hex;
+}
+
+/**
+ * @param data: data to hash
+ * @param size: size of the data
+ * @return: SHA-256 of the data
+ */
+Digest sha256Digest(const void *data, size_t size)
+{
+    Digest digest{};
+    EVP_Digest(data, size, digest.data(), nullptr, EVP_sha256(), nullptr);
+    return digest;
+}
+
+/**
+ * @param data: data to hash
+ * @param size: size of the data
+ * @return: BLAKE3 of the data
+ */
+Digest blake3Digest(const void *data, size_t size)
+{
+    Digest digest{};
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    blake3_hasher_update(&hasher, data, size);
+    blake3_hasher_finalize(&hasher, digest.data(), digest.size());
+    return digest;
+}
+
+/**
+ * Build the Merkle tree levels on top of the chunk digests. Leaves and interior nodes are hashed with
+ * different prefixes (as in RFC 6962), so an interior node can't be presented as a chunk digest.
+ *
+ * @param digests: chunk digests in file order
+ * @param hash: hash function of the leaves and nodes
+ * @return: tree levels, from the leaves up to the root
+ */
+static std::vector<std::vector<Digest>> buildMerkleTree(const std::vector<Digest>& digests,
+                                                        Digest (*hash)(const void *, size_t))
+{
+    std::vector<Digest> leaves;
+    leaves.reserve(digests.size());
+    for (const Digest& digest : digests) {
+        uint8_t leaf[1 + sizeof(Digest)] = {MERKLE_LEAF_PREFIX};
+        std::copy(digest.begin(), digest.end(), leaf + 1);
+        leaves.push_back(hash(leaf, sizeof(leaf)));
+    }
+
+    std::vector<std::vector<Digest>> tree;
+    tree.push_back(std::move(leaves));
+
+    while (tree.back().size() > 1) {
+        const std::vector<Digest>& level = tree.back();
+        std::vector<Digest> parents;
+
+        for (size_t i = 0; i < level.size(); i += 2) {
+            if (i + 1 == level.size()) {
+                parents.push_back(level[i]);
+                continue;
+            }
+
+            uint8_t children[1 + sizeof(Digest) * 2] = {MERKLE_NODE_PREFIX};
+            std::copy(level[i].begin(), level[i].end(), children + 1);
+            std::copy(level[i + 1].begin(), level[i + 1].end(), children + 1 + sizeof(Digest));
+            parents.push_back(hash(children, sizeof(children)));
+        }
+
+        tree.push_back(std::move(parents));
+    }
+
+    return tree;
+}
+
+/**
+ * Hash the dump in HASH_CHUNK_SIZE chunks. The file is read once, sequentially, on the calling thread,
+ * the chunks are hashed on the pool. Every chunk is also handed to the visitor, so scanners such as
+ * SystemProcessScanner can run on the same read pass instead of reading the dump a second time.
+ *
+ * @param path: path to the dump
+ * @param manifest: receives the chunk digests and the Merkle trees
+ * @param visitor: optional consumer of the chunks, called concurrently from the pool
+ * @param pool: pool the chunks are hashed on
+ * @return: true if the whole file was read, false otherwise
+ */
+bool hashDump(const std::string& path, DumpHashManifest& manifest, const ChunkVisitor& visitor, ThreadPool& pool)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        std::cerr << "Failed to get the size of " << path << "\n";
+        return false;
+    }
+
+    uint64_t chunkCount = (fileSize + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+    manifest = DumpHashManifest{fileSize, HASH_CHUNK_SIZE, std::vector<ChunkDigest>(chunkCount), {}, {}};
+
+    struct InFlightChunk {
+        std::shared_ptr<std::vector<char>> buffer;
+        std::future<void> done;
+    };
+
+    size_t maxInFlight = pool.size() + 1;
+    std::deque<InFlightChunk> inFlight;
+    std::vector<std::shared_ptr<std::vector<char>>> freeBuffers;
+    bool readFailed = false;
+
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        if (inFlight.size() == maxInFlight) {
+            inFlight.front().done.get();
+            freeBuffers.push_back(inFlight.front().buffer);
+            inFlight.pop_front();
+        }
+
+        std::shared_ptr<std::vector<char>> buffer;
+        if (freeBuffers.empty()) {
+            buffer = std::make_shared<std::vector<char>>(HASH_CHUNK_SIZE + SCAN_CHUNK_OVERLAP);
+        } else {
+            buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+
+        uint64_t offset = chunk * HASH_CHUNK_SIZE;
+        size_t readSize = std::min<uint64_t>(buffer->size(), fileSize - offset);
+        if (!readPhysicalMemory(offset, buffer->data(), readSize, file)) {
+            readFailed = true;
+            break;
+        }
+
+        DumpChunk dumpChunk{offset, buffer->data(), std::min<size_t>(readSize, HASH_CHUNK_SIZE), readSize};
+        ChunkDigest& chunkDigest = manifest.chunks[chunk];
+
+        inFlight.push_back(InFlightChunk{buffer, pool.submit([dumpChunk, &chunkDigest, &visitor]() {
+            chunkDigest.offset = dumpChunk.offset;
+            chunkDigest.size = dumpChunk.size;
+            chunkDigest.sha256 = sha256Digest(dumpChunk.data, dumpChunk.size);
+            chunkDigest.blake3 = blake3Digest(dumpChunk.data, dumpChunk.size);
+
+            if (visitor) {
+                visitor(dumpChunk);
+            }
+        })});
+    }
+
+    for (auto& chunk : inFlight) {
+        chunk.done.get();
+    }
+
+    if (readFailed) {
+        return false;
+    }
+
+    manifest.buildTrees();
+    return true;
+}
+
+/**
+ * Rehash the dump and compare it against a manifest.
+ *
+ * @param path: path to the dump
+ * @param manifest: manifest recorded when the dump was ingested
+ * @param pool: pool the chunks are hashed on
+ * @return: indices of the chunks which don't match, empty if the dump is intact
+ */
+std::vector<size_t> verifyDump(const std::string& path, const DumpHashManifest& manifest, ThreadPool& pool)
+{
+    std::vector<size_t> mismatches;
+
+    DumpHashManifest current;
+    if (!hashDump(path, current, nullptr, pool) || current.fileSize != manifest.fileSize) {
+        for (size_t i = 0; i < manifest.chunks.size(); i++) {
+            mismatches.push_back(i);
+        }
+        return mismatches;
+    }
+
+    for (size_t i = 0; i < manifest.chunks.size(); i++) {
+        if (current.chunks[i].sha256 != manifest.chunks[i].sha256 ||
+            current.chunks[i].blake3 != manifest.chunks[i].blake3) {
+            mismatches.push_back(i);
+        }
+    }
+
+    return mismatches;
+}
+
+/**
+ * Build both Merkle trees over the chunk digests, once all of them are set.
+ */
+void DumpHashManifest::buildTrees()
+{
+    std::vector<Digest> sha256Leaves, blake3Leaves;
+    for (auto& chunk : chunks) {
+        sha256Leaves.push_back(chunk.sha256);
+        blake3Leaves.push_back(chunk.blake3);
+    }
+
+    sha256Tree = buildMerkleTree(sha256Leaves, sha256Digest);
+    blake3Tree = buildMerkleTree(blake3Leaves, blake3Digest);
+}
+
+/**
+ * @return: root of the SHA-256 Merkle tree, zeroed for an empty dump
+ */
+Digest DumpHashManifest::sha256Root() const
+{
+    if (sha256Tree.empty() || sha256Tree.back().empty()) {
+        return Digest{};
+    }
+    return sha256Tree.back().front();
+}
+
+/**
+ * @return: root of the BLAKE3 Merkle tree, zeroed for an empty dump
+ */
+Digest DumpHashManifest::blake3Root() const
+{
+    if (blake3Tree.empty() || blake3Tree.back().empty()) {
+        return Digest{};
+    }
+    return blake3Tree.back().front();
+}
+
+/**
+ * @return: the manifest as a JSON document
+ */
+std::string DumpHashManifest::toJson() const
+{
+    std::ostringstream json;
+
+    json << "{\"fileSize\":" << fileSize
+         << ",\"chunkSize\":" << chunkSize
+         << ",\"sha256Root\":\"" << digestToHex(sha256Root()) << "\""
+         << ",\"blake3Root\":\"" << digestToHex(blake3Root()) << "\""
+         << ",\"chunks\":[";
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (i != 0) {
+            json << ",";
+        }
+        json << "{\"offset\":" << chunks[i].offset
+             << ",\"size\":" << chunks[i].size
+             << ",\"sha256\":\"" << digestToHex(chunks[i].sha256) << "\""
+             << ",\"blake3\":\"" << digestToHex(chunks[i].blake3) << "\"}";
+    }
+
+    json << "]}";
+    return json.str();
+}
@@ -0,0 +1,55 @@
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "structs.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_HASHING_H
+#define DUDEDUMPER_HASHING_H
+
+#define HASH_CHUNK_SIZE 0x1000000
+// First byte hashed for a Merkle leaf and an interior node, so that one can't be passed off as the other
+#define MERKLE_LEAF_PREFIX 0x00
+#define MERKLE_NODE_PREFIX 0x01
+
+using Digest = std::array<uint8_t, 32>;
+using ChunkVisitor = std::function<void(const DumpChunk&)>;
+
+struct ChunkDigest {
+    uint64_t offset;
+    uint64_t size;
+    Digest sha256;
+    Digest blake3;
+};
+
+/*
+ * Per-chunk SHA-256 and BLAKE3 digests of a dump together with the Merkle trees built over them.
+ * Level 0 of a tree holds the leaves, the hash of MERKLE_LEAF_PREFIX and a chunk digest, the last level holds
+ * the root. A parent is the hash of MERKLE_NODE_PREFIX and its two children, an odd node is carried up unchanged.
+ */
+struct DumpHashManifest {
+    uint64_t fileSize;
+    uint64_t chunkSize;
+    std::vector<ChunkDigest> chunks;
+    std::vector<std::vector<Digest>> sha256Tree;
+    std::vector<std::vector<Digest>> blake3Tree;
+
+    void buildTrees();
+    Digest sha256Root() const;
+    Digest blake3Root() const;
+    std::string toJson() const;
+};
+
+std::string digestToHex(const Digest& digest);
+Digest sha256Digest(const void *data, size_t size);
+Digest blake3Digest(const void *data, size_t size);
+
+bool hashDump(const std::string& path, DumpHashManifest& manifest,
+              const ChunkVisitor& visitor = nullptr, ThreadPool& pool = ThreadPool::global());
+std::vector<size_t> verifyDump(const std::string& path, const DumpHashManifest& manifest,
+                               ThreadPool& pool = ThreadPool::global());
+
+#endif //DUDEDUMPER_HASHING_H
@@ -0,0 +1,240 @@
+#include "hexviewer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define HEX_VIEWER_WHEEL_ROWS 3
+
+/**
+ * Opens the dump, the previous one is closed
+ * The pages are read through the given cache, or a private one if there is none
+ * Physical addresses follow the layout of the dump, opened here if it isn't given
+ */
+void HexViewer::Open(const std::string& path, std::shared_ptr<PageCache> cache, const DumpLayout& layout)
+{
+	if (!cache)
+		cache = std::make_shared<PageCache>(MEMORY_VIEW_CACHE_SIZE);
+	view = std::make_unique<MemoryView>(path, std::move(cache), layout);
+	selectedSpace = 0;
+	topRow = 0;
+	highlightAddress = UINT64_MAX;
+	InvalidatePages();
+}
+
+void HexViewer::Close()
+{
+	view.reset();
+	InvalidatePages();
+}
+
+/**
+ * Follows the physical memory of a dump that grew, the pages on screen are read again
+ */
+void HexViewer::SetPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical)
+{
+	if (view)
+		view->setPhysicalSpace(std::move(physical));
+	InvalidatePages();
+}
+
+void HexViewer::InvalidatePages()
+{
+	for (PageSlot& slot : slots)
+		slot.pageNumber = UINT64_MAX;
+}
+
+/**
+ * Returns a page of the current address space, only the few pages on screen are kept here,
+ * everything else comes from the bounded cache of the MemoryView
+ */
+const HexViewer::PageSlot& HexViewer::FetchPage(uint64_t pageNumber)
+{
+	for (PageSlot& slot : slots)
+	{
+		if (slot.pageNumber == pageNumber)
+			return slot;
+	}
+
+	PageSlot& slot = slots[nextSlot];
+	nextSlot = (nextSlot + 1) % HEX_VIEWER_PAGE_SLOTS;
+	slot.pageNumber = pageNumber;
+	slot.size = view->readPage(pageNumber, slot.data);
+	return slot;
+}
+
+uint64_t HexViewer::LastRow()
+{
+	return ((view->lastPage() << PAGE_4KB_SHIFT) + PAGE_SIZE - 1) / HEX_VIEWER_BYTES_PER_ROW;
+}
+
+/**
+ * Scrolls so that the address is near the top of the window and highlights it
+ */
+void HexViewer::JumpTo(uint64_t address)
+{
+	uint64_t row = address / HEX_VIEWER_BYTES_PER_ROW;
+	topRow = std::min(row - std::min<uint64_t>(row, 4), LastRow());
+	highlightAddress = address;
+}
+
+/**
+ * Formats and draws the visible rows only, a row never crosses a page
+ */
+void HexViewer::DrawRows(int visibleRows)
+{
+	const ImVec4 unmappedColor = ImGui::GetStyle().Colors[ImGuiCol_TextDisabled];
+	const ImVec4 highlightColor(1.f, 0.85f, 0.3f, 1.f);
+	uint64_t lastRow = LastRow();
+
+	for (int i = 0; i < visibleRows && topRow + i <= lastRow; i++)
+	{
+		uint64_t address = (topRow + i) * HEX_VIEWER_BYTES_PER_ROW;
+		const PageSlot& page = FetchPage(address >> PAGE_4KB_SHIFT);
+		size_t offset = PAGE_4KB_OFFSET(address);
+
+		char line[24 + HEX_VIEWER_BYTES_PER_ROW * 4];
+		int length = snprintf(line, sizeof(line), "%016llx  ", static_cast<unsigned long long>(address));
+
+		if (page.size == 0)
+		{
+			snprintf(line + length, sizeof(line) - length, "-- unmapped --");
+			ImGui::TextColored(unmappedColor, "%s", line);
+			continue;
+		}
+
+		char* ascii = line + length + HEX_VIEWER_BYTES_PER_ROW * 3 + 1;
+		for (size_t column = 0; column < HEX_VIEWER_BYTES_PER_ROW; column++)
+		{
+			char* hex = line + length + column * 3;
+			if (offset + column < page.size)
+			{
+				uint8_t value = page.data[offset + column];
+				snprintf(hex, 4, "%02x ", value);
+				ascii[column] = value >= 0x20 && value < 0x7f ? static_cast<char>(value) : '.';
+			}
+			else
+			{
+				snprintf(hex, 4, "   ");
+				ascii[column] = ' ';
+			}
+		}
+		ascii[-1] = ' ';
+		ascii[HEX_VIEWER_BYTES_PER_ROW] = '\0';
+
+		bool highlighted = highlightAddress != UINT64_MAX && highlightAddress / HEX_VIEWER_BYTES_PER_ROW == topRow + i;
+		if (highlighted)
+			ImGui::TextColored(highlightColor, "%s", line);
+		else
+			ImGui::TextUnformatted(line);
+	}
+}
+
+/**
+ * Draws the viewer window
+ */
+void HexViewer::Draw(const std::vector<Process>& processList, bool* open)
+{
+	if (!ImGui::Begin("Hex viewer", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	if (view == nullptr || !view->isOpen())
+	{
+		ImGui::TextUnformatted("No dump opened");
+		ImGui::End();
+		return;
+	}
+
+	if (selectedSpace > static_cast<int>(processList.size()))
+		selectedSpace = 0;
+
+	const char* preview = selectedSpace == 0 ? "Physical memory" : processList[selectedSpace - 1].ProcessName.c_str();
+	ImGui::SetNextItemWidth(200.f);
+	if (ImGui::BeginCombo("Address space", preview))
+	{
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(processList.size()) + 1);
+		while (clipper.Step())
+		{
+			for (int n = clipper.DisplayStart; n < clipper.DisplayEnd; n++)
+			{
+				ImGui::PushID(n);
+				const char* label = n == 0 ? "Physical memory" : processList[n - 1].ProcessName.c_str();
+				if (ImGui::Selectable(label, selectedSpace == n) && selectedSpace != n)
+				{
+					selectedSpace = n;
+					if (n == 0)
+						view->setPhysical();
+					else
+						view->setVirtual(processList[n - 1].DirectoryTableBase);
+					InvalidatePages();
+					topRow = std::min(topRow, LastRow());
+				}
+				ImGui::PopID();
+			}
+		}
+		ImGui::EndCombo();
+	}
+
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(160.f);
+	bool jump = ImGui::InputTextWithHint("##address", "address", jumpText, sizeof(jumpText),
+		ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	jump |= ImGui::Button("Go");
+	if (jump && jumpText[0] != '\0')
+		JumpTo(std::strtoull(jumpText, nullptr, 16));
+
+	ImGui::SameLine();
+	ImGui::TextDisabled("cache: %llu hits, %llu misses",
+		static_cast<unsigned long long>(view->cache().hits()),
+		static_cast<unsigned long long>(view->cache().misses()));
+
+	float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+	float scrollbarWidth = ImGui::GetStyle().ScrollbarSize;
+	ImVec2 available = ImGui::GetContentRegionAvail();
+	int visibleRows = std::max(1, static_cast<int>(available.y / lineHeight));
+	uint64_t lastRow = LastRow();
+	uint64_t lastTopRow = lastRow - std::min<uint64_t>(lastRow, visibleRows - 1);
+
+	ImGui::BeginChild("rows", ImVec2(available.x - scrollbarWidth - ImGui::GetStyle().ItemSpacing.x, available.y), false,
+		ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+	if (ImGui::IsWindowHovered())
+	{
+		float wheel = ImGui::GetIO().MouseWheel;
+		if (wheel > 0.f)
+			topRow -= std::min<uint64_t>(topRow, static_cast<uint64_t>(wheel * HEX_VIEWER_WHEEL_ROWS));
+		else if (wheel < 0.f)
+			topRow += static_cast<uint64_t>(-wheel * HEX_VIEWER_WHEEL_ROWS);
+	}
+	if (ImGui::IsWindowFocused())
+	{
+		if (ImGui::IsKeyPressed(ImGuiKey_PageDown))
+			topRow += visibleRows;
+		if (ImGui::IsKeyPressed(ImGuiKey_PageUp))
+			topRow -= std::min<uint64_t>(topRow, visibleRows);
+		if (ImGui::IsKeyPressed(ImGuiKey_DownArrow))
+			topRow++;
+		if (ImGui::IsKeyPressed(ImGuiKey_UpArrow) && topRow > 0)
+			topRow--;
+	}
+	topRow = std::min(topRow, lastTopRow);
+
+	DrawRows(visibleRows);
+	ImGui::EndChild();
+
+	// Sliders put the maximum at the top, the position is mirrored so that row 0 is at the top
+	ImGui::SameLine();
+	uint64_t position = lastTopRow - topRow;
+	const uint64_t minimum = 0;
+	if (ImGui::VSliderScalar("##position", ImVec2(scrollbarWidth, available.y), ImGuiDataType_U64, &position,
+		&minimum, &lastTopRow, "", ImGuiSliderFlags_NoInput))
+	{
+		topRow = lastTopRow - std::min(position, lastTopRow);
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "imgui.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "structs.h"
+#include "memoryview.h"
+
+#define HEX_VIEWER_BYTES_PER_ROW 16
+#define HEX_VIEWER_PAGE_SLOTS 4
+
+/*
+ * Hex/ASCII window over the physical memory of the dump or the virtual memory of a process.
+ * The position is kept as a 64-bit row number instead of an ImGui scroll offset,
+ * so that scrolling stays exact over address spaces of any size.
+ */
+class HexViewer {
+public:
+	void Open(const std::string& path, std::shared_ptr<PageCache> cache = nullptr, const DumpLayout& layout = DumpLayout());
+	void Close();
+	void SetPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical);
+	void Draw(const std::vector<Process>& processList, bool* open);
+
+private:
+	struct PageSlot {
+		uint64_t pageNumber = UINT64_MAX;
+		size_t size = 0;
+		uint8_t data[PAGE_SIZE];
+	};
+
+	const PageSlot& FetchPage(uint64_t pageNumber);
+	void InvalidatePages();
+	void JumpTo(uint64_t address);
+	void DrawRows(int visibleRows);
+	uint64_t LastRow();
+
+	std::unique_ptr<MemoryView> view;
+	PageSlot slots[HEX_VIEWER_PAGE_SLOTS];
+	size_t nextSlot = 0;
+	uint64_t topRow = 0;
+	uint64_t highlightAddress = UINT64_MAX;
+	int selectedSpace = 0;
+	char jumpText[20] = "";
+};
@@ -0,0 +1,288 @@
+#include "hiberfil.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "xpress.h"
+
+
+template<class T>
+static T readField(const uint8_t *data, uint64_t offset)
+{
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+/**
+ * @param file: file stream
+ * @return: true if the file starts with the signature of a hibernation file
+ */
+bool isHiberFile(std::istream& file)
+{
+    char signature[4];
+    file.clear();
+    file.seekg(HIBER_SIGNATURE_OFFSET, std::ios::beg);
+    if (!file.read(signature, sizeof(signature))) {
+        return false;
+    }
+
+    for (const char *known : {"hibr", "HIBR", "wake", "WAKE"}) {
+        if (std::memcmp(signature, known, sizeof(signature)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Index the memory tables and the Xpress blocks of a mapped hibernation file, isOpen tells whether they are valid.
+ * Windows 7 files have an Xpress block right after their first memory table, later ones are read as restore sets.
+ *
+ * @param file: mapping of the hibernation file
+ * @param cacheSize: upper bound of the decompressed blocks kept in memory
+ */
+HiberFile::HiberFile(std::shared_ptr<const MappedFile> file, size_t cacheSize)
+    : file(std::move(file))
+{
+    if (!this->file || !this->file->isOpen() || this->file->size() < PAGE_SIZE) {
+        return;
+    }
+
+    uint64_t firstTablePage = readField<uint64_t>(this->file->data(), HIBER_FIRST_TABLE_PAGE_OFFSET);
+    uint64_t firstBlock = (firstTablePage + 1) * PAGE_SIZE;
+    bool memoryTables = firstTablePage != 0 && firstTablePage < this->file->size() / PAGE_SIZE
+                        && firstBlock + XPRESS_SIGNATURE_SIZE <= this->file->size()
+                        && std::memcmp(this->file->data() + firstBlock, XPRESS_SIGNATURE, XPRESS_SIGNATURE_SIZE) == 0;
+
+    auto table = std::make_shared<RunTable>();
+    if (!(memoryTables ? readTables(*table) : readRestoreSets(*table)) || xpressBlocks.empty()) {
+        return;
+    }
+    runTable = table;
+
+    uint64_t blockSize = XPRESS_MAX_PAGES * PAGE_SIZE;
+    initializeCache(blockSize, xpressBlocks.size(), xpressBlocks.size() * blockSize, cacheSize);
+}
+
+/**
+ * Follow the memory tables from the header. The Xpress blocks after each table hold the pages of its
+ * ranges, in order.
+ *
+ * @param runTable: receives the physical pages of the blocks, finalized
+ * @return: true if the tables and the block headers are valid, false otherwise
+ */
+bool HiberFile::readTables(RunTable& runTable)
+{
+    const uint8_t *data = file->data();
+    uint64_t fileSize = file->size();
+
+    uint64_t tablePage = readField<uint64_t>(data, HIBER_FIRST_TABLE_PAGE_OFFSET);
+    uint32_t set = 0;
+    while (tablePage != 0) {
+        if (tablePage >= fileSize / PAGE_SIZE) {
+            std::cerr << "Hibernation memory table past the end of the file: page " << tablePage << "\n";
+            return false;
+        }
+
+        const uint8_t *table = data + tablePage * PAGE_SIZE;
+        uint32_t entryCount = readField<uint32_t>(table, HIBER_TABLE_COUNT_OFFSET);
+        if (entryCount > HIBER_TABLE_MAX_ENTRIES) {
+            std::cerr << "Invalid hibernation memory table at page " << tablePage << "\n";
+            return false;
+        }
+
+        uint64_t offset = (tablePage + 1) * PAGE_SIZE;
+        uint32_t blockPagesLeft = 0;
+        for (uint32_t entry = 0; entry < entryCount; entry++) {
+            const uint8_t *range = table + HIBER_TABLE_ENTRIES_OFFSET + entry * HIBER_TABLE_ENTRY_SIZE;
+            uint64_t startPage = readField<uint64_t>(range, HIBER_ENTRY_START_PAGE_OFFSET);
+            uint64_t endPage = readField<uint64_t>(range, HIBER_ENTRY_END_PAGE_OFFSET);
+            if (endPage < startPage) {
+                std::cerr << "Invalid hibernation memory range at page " << tablePage << "\n";
+                return false;
+            }
+
+            while (startPage < endPage) {
+                if (blockPagesLeft == 0) {
+                    if (offset + XPRESS_HEADER_SIZE > fileSize
+                        || std::memcmp(data + offset, XPRESS_SIGNATURE, XPRESS_SIGNATURE_SIZE) != 0) {
+                        std::cerr << "Missing Xpress block at offset " << offset << "\n";
+                        return false;
+                    }
+
+                    uint32_t sizes = readField<uint32_t>(data, offset + XPRESS_SIGNATURE_SIZE);
+                    XpressBlock block{offset + XPRESS_HEADER_SIZE, (sizes >> XPRESS_SIZE_SHIFT) + 1,
+                                      (sizes & XPRESS_PAGES_MASK) + 1, set};
+                    if (block.pageCount > XPRESS_MAX_PAGES || block.compressedSize > fileSize - block.fileOffset) {
+                        std::cerr << "Invalid Xpress block at offset " << offset << "\n";
+                        return false;
+                    }
+
+                    xpressBlocks.push_back(block);
+                    blockPagesLeft = block.pageCount;
+                    offset = block.fileOffset + ((block.compressedSize + 7) & ~7ull);
+                }
+
+                const XpressBlock& block = xpressBlocks.back();
+                uint64_t pages = std::min<uint64_t>(endPage - startPage, blockPagesLeft);
+                uint64_t blockOffset = ((xpressBlocks.size() - 1) * XPRESS_MAX_PAGES + block.pageCount - blockPagesLeft) * PAGE_SIZE;
+                runTable.add(startPage * PAGE_SIZE, pages * PAGE_SIZE, blockOffset);
+                startPage += pages;
+                blockPagesLeft -= pages;
+            }
+        }
+
+        if (blockPagesLeft != 0) {
+            std::cerr << "Xpress blocks don't match the memory table at page " << tablePage << "\n";
+            return false;
+        }
+
+        uint64_t nextPage = readField<uint64_t>(table, HIBER_TABLE_NEXT_OFFSET);
+        if (nextPage != 0 && nextPage <= tablePage) {
+            std::cerr << "Hibernation memory tables loop at page " << tablePage << "\n";
+            return false;
+        }
+        tablePage = nextPage;
+        set++;
+    }
+
+    runTable.finalize();
+    return true;
+}
+
+/**
+ * Read the boot restore set, holding the pages of the loader, then the kernel restore set, holding the
+ * rest of the memory. Each one is a sequence of compression sets starting at the page the header gives.
+ *
+ * @param runTable: receives the physical pages of the compression sets, finalized
+ * @return: true if the restore sets are valid, false otherwise
+ */
+bool HiberFile::readRestoreSets(RunTable& runTable)
+{
+    const uint8_t *data = file->data();
+    uint64_t fileSize = file->size();
+
+    uint64_t loaderPages = readField<uint64_t>(data, HIBER_LOADER_PAGES_OFFSET);
+    uint64_t bootPage = readField<uint64_t>(data, HIBER_FIRST_BOOT_RESTORE_PAGE_OFFSET);
+    uint64_t kernelPage = readField<uint64_t>(data, HIBER_FIRST_KERNEL_RESTORE_PAGE_OFFSET);
+    if (bootPage == 0 || kernelPage < bootPage || kernelPage >= fileSize / PAGE_SIZE) {
+        std::cerr << "Invalid hibernation restore sets: boot page " << bootPage << ", kernel page " << kernelPage << "\n";
+        return false;
+    }
+
+    // The kernel set has no page count here, it ends at the first header that isn't a compression set
+    if (!readRestoreSet(bootPage * PAGE_SIZE, kernelPage * PAGE_SIZE, loaderPages, HIBER_BOOT_SET, runTable)
+        || !readRestoreSet(kernelPage * PAGE_SIZE, fileSize, UINT64_MAX, HIBER_KERNEL_SET, runTable)) {
+        return false;
+    }
+
+    runTable.finalize();
+    return true;
+}
+
+/**
+ * Read the compression sets of a restore set. A set header packs the number of page descriptors (low 8 bits),
+ * the compressed size (next 22 bits) and the Huffman flag (high bit), the descriptors and the compressed
+ * data follow it. A descriptor holds the first page number (high 60 bits) and the page count - 1 (low 4 bits).
+ *
+ * @param offset: file offset of the first compression set
+ * @param endOffset: file offset the restore set can't cross
+ * @param pageCount: pages of the restore set, UINT64_MAX if it ends at the first invalid header
+ * @param set: set of the blocks
+ * @param runTable: receives the physical pages of the compression sets
+ * @return: true if the compression sets are valid, false otherwise
+ */
+bool HiberFile::readRestoreSet(uint64_t offset, uint64_t endOffset, uint64_t pageCount, uint32_t set,
+                               RunTable& runTable)
+{
+    const uint8_t *data = file->data();
+    uint64_t pagesRead = 0;
+
+    while (pagesRead < pageCount) {
+        uint32_t header = offset + HIBER_SET_HEADER_SIZE <= endOffset ? readField<uint32_t>(data, offset) : 0;
+        uint32_t descriptorCount = header & HIBER_SET_DESCRIPTOR_COUNT_MASK;
+        uint64_t descriptorsEnd = offset + HIBER_SET_HEADER_SIZE + descriptorCount * HIBER_SET_DESCRIPTOR_SIZE;
+        XpressBlock block{descriptorsEnd, (header >> HIBER_SET_SIZE_SHIFT) & HIBER_SET_SIZE_MASK, 0, set,
+                          (header & HIBER_SET_HUFFMAN) != 0};
+
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        bool valid = descriptorCount != 0 && descriptorCount <= XPRESS_MAX_PAGES && block.compressedSize != 0
+                     && descriptorsEnd <= endOffset && block.compressedSize <= endOffset - descriptorsEnd;
+        for (uint32_t i = 0; valid && i < descriptorCount; i++) {
+            uint64_t descriptor = readField<uint64_t>(data, offset + HIBER_SET_HEADER_SIZE + i * HIBER_SET_DESCRIPTOR_SIZE);
+            uint64_t pages = (descriptor & HIBER_DESCRIPTOR_PAGES_MASK) + 1;
+            ranges.emplace_back(descriptor >> HIBER_DESCRIPTOR_PAGE_SHIFT, pages);
+            block.pageCount += pages;
+            valid = block.pageCount <= XPRESS_MAX_PAGES;
+        }
+        valid = valid && block.compressedSize <= block.pageCount * PAGE_SIZE;
+
+        if (!valid) {
+            if (pageCount != UINT64_MAX) {
+                std::cerr << "Invalid hibernation compression set at offset " << offset << "\n";
+                return false;
+            }
+            break;
+        }
+
+        uint64_t blockOffset = xpressBlocks.size() * XPRESS_MAX_PAGES * PAGE_SIZE;
+        for (auto& [firstPage, pages] : ranges) {
+            runTable.add(firstPage * PAGE_SIZE, pages * PAGE_SIZE, blockOffset);
+            blockOffset += pages * PAGE_SIZE;
+        }
+        xpressBlocks.push_back(block);
+        offset = block.fileOffset + block.compressedSize;
+        pagesRead += block.pageCount;
+    }
+
+    return true;
+}
+
+/**
+ * @return: physical pages of the file, mapped to offsets in the decompressed blocks
+ */
+std::shared_ptr<const RunTable> HiberFile::runs() const
+{
+    return runTable;
+}
+
+const std::vector<XpressBlock>& HiberFile::blocks() const
+{
+    return xpressBlocks;
+}
+
+bool HiberFile::decompress(uint64_t index, std::vector<uint8_t>& data) const
+{
+    const XpressBlock& block = xpressBlocks[index];
+    data.resize(static_cast<size_t>(block.pageCount) * PAGE_SIZE);
+    const uint8_t *input = file->data() + block.fileOffset;
+
+    if (block.compressedSize == data.size()) {
+        std::memcpy(data.data(), input, data.size());
+        return true;
+    }
+
+    bool decompressed = block.huffman ? xpressHuffmanDecompress(input, block.compressedSize, data.data(), data.size())
+                                      : xpressDecompress(input, block.compressedSize, data.data(), data.size());
+    if (!decompressed) {
+        std::cerr << "Failed to decompress Xpress block at offset " << block.fileOffset << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @param index: block missing from the cache
+ * @return: number of blocks of its set from it on, at most HIBER_READ_AHEAD_BLOCKS
+ */
+uint64_t HiberFile::readAheadBlocks(uint64_t index) const
+{
+    uint64_t count = 1;
+    while (count < HIBER_READ_AHEAD_BLOCKS && index + count < xpressBlocks.size()
+           && xpressBlocks[index + count].set == xpressBlocks[index].set) {
+        count++;
+    }
+    return count;
+}
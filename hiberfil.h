@@ -0,0 +1,95 @@
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <vector>
+
+#include "compresseddump.h"
+#include "dumpformat.h"
+#include "mappedfile.h"
+
+#ifndef DUDEDUMPER_HIBERFIL_H
+#define DUDEDUMPER_HIBERFIL_H
+
+// PO_MEMORY_IMAGE, _PO_MEMORY_RANGE_ARRAY and Xpress block headers of Windows 7 / 2008 R2 x64
+#define HIBER_SIGNATURE_OFFSET 0x0
+#define HIBER_FIRST_TABLE_PAGE_OFFSET 0x68
+#define HIBER_TABLE_NEXT_OFFSET 0x8
+#define HIBER_TABLE_COUNT_OFFSET 0x14
+#define HIBER_TABLE_ENTRIES_OFFSET 0x20
+#define HIBER_TABLE_ENTRY_SIZE 0x20
+#define HIBER_ENTRY_START_PAGE_OFFSET 0x8
+#define HIBER_ENTRY_END_PAGE_OFFSET 0x10
+#define HIBER_TABLE_MAX_ENTRIES ((PAGE_SIZE - HIBER_TABLE_ENTRIES_OFFSET) / HIBER_TABLE_ENTRY_SIZE)
+
+// PO_MEMORY_IMAGE and compression set headers of the restore sets of Windows 8 and later x64
+#define HIBER_LOADER_PAGES_OFFSET 0x58
+#define HIBER_FIRST_BOOT_RESTORE_PAGE_OFFSET 0x68
+#define HIBER_FIRST_KERNEL_RESTORE_PAGE_OFFSET 0x70
+#define HIBER_SET_HEADER_SIZE 4
+#define HIBER_SET_DESCRIPTOR_SIZE 8
+// Set header: descriptor count in bits 0-7, compressed size in bits 8-29, Huffman flag in bit 31
+#define HIBER_SET_DESCRIPTOR_COUNT_MASK 0xffu
+#define HIBER_SET_SIZE_SHIFT 8
+#define HIBER_SET_SIZE_MASK 0x3fffffu
+#define HIBER_SET_HUFFMAN 0x80000000u
+// Descriptor: page count - 1 in bits 0-3, first page number in bits 4-63
+#define HIBER_DESCRIPTOR_PAGES_MASK 0xfu
+#define HIBER_DESCRIPTOR_PAGE_SHIFT 4
+#define HIBER_BOOT_SET 0
+#define HIBER_KERNEL_SET 1
+
+#define XPRESS_SIGNATURE "\x81\x81xpress"
+#define XPRESS_SIGNATURE_SIZE 8
+#define XPRESS_HEADER_SIZE 0x20
+// Size field after the signature: page count - 1 in bits 0-9, compressed size - 1 in bits 10-31
+#define XPRESS_PAGES_MASK 0x3ffu
+#define XPRESS_SIZE_SHIFT 10
+#define XPRESS_MAX_PAGES 16
+
+#define HIBER_CACHE_SIZE 0x4000000
+#define HIBER_READ_AHEAD_BLOCKS 16
+
+/*
+ * Xpress block of a hibernation file, decompressing to pageCount pages. Blocks stored uncompressed
+ * have a compressedSize of pageCount pages. Blocks following the same memory table, or of the same
+ * restore set since Windows 8, form a set. Windows 8 and later compress them with LZ77+Huffman.
+ */
+struct XpressBlock {
+    uint64_t fileOffset;
+    uint32_t compressedSize;
+    uint32_t pageCount;
+    uint32_t set;
+    bool huffman = false;
+};
+
+/*
+ * Hibernation file. The memory tables and Xpress block headers (Windows 7), or the compression sets of
+ * the boot and kernel restore sets (Windows 8 and later), are indexed when the file is opened: block i
+ * decompresses to i * XPRESS_MAX_PAGES pages in the decompressed space, and the run table maps the
+ * physical pages listed by the tables or the page descriptors to them. Blocks are decompressed when a read touches them,
+ * with the following blocks of their set in parallel.
+ */
+class HiberFile : public BlockCompressedDump {
+public:
+    explicit HiberFile(std::shared_ptr<const MappedFile> file, size_t cacheSize = HIBER_CACHE_SIZE);
+
+    std::shared_ptr<const RunTable> runs() const;
+    const std::vector<XpressBlock>& blocks() const;
+
+protected:
+    bool decompress(uint64_t index, std::vector<uint8_t>& data) const override;
+    uint64_t readAheadBlocks(uint64_t index) const override;
+
+private:
+    bool readTables(RunTable& runTable);
+    bool readRestoreSets(RunTable& runTable);
+    bool readRestoreSet(uint64_t offset, uint64_t endOffset, uint64_t pageCount, uint32_t set, RunTable& runTable);
+
+    std::shared_ptr<const MappedFile> file;
+    std::shared_ptr<const RunTable> runTable;
+    std::vector<XpressBlock> xpressBlocks;
+};
+
+bool isHiberFile(std::istream& file);
+
+#endif //DUDEDUMPER_HIBERFIL_H
@@ -0,0 +1,125 @@
+#include "layout.h"
+
+#include <algorithm>
+
+#include "memory.h"
+
+
+/**
+ * Append a range to a sorted list, merging it with the last range if the gap between them is below minimumGap.
+ */
+static void appendRange(std::vector<AddressRange>& ranges, const AddressRange& range, uint64_t minimumGap)
+{
+    if (!ranges.empty() && range.start <= ranges.back().end + minimumGap) {
+        ranges.back().end = std::max(ranges.back().end, range.end);
+    } else {
+        ranges.push_back(range);
+    }
+}
+
+/**
+ * @param ranges: ranges in any order, they may overlap
+ */
+void RangeLod::build(std::vector<AddressRange> ranges)
+{
+    levels.clear();
+
+    std::sort(ranges.begin(), ranges.end(), [](const AddressRange& left, const AddressRange& right) {
+        return left.start < right.start;
+    });
+
+    std::vector<AddressRange> exact;
+    for (auto& range : ranges) {
+        if (range.end > range.start) {
+            appendRange(exact, range, 0);
+        }
+    }
+    levels.push_back(std::move(exact));
+
+    for (size_t level = 1; levels.back().size() > 1 && level * RANGE_LOD_GAP_SHIFT + PAGE_4KB_SHIFT < 64; level++) {
+        uint64_t minimumGap = static_cast<uint64_t>(PAGE_SIZE) << (level * RANGE_LOD_GAP_SHIFT);
+        std::vector<AddressRange> coarse;
+        for (auto& range : levels.back()) {
+            appendRange(coarse, range, minimumGap);
+        }
+        levels.push_back(std::move(coarse));
+    }
+}
+
+/**
+ * Get the ranges intersecting [start, end) as seen at a resolution.
+ *
+ * @param start: first address of the window
+ * @param end: end of the window (exclusive)
+ * @param resolution: number of bytes covered by one pixel, gaps below it aren't kept
+ * @param result: receives the ranges, sorted
+ */
+void RangeLod::query(uint64_t start, uint64_t end, uint64_t resolution, std::vector<AddressRange>& result) const
+{
+    result.clear();
+    if (levels.empty() || end <= start) {
+        return;
+    }
+
+    size_t level = 0;
+    while (level + 1 < levels.size() &&
+           (static_cast<uint64_t>(PAGE_SIZE) << ((level + 1) * RANGE_LOD_GAP_SHIFT)) <= resolution) {
+        level++;
+    }
+
+    const std::vector<AddressRange>& ranges = levels[level];
+    auto first = std::upper_bound(ranges.begin(), ranges.end(), start, [](uint64_t address, const AddressRange& range) {
+        return address < range.end;
+    });
+
+    for (auto range = first; range != ranges.end() && range->start < end; range++) {
+        appendRange(result, *range, resolution);
+    }
+}
+
+/**
+ * @return: number of ranges at full detail
+ */
+size_t RangeLod::size() const
+{
+    return levels.empty() ? 0 : levels[0].size();
+}
+
+size_t RangeLod::levelCount() const
+{
+    return levels.size();
+}
+
+/**
+ * Collect the VADs of a process and walk the user half of its page tables.
+ *
+ * @param process: process with its VAD tree read
+ * @param file: file stream
+ * @return: layout of the address space
+ */
+ProcessLayout buildProcessLayout(const Process& process, std::ifstream& file)
+{
+    ProcessLayout layout;
+
+    std::vector<AddressRange> vads;
+    vads.reserve(process.VadTree.size());
+    for (auto& vad : process.VadTree) {
+        vads.push_back({vad.startAddress, vad.endAddress});
+    }
+    layout.vads.build(std::move(vads));
+
+    std::vector<AddressRange> present;
+    std::vector<AddressRange> large;
+    walkPageTables(process.DirectoryTableBase, 0, USER_SPACE_END, file, [&](const PageMapping& mapping) {
+        AddressRange range{mapping.virtualAddress, mapping.virtualAddress + mapping.size};
+        appendRange(present, range, 0);
+        if (mapping.size > PAGE_SIZE) {
+            appendRange(large, range, 0);
+        }
+        layout.presentBytes += mapping.size;
+    });
+    layout.presentPages.build(std::move(present));
+    layout.largePages.build(std::move(large));
+
+    return layout;
+}
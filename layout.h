@@ -0,0 +1,48 @@
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "structs.h"
+
+#ifndef DUDEDUMPER_LAYOUT_H
+#define DUDEDUMPER_LAYOUT_H
+
+// Every level of detail closes the gaps up to 4 times larger than the previous one
+#define RANGE_LOD_GAP_SHIFT 2
+
+struct AddressRange {
+    uint64_t start;
+    uint64_t end;
+};
+
+/*
+ * Sorted ranges of an address space with coarser copies of them, level n having every gap
+ * shorter than PAGE_SIZE << (n * RANGE_LOD_GAP_SHIFT) closed. A query picks the level matching
+ * the resolution it is drawn at, so the number of ranges returned is bounded by the number of
+ * pixels instead of the number of ranges.
+ */
+class RangeLod {
+public:
+    void build(std::vector<AddressRange> ranges);
+    void query(uint64_t start, uint64_t end, uint64_t resolution, std::vector<AddressRange>& result) const;
+    size_t size() const;
+    size_t levelCount() const;
+
+private:
+    std::vector<std::vector<AddressRange>> levels;
+};
+
+/*
+ * What the strip of a process address space shows: the VADs, the present pages and the large pages
+ * of the user half of the address space.
+ */
+struct ProcessLayout {
+    RangeLod vads;
+    RangeLod presentPages;
+    RangeLod largePages;
+    uint64_t presentBytes = 0;
+};
+
+ProcessLayout buildProcessLayout(const Process& process, std::ifstream& file);
+
+#endif //DUDEDUMPER_LAYOUT_H
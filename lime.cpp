@@ -0,0 +1,54 @@
+#include "lime.h"
+
+#include <iostream>
+
+
+/**
+ * @param file: file stream
+ * @return: true if the file starts with a LiME range header
+ */
+bool isLimeDump(std::istream& file)
+{
+    LimeRangeHeader header;
+    file.clear();
+    file.seekg(0, std::ios::beg);
+    return file.read(reinterpret_cast<char *>(&header), sizeof(header)) && header.magic == LIME_MAGIC;
+}
+
+/**
+ * Index the ranges of a LiME dump, they follow each other until the end of the file.
+ *
+ * @param file: file stream
+ * @param runs: receives the physical memory runs, finalized
+ * @return: true if every range header is valid, false otherwise
+ */
+bool readLimeDump(std::istream& file, RunTable& runs)
+{
+    file.clear();
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+    uint64_t offset = 0;
+    while (offset + LIME_HEADER_SIZE <= fileSize) {
+        LimeRangeHeader header;
+        file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+            || header.magic != LIME_MAGIC || header.version != LIME_VERSION
+            || header.endAddress < header.startAddress) {
+            std::cerr << "Invalid LiME range header at offset " << offset << "\n";
+            return false;
+        }
+
+        uint64_t size = header.endAddress - header.startAddress + 1;
+        if (size > fileSize - offset - LIME_HEADER_SIZE) {
+            std::cerr << "Truncated LiME range at offset " << offset << "\n";
+            return false;
+        }
+
+        runs.add(header.startAddress, size, offset + LIME_HEADER_SIZE);
+        offset += LIME_HEADER_SIZE + size;
+    }
+
+    runs.finalize();
+    return true;
+}
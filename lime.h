@@ -0,0 +1,27 @@
+#include <cstdint>
+#include <istream>
+
+#include "dumpformat.h"
+
+#ifndef DUDEDUMPER_LIME_H
+#define DUDEDUMPER_LIME_H
+
+#define LIME_MAGIC 0x4c694d45               // "EMiL"
+#define LIME_VERSION 1
+#define LIME_HEADER_SIZE 32
+
+/*
+ * Header of every range of a LiME dump, the range data follows it. endAddress is inclusive.
+ */
+struct LimeRangeHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t startAddress;
+    uint64_t endAddress;
+    uint8_t reserved[8];
+};
+
+bool isLimeDump(std::istream& file);
+bool readLimeDump(std::istream& file, RunTable& runs);
+
+#endif //DUDEDUMPER_LIME_H
@@ -8,6 +8,9 @@
 #include "GUI.h"
 
 #include "memory.h"
+#include "fingerprint.h"
+#include "pagecache.h"
+#include "sessionview.h"
 
 
 int main()
@@ -20,12 +23,16 @@ int main()
 	bool showplotdemo = false;
 
 	bool open = false;
-	std::string path_to_file = "";
-    bool fileIsAnalyzed = false;
+	bool followGrowth = false;
 
-    std::ifstream file;
-    uint64_t systemKProcessAddress = 0xdeadbeef;
-    std::vector<Process> processList;
+    auto cacheBudget = std::make_shared<CacheBudget>(GUI_CACHE_BUDGET);
+    std::vector<WindowsProfile> profiles = candidateProfiles(PROFILE_DIRECTORY);
+    std::vector<std::unique_ptr<SessionView>> sessions;
+    SessionView* activeSession = nullptr;
+    int nextSessionId = 0;
+    bool showHexViewer = false;
+    bool showMemoryMap = false;
+    file_dialog.on_entries_read = [&gui]() { gui.RequestRedraw(); };
 
 	while (!gui.WindowShouldClose())
 	{
@@ -78,10 +85,33 @@ int main()
 					if (ImGui::MenuItem("Open file")) { 
 						open = true;
 					}
+					ImGui::MenuItem("Follow growing dumps", NULL, &followGrowth);
 					ImGui::Separator();
 					if (ImGui::MenuItem("Exit")) { exit(0); }
 					ImGui::EndMenu();
 				}
+				if (ImGui::BeginMenu("View"))
+				{
+					ImGui::MenuItem("Hex viewer", NULL, &showHexViewer);
+					ImGui::MenuItem("Memory map", NULL, &showMemoryMap);
+					if (ImGui::BeginMenu("Frame rate limit"))
+					{
+						const int limits[] = { 0, 30, 60, 144 };
+						for (int limit : limits)
+						{
+							char label[16];
+							snprintf(label, sizeof(label), limit == 0 ? "Unlimited" : "%d FPS", limit);
+							if (ImGui::MenuItem(label, NULL, gui.GetFrameRateLimit() == limit))
+								gui.SetFrameRateLimit(limit);
+						}
+						ImGui::EndMenu();
+					}
+					ImGui::Separator();
+					ImGui::Text("Page cache: %llu / %llu MB",
+						static_cast<unsigned long long>(cacheBudget->used() >> 20),
+						static_cast<unsigned long long>(cacheBudget->capacity() >> 20));
+					ImGui::EndMenu();
+				}
 #ifdef _DEBUG
 				if (ImGui::BeginMenu("DBG"))
 				{
@@ -101,86 +131,70 @@ int main()
 				ImGui::OpenPopup("Open File");
 			if (file_dialog.showFileDialog(&open, "Open File", imgui_addons::ImGuiFileBrowser::DialogMode::OPEN, ImVec2(700, 310), "*.*"))
 			{
-                if (file.is_open()) {
-                    file.close();
-                }
-				path_to_file = file_dialog.selected_path;
-                fileIsAnalyzed = false;
+                auto session = std::make_unique<SessionView>(file_dialog.selected_path, cacheBudget, nextSessionId++, profiles);
+                session->SetUpdateCallback([&gui]() { gui.RequestRedraw(); });
+                session->Start(followGrowth);
+                sessions.push_back(std::move(session));
+                activeSession = sessions.back().get();
 			}
 		}
 
-        if (!fileIsAnalyzed && !path_to_file.empty())
+        bool anyRunning = false;
+        for (auto& session : sessions)
         {
-            file = std::ifstream(path_to_file, std::ios::binary);
-            if (!file.is_open())
-            {
-                std::cerr << "Failed to open file: " << path_to_file << std::endl;
-                exit(1);
-            }
-            systemKProcessAddress = findSystemKProcessAddress(file);
-
-            if (systemKProcessAddress == 0)
-            {
-                std::cerr << "Failed to find systemKProcessAddress" << std::endl;
-                exit(1);
-            }
-            processList = getProcessList(systemKProcessAddress, _CR3, file);
-            fileIsAnalyzed = true;
+            session->Update();
+            anyRunning |= session->IsRunning();
         }
+        gui.SetWaitTimeout(anyRunning ? BUSY_WAIT_SECONDS : IDLE_WAIT_SECONDS);
 
-		if (fileIsAnalyzed)
+		if (!sessions.empty())
 		{
 			bool windowopened = true;
 			ImGui::Begin("Dump analyzer", &windowopened);
-			ImGui::Text("Current file: %s", path_to_file.c_str());
-			ImGui::Separator();
-
-            static int item_current_idx = 0;
-            const char* combo_preview_value = processList[item_current_idx].ProcessName.c_str();
 
-            if (ImGui::BeginCombo("Process", combo_preview_value))
+            if (ImGui::BeginTabBar("Sessions", ImGuiTabBarFlags_Reorderable | ImGuiTabBarFlags_AutoSelectNewTabs))
             {
-                for (int n = 0; n < processList.size(); n++)
+                for (size_t i = 0; i < sessions.size();)
                 {
-                    const bool is_selected = (item_current_idx == n);
-                    if (ImGui::Selectable(processList[n].ProcessName.c_str(), is_selected)) {
-                        item_current_idx = n;
+                    bool tabOpen = true;
+                    if (ImGui::BeginTabItem(sessions[i]->TabLabel(), &tabOpen))
+                    {
+                        activeSession = sessions[i].get();
+                        sessions[i]->DrawAnalyzer();
+                        ImGui::EndTabItem();
                     }
 
-                    if (is_selected)
-                        ImGui::SetItemDefaultFocus();
-                }
-                ImGui::EndCombo();
-            }
-
-			ImGui::Separator();
-			ImGui::Text("VAD nodes:");
-			if (ImGui::BeginTable("table1", 2, ImGuiTableFlags_Borders))
-			{
-				ImGui::TableSetupColumn("StartAddress", ImGuiTableColumnFlags_WidthFixed);
-				ImGui::TableSetupColumn("EndAddress", ImGuiTableColumnFlags_WidthFixed);
-				ImGui::TableHeadersRow();
-
-                for (auto & processVadNode : processList[item_current_idx].VadTree) {
-                    ImGui::TableNextRow();
-                    for (int column = 0; column < 2; column++)
+                    if (!tabOpen)
+                    {
+                        if (activeSession == sessions[i].get())
+                            activeSession = nullptr;
+                        sessions.erase(sessions.begin() + i);
+                    }
+                    else
                     {
-                        ImGui::TableSetColumnIndex(column);
-                        if (column == 0) {
-                            ImGui::Text("%llx", processVadNode.startAddress);
-                        }
-                        else {
-                            ImGui::Text("%llx", processVadNode.endAddress);
-                        }
+                        i++;
                     }
                 }
-
-				ImGui::EndTable();
-			}
+                ImGui::EndTabBar();
+            }
 
 			ImGui::End();
 			if (!windowopened)
-				path_to_file.clear();
+            {
+                activeSession = nullptr;
+                sessions.clear();
+            }
+		}
+
+        // The hex viewer and the memory map follow the selected tab
+		if (showHexViewer && activeSession)
+		{
+			activeSession->DrawHexViewer(&showHexViewer);
+		}
+
+		if (showMemoryMap && activeSession)
+		{
+			activeSession->DrawMemoryMap(&showMemoryMap);
 		}
 
 
@@ -0,0 +1,92 @@
+#include "mappedfile.h"
+
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * Map the file, isOpen tells whether it worked.
+ *
+ * @param path: path to the file
+ */
+MappedFile::MappedFile(const std::string& path)
+{
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (error || fileSize == 0) {
+        return;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        std::cerr << "Failed to map " << path << "\n";
+        return;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+#else
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return;
+    }
+    void *view = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, descriptor, 0);
+    // The mapping keeps the file referenced
+    close(descriptor);
+    if (view == MAP_FAILED) {
+        std::cerr << "Failed to map " << path << "\n";
+        return;
+    }
+#endif
+
+    mapped = static_cast<uint8_t *>(view);
+    mappedSize = fileSize;
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+#else
+    munmap(mapped, mappedSize);
+#endif
+}
+
+bool MappedFile::isOpen() const
+{
+    return mapped != nullptr;
+}
+
+const uint8_t *MappedFile::data() const
+{
+    return mapped;
+}
+
+uint64_t MappedFile::size() const
+{
+    return mappedSize;
+}
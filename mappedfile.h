@@ -0,0 +1,31 @@
+#include <cstdint>
+#include <string>
+
+#ifndef DUDEDUMPER_MAPPEDFILE_H
+#define DUDEDUMPER_MAPPEDFILE_H
+
+/*
+ * Read-only memory mapping of a whole file, shared by every reader of a dump.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const;
+    const uint8_t *data() const;
+    uint64_t size() const;
+
+private:
+    uint8_t *mapped = nullptr;
+    uint64_t mappedSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+#endif //DUDEDUMPER_MAPPEDFILE_H
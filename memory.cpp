@@ -1,5 +1,12 @@
 #include  "memory.h"
 
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+#include "addressspace.h"
+
+// The functions below are kept for existing callers, they wrap an AddressSpace with the default profile.
 
 /**
  * Validate _KPROCESS structure by checking if System's DirectoryTableBase is equal to _CR3.
@@ -10,39 +17,132 @@
  */
 bool validateKProcess(uint64_t kProcessAddress, std::ifstream &file)
 {
-    _KPROCESS kProcess;
-    readPhysicalMemory(kProcessAddress, &kProcess, sizeof(_KPROCESS), file);
-
-    if (kProcess.DirectoryTableBase == _CR3) {
-        return true;
-    }
-
-    return false;
+    return AddressSpace(file, 0).validateKProcess(kProcessAddress);
 }
 
 /**
  * Find the offset of _KPROCESS structure of System process.
  *
  * @param file: file stream
- * @return: offset of _KPROCESS structure of System process
+ * @param progress: optional token receiving the scanned bytes, the scan stops when it is cancelled
+ * @return: offset of _KPROCESS structure of System process, 0 if not found or cancelled
  */
-std::ptrdiff_t findSystemKProcessAddress(std::ifstream &file)
+std::ptrdiff_t findSystemKProcessAddress(std::ifstream &file, AnalysisProgress *progress)
 {
-    std::string data(std::istreambuf_iterator<char>(file), {});
+    return AddressSpace(file, 0).findSystemKProcess(progress);
+}
 
-    std::size_t position = data.find("System");
-    while (position != std::string::npos) {
-        auto kProcessOffset = position - IMAGE_FILE_NAME;
+/**
+ * Scanner probing the built-in profiles.
+ */
+SystemProcessScanner::SystemProcessScanner()
+    : profiles(builtinProfiles())
+{
+}
+
+/**
+ * @param profiles: candidate layouts, in order of preference
+ */
+SystemProcessScanner::SystemProcessScanner(std::vector<WindowsProfile> profiles)
+    : profiles(std::move(profiles))
+{
+}
 
-        if (validateKProcess(kProcessOffset, file)) {
-            return static_cast<std::ptrdiff_t>(position - IMAGE_FILE_NAME);
+/**
+ * Search the chunk for "System" and check the candidate _KPROCESS structures of every profile.
+ * Candidates whose DirectoryTableBase lies inside the chunk and is the one of the profile are validated
+ * in place, the rest are left for result().
+ *
+ * @param chunk: part of the dump to scan
+ */
+void SystemProcessScanner::scanChunk(const DumpChunk& chunk)
+{
+    // ImageFileName is NUL padded, the terminator keeps out names such as "SystemSettings.exe"
+    static const std::string needle("System", sizeof("System"));
+
+    std::string_view data(chunk.data, chunk.readSize);
+    std::vector<SystemCandidate> chunkValidated;
+    std::vector<SystemCandidate> chunkDeferred;
+
+    for (size_t position = data.find(needle); position < chunk.size; position = data.find(needle, position + 1)) {
+        uint64_t imageFileNameOffset = chunk.offset + position;
+
+        for (size_t i = 0; i < profiles.size(); i++) {
+            const OffsetsProfile& profile = profiles[i].offsets;
+            if (imageFileNameOffset < profile.imageFileName) {
+                continue;
+            }
+
+            uint64_t kProcessOffset = imageFileNameOffset - profile.imageFileName;
+            uint64_t directoryTableBaseOffset = kProcessOffset + profile.directoryTableBase;
+
+            if (directoryTableBaseOffset < chunk.offset || directoryTableBaseOffset + sizeof(uint64_t) > chunk.offset + chunk.readSize) {
+                chunkDeferred.push_back({kProcessOffset, i});
+                continue;
+            }
+
+            uint64_t directoryTableBase;
+            std::memcpy(&directoryTableBase, chunk.data + (directoryTableBaseOffset - chunk.offset), sizeof(uint64_t));
+            if (directoryTableBase == 0) {
+                continue;
+            }
+
+            if (directoryTableBase == profile.systemDirectoryTableBase) {
+                chunkValidated.push_back({kProcessOffset, i});
+            } else {
+                // Another DirectoryTableBase than the expected one, only the process links can tell
+                chunkDeferred.push_back({kProcessOffset, i});
+            }
         }
+    }
 
-        position = data.find("System", position + 1);
+    if (chunkValidated.empty() && chunkDeferred.empty()) {
+        return;
     }
 
-    std::cerr << "'System' _EPROCESS not found\n";
-    return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    validated.insert(validated.end(), chunkValidated.begin(), chunkValidated.end());
+    deferred.insert(deferred.end(), chunkDeferred.begin(), chunkDeferred.end());
+}
+
+/**
+ * Probe the deferred candidates and pick the lowest System _KPROCESS found so far.
+ * The profile it was found with is left in detected, with the DirectoryTableBase of System.
+ *
+ * @param file: file stream used to read the deferred candidates
+ * @param keepUnresolved: keep the candidates that failed the probe for the next call, for a dump whose
+ *                        pages are still being written
+ * @return: offset of _KPROCESS structure of System process, 0 if there is none
+ */
+std::ptrdiff_t SystemProcessScanner::result(std::ifstream &file, bool keepUnresolved)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<SystemCandidate> unresolved;
+    for (const SystemCandidate& candidate : deferred) {
+        if (AddressSpace(file, 0, profiles[candidate.profile].offsets).probeKProcess(candidate.kProcess)) {
+            validated.push_back(candidate);
+        } else if (keepUnresolved) {
+            unresolved.push_back(candidate);
+        }
+    }
+    deferred = std::move(unresolved);
+
+    if (validated.empty()) {
+        return 0;
+    }
+
+    // Ties go to the preferred profile
+    const SystemCandidate& lowest = *std::min_element(validated.begin(), validated.end(),
+                                                      [](const SystemCandidate& a, const SystemCandidate& b) {
+        return a.kProcess != b.kProcess ? a.kProcess < b.kProcess : a.profile < b.profile;
+    });
+
+    detected = profiles[lowest.profile];
+    readPhysicalMemory(lowest.kProcess + detected.offsets.directoryTableBase,
+                       &detected.offsets.systemDirectoryTableBase, sizeof(uint64_t), file);
+
+    return static_cast<std::ptrdiff_t>(lowest.kProcess);
 }
 
 
@@ -57,115 +157,37 @@ std::ptrdiff_t findSystemKProcessAddress(std::ifstream &file)
  */
 bool readPhysicalMemory(uint64_t physicalAddress, void *buffer, size_t size, std::ifstream &file)
 {
-
-    file.seekg(physicalAddress, std::ios::beg);
-
-    if (file.fail()) {
-        std::cerr << "Failed to seek to the physicalAddress position in the file\n";
-        file.clear();
-        return false;
-    }
-
-    file.read(reinterpret_cast<char *>(buffer), size);
-
-    if (file.fail()) {
-        std::cerr << "Failed to read the physicalAddress from the file\n";
-        file.clear();
-        return false;
-    }
-
-    return true;
+    return AddressSpace(file, 0).readPhysical(physicalAddress, buffer, size);
 }
 
-
 /**
  * Convert virtual address to physical address.
  *
  * @param VirtualAddress: virtual address to convert
  * @param DirectoryTableBase: DirectoryTableBase of the process
  * @param file: file stream
- * @return: physical address
+ * @param quiet: don't report pages that aren't present, for callers probing many addresses
+ * @return: physical address, 0 if the address isn't mapped
  */
-uint64_t virtualToPhysicalAddress(uint64_t VirtualAddress, uint64_t DirectoryTableBase, std::ifstream &file)
+uint64_t virtualToPhysicalAddress(uint64_t VirtualAddress, uint64_t DirectoryTableBase, std::ifstream &file, bool quiet)
 {
-    VIRTUAL_ADDRESS virtAddr = {0};
-
-    DIR_TABLE_BASE dirTableBase = {0};
-    PML4E pml4e = {0};
-    PDPTE pdpte = {0};
-    PDPTE_LARGE pdpteLarge = {0};
-    PDE pde = {0};
-    PDE_LARGE pdeLarge = {0};
-    PTE pte = {0};
-
-    virtAddr.All = VirtualAddress;
-    dirTableBase.All = DirectoryTableBase;
-
-    if (!readPhysicalMemory(
-            (dirTableBase.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.Pml4Index * 8),
-            &pml4e,
-            sizeof(PML4E),
-            file)) {
-        return 0;
-    }
-
-    if (pml4e.Bits.Present == 0) {
-        std::cerr << "PML4E not present\n";
-        return 0;
-    }
-
-    if (!readPhysicalMemory(
-            (pml4e.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.PdptIndex * 8),
-            &pdpte,
-            sizeof(PDPTE),
-            file)) {
-        return 0;
-    }
-
-    if (pdpte.Bits.Present == 0) {
-        std::cerr << "PDPTE not present\n";
-        return 0;
-    }
-
-    if (IS_LARGE_PAGE(pdpte.All)) {
-        pdpteLarge.All = pdpte.All;
-        return (pdpteLarge.Bits.PhysicalAddress << PAGE_1GB_SHIFT) + PAGE_1GB_OFFSET(VirtualAddress);
-    }
-
-    if (!readPhysicalMemory(
-            (pdpte.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.PdIndex * 8),
-            &pde,
-            sizeof(PDE),
-            file)) {
-        return 0;
-    }
-
-    if (pde.Bits.Present == 0) {
-        std::cerr << "PDE not present\n";
-        return 0;
-    }
-
-    if (IS_LARGE_PAGE(pde.All)) {
-        pdeLarge.All = pde.All;
-
-        return (pdeLarge.Bits.PhysicalAddress << PAGE_2MB_SHIFT) + PAGE_2MB_OFFSET(VirtualAddress);
-    }
-
-    if (!readPhysicalMemory(
-            (pde.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + (virtAddr.Bits.PtIndex * 8),
-            &pte,
-            sizeof(PTE),
-            file)) {
-        return 0;
-    }
-
-    if (pte.Bits.Present == 0) {
-        std::cerr << "PTE not present\n";
-        return 0;
-    }
-
-    return (pte.Bits.PhysicalAddress << PAGE_4KB_SHIFT) + virtAddr.Bits.PageIndex;
+    return AddressSpace(file, DirectoryTableBase).translate(VirtualAddress, quiet);
+}
 
+/**
+ * Walk the page tables of an address space and report every present page in a range of it.
+ *
+ * @param DirectoryTableBase: DirectoryTableBase of the process
+ * @param startAddress: first virtual address of the range
+ * @param endAddress: end of the range (exclusive), 0 for the end of the address space
+ * @param file: file stream
+ * @param onMapping: called for every present page, in ascending virtual address order
+ * @param onTable: called with the physical address of every paging structure that was read
+ */
+void walkPageTables(uint64_t DirectoryTableBase, uint64_t startAddress, uint64_t endAddress, std::ifstream &file,
+                    const PageMappingCallback& onMapping, const PageTableCallback& onTable)
+{
+    AddressSpace(file, DirectoryTableBase).walk(startAddress, endAddress, onMapping, onTable);
 }
 
 /**
@@ -177,13 +199,7 @@ uint64_t virtualToPhysicalAddress(uint64_t VirtualAddress, uint64_t DirectoryTab
  */
 uint64_t getNextProcessKProcess(uint64_t kProcessAddress, uint64_t DirectoryTableBase, std::ifstream &file)
 {
-    uint64_t flinkVirtAddr;
-    readPhysicalMemory(kProcessAddress + ACTIVE_PROCESS_LINKS_FLINK, &flinkVirtAddr, sizeof(uint64_t), file);
-    uint64_t flinkPhysAddr = virtualToPhysicalAddress(flinkVirtAddr, DirectoryTableBase, file);
-
-    uint64_t nextProcessKProcess = flinkPhysAddr - ACTIVE_PROCESS_LINKS_FLINK;
-
-    return nextProcessKProcess;
+    return AddressSpace(file, DirectoryTableBase).nextProcess(kProcessAddress);
 }
 
 /**
@@ -195,13 +211,7 @@ uint64_t getNextProcessKProcess(uint64_t kProcessAddress, uint64_t DirectoryTabl
  */
 uint64_t getPreviousProcessKProcess(uint64_t kProcessAddress, uint64_t DirectoryTableBase, std::ifstream &file)
 {
-    uint64_t blinkVirtAddr;
-    readPhysicalMemory(kProcessAddress + ACTIVE_PROCESS_LINKS_BLINK, &blinkVirtAddr, sizeof(uint64_t), file);
-    uint64_t blinkPhysAddr = virtualToPhysicalAddress(blinkVirtAddr, DirectoryTableBase, file);
-
-    uint64_t previousProcessKProcess = blinkPhysAddr - ACTIVE_PROCESS_LINKS_FLINK;
-
-    return previousProcessKProcess;
+    return AddressSpace(file, DirectoryTableBase).previousProcess(kProcessAddress);
 }
 
 /**
@@ -212,16 +222,7 @@ uint64_t getPreviousProcessKProcess(uint64_t kProcessAddress, uint64_t Directory
  */
 std::string getProcessName(uint64_t kProcessAddress, std::ifstream &file)
 {
-    char processName[15];
-    readPhysicalMemory(kProcessAddress + IMAGE_FILE_NAME, processName, 15, file);
-
-    std::string processNameStr{processName};
-
-    if (processNameStr.empty()) {
-        processNameStr = "###";
-    }
-
-    return processNameStr;
+    return AddressSpace(file, 0).processName(kProcessAddress);
 }
 
 /**
@@ -229,38 +230,28 @@ std::string getProcessName(uint64_t kProcessAddress, std::ifstream &file)
  * @param systemKProcessAddress: offset of _KPROCESS structure of the system process
  * @param systemDirectoryTableBase: DirectoryTableBase of the system process
  * @param file: file stream
+ * @param progress: optional token counting the processes, the walk stops when it is cancelled
  * @return: list of processes
  */
-std::vector<Process> getProcessList(uint64_t systemKProcessAddress, uint64_t systemDirectoryTableBase, std::ifstream &file)
+std::vector<Process> getProcessList(uint64_t systemKProcessAddress, uint64_t systemDirectoryTableBase, std::ifstream &file,
+                                    AnalysisProgress *progress)
+{
+    return AddressSpace(file, systemDirectoryTableBase).processList(systemKProcessAddress, progress);
+}
+
+/**
+ * Walk ActiveProcessLinks starting from the system process and report every process as soon as it is read.
+ * @param systemKProcessAddress: offset of _KPROCESS structure of the system process
+ * @param systemDirectoryTableBase: DirectoryTableBase of the system process
+ * @param file: file stream
+ * @param callback: called for every process in list order
+ * @param readVadTrees: read the VAD tree of every process, otherwise Process::VadTree is left empty
+ * @param progress: optional token counting the processes, the walk stops when it is cancelled
+ */
+void walkProcessList(uint64_t systemKProcessAddress, uint64_t systemDirectoryTableBase, std::ifstream &file,
+                     const ProcessCallback& callback, bool readVadTrees, AnalysisProgress *progress)
 {
-    std::vector<Process> processList;
-
-    uint64_t curProcessKProcess = systemKProcessAddress;
-    std::string curProcessName = getProcessName(curProcessKProcess, file);
-    uint64_t curProcessDirectoryTableBase = systemDirectoryTableBase;
-    std::vector<VadNode> curVadTree = readProcessVadTree(curProcessKProcess, curProcessDirectoryTableBase, file);
-
-    Process curProcess{curProcessKProcess,
-                       curProcessDirectoryTableBase,
-                       curProcessName,
-                       curVadTree};
-    processList.push_back(curProcess);
-
-    do {
-        curProcessKProcess = getNextProcessKProcess(curProcessKProcess, systemDirectoryTableBase, file);
-        curProcessName = getProcessName(curProcessKProcess, file);
-        readPhysicalMemory(curProcessKProcess + DIRECTORY_TABLE_BASE, &curProcessDirectoryTableBase, sizeof(uint64_t), file);
-        curVadTree = readProcessVadTree(curProcessKProcess, curProcessDirectoryTableBase, file);
-
-        curProcess = Process{curProcessKProcess,
-                           curProcessDirectoryTableBase,
-                           curProcessName,
-                             curVadTree};
-        processList.push_back(curProcess);
-
-    } while (curProcessDirectoryTableBase != systemDirectoryTableBase);
-
-    return processList;
+    AddressSpace(file, systemDirectoryTableBase).walkProcessList(systemKProcessAddress, callback, readVadTrees, progress);
 }
 
 /**
@@ -272,11 +263,7 @@ std::vector<Process> getProcessList(uint64_t systemKProcessAddress, uint64_t sys
  */
 uint64_t getVadRootPhysicalAddress(uint64_t kProcessPhysAddr, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    uint64_t vadRootVirtAddr;
-    readPhysicalMemory(kProcessPhysAddr + VAD_ROOT, &vadRootVirtAddr, sizeof(uint64_t), file);
-    uint64_t vadRootPhysAddr = virtualToPhysicalAddress(vadRootVirtAddr, DirectoryTableBase, file);
-
-    return vadRootPhysAddr;
+    return AddressSpace(file, DirectoryTableBase).vadRoot(kProcessPhysAddr);
 }
 
 /**
@@ -288,17 +275,7 @@ uint64_t getVadRootPhysicalAddress(uint64_t kProcessPhysAddr, uint64_t Directory
  */
 uint64_t getLeftNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    uint64_t leftVirtAddr;
-    readPhysicalMemory(nodePhysAddr, &leftVirtAddr, sizeof(uint64_t), file);
-
-    if (leftVirtAddr == 0x0)
-    {
-        return 0;
-    }
-
-    uint64_t leftPhysAddr = virtualToPhysicalAddress(leftVirtAddr, DirectoryTableBase, file);
-
-    return leftPhysAddr;
+    return AddressSpace(file, DirectoryTableBase).leftNode(nodePhysAddr);
 }
 
 /**
@@ -310,17 +287,7 @@ uint64_t getLeftNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTab
  */
 uint64_t getRightNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    uint64_t rightVirtAddr;
-    readPhysicalMemory(nodePhysAddr + RIGHT_CHILD, &rightVirtAddr, sizeof(uint64_t), file);
-
-    if (rightVirtAddr == 0x0)
-    {
-        return 0;
-    }
-
-    uint64_t rightPhysAddr = virtualToPhysicalAddress(rightVirtAddr, DirectoryTableBase, file);
-
-    return rightPhysAddr;
+    return AddressSpace(file, DirectoryTableBase).rightNode(nodePhysAddr);
 }
 
 /**
@@ -332,12 +299,7 @@ uint64_t getRightNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTa
  */
 uint64_t getParentNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    uint64_t parentValueVirtAddr;
-    readPhysicalMemory(nodePhysAddr + PARENT_VALUE, &parentValueVirtAddr, sizeof(uint64_t), file);
-    parentValueVirtAddr = parentValueVirtAddr & (~0x7);
-    uint64_t parentValuePhysAddr = virtualToPhysicalAddress(parentValueVirtAddr, DirectoryTableBase, file);
-
-    return parentValuePhysAddr;
+    return AddressSpace(file, DirectoryTableBase).parentNode(nodePhysAddr);
 }
 
 /**
@@ -349,18 +311,7 @@ uint64_t getParentNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryT
  */
 VadNode readVadNode(uint64_t nodePhysicalAddress, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    ULONG StartingVpn, EndingVpn;
-    UCHAR StartingVpnHigh, EndingVpnHigh;
-
-    readPhysicalMemory(nodePhysicalAddress + STARTING_VPN, &StartingVpn, sizeof(ULONG), file);
-    readPhysicalMemory(nodePhysicalAddress + ENDING_VPN, &EndingVpn, sizeof(ULONG), file);
-    readPhysicalMemory(nodePhysicalAddress + STARTING_VPN_HIGH, &StartingVpnHigh, sizeof(UCHAR), file);
-    readPhysicalMemory(nodePhysicalAddress + ENDING_VPN_HIGH, &EndingVpnHigh, sizeof(UCHAR), file);
-
-    uint64_t start = ((uint64_t)StartingVpn << 12) | ((uint64_t)StartingVpnHigh << 44);
-    uint64_t end = (((uint64_t)EndingVpn + 1ll) << 12) | ((uint64_t)EndingVpnHigh << 44);
-
-    return VadNode{start, end};
+    return AddressSpace(file, DirectoryTableBase).readVadNode(nodePhysicalAddress);
 }
 
 /**
@@ -372,27 +323,7 @@ VadNode readVadNode(uint64_t nodePhysicalAddress, uint64_t DirectoryTableBase, s
  */
 std::vector<VadNode> readVadTree(uint64_t nodePhysicalAddress, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    uint64_t leftNode = getLeftNodePhysicalAddress(nodePhysicalAddress, DirectoryTableBase, file);
-    uint64_t rightNode = getRightNodePhysicalAddress(nodePhysicalAddress, DirectoryTableBase, file);
-
-    std::vector<VadNode> nodes;
-
-    if (leftNode != 0x0)
-    {
-        std::vector<VadNode> leftNodes = readVadTree(leftNode, DirectoryTableBase, file);
-        nodes.insert(nodes.end(), leftNodes.begin(), leftNodes.end());
-    }
-
-    VadNode node = readVadNode(nodePhysicalAddress, DirectoryTableBase, file);
-    nodes.push_back(node);
-
-    if (rightNode != 0x0)
-    {
-        std::vector<VadNode> rightNodes = readVadTree(rightNode, DirectoryTableBase, file);
-        nodes.insert(nodes.end(), rightNodes.begin(), rightNodes.end());
-    }
-
-    return nodes;
+    return AddressSpace(file, DirectoryTableBase).readVadTree(nodePhysicalAddress);
 }
 
 /**
@@ -404,6 +335,5 @@ std::vector<VadNode> readVadTree(uint64_t nodePhysicalAddress, uint64_t Director
  */
 std::vector<VadNode> readProcessVadTree(uint64_t kProcessPhysicalAddress, uint64_t DirectoryTableBase, std::ifstream& file)
 {
-    uint64_t vadRoot = getVadRootPhysicalAddress(kProcessPhysicalAddress, DirectoryTableBase, file);
-    return readVadTree(vadRoot, DirectoryTableBase, file);
-}
\ No newline at end of file
+    return AddressSpace(file, DirectoryTableBase).readProcessVadTree(kProcessPhysicalAddress);
+}
@@ -1,24 +1,93 @@
 //
 // Created by vanya on 6/9/2023.
 //
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "structs.h"
+#include "profile.h"
 
 #ifndef DUDEDUMPER_MEMORY_H
 #define DUDEDUMPER_MEMORY_H
 
+#define SCAN_CHUNK_SIZE 0x1000000
+#define SCAN_CHUNK_OVERLAP 0x10
+
+#define USER_SPACE_END 0x800000000000
+#define KERNEL_SPACE_START 0xffff800000000000
+#define PAGE_TABLE_ENTRIES 512
+
+using ProcessCallback = std::function<void(const Process&)>;
+
+/*
+ * Present translation found by walkPageTables, size is the size of the page (4KB, 2MB or 1GB).
+ */
+struct PageMapping {
+    uint64_t virtualAddress;
+    uint64_t physicalAddress;
+    uint64_t size;
+};
+
+using PageMappingCallback = std::function<void(const PageMapping&)>;
+using PageTableCallback = std::function<void(uint64_t tablePhysicalAddress)>;
+
+/*
+ * Progress and cancellation token of a running analysis. The analysis updates the counters,
+ * any other thread may read them or request cancellation.
+ */
+struct AnalysisProgress {
+    std::atomic<uint64_t> bytesScanned{0};
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<uint64_t> processesFound{0};
+    std::atomic<bool> cancelled{false};
+};
+
+/*
+ * "System" _EPROCESS candidate and the index of the profile whose layout placed it there.
+ */
+struct SystemCandidate {
+    uint64_t kProcess;
+    size_t profile;
+};
+
+/*
+ * Collects "System" _EPROCESS candidates from chunks of the dump. scanChunk may be called
+ * concurrently and in any order, so the scan can share a read pass with other consumers (e.g. hashDump).
+ * Every "System" string is tried with the layout of every profile, result() keeps the lowest candidate
+ * that validates and the profile it was found with.
+ */
+struct SystemProcessScanner {
+    SystemProcessScanner();
+    explicit SystemProcessScanner(std::vector<WindowsProfile> profiles);
+
+    void scanChunk(const DumpChunk& chunk);
+    std::ptrdiff_t result(std::ifstream& file, bool keepUnresolved = false);
+
+    std::vector<WindowsProfile> profiles;
+    WindowsProfile detected;
+    std::mutex mutex;
+    std::vector<SystemCandidate> validated;
+    std::vector<SystemCandidate> deferred;
+};
+
 bool validateKProcess(uint64_t kProcessAddress, std::ifstream &file);
-std::ptrdiff_t findSystemKProcessAddress(std::ifstream &file);
+std::ptrdiff_t findSystemKProcessAddress(std::ifstream &file, AnalysisProgress *progress = nullptr);
 bool readPhysicalMemory(uint64_t physicalAddress, void *buffer, size_t size, std::ifstream &file);
-uint64_t virtualToPhysicalAddress(uint64_t VirtualAddress, uint64_t DirectoryTableBase, std::ifstream &file);
+uint64_t virtualToPhysicalAddress(uint64_t VirtualAddress, uint64_t DirectoryTableBase, std::ifstream &file, bool quiet = false);
+void walkPageTables(uint64_t DirectoryTableBase, uint64_t startAddress, uint64_t endAddress, std::ifstream &file,
+                    const PageMappingCallback& onMapping, const PageTableCallback& onTable = nullptr);
 uint64_t getNextProcessKProcess(uint64_t kProcessAddress, uint64_t DirectoryTableBase, std::ifstream &file);
 uint64_t getPreviousProcessKProcess(uint64_t kProcessAddress, uint64_t DirectoryTableBase, std::ifstream &file);
 std::string getProcessName(uint64_t kProcessAddress, std::ifstream &file);
-std::vector<Process> getProcessList(uint64_t systemKProcessAddress, uint64_t systemDirectoryTableBase, std::ifstream &file);
+std::vector<Process> getProcessList(uint64_t systemKProcessAddress, uint64_t systemDirectoryTableBase, std::ifstream &file,
+                                    AnalysisProgress *progress = nullptr);
+void walkProcessList(uint64_t systemKProcessAddress, uint64_t systemDirectoryTableBase, std::ifstream &file,
+                     const ProcessCallback& callback, bool readVadTrees = true, AnalysisProgress *progress = nullptr);
 uint64_t getVadRootPhysicalAddress(uint64_t kProcessPhysAddr, uint64_t DirectoryTableBase, std::ifstream& file);
 uint64_t getLeftNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTableBase, std::ifstream& file);
 uint64_t getRightNodePhysicalAddress(uint64_t nodePhysAddr, uint64_t DirectoryTableBase, std::ifstream& file);
@@ -1,6 +1,36 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <thread>
+
 #include "memory.h"
+#include "addressspace.h"
+#include "fingerprint.h"
+#include "hashing.h"
+#include "pagecache.h"
+#include "memoryview.h"
+#include "memorymap.h"
+#include "layout.h"
+#include "batch.h"
+#include "worker.h"
+#include "session.h"
+#include "growingfile.h"
+#include "pdb.h"
+#include "crashdump.h"
+#include "elfcore.h"
+#include "lime.h"
+#include "compresseddump.h"
+#include "hiberfil.h"
+#include "xpress.h"
+#include "physicalspace.h"
+#include "streaming.h"
+#include "triage.h"
+#include "pagestore.h"
 
 
 #define TEST_FILE "../2.raw"
@@ -113,3 +143,2029 @@ TEST_CASE("Test readVadNode")
     REQUIRE_EQ(node.endAddress, 0x1b0b94a2000);
 }
 
+
+static std::string writeFixture(const std::string& name, const std::vector<uint8_t>& data)
+{
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return path;
+}
+
+static std::vector<uint8_t> patternData(size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+    }
+    return data;
+}
+
+TEST_CASE("Test computeDumpFingerprint")
+{
+    std::vector<uint8_t> data = patternData(0x400000);
+    std::string first = writeFixture("fingerprint_a.raw", data);
+    std::string second = writeFixture("fingerprint_b.raw", data);
+
+    DumpFingerprint a = computeDumpFingerprint(first);
+    DumpFingerprint b = computeDumpFingerprint(second);
+    REQUIRE_EQ(a.fileSize, data.size());
+    REQUIRE(a.sameContent(b));
+
+    data[0x10] ^= 0xff;
+    writeFixture("fingerprint_b.raw", data);
+    REQUIRE_FALSE(a.sameContent(computeDumpFingerprint(second)));
+}
+
+TEST_CASE("Test computeFullDumpHash")
+{
+    std::vector<uint8_t> data = patternData(FULL_HASH_CHUNK_SIZE + 0x3000);
+    std::string path = writeFixture("fullhash.raw", data);
+    uint64_t digest = computeFullDumpHash(path);
+    REQUIRE_NE(digest, 0);
+    REQUIRE_EQ(digest, computeFullDumpHash(path));
+
+    data.back() ^= 0xff;
+    writeFixture("fullhash.raw", data);
+    REQUIRE_NE(digest, computeFullDumpHash(path));
+}
+
+TEST_CASE("Test sha256Digest")
+{
+    Digest digest = sha256Digest("abc", 3);
+    REQUIRE_EQ(digestToHex(digest), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST_CASE("Test hashDump and verifyDump")
+{
+    std::vector<uint8_t> data = patternData(HASH_CHUNK_SIZE * 2 + 0x5000);
+    std::string path = writeFixture("hashdump.raw", data);
+
+    DumpHashManifest manifest;
+    REQUIRE(hashDump(path, manifest));
+    REQUIRE_EQ(manifest.chunks.size(), 3);
+    REQUIRE_EQ(manifest.sha256Tree.size(), 3);
+    REQUIRE(manifest.chunks[0].sha256 == sha256Digest(data.data(), HASH_CHUNK_SIZE));
+    REQUIRE_EQ(manifest.chunks[2].size, 0x5000);
+    REQUIRE(verifyDump(path, manifest).empty());
+
+    // Leaves and interior nodes are hashed with their own prefix, the odd last leaf is carried up
+    std::vector<Digest> leaves;
+    for (const ChunkDigest& chunk : manifest.chunks) {
+        std::vector<uint8_t> leaf = {MERKLE_LEAF_PREFIX};
+        leaf.insert(leaf.end(), chunk.sha256.begin(), chunk.sha256.end());
+        leaves.push_back(sha256Digest(leaf.data(), leaf.size()));
+    }
+    std::vector<uint8_t> node = {MERKLE_NODE_PREFIX};
+    node.insert(node.end(), leaves[0].begin(), leaves[0].end());
+    node.insert(node.end(), leaves[1].begin(), leaves[1].end());
+    Digest parent = sha256Digest(node.data(), node.size());
+    node = {MERKLE_NODE_PREFIX};
+    node.insert(node.end(), parent.begin(), parent.end());
+    node.insert(node.end(), leaves[2].begin(), leaves[2].end());
+    REQUIRE(manifest.sha256Tree[0] == leaves);
+    REQUIRE(manifest.sha256Root() == sha256Digest(node.data(), node.size()));
+
+    data[HASH_CHUNK_SIZE * 2 + 0x10] ^= 0xff;
+    writeFixture("hashdump.raw", data);
+    std::vector<size_t> mismatches = verifyDump(path, manifest);
+    REQUIRE_EQ(mismatches.size(), 1);
+    REQUIRE_EQ(mismatches[0], 2);
+}
+
+static std::vector<uint8_t> systemProcessFixture(uint64_t kProcessOffset, uint64_t decoyOffset)
+{
+    std::vector<uint8_t> data(SCAN_CHUNK_SIZE * 2, 0);
+    uint64_t directoryTableBase = _CR3;
+    uint64_t wrongDirectoryTableBase = 0x1234000;
+
+    std::memcpy(&data[kProcessOffset + DIRECTORY_TABLE_BASE], &directoryTableBase, sizeof(uint64_t));
+    std::memcpy(&data[kProcessOffset + IMAGE_FILE_NAME], "System", 6);
+    std::memcpy(&data[decoyOffset + DIRECTORY_TABLE_BASE], &wrongDirectoryTableBase, sizeof(uint64_t));
+    std::memcpy(&data[decoyOffset + IMAGE_FILE_NAME], "System", 6);
+
+    return data;
+}
+
+TEST_CASE("Test findSystemKProcessAddress (chunk boundary)")
+{
+    // The image name crosses the first chunk boundary, the decoy precedes it with a wrong DirectoryTableBase.
+    uint64_t kProcessOffset = SCAN_CHUNK_SIZE - IMAGE_FILE_NAME - 3;
+    std::string path = writeFixture("system_boundary.raw", systemProcessFixture(kProcessOffset, 0x1000));
+
+    std::ifstream file(path, std::ios::binary);
+    REQUIRE_EQ(findSystemKProcessAddress(file), kProcessOffset);
+}
+
+TEST_CASE("Test SystemProcessScanner shares the hashDump pass")
+{
+    uint64_t kProcessOffset = SCAN_CHUNK_SIZE + 0x2000;
+    std::string path = writeFixture("system_shared.raw", systemProcessFixture(kProcessOffset, 0x1000));
+
+    SystemProcessScanner scanner;
+    DumpHashManifest manifest;
+    REQUIRE(hashDump(path, manifest, [&](const DumpChunk& chunk) { scanner.scanChunk(chunk); }));
+
+    std::ifstream file(path, std::ios::binary);
+    REQUIRE_EQ(scanner.result(file), kProcessOffset);
+}
+
+TEST_CASE("Test CachedDumpStream")
+{
+    std::vector<uint8_t> data = patternData(0x20000 + 0x800);
+    std::string path = writeFixture("cached.raw", data);
+
+    auto cache = std::make_shared<PageCache>(0x4000);
+    CachedDumpStream file(path, cache);
+    REQUIRE(file.is_open());
+
+    uint64_t value;
+    REQUIRE(readPhysicalMemory(0x1ffc, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(std::memcmp(&value, &data[0x1ffc], sizeof(uint64_t)), 0);
+    REQUIRE(readPhysicalMemory(0x1ff8, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(std::memcmp(&value, &data[0x1ff8], sizeof(uint64_t)), 0);
+    REQUIRE_EQ(cache->misses(), 2);
+    REQUIRE_EQ(cache->hits(), 1);
+
+    std::vector<uint8_t> large(PAGE_CACHE_BYPASS_SIZE);
+    REQUIRE(readPhysicalMemory(0x100, large.data(), large.size(), file));
+    REQUIRE_EQ(std::memcmp(large.data(), &data[0x100], large.size()), 0);
+
+    REQUIRE(readPhysicalMemory(0x20000 + 0x7f8, &value, sizeof(uint64_t), file));
+    REQUIRE_FALSE(readPhysicalMemory(0x20000 + 0x7fc, &value, sizeof(uint64_t), file));
+}
+
+#define FIXTURE_KERNEL_BASE 0xfffff80000000000
+#define FIXTURE_SIZE 0x400000
+
+struct FixtureProcess {
+    std::string name;
+    uint64_t kProcess;
+    uint64_t directoryTableBase;
+    std::vector<VadNode> vads;
+};
+
+/*
+ * Synthetic dump: the first FIXTURE_SIZE bytes of physical memory are mapped at FIXTURE_KERNEL_BASE
+ * with 2MB pages, every process has its own PML4 copy and a balanced VAD tree. The structures are
+ * laid out as the given profile says.
+ */
+struct ProcessFixture {
+    std::vector<uint8_t> data = std::vector<uint8_t>(FIXTURE_SIZE, 0);
+    std::vector<FixtureProcess> processes;
+    OffsetsProfile offsets;
+
+    void write64(uint64_t physicalAddress, uint64_t value)
+    {
+        std::memcpy(&data[physicalAddress], &value, sizeof(uint64_t));
+    }
+
+    static uint64_t kernelAddress(uint64_t physicalAddress)
+    {
+        return physicalAddress == 0 ? 0 : FIXTURE_KERNEL_BASE + physicalAddress;
+    }
+
+    void writePml4(uint64_t directoryTableBase)
+    {
+        uint64_t pml4Index = (FIXTURE_KERNEL_BASE >> 39) & 0x1ff;
+        write64(directoryTableBase + pml4Index * 8, (_CR3 + PAGE_SIZE) | 0x3);
+    }
+
+    uint64_t writeVadTree(const std::vector<VadNode>& vads, size_t first, size_t last, uint64_t& nextNode)
+    {
+        if (first >= last) {
+            return 0;
+        }
+
+        size_t middle = (first + last) / 2;
+        uint64_t node = nextNode;
+        nextNode += 0x40;
+
+        write64(node, kernelAddress(writeVadTree(vads, first, middle, nextNode)));
+        write64(node + offsets.rightChild, kernelAddress(writeVadTree(vads, middle + 1, last, nextNode)));
+
+        uint32_t startingVpn = static_cast<uint32_t>(vads[middle].startAddress >> 12);
+        uint32_t endingVpn = static_cast<uint32_t>((vads[middle].endAddress >> 12) - 1);
+        std::memcpy(&data[node + offsets.startingVpn], &startingVpn, sizeof(uint32_t));
+        std::memcpy(&data[node + offsets.endingVpn], &endingVpn, sizeof(uint32_t));
+
+        return node;
+    }
+
+    explicit ProcessFixture(const OffsetsProfile& layout = OffsetsProfile())
+        : offsets(layout)
+    {
+        // PML4 at _CR3, the PDPT and the PD right after it.
+        writePml4(_CR3);
+        write64(_CR3 + PAGE_SIZE, (_CR3 + 2 * PAGE_SIZE) | 0x3);
+        for (uint64_t i = 0; i < FIXTURE_SIZE >> PAGE_2MB_SHIFT; i++) {
+            write64(_CR3 + 2 * PAGE_SIZE + i * 8, (i << PAGE_2MB_SHIFT) | 0x83);
+        }
+
+        processes = {
+                {"System", 0x10000, _CR3, {{0x10000, 0x20000}}},
+                {"smss.exe", 0x11000, 0x20000, {{0x10000, 0x12000}, {0x7ff0000, 0x7ff1000}, {0x40000000, 0x40100000}}},
+                {"lsass.exe", 0x12000, 0x21000, {{0x1000, 0x2000}, {0x3000, 0x5000}, {0x9000, 0xa000},
+                                                 {0x20000, 0x30000}, {0x500000, 0x600000}}},
+        };
+
+        uint64_t nextNode = 0x30000;
+        for (size_t i = 0; i < processes.size(); i++) {
+            FixtureProcess& process = processes[i];
+            FixtureProcess& next = processes[(i + 1) % processes.size()];
+
+            if (process.directoryTableBase != _CR3) {
+                writePml4(process.directoryTableBase);
+            }
+
+            write64(process.kProcess + offsets.directoryTableBase, process.directoryTableBase);
+            write64(process.kProcess + offsets.activeProcessLinksFlink, kernelAddress(next.kProcess + offsets.activeProcessLinksFlink));
+            std::memcpy(&data[process.kProcess + offsets.imageFileName], process.name.c_str(), process.name.size());
+
+            uint64_t vadRoot = writeVadTree(process.vads, 0, process.vads.size(), nextNode);
+            write64(process.kProcess + offsets.vadRoot, kernelAddress(vadRoot));
+        }
+    }
+};
+
+/**
+ * Run the whole analysis of a dump of ProcessFixture and check that it walks the process list and the VADs.
+ *
+ * @param path: path to the dump
+ * @return: profile the worker detected
+ */
+static WindowsProfile requireWorkerFindsLsass(const std::string& path)
+{
+    AnalysisWorker worker;
+    worker.start(path);
+    while (worker.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(worker.state() == AnalysisState::Done);
+    std::vector<Process> processList;
+    REQUIRE_EQ(worker.fetchProcesses(processList), 4);
+    REQUIRE_EQ(processList[2].ProcessName, "lsass.exe");
+    REQUIRE_EQ(processList[2].VadTree.size(), 5);
+    return worker.profile();
+}
+
+TEST_CASE("Test walkProcessList")
+{
+    ProcessFixture fixture;
+    std::string path = writeFixture("processes.raw", fixture.data);
+    std::ifstream file(path, std::ios::binary);
+
+    std::ptrdiff_t systemKProcess = findSystemKProcessAddress(file);
+    REQUIRE_EQ(systemKProcess, fixture.processes[0].kProcess);
+
+    std::vector<std::string> names;
+    walkProcessList(systemKProcess, _CR3, file, [&](const Process& process) {
+        names.push_back(process.ProcessName);
+        REQUIRE(process.VadTree.empty());
+    }, false);
+    REQUIRE_EQ(names.size(), 4);
+    REQUIRE_EQ(names[1], "smss.exe");
+    REQUIRE_EQ(names[2], "lsass.exe");
+    REQUIRE_EQ(names[3], "System");
+
+    std::vector<Process> processList = getProcessList(systemKProcess, _CR3, file);
+    REQUIRE_EQ(processList.size(), 4);
+    REQUIRE_EQ(processList[2].VadTree.size(), 5);
+    REQUIRE_EQ(processList[2].VadTree[3].startAddress, 0x20000);
+    REQUIRE_EQ(processList[2].VadTree[3].endAddress, 0x30000);
+}
+
+TEST_CASE("Test runBatch")
+{
+    ProcessFixture fixture;
+    writeFixture("batch_a.raw", fixture.data);
+    writeFixture("batch_b.raw", fixture.data);
+    std::string manifest = "batch_a.raw\n# comment\n\nbatch_b.raw\nnone\n";
+    std::vector<std::string> paths = readBatchManifest(writeFixture("batch.txt", std::vector<uint8_t>(manifest.begin(), manifest.end())));
+    REQUIRE_EQ(paths.size(), 3);
+
+    std::ostringstream output;
+    NdjsonWriter writer(output);
+    BatchOptions options;
+    options.jobs = 2;
+    BatchReport report = runBatch(paths, options, writer);
+
+    REQUIRE_EQ(report.jobs.size(), 3);
+    REQUIRE(report.jobs[0].result.succeeded);
+    REQUIRE_EQ(report.jobs[1].result.processCount, 4);
+    REQUIRE_EQ(report.jobs[2].result.failedStage, "open");
+    REQUIRE_NE(output.str().find("\"type\":\"progress\",\"dump\":\"1\""), std::string::npos);
+}
+
+TEST_CASE("Test jsonEscape")
+{
+    REQUIRE_EQ(jsonEscape("lsass.exe"), "\"lsass.exe\"");
+    REQUIRE_EQ(jsonEscape("a\"b\\c\n"), "\"a\\\"b\\\\c\\n\"");
+    REQUIRE_EQ(jsonEscape(std::string("\x01\x7f", 2)), "\"\\u0001\\u007f\"");
+    // UTF-8 sequences are kept as they are
+    REQUIRE_EQ(jsonEscape("caf\xc3\xa9.exe"), "\"caf\xc3\xa9.exe\"");
+
+    // A lone Latin-1 byte and a truncated sequence are escaped, the line stays valid UTF-8
+    std::string escaped = jsonEscape("caf\xe9.exe\xc3");
+    REQUIRE_EQ(escaped, "\"caf\\u00e9.exe\\u00c3\"");
+    REQUIRE(std::all_of(escaped.begin(), escaped.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; }));
+    // Overlong, surrogate and above U+10FFFF sequences are escaped byte by byte
+    REQUIRE_EQ(jsonEscape("\xc0\xaf"), "\"\\u00c0\\u00af\"");
+    REQUIRE_EQ(jsonEscape("\xed\xa0\x80"), "\"\\u00ed\\u00a0\\u0080\"");
+    REQUIRE_EQ(jsonEscape("\xf4\x90\x80\x80"), "\"\\u00f4\\u0090\\u0080\\u0080\"");
+    REQUIRE_EQ(jsonEscape("\xf0\x9f\x98\x80"), "\"\xf0\x9f\x98\x80\"");
+}
+
+TEST_CASE("Test AnalysisWorker")
+{
+    ProcessFixture fixture;
+    std::string path = writeFixture("worker.raw", fixture.data);
+
+    std::atomic<size_t> updates{0};
+    AnalysisWorker worker;
+    worker.onUpdate = [&]() { updates++; };
+    worker.start(path);
+    while (worker.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE(worker.state() == AnalysisState::Done);
+    REQUIRE_EQ(worker.progress().bytesScanned, FIXTURE_SIZE);
+    REQUIRE_EQ(worker.progress().processesFound, 4);
+    REQUIRE_GT(updates, 4);
+
+    std::vector<Process> processList;
+    REQUIRE_EQ(worker.fetchProcesses(processList), 4);
+    REQUIRE_EQ(worker.fetchProcesses(processList), 0);
+    REQUIRE_EQ(processList[2].VadTree.size(), 5);
+
+    worker.start(writeFixture("worker_missing.raw", std::vector<uint8_t>(PAGE_SIZE, 0)));
+    while (worker.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(worker.state() == AnalysisState::Failed);
+    REQUIRE_FALSE(worker.error().empty());
+}
+
+TEST_CASE("Test MemoryView")
+{
+    ProcessFixture fixture;
+    std::string path = writeFixture("view.raw", fixture.data);
+
+    MemoryView view(path, 0x10000);
+    REQUIRE(view.isOpen());
+    REQUIRE_EQ(view.lastPage(), (FIXTURE_SIZE >> PAGE_4KB_SHIFT) - 1);
+
+    uint8_t page[PAGE_SIZE];
+    REQUIRE_EQ(view.readPage(fixture.processes[1].kProcess >> PAGE_4KB_SHIFT, page), PAGE_SIZE);
+    REQUIRE_EQ(std::memcmp(&page[IMAGE_FILE_NAME], "smss.exe", 8), 0);
+    REQUIRE_EQ(view.readPage(FIXTURE_SIZE >> PAGE_4KB_SHIFT, page), 0);
+
+    view.setVirtual(fixture.processes[1].directoryTableBase);
+    REQUIRE_EQ(view.lastPage(), VIRTUAL_SPACE_LAST_PAGE);
+    REQUIRE_EQ(view.readPage(ProcessFixture::kernelAddress(fixture.processes[2].kProcess) >> PAGE_4KB_SHIFT, page), PAGE_SIZE);
+    REQUIRE_EQ(std::memcmp(&page[IMAGE_FILE_NAME], "lsass.exe", 9), 0);
+    REQUIRE_EQ(view.readPage(0x10000 >> PAGE_4KB_SHIFT, page), 0);
+    REQUIRE_GT(view.cache().hits(), 0);
+
+    view.setPhysical();
+    REQUIRE_FALSE(view.isVirtual());
+    REQUIRE_EQ(view.translate(0x1234), 0x1234);
+}
+
+/*
+ * Maps the 2MB page at physical 0x200000 at virtual address 0 of smss.exe.
+ */
+static void mapFixtureUserPage(ProcessFixture& fixture)
+{
+    fixture.write64(fixture.processes[1].directoryTableBase, 0x22000 | 0x7);
+    fixture.write64(0x22000, 0x23000 | 0x7);
+    fixture.write64(0x23000, 0x200000 | 0x87);
+    std::vector<uint8_t> pattern = patternData(4 * PAGE_SIZE);
+    std::memcpy(&fixture.data[0x200000], pattern.data(), pattern.size());
+}
+
+TEST_CASE("Test walkPageTables")
+{
+    ProcessFixture fixture;
+    mapFixtureUserPage(fixture);
+    std::string path = writeFixture("page_tables.raw", fixture.data);
+    std::ifstream file(path, std::ios::binary);
+
+    std::vector<PageMapping> mappings;
+    std::vector<uint64_t> tables;
+    walkPageTables(fixture.processes[1].directoryTableBase, 0, USER_SPACE_END, file,
+                   [&](const PageMapping& mapping) { mappings.push_back(mapping); },
+                   [&](uint64_t table) { tables.push_back(table); });
+    REQUIRE_EQ(mappings.size(), 1);
+    REQUIRE_EQ(mappings[0].virtualAddress, 0);
+    REQUIRE_EQ(mappings[0].physicalAddress, 0x200000);
+    REQUIRE_EQ(mappings[0].size, 1 << PAGE_2MB_SHIFT);
+    REQUIRE_EQ(tables.size(), 3);
+
+    mappings.clear();
+    walkPageTables(_CR3, KERNEL_SPACE_START, 0, file, [&](const PageMapping& mapping) { mappings.push_back(mapping); });
+    REQUIRE_EQ(mappings.size(), FIXTURE_SIZE >> PAGE_2MB_SHIFT);
+    REQUIRE_EQ(mappings[1].virtualAddress, FIXTURE_KERNEL_BASE + (1 << PAGE_2MB_SHIFT));
+}
+
+TEST_CASE("Test MemoryMap")
+{
+    ProcessFixture fixture;
+    mapFixtureUserPage(fixture);
+    std::string path = writeFixture("memory_map.raw", fixture.data);
+
+    std::vector<Process> processes;
+    for (auto& process : fixture.processes) {
+        processes.push_back({process.kProcess, process.directoryTableBase, process.name, {}});
+    }
+
+    MemoryMap map;
+    REQUIRE(map.start(path, processes, 256));
+    while (map.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE_EQ(map.pagesPerCell(), 4);
+    REQUIRE_EQ(map.passesDone(), map.passCount());
+    REQUIRE_EQ(map.height(), 1);
+    REQUIRE(map.cellClass((_CR3 >> PAGE_4KB_SHIFT) / 4) == PageClass::PageTable);
+    REQUIRE(map.cellClass(0x10 / 4) == PageClass::Kernel);
+    REQUIRE(map.cellClass(0x200 / 4) == PageClass::Process);
+    REQUIRE_EQ(map.cellOwner(0x200 / 4), 1);
+    REQUIRE(map.cellClass(0x300 / 4) == PageClass::Zero);
+
+    std::vector<uint8_t> random(PAGE_SIZE);
+    uint64_t state = 0x9e3779b97f4a7c15;
+    for (auto& value : random) {
+        state = state * 6364136223846793005 + 1442695040888963407;
+        value = static_cast<uint8_t>(state >> 56);
+    }
+    REQUIRE(classifyPage(random.data(), random.size()) == PageClass::HighEntropy);
+}
+
+TEST_CASE("Test RangeLod")
+{
+    std::vector<AddressRange> ranges;
+    for (uint64_t i = 0; i < 10000; i++) {
+        ranges.push_back({i * 0x10000, i * 0x10000 + PAGE_SIZE});
+    }
+    ranges.push_back({0x2000, 0x3000});
+    ranges.push_back({0x800000000000 - 0x1000, 0x800000000000});
+
+    RangeLod lod;
+    lod.build(ranges);
+    REQUIRE_EQ(lod.size(), 10002);
+    REQUIRE_GT(lod.levelCount(), 1);
+
+    std::vector<AddressRange> result;
+    lod.query(0, 0x30000, 1, result);
+    REQUIRE_EQ(result.size(), 4);
+    REQUIRE_EQ(result[0].end, 0x1000);
+    REQUIRE_EQ(result[1].start, 0x2000);
+
+    // The whole user space on 1000 pixels
+    lod.query(0, 0x800000000000, 0x800000000000 / 1000, result);
+    REQUIRE_EQ(result.size(), 2);
+    REQUIRE_EQ(result[0].start, 0);
+    REQUIRE_EQ(result[0].end, 9999 * 0x10000 + PAGE_SIZE);
+}
+
+TEST_CASE("Test buildProcessLayout")
+{
+    ProcessFixture fixture;
+    mapFixtureUserPage(fixture);
+    std::string path = writeFixture("layout.raw", fixture.data);
+    std::ifstream file(path, std::ios::binary);
+
+    Process process{fixture.processes[1].kProcess, fixture.processes[1].directoryTableBase, "smss.exe",
+                    fixture.processes[1].vads};
+    ProcessLayout layout = buildProcessLayout(process, file);
+    REQUIRE_EQ(layout.vads.size(), 3);
+    REQUIRE_EQ(layout.presentPages.size(), 1);
+    REQUIRE_EQ(layout.largePages.size(), 1);
+    REQUIRE_EQ(layout.presentBytes, 1 << PAGE_2MB_SHIFT);
+}
+
+TEST_CASE("Test CacheBudget")
+{
+    std::vector<uint8_t> data = patternData(32 * PAGE_SIZE);
+    std::string path = writeFixture("budget.raw", data);
+
+    auto budget = std::make_shared<CacheBudget>(4 * PAGE_SIZE);
+    auto first = std::make_shared<PageCache>(16 * PAGE_SIZE, budget);
+    CachedDumpStream firstStream(path, first);
+
+    uint64_t value;
+    for (uint64_t page = 0; page < 4; page++) {
+        REQUIRE(readPhysicalMemory(page * PAGE_SIZE, &value, sizeof(uint64_t), firstStream));
+    }
+    REQUIRE_EQ(first->size(), 4);
+    REQUIRE_EQ(budget->used(), 4 * PAGE_SIZE);
+
+    {
+        auto second = std::make_shared<PageCache>(16 * PAGE_SIZE, budget);
+        CachedDumpStream secondStream(path, second);
+        for (uint64_t page = 4; page < 6; page++) {
+            REQUIRE(readPhysicalMemory(page * PAGE_SIZE, &value, sizeof(uint64_t), secondStream));
+            REQUIRE_EQ(std::memcmp(&value, &data[page * PAGE_SIZE], sizeof(uint64_t)), 0);
+        }
+        REQUIRE_EQ(first->size(), 2);
+        REQUIRE_EQ(second->size(), 2);
+        REQUIRE_EQ(budget->used(), 4 * PAGE_SIZE);
+
+        // Page 20 goes to the full shard of page 4, which recycles its page instead of taking one from the budget
+        REQUIRE(readPhysicalMemory(20 * PAGE_SIZE, &value, sizeof(uint64_t), secondStream));
+        REQUIRE_EQ(first->size(), 2);
+        REQUIRE_EQ(second->size(), 2);
+        REQUIRE_EQ(budget->used(), 4 * PAGE_SIZE);
+    }
+
+    // Destroying a cache gives its pages back to the budget
+    REQUIRE_EQ(budget->used(), 2 * PAGE_SIZE);
+}
+
+TEST_CASE("Test DumpSession")
+{
+    ProcessFixture fixture;
+    std::string path = writeFixture("session.raw", fixture.data);
+
+    auto budget = std::make_shared<CacheBudget>(0x100000);
+    DumpSession session(path, budget);
+    REQUIRE_EQ(session.name(), "session.raw");
+
+    session.startAnalysis();
+    while (session.worker().isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE_EQ(session.update(), 4);
+    REQUIRE_EQ(session.processes()[1].ProcessName, "smss.exe");
+    REQUIRE_GT(session.cache()->size(), 0);
+    REQUIRE_LE(budget->used(), budget->capacity());
+}
+
+TEST_CASE("Test AddressSpace")
+{
+    ProcessFixture fixture;
+    std::string path = writeFixture("address_space.raw", fixture.data);
+    std::ifstream file(path, std::ios::binary);
+
+    AccessCounters counters;
+    AddressSpace kernel(file, _CR3, OffsetsProfile(), &counters);
+    REQUIRE_EQ(kernel.translate(ProcessFixture::kernelAddress(0x12000)), 0x12000);
+    REQUIRE_EQ(kernel.translate(ProcessFixture::kernelAddress(0x12008)), 0x12008);
+    REQUIRE_EQ(counters.translations, 2);
+    REQUIRE_EQ(counters.translationCacheHits, 1);
+    REQUIRE_EQ(kernel.translate(0x1000, true), 0);
+
+    uint8_t buffer[16];
+    REQUIRE(kernel.read(ProcessFixture::kernelAddress(0x11ff8), buffer, sizeof(buffer)));
+    REQUIRE_EQ(std::memcmp(buffer, &fixture.data[0x11ff8], sizeof(buffer)), 0);
+    REQUIRE_FALSE(kernel.read(0x1000, buffer, sizeof(buffer)));
+
+    std::vector<Process> processes = kernel.processList(fixture.processes[0].kProcess);
+    REQUIRE_EQ(processes.size(), 4);
+    REQUIRE_EQ(processes[2].ProcessName, "lsass.exe");
+    REQUIRE_EQ(processes[2].VadTree.size(), 5);
+    REQUIRE_EQ(kernel.forProcess(processes[1].DirectoryTableBase).readProcessVadTree(processes[1].KProcessAddress).size(), 3);
+
+    OffsetsProfile profile;
+    profile.systemDirectoryTableBase = fixture.processes[1].directoryTableBase;
+    AddressSpace physical(file, 0, profile);
+    REQUIRE(physical.validateKProcess(fixture.processes[1].kProcess));
+    REQUIRE_FALSE(physical.validateKProcess(fixture.processes[0].kProcess));
+
+    DumpSession session(path);
+    AddressSpace sessionSpace = session.addressSpace(_CR3);
+    REQUIRE_EQ(sessionSpace.processName(fixture.processes[1].kProcess), "smss.exe");
+    REQUIRE_GT(session.counters().bytesRead, 0);
+}
+
+TEST_CASE("Test WindowsProfile")
+{
+    WindowsProfile profile = *findProfile(builtinProfiles(), "win11-24h2");
+    WindowsProfile parsed;
+    REQUIRE(parseProfile(profileToJson(profile), parsed));
+    REQUIRE_EQ(parsed.name, "win11-24h2");
+    REQUIRE_EQ(parsed.build, 26100);
+    REQUIRE_EQ(parsed.offsets.imageFileName, 0x338);
+    REQUIRE_EQ(parsed.offsets.activeProcessLinksBlink, 0x1e0);
+
+    REQUIRE(parseProfile("{ \"name\": \"custom\", \"offsets\": { \"vadRoot\": 2008, \"imageFileName\": \"0x5b0\" } }", parsed));
+    REQUIRE_EQ(parsed.offsets.vadRoot, 0x7d8);
+    REQUIRE_EQ(parsed.offsets.imageFileName, 0x5b0);
+    REQUIRE_EQ(parsed.offsets.activeProcessLinksFlink, ACTIVE_PROCESS_LINKS_FLINK);
+    REQUIRE_FALSE(parseProfile("{\"offsets\": {}}", parsed));
+    REQUIRE_FALSE(parseProfile("{\"name\": \"broken\", \"offsets\": {\"vadRoot\": \"x\"}}", parsed));
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "profiles_test";
+    std::filesystem::create_directories(directory);
+    parsed.name = "win10-2004";
+    REQUIRE(saveProfile((directory / "win10-2004.json").string(), parsed));
+    std::vector<WindowsProfile> candidates = candidateProfiles(directory.string());
+    REQUIRE_EQ(candidates.size(), builtinProfiles().size());
+    REQUIRE_EQ(candidates[0].offsets.imageFileName, 0x5b0);
+    REQUIRE_EQ(candidateProfiles((directory / "missing").string()).size(), builtinProfiles().size());
+}
+
+TEST_CASE("Test detectProfile")
+{
+    const WindowsProfile& layout = *findProfile(builtinProfiles(), "win11-24h2");
+    ProcessFixture fixture(layout.offsets);
+    std::string path = writeFixture("profile_24h2.raw", fixture.data);
+    std::ifstream file(path, std::ios::binary);
+
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.name, "win11-24h2");
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+
+    // Without the expected DirectoryTableBase the layout is recognized by following the process links
+    std::vector<WindowsProfile> candidates = builtinProfiles();
+    for (WindowsProfile& candidate : candidates) {
+        candidate.offsets.systemDirectoryTableBase = 0;
+    }
+    detected = WindowsProfile{};
+    REQUIRE_EQ(detectProfile(file, candidates, detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.name, "win11-24h2");
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+
+    REQUIRE_EQ(requireWorkerFindsLsass(path).name, "win11-24h2");
+
+    // A process whose name starts with "System", placed below System and linked into the list
+    ProcessFixture decoyFixture;
+    uint64_t decoy = 0xf000;
+    decoyFixture.writePml4(0x24000);
+    decoyFixture.write64(decoy + ACTIVE_PROCESS_LINKS_FLINK, ProcessFixture::kernelAddress(decoyFixture.processes[1].kProcess + ACTIVE_PROCESS_LINKS_FLINK));
+    decoyFixture.write64(decoy + DIRECTORY_TABLE_BASE, 0x24000);
+    std::memcpy(&decoyFixture.data[decoy + IMAGE_FILE_NAME], "SystemSettings.", 15);
+    decoyFixture.write64(decoyFixture.processes[0].kProcess + ACTIVE_PROCESS_LINKS_FLINK,
+                         ProcessFixture::kernelAddress(decoy + ACTIVE_PROCESS_LINKS_FLINK));
+    std::ifstream decoyFile(writeFixture("profile_decoy.raw", decoyFixture.data), std::ios::binary);
+    detected = WindowsProfile{};
+    REQUIRE_EQ(detectProfile(decoyFile, builtinProfiles(), detected), decoyFixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+}
+
+static void putLittleEndian(std::vector<uint8_t>& out, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static void padRecord(std::vector<uint8_t>& record)
+{
+    for (size_t pad = (4 - record.size() % 4) % 4; pad > 0; pad--) {
+        record.push_back(static_cast<uint8_t>(0xf0 | pad));
+    }
+}
+
+static void addMember(std::vector<uint8_t>& fieldList, const std::string& name, uint32_t offset, uint32_t type = 0x23,
+                      bool wideOffset = false)
+{
+    putLittleEndian(fieldList, 0x150d, 2);
+    putLittleEndian(fieldList, 3, 2);
+    putLittleEndian(fieldList, type, 4);
+    if (wideOffset) {
+        putLittleEndian(fieldList, 0x8004, 2);
+        putLittleEndian(fieldList, offset, 4);
+    } else {
+        putLittleEndian(fieldList, offset, 2);
+    }
+    fieldList.insert(fieldList.end(), name.begin(), name.end());
+    fieldList.push_back(0);
+    padRecord(fieldList);
+}
+
+/*
+ * TPI stream of a fake kernel PDB with the win11-24h2 _EPROCESS layout.
+ */
+struct TypeStreamBuilder {
+    std::vector<uint8_t> records;
+    uint32_t nextIndex = 0x1000;
+
+    uint32_t add(uint16_t kind, std::vector<uint8_t> payload)
+    {
+        padRecord(payload);
+        putLittleEndian(records, payload.size() + 2, 2);
+        putLittleEndian(records, kind, 2);
+        records.insert(records.end(), payload.begin(), payload.end());
+        return nextIndex++;
+    }
+
+    uint32_t addAggregate(uint16_t kind, uint16_t properties, uint32_t fieldList, const std::string& name,
+                          const std::string& uniqueName = "")
+    {
+        std::vector<uint8_t> payload;
+        putLittleEndian(payload, 1, 2);
+        putLittleEndian(payload, properties | (uniqueName.empty() ? 0 : 0x200), 2);
+        putLittleEndian(payload, fieldList, 4);
+        if (kind != 0x1506) {
+            putLittleEndian(payload, 0, 8);
+        }
+        putLittleEndian(payload, 0x10, 2);
+        payload.insert(payload.end(), name.c_str(), name.c_str() + name.size() + 1);
+        if (!uniqueName.empty()) {
+            payload.insert(payload.end(), uniqueName.c_str(), uniqueName.c_str() + uniqueName.size() + 1);
+        }
+        return add(kind, payload);
+    }
+
+    std::vector<uint8_t> stream(bool withVad = true)
+    {
+        std::vector<uint8_t> list;
+        addMember(list, "Header", 0);
+        addMember(list, "DirectoryTableBase", 0x28);
+        uint32_t kProcess = addAggregate(0x1505, 0, add(0x1203, list), "_KPROCESS");
+
+        // Referenced before it is defined, like in the real PDBs
+        uint32_t unionForward = addAggregate(0x1506, 0x80, 0, "<unnamed-tag>", "<unnamed-type-u1>");
+        list.clear();
+        addMember(list, "VadRoot", 0);
+        addMember(list, "VadHint", 0x8);
+
+        // Padding records, so the stream spans several blocks
+        for (int i = 0; i < 64; i++) {
+            add(0x1001, std::vector<uint8_t>(12, 0));
+        }
+        addAggregate(0x1506, 0, add(0x1203, list), "<unnamed-tag>", "<unnamed-type-u1>");
+
+        addAggregate(0x1505, 0x80, 0, "_EPROCESS");
+        list.clear();
+        addMember(list, "Pcb", 0, kProcess);
+        addMember(list, "ActiveProcessLinks", 0x1d8);
+        addMember(list, "ImageFileName", 0x338, 0x23, true);
+        addMember(list, "", 0x558, unionForward);
+        addAggregate(0x1505, 0, add(0x1203, list), "_EPROCESS");
+
+        list.clear();
+        addMember(list, "Left", 0);
+        addMember(list, "Right", 0x8);
+        addMember(list, "ParentValue", 0x10);
+        uint32_t balancedNode = addAggregate(0x1505, 0, add(0x1203, list), "_RTL_BALANCED_NODE");
+
+        if (withVad) {
+            // A field list continued with LF_INDEX
+            list.clear();
+            addMember(list, "StartingVpnHigh", 0x20);
+            addMember(list, "EndingVpnHigh", 0x21);
+            uint32_t continuation = add(0x1203, list);
+            list.clear();
+            addMember(list, "VadNode", 0, balancedNode);
+            addMember(list, "StartingVpn", 0x18);
+            addMember(list, "EndingVpn", 0x1c);
+            putLittleEndian(list, 0x1404, 2);
+            putLittleEndian(list, 0, 2);
+            putLittleEndian(list, continuation, 4);
+            addAggregate(0x1505, 0, add(0x1203, list), "_MMVAD_SHORT");
+        }
+
+        std::vector<uint8_t> tpi;
+        putLittleEndian(tpi, 20040203, 4);
+        putLittleEndian(tpi, 56, 4);
+        putLittleEndian(tpi, 0x1000, 4);
+        putLittleEndian(tpi, nextIndex, 4);
+        putLittleEndian(tpi, records.size(), 4);
+        tpi.resize(56, 0);
+        tpi.insert(tpi.end(), records.begin(), records.end());
+        return tpi;
+    }
+};
+
+static std::vector<uint8_t> pdbFixture(const std::vector<uint8_t>& tpi)
+{
+    const uint32_t blockSize = 512;
+    const uint8_t guid[16] = {0xb9, 0xdb, 0x44, 0x38, 0x17, 0x20, 0x67, 0x49,
+                              0xbe, 0x7a, 0xa4, 0xa2, 0xc2, 0x04, 0x30, 0xfa};
+
+    std::vector<uint8_t> info;
+    putLittleEndian(info, 20000404, 4);
+    putLittleEndian(info, 0x5f3c8d41, 4);
+    putLittleEndian(info, 1, 4);
+    info.insert(info.end(), guid, guid + 16);
+
+    std::vector<uint8_t> dbi;
+    putLittleEndian(dbi, 0xffffffff, 4);
+    putLittleEndian(dbi, 19990903, 4);
+    putLittleEndian(dbi, 3, 4);
+
+    std::vector<std::vector<uint8_t>> streams = {{}, info, tpi, dbi};
+
+    // Superblock and the two free block maps
+    std::vector<uint8_t> file(3 * blockSize, 0);
+    std::vector<uint8_t> directory;
+    putLittleEndian(directory, streams.size(), 4);
+    for (const auto& stream : streams) {
+        putLittleEndian(directory, stream.size(), 4);
+    }
+    for (const auto& stream : streams) {
+        size_t count = (stream.size() + blockSize - 1) / blockSize;
+        size_t first = file.size() / blockSize;
+        file.resize(file.size() + count * blockSize, 0);
+        // Stream blocks don't have to be in order
+        for (size_t i = 0; i < count; i++) {
+            size_t block = first + count - 1 - i;
+            std::memcpy(&file[block * blockSize], stream.data() + i * blockSize,
+                        std::min<size_t>(blockSize, stream.size() - i * blockSize));
+            putLittleEndian(directory, block, 4);
+        }
+    }
+
+    size_t directoryBlock = file.size() / blockSize;
+    file.resize(file.size() + blockSize, 0);
+    std::memcpy(&file[directoryBlock * blockSize], directory.data(), directory.size());
+    size_t blockMap = file.size() / blockSize;
+    file.resize(file.size() + blockSize, 0);
+    std::memcpy(&file[blockMap * blockSize], &directoryBlock, sizeof(uint32_t));
+
+    std::memcpy(file.data(), MSF_MAGIC, MSF_MAGIC_SIZE);
+    std::vector<uint8_t> superBlock;
+    putLittleEndian(superBlock, blockSize, 4);
+    putLittleEndian(superBlock, 1, 4);
+    putLittleEndian(superBlock, file.size() / blockSize, 4);
+    putLittleEndian(superBlock, directory.size(), 4);
+    putLittleEndian(superBlock, 0, 4);
+    putLittleEndian(superBlock, blockMap, 4);
+    std::memcpy(file.data() + MSF_MAGIC_SIZE, superBlock.data(), superBlock.size());
+    return file;
+}
+
+TEST_CASE("Test profileFromPdb")
+{
+    std::vector<uint8_t> tpi = TypeStreamBuilder().stream();
+    REQUIRE_GT(tpi.size(), 1024);
+    std::string path = writeFixture("ntkrnlmp.pdb", pdbFixture(tpi));
+
+    MsfFile msf(path);
+    REQUIRE(msf.isOpen());
+    REQUIRE_EQ(msf.streamCount(), 4);
+    std::vector<uint8_t> stream;
+    REQUIRE(msf.readStream(PDB_TPI_STREAM, stream));
+    REQUIRE(stream == tpi);
+
+    // The age is the one of the DBI stream
+    PdbInfo info;
+    REQUIRE(readPdbInfo(msf, info));
+    REQUIRE_EQ(info.key(), "3844DBB920174967BE7AA4A2C20430FA3");
+
+    WindowsProfile profile;
+    REQUIRE(profileFromPdb(path, profile));
+    REQUIRE_EQ(profile.name, "ntkrnlmp-3844DBB920174967BE7AA4A2C20430FA3");
+    const OffsetsProfile& expected = findProfile(builtinProfiles(), "win11-24h2")->offsets;
+    REQUIRE_EQ(profile.offsets.imageFileName, expected.imageFileName);
+    REQUIRE_EQ(profile.offsets.activeProcessLinksFlink, expected.activeProcessLinksFlink);
+    REQUIRE_EQ(profile.offsets.activeProcessLinksBlink, expected.activeProcessLinksBlink);
+    REQUIRE_EQ(profile.offsets.vadRoot, expected.vadRoot);
+    REQUIRE_EQ(profile.offsets.directoryTableBase, DIRECTORY_TABLE_BASE);
+    REQUIRE_EQ(profile.offsets.rightChild, RIGHT_CHILD);
+    REQUIRE_EQ(profile.offsets.parentValue, PARENT_VALUE);
+    REQUIRE_EQ(profile.offsets.startingVpn, STARTING_VPN);
+    REQUIRE_EQ(profile.offsets.endingVpn, ENDING_VPN);
+    REQUIRE_EQ(profile.offsets.startingVpnHigh, STARTING_VPN_HIGH);
+    REQUIRE_EQ(profile.offsets.endingVpnHigh, ENDING_VPN_HIGH);
+
+    // The second time the profile comes from the cache, even if the types can't be read anymore
+    std::string cache = (std::filesystem::temp_directory_path() / "pdb_profiles").string();
+    std::filesystem::remove_all(cache);
+    REQUIRE(profileFromPdb(path, profile, cache));
+    REQUIRE(std::filesystem::exists(std::filesystem::path(cache) / "3844DBB920174967BE7AA4A2C20430FA3.json"));
+    REQUIRE(findProfile(candidateProfiles(cache), profile.name) != nullptr);
+
+    writeFixture("ntkrnlmp.pdb", pdbFixture(TypeStreamBuilder().stream(false)));
+    WindowsProfile cached;
+    REQUIRE(profileFromPdb(path, cached, cache));
+    REQUIRE_EQ(cached.name, profile.name);
+    REQUIRE_EQ(cached.offsets.vadRoot, expected.vadRoot);
+    REQUIRE_FALSE(profileFromPdb(path, cached));
+
+    REQUIRE_FALSE(profileFromPdb(writeFixture("not_a.pdb", patternData(PAGE_SIZE)), cached));
+    std::filesystem::remove_all(cache);
+}
+
+TEST_CASE("Test RunTable")
+{
+    // Every other page, added out of order
+    RunTable runs;
+    for (uint64_t i = 0; i < 1000; i++) {
+        uint64_t page = ((i * 617) % 1000) * 2 + 1;
+        runs.add(page << PAGE_4KB_SHIFT, PAGE_SIZE, i * PAGE_SIZE);
+    }
+    runs.finalize();
+    REQUIRE_EQ(runs.runs().size(), 1000);
+    REQUIRE_EQ(runs.end(), 2000 * PAGE_SIZE);
+
+    uint64_t fileOffset, available;
+    for (uint64_t page = 0; page < 2001; page++) {
+        bool present = runs.locate((page << PAGE_4KB_SHIFT) + 0x10, fileOffset, available);
+        REQUIRE_EQ(present, page % 2 == 1 && page < 2000);
+        if (present) {
+            REQUIRE_EQ(available, PAGE_SIZE - 0x10);
+            REQUIRE_EQ(PAGE_4KB_OFFSET(fileOffset), 0x10);
+        }
+    }
+
+    // Runs continuing each other are merged
+    RunTable merged;
+    merged.add(0x1000, 0x1000, 0x2000);
+    merged.add(0x2000, 0x1000, 0x3000);
+    merged.add(0x3000, 0x1000, 0x5000);
+    merged.finalize();
+    REQUIRE_EQ(merged.runs().size(), 2);
+    REQUIRE(merged.locate(0x2ff8, fileOffset, available));
+    REQUIRE_EQ(fileOffset, 0x3ff8);
+    REQUIRE_EQ(available, 8);
+}
+
+static std::vector<uint8_t> crashDumpHeader(uint32_t dumpType, uint64_t directoryTableBase, uint64_t activeProcessHead)
+{
+    std::vector<uint8_t> header(DUMP_HEADER64_SIZE, 0);
+    uint32_t signature[2] = {DUMP_SIGNATURE, DUMP_VALID_DUMP64};
+    std::memcpy(header.data(), signature, sizeof(signature));
+    std::memcpy(&header[DUMP_DIRECTORY_TABLE_BASE], &directoryTableBase, sizeof(uint64_t));
+    std::memcpy(&header[DUMP_PS_ACTIVE_PROCESS_HEAD], &activeProcessHead, sizeof(uint64_t));
+    std::memcpy(&header[DUMP_TYPE], &dumpType, sizeof(uint32_t));
+    return header;
+}
+
+TEST_CASE("Test crash dump")
+{
+    ProcessFixture fixture;
+    // PsActiveProcessHead, its Flink is the ActiveProcessLinks of System
+    uint64_t head = 0x3f000;
+    fixture.write64(head, ProcessFixture::kernelAddress(fixture.processes[0].kProcess + ACTIVE_PROCESS_LINKS_FLINK));
+
+    // Full dump of pages [1, 0x100) and [0x101, FIXTURE_SIZE), the header has the DirectoryTableBase of smss.exe
+    std::vector<uint8_t> dump = crashDumpHeader(DUMP_TYPE_FULL, fixture.processes[1].directoryTableBase,
+                                                ProcessFixture::kernelAddress(head));
+    uint32_t runCount = 2;
+    uint64_t runs[] = {1, 0xff, 0x101, (FIXTURE_SIZE >> PAGE_4KB_SHIFT) - 0x101};
+    std::memcpy(&dump[DUMP_PHYSICAL_MEMORY_BLOCK], &runCount, sizeof(uint32_t));
+    std::memcpy(&dump[DUMP_PHYSICAL_MEMORY_RUNS], runs, sizeof(runs));
+    dump.insert(dump.end(), fixture.data.begin() + 0x1000, fixture.data.begin() + 0x100000);
+    dump.insert(dump.end(), fixture.data.begin() + 0x101000, fixture.data.end());
+    std::string path = writeFixture("full.dmp", dump);
+
+    DumpLayout layout = openDumpLayout(path);
+    REQUIRE(layout.format == DumpFormat::CrashDump);
+    REQUIRE_EQ(layout.runs->runs().size(), 2);
+    REQUIRE_EQ(layout.runs->runs()[0].start, 0x1000);
+    REQUIRE_EQ(layout.runs->runs()[0].size, 0xff000);
+    REQUIRE_EQ(layout.runs->runs()[1].start, 0x101000);
+    REQUIRE_EQ(layout.runs->runs()[1].fileOffset, layout.runs->runs()[0].fileOffset + 0xff000);
+    REQUIRE_FALSE(layout.physical->isPresent(0x100000));
+    REQUIRE_EQ(layout.directoryTableBase, fixture.processes[1].directoryTableBase);
+    REQUIRE_EQ(openDumpLayout(writeFixture("not_a.dmp", patternData(PAGE_SIZE))).format, DumpFormat::Raw);
+
+    CachedDumpStream file(path, std::make_shared<PageCache>(0x100000), layout);
+    uint64_t value;
+    REQUIRE(readPhysicalMemory(head, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(std::memcmp(&value, &fixture.data[head], sizeof(uint64_t)), 0);
+    REQUIRE_FALSE(readPhysicalMemory(0x100008, &value, sizeof(uint64_t), file));
+    REQUIRE_FALSE(readPhysicalMemory(0x10, &value, sizeof(uint64_t), file));
+    std::vector<uint8_t> large(PAGE_CACHE_BYPASS_SIZE);
+    REQUIRE(readPhysicalMemory(0x200000, large.data(), large.size(), file));
+    REQUIRE_EQ(std::memcmp(large.data(), &fixture.data[0x200000], large.size()), 0);
+    file.seekg(0, std::ios::end);
+    REQUIRE_EQ(static_cast<uint64_t>(file.tellg()), FIXTURE_SIZE);
+
+    // System comes from PsActiveProcessHead, without scanning
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.name, "win10-2004");
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+
+    requireWorkerFindsLsass(path);
+
+    // Bitmap dump without pages 0, 0x100 and 0x200, and without PsActiveProcessHead
+    std::vector<uint8_t> bitmapDump = crashDumpHeader(DUMP_TYPE_BITMAP_FULL, _CR3, 0);
+    uint64_t pageCount = FIXTURE_SIZE >> PAGE_4KB_SHIFT;
+    std::vector<uint64_t> bitmap(pageCount / 64, ~0ULL);
+    bitmap[0] &= ~1ULL;
+    bitmap[0x100 / 64] &= ~1ULL;
+    bitmap[0x200 / 64] &= ~1ULL;
+    std::vector<uint8_t> summary;
+    putLittleEndian(summary, FULL_DUMP_SIGNATURE, 4);
+    putLittleEndian(summary, SUMMARY_DUMP_VALID_DUMP, 4);
+    summary.resize(SUMMARY_DUMP_HEADER_SIZE, 0);
+    putLittleEndian(summary, 0x3000, 8);
+    putLittleEndian(summary, pageCount, 8);
+    putLittleEndian(summary, pageCount - 3, 8);
+    summary.insert(summary.end(), reinterpret_cast<uint8_t *>(bitmap.data()),
+                   reinterpret_cast<uint8_t *>(bitmap.data() + bitmap.size()));
+    bitmapDump.insert(bitmapDump.end(), summary.begin(), summary.end());
+    bitmapDump.resize(0x3000, 0);
+    for (uint64_t page = 0; page < pageCount; page++) {
+        if (page != 0 && page != 0x100 && page != 0x200) {
+            bitmapDump.insert(bitmapDump.end(), fixture.data.begin() + (page << PAGE_4KB_SHIFT),
+                              fixture.data.begin() + ((page + 1) << PAGE_4KB_SHIFT));
+        }
+    }
+    std::string bitmapPath = writeFixture("bitmap.dmp", bitmapDump);
+
+    DumpLayout bitmapLayout = openDumpLayout(bitmapPath);
+    REQUIRE(bitmapLayout.format == DumpFormat::CrashDump);
+    REQUIRE_EQ(bitmapLayout.runs->runs().size(), 3);
+    CachedDumpStream bitmapFile(bitmapPath, std::make_shared<PageCache>(0x100000), bitmapLayout);
+    REQUIRE(readPhysicalMemory(0x201000, large.data(), large.size(), bitmapFile));
+    REQUIRE_EQ(std::memcmp(large.data(), &fixture.data[0x201000], large.size()), 0);
+
+    // The DirectoryTableBase of the header tells which candidate is System
+    detected = WindowsProfile{};
+    REQUIRE_EQ(detectProfile(bitmapFile, bitmapLayout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+}
+
+static void appendLimeRange(std::vector<uint8_t>& dump, const std::vector<uint8_t>& memory, uint64_t start, uint64_t end)
+{
+    LimeRangeHeader header{LIME_MAGIC, LIME_VERSION, start, end - 1, {}};
+    dump.insert(dump.end(), reinterpret_cast<uint8_t *>(&header), reinterpret_cast<uint8_t *>(&header + 1));
+    dump.insert(dump.end(), memory.begin() + start, memory.begin() + end);
+}
+
+TEST_CASE("Test LiME and ELF core dumps")
+{
+    ProcessFixture fixture;
+
+    // Page 0x100 isn't in the dump
+    std::vector<uint8_t> lime;
+    appendLimeRange(lime, fixture.data, 0, 0x100000);
+    appendLimeRange(lime, fixture.data, 0x101000, FIXTURE_SIZE);
+    std::string limePath = writeFixture("memory.lime", lime);
+
+    DumpLayout layout = openDumpLayout(limePath);
+    REQUIRE(layout.format == DumpFormat::Lime);
+    REQUIRE_EQ(layout.mappings.size(), 1);
+    REQUIRE_EQ(layout.runs->runs().size(), 2);
+
+    CachedDumpStream file(limePath, std::make_shared<PageCache>(0x100000), layout);
+    uint64_t value;
+    REQUIRE(readPhysicalMemory(0x10000, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(std::memcmp(&value, &fixture.data[0x10000], sizeof(uint64_t)), 0);
+    std::vector<uint8_t> large(PAGE_CACHE_BYPASS_SIZE);
+    REQUIRE(readPhysicalMemory(0x101000, large.data(), large.size(), file));
+    REQUIRE_EQ(std::memcmp(large.data(), &fixture.data[0x101000], large.size()), 0);
+    REQUIRE_FALSE(readPhysicalMemory(0x100800, &value, sizeof(uint64_t), file));
+    REQUIRE_FALSE(readPhysicalMemory(0xffffc, &value, sizeof(uint64_t), file));
+    REQUIRE(readPhysicalMemory(0xffff8, &value, sizeof(uint64_t), file));
+
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+
+    // ELF core with a note, and a last segment larger in memory than in the file
+    std::vector<uint8_t> core(0x1000, 0);
+    Elf64Header header{};
+    std::memcpy(header.ident, "\x7f" "ELF", 4);
+    header.ident[4] = ELF_CLASS_64;
+    header.ident[5] = ELF_DATA_LITTLE_ENDIAN;
+    header.type = ELF_TYPE_CORE;
+    header.programHeaderOffset = sizeof(Elf64Header);
+    header.programHeaderSize = sizeof(Elf64ProgramHeader);
+    header.programHeaderCount = 3;
+    Elf64ProgramHeader segments[3] = {
+            {4, 0, 0x800, 0, 0, 0x10, 0x10, 0},
+            {ELF_PT_LOAD, 4, 0x1000, FIXTURE_KERNEL_BASE, 0, 0x100000, 0x100000, PAGE_SIZE},
+            {ELF_PT_LOAD, 4, 0x101000, FIXTURE_KERNEL_BASE + 0x101000, 0x101000, FIXTURE_SIZE - 0x101000,
+             FIXTURE_SIZE - 0x101000 + 0x10000, PAGE_SIZE},
+    };
+    std::memcpy(core.data(), &header, sizeof(header));
+    std::memcpy(core.data() + sizeof(header), segments, sizeof(segments));
+    core.insert(core.end(), fixture.data.begin(), fixture.data.begin() + 0x100000);
+    core.insert(core.end(), fixture.data.begin() + 0x101000, fixture.data.end());
+    std::string corePath = writeFixture("memory.core", core);
+
+    DumpLayout coreLayout = openDumpLayout(corePath);
+    REQUIRE(coreLayout.format == DumpFormat::ElfCore);
+    REQUIRE_EQ(coreLayout.runs->runs().size(), 2);
+    REQUIRE_EQ(coreLayout.runs->end(), FIXTURE_SIZE);
+    REQUIRE_EQ(coreLayout.runs->runs()[1].start, 0x101000);
+    REQUIRE_EQ(coreLayout.runs->runs()[1].fileOffset, 0x101000);
+    REQUIRE_FALSE(coreLayout.physical->isPresent(0x100000));
+
+    CachedDumpStream coreFile(corePath, std::make_shared<PageCache>(0x100000), coreLayout);
+    REQUIRE(readPhysicalMemory(FIXTURE_SIZE - PAGE_SIZE, large.data(), PAGE_SIZE, coreFile));
+    REQUIRE_EQ(std::memcmp(large.data(), &fixture.data[FIXTURE_SIZE - PAGE_SIZE], PAGE_SIZE), 0);
+    REQUIRE_FALSE(readPhysicalMemory(FIXTURE_SIZE, &value, sizeof(uint64_t), coreFile));
+
+    // Program header count past PN_XNUM, given by the first section header
+    header.programHeaderCount = ELF_PN_XNUM;
+    header.sectionHeaderOffset = 0x200;
+    header.sectionHeaderSize = sizeof(Elf64SectionHeader);
+    Elf64SectionHeader section{};
+    section.info = 3;
+    std::memcpy(core.data(), &header, sizeof(header));
+    std::memcpy(core.data() + header.sectionHeaderOffset, &section, sizeof(section));
+    std::string extendedPath = writeFixture("extended.core", core);
+
+    DumpLayout extendedLayout = openDumpLayout(extendedPath);
+    REQUIRE(extendedLayout.format == DumpFormat::ElfCore);
+    REQUIRE_EQ(extendedLayout.runs->runs().size(), 2);
+    REQUIRE_EQ(extendedLayout.runs->end(), FIXTURE_SIZE);
+
+    requireWorkerFindsLsass(corePath);
+}
+
+TEST_CASE("Test compressed dump")
+{
+    ProcessFixture fixture;
+
+    // Random data doesn't compress and is stored as is, the last block is partial
+    std::vector<uint8_t> raw = fixture.data;
+    std::mt19937_64 random(42);
+    for (size_t i = 0; i < COMPRESSED_BLOCK_SIZE + 0x123; i++) {
+        raw.push_back(static_cast<uint8_t>(random()));
+    }
+    std::string rawPath = writeFixture("compressed.raw", raw);
+    std::string compressedPath = (std::filesystem::temp_directory_path() / "compressed.ddz").string();
+
+    ThreadPool pool(4);
+    AnalysisProgress progress;
+    REQUIRE(compressDump(rawPath, compressedPath, pool, &progress));
+    REQUIRE_EQ(progress.totalBytes.load(), raw.size());
+    REQUIRE_EQ(progress.bytesScanned.load(), raw.size());
+    REQUIRE_LT(std::filesystem::file_size(compressedPath), raw.size() / 4);
+
+    // A cancelled run leaves nothing behind
+    std::string cancelledPath = (std::filesystem::temp_directory_path() / "cancelled.ddz").string();
+    std::filesystem::remove(cancelledPath);
+    AnalysisProgress cancelled;
+    cancelled.cancelled = true;
+    REQUIRE_FALSE(compressDump(rawPath, cancelledPath, pool, &cancelled));
+    REQUIRE_FALSE(std::filesystem::exists(cancelledPath));
+    REQUIRE_FALSE(std::filesystem::exists(cancelledPath + ".partial"));
+
+    DumpLayout layout = openDumpLayout(compressedPath);
+    REQUIRE(layout.format == DumpFormat::Compressed);
+    REQUIRE(layout.compressed != nullptr);
+    REQUIRE_EQ(layout.compressed->size(), raw.size());
+    REQUIRE_EQ(layout.physical->presentBytes(), raw.size());
+
+    CachedDumpStream file(compressedPath, std::make_shared<PageCache>(0x100000), layout);
+    file.seekg(0, std::ios::end);
+    REQUIRE_EQ(static_cast<uint64_t>(file.tellg()), raw.size());
+
+    // Reads across a block boundary, from the stored block and from the partial last block
+    std::vector<uint8_t> buffer(PAGE_CACHE_BYPASS_SIZE + 0x10);
+    uint64_t across = COMPRESSED_BLOCK_SIZE - 8;
+    REQUIRE(readPhysicalMemory(across, buffer.data(), buffer.size(), file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &raw[across], buffer.size()), 0);
+    REQUIRE(readPhysicalMemory(FIXTURE_SIZE + 0x100, buffer.data(), 0x100, file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &raw[FIXTURE_SIZE + 0x100], 0x100), 0);
+    REQUIRE(readPhysicalMemory(raw.size() - 8, buffer.data(), 8, file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &raw[raw.size() - 8], 8), 0);
+    REQUIRE_FALSE(readPhysicalMemory(raw.size() - 4, buffer.data(), 8, file));
+
+    uint64_t misses = layout.compressed->misses();
+    uint64_t value;
+    REQUIRE(readPhysicalMemory(across, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(layout.compressed->misses(), misses);
+    REQUIRE_GT(layout.compressed->hits(), 0);
+
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+
+    requireWorkerFindsLsass(compressedPath);
+
+    // The runs of a crash dump are stored without its holes, with the fields of its header
+    uint64_t head = 0x3f000;
+    fixture.write64(head, ProcessFixture::kernelAddress(fixture.processes[0].kProcess + ACTIVE_PROCESS_LINKS_FLINK));
+    std::vector<uint8_t> dump = crashDumpHeader(DUMP_TYPE_FULL, _CR3, ProcessFixture::kernelAddress(head));
+    uint32_t runCount = 2;
+    uint64_t runs[] = {1, 0xff, 0x101, (FIXTURE_SIZE >> PAGE_4KB_SHIFT) - 0x101};
+    std::memcpy(&dump[DUMP_PHYSICAL_MEMORY_BLOCK], &runCount, sizeof(uint32_t));
+    std::memcpy(&dump[DUMP_PHYSICAL_MEMORY_RUNS], runs, sizeof(runs));
+    dump.insert(dump.end(), fixture.data.begin() + 0x1000, fixture.data.begin() + 0x100000);
+    dump.insert(dump.end(), fixture.data.begin() + 0x101000, fixture.data.end());
+    std::string dumpPath = writeFixture("compressed.dmp", dump);
+    REQUIRE(compressDump(dumpPath, compressedPath, pool));
+
+    DumpLayout dumpLayout = openDumpLayout(compressedPath);
+    REQUIRE(dumpLayout.format == DumpFormat::Compressed);
+    REQUIRE_EQ(dumpLayout.compressed->size(), FIXTURE_SIZE - 2 * PAGE_SIZE);
+    REQUIRE_EQ(dumpLayout.runs->runs().size(), 2);
+    REQUIRE_EQ(dumpLayout.directoryTableBase, _CR3);
+    REQUIRE_EQ(dumpLayout.activeProcessHead, ProcessFixture::kernelAddress(head));
+    REQUIRE_FALSE(dumpLayout.physical->isPresent(0x100000));
+    REQUIRE_EQ(dumpLayout.physical->presentBytes(), FIXTURE_SIZE - 2 * PAGE_SIZE);
+
+    CachedDumpStream dumpFile(compressedPath, std::make_shared<PageCache>(0x100000), dumpLayout);
+    REQUIRE_FALSE(readPhysicalMemory(0x100008, &value, sizeof(uint64_t), dumpFile));
+    REQUIRE(readPhysicalMemory(0x101000, buffer.data(), buffer.size(), dumpFile));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0x101000], buffer.size()), 0);
+    // System comes from PsActiveProcessHead, without scanning
+    AnalysisProgress dumpProgress;
+    REQUIRE_EQ(detectProfile(dumpFile, dumpLayout, builtinProfiles(), detected, &dumpProgress),
+               fixture.processes[0].kProcess);
+    REQUIRE_EQ(dumpProgress.bytesScanned.load(), 0);
+
+    // A truncated container has no footer left and opens as a raw dump
+    std::filesystem::resize_file(compressedPath, std::filesystem::file_size(compressedPath) - 1);
+    REQUIRE(openDumpLayout(compressedPath).format == DumpFormat::Raw);
+}
+
+/*
+ * Plain LZ77 Xpress encoder for the fixtures, only repeats of the previous byte become matches.
+ */
+static std::vector<uint8_t> xpressCompress(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> out(4, 0);
+    size_t flagPosition = 0;
+    uint32_t flags = 0;
+    int flagCount = 0;
+    size_t halfBytePosition = SIZE_MAX;
+
+    auto addFlag = [&](uint32_t flag) {
+        if (flagCount == 32) {
+            std::memcpy(&out[flagPosition], &flags, sizeof(flags));
+            flagPosition = out.size();
+            out.resize(out.size() + 4);
+            flags = 0;
+            flagCount = 0;
+        }
+        flags = (flags << 1) | flag;
+        flagCount++;
+    };
+
+    size_t position = 0;
+    while (position < data.size()) {
+        size_t length = 0;
+        while (position > 0 && position + length < data.size() && length < 0x10000
+               && data[position + length] == data[position - 1]) {
+            length++;
+        }
+
+        if (length < 3) {
+            addFlag(0);
+            out.push_back(data[position++]);
+            continue;
+        }
+
+        addFlag(1);
+        size_t encoded = length - 3;
+        putLittleEndian(out, std::min<size_t>(encoded, 7), 2);
+        if (encoded >= 7) {
+            size_t halfByte = std::min<size_t>(encoded - 7, 15);
+            if (halfBytePosition == SIZE_MAX) {
+                halfBytePosition = out.size();
+                out.push_back(static_cast<uint8_t>(halfByte));
+            } else {
+                out[halfBytePosition] |= static_cast<uint8_t>(halfByte << 4);
+                halfBytePosition = SIZE_MAX;
+            }
+            if (halfByte == 15 && encoded - 22 < 255) {
+                out.push_back(static_cast<uint8_t>(encoded - 22));
+            } else if (halfByte == 15) {
+                out.push_back(255);
+                putLittleEndian(out, encoded, 2);
+            }
+        }
+        position += length;
+    }
+
+    flags <<= 32 - flagCount;
+    flags |= flagCount == 32 ? 0 : (1u << (32 - flagCount)) - 1;
+    std::memcpy(&out[flagPosition], &flags, sizeof(flags));
+    return out;
+}
+
+/*
+ * LZ77+Huffman Xpress encoder for the fixtures. Every symbol has a 9-bit code, so the code of a symbol is
+ * its value, and only repeats of the previous byte or of the bytes 16 before become matches.
+ */
+static std::vector<uint8_t> xpressHuffmanCompress(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> out;
+    for (size_t chunk = 0; chunk < data.size(); chunk += XPRESS_HUFFMAN_CHUNK_SIZE) {
+        size_t chunkEnd = std::min<size_t>(data.size(), chunk + XPRESS_HUFFMAN_CHUNK_SIZE);
+        out.insert(out.end(), XPRESS_HUFFMAN_TABLE_SIZE, 0x99);
+
+        // The decoder reads two words ahead, then the next one whenever 16 more bits are used
+        std::vector<size_t> words;
+        size_t bitCount = 0;
+        auto reserveWord = [&]() {
+            words.push_back(out.size());
+            out.resize(out.size() + 2, 0);
+        };
+        auto writeBits = [&](uint32_t value, int count) {
+            for (int bit = count - 1; bit >= 0; bit--, bitCount++) {
+                int wordBit = 15 - static_cast<int>(bitCount % 16);
+                out[words[bitCount / 16] + wordBit / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (wordBit % 8));
+            }
+            if (bitCount > 16 * (words.size() - 1)) {
+                reserveWord();
+            }
+        };
+        reserveWord();
+        reserveWord();
+
+        size_t position = chunk;
+        while (position < chunkEnd) {
+            size_t offset = 0;
+            size_t length = 0;
+            for (size_t candidate : {size_t(1), size_t(16)}) {
+                size_t candidateLength = 0;
+                while (position >= candidate && position + candidateLength < chunkEnd && candidateLength < 0x10000
+                       && data[position + candidateLength] == data[position + candidateLength - candidate]) {
+                    candidateLength++;
+                }
+                if (candidateLength > length) {
+                    offset = candidate;
+                    length = candidateLength;
+                }
+            }
+
+            if (length < 3) {
+                writeBits(data[position++], 9);
+                continue;
+            }
+
+            int offsetBitCount = offset == 1 ? 0 : 4;
+            size_t encoded = length - 3;
+            writeBits(static_cast<uint32_t>(256 + offsetBitCount * 16 + std::min<size_t>(encoded, 15)), 9);
+            if (encoded >= 15 && encoded - 15 < 255) {
+                out.push_back(static_cast<uint8_t>(encoded - 15));
+            } else if (encoded >= 15) {
+                out.push_back(255);
+                putLittleEndian(out, encoded, 2);
+            }
+            writeBits(static_cast<uint32_t>(offset - (size_t(1) << offsetBitCount)), offsetBitCount);
+            position += length;
+        }
+    }
+    return out;
+}
+
+/*
+ * Hibernation file holding the pages of the ranges of each table, in blocks of XPRESS_MAX_PAGES pages.
+ */
+static std::vector<uint8_t> hiberFixture(const std::vector<uint8_t>& memory,
+                                         const std::vector<std::vector<std::pair<uint64_t, uint64_t>>>& tables,
+                                         size_t storedBlock)
+{
+    std::vector<uint8_t> hiberFile(PAGE_SIZE, 0);
+    std::memcpy(hiberFile.data(), "hibr", 4);
+    uint64_t firstTable = 1;
+    std::memcpy(&hiberFile[HIBER_FIRST_TABLE_PAGE_OFFSET], &firstTable, sizeof(uint64_t));
+
+    size_t blockIndex = 0;
+    size_t previousTable = 0;
+    for (auto& ranges : tables) {
+        size_t table = hiberFile.size();
+        if (previousTable != 0) {
+            uint64_t page = table / PAGE_SIZE;
+            std::memcpy(&hiberFile[previousTable + HIBER_TABLE_NEXT_OFFSET], &page, sizeof(uint64_t));
+        }
+        previousTable = table;
+        hiberFile.resize(table + PAGE_SIZE);
+
+        uint32_t count = static_cast<uint32_t>(ranges.size());
+        std::memcpy(&hiberFile[table + HIBER_TABLE_COUNT_OFFSET], &count, sizeof(uint32_t));
+        std::vector<uint64_t> pages;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            size_t entry = table + HIBER_TABLE_ENTRIES_OFFSET + i * HIBER_TABLE_ENTRY_SIZE;
+            std::memcpy(&hiberFile[entry + HIBER_ENTRY_START_PAGE_OFFSET], &ranges[i].first, sizeof(uint64_t));
+            std::memcpy(&hiberFile[entry + HIBER_ENTRY_END_PAGE_OFFSET], &ranges[i].second, sizeof(uint64_t));
+            for (uint64_t page = ranges[i].first; page < ranges[i].second; page++) {
+                pages.push_back(page);
+            }
+        }
+
+        for (size_t first = 0; first < pages.size(); first += XPRESS_MAX_PAGES, blockIndex++) {
+            size_t pageCount = std::min<size_t>(XPRESS_MAX_PAGES, pages.size() - first);
+            std::vector<uint8_t> data;
+            for (size_t i = first; i < first + pageCount; i++) {
+                data.insert(data.end(), memory.begin() + pages[i] * PAGE_SIZE, memory.begin() + (pages[i] + 1) * PAGE_SIZE);
+            }
+            std::vector<uint8_t> compressed = blockIndex == storedBlock ? data : xpressCompress(data);
+
+            hiberFile.insert(hiberFile.end(), XPRESS_SIGNATURE, XPRESS_SIGNATURE + XPRESS_SIGNATURE_SIZE);
+            putLittleEndian(hiberFile, ((compressed.size() - 1) << XPRESS_SIZE_SHIFT) | (pageCount - 1), 4);
+            hiberFile.resize(hiberFile.size() + XPRESS_HEADER_SIZE - XPRESS_SIGNATURE_SIZE - 4, 0);
+            hiberFile.insert(hiberFile.end(), compressed.begin(), compressed.end());
+            hiberFile.resize((hiberFile.size() + 7) & ~size_t(7), 0);
+        }
+        hiberFile.resize((hiberFile.size() + PAGE_SIZE - 1) & ~size_t(PAGE_SIZE - 1), 0);
+    }
+
+    return hiberFile;
+}
+
+/*
+ * Windows 8+ hibernation file holding the pages of the boot and the kernel restore sets, in compression sets of
+ * XPRESS_MAX_PAGES pages. Compression sets are LZ77+Huffman except the stored one and the plain LZ77 one, and
+ * the kernel set is followed by stale data.
+ */
+static std::vector<uint8_t> restoreSetFixture(const std::vector<uint8_t>& memory,
+                                              const std::vector<uint64_t>& bootPages,
+                                              const std::vector<uint64_t>& kernelPages,
+                                              size_t storedBlock, size_t plainBlock)
+{
+    std::vector<uint8_t> hiberFile(PAGE_SIZE, 0);
+    std::memcpy(hiberFile.data(), "HIBR", 4);
+    uint64_t loaderPages = bootPages.size();
+    std::memcpy(&hiberFile[HIBER_LOADER_PAGES_OFFSET], &loaderPages, sizeof(uint64_t));
+
+    size_t blockIndex = 0;
+    for (auto [pages, firstPageOffset] : {std::make_pair(&bootPages, HIBER_FIRST_BOOT_RESTORE_PAGE_OFFSET),
+                                          std::make_pair(&kernelPages, HIBER_FIRST_KERNEL_RESTORE_PAGE_OFFSET)}) {
+        hiberFile.resize((hiberFile.size() + PAGE_SIZE - 1) & ~size_t(PAGE_SIZE - 1), 0);
+        uint64_t firstPage = hiberFile.size() / PAGE_SIZE;
+        std::memcpy(&hiberFile[firstPageOffset], &firstPage, sizeof(uint64_t));
+
+        for (size_t first = 0; first < pages->size(); first += XPRESS_MAX_PAGES, blockIndex++) {
+            size_t pageCount = std::min<size_t>(XPRESS_MAX_PAGES, pages->size() - first);
+            std::vector<uint8_t> data;
+            std::vector<uint64_t> descriptors;
+            for (size_t i = first; i < first + pageCount; i++) {
+                uint64_t page = (*pages)[i];
+                data.insert(data.end(), memory.begin() + page * PAGE_SIZE, memory.begin() + (page + 1) * PAGE_SIZE);
+                if (i > first && page == (*pages)[i - 1] + 1) {
+                    descriptors.back()++;
+                } else {
+                    descriptors.push_back(page << HIBER_DESCRIPTOR_PAGE_SHIFT);
+                }
+            }
+
+            bool huffman = blockIndex != storedBlock && blockIndex != plainBlock;
+            std::vector<uint8_t> compressed = blockIndex == storedBlock ? data
+                                              : huffman ? xpressHuffmanCompress(data) : xpressCompress(data);
+            putLittleEndian(hiberFile, descriptors.size() | (compressed.size() << HIBER_SET_SIZE_SHIFT) | (huffman ? HIBER_SET_HUFFMAN : 0), 4);
+            for (uint64_t descriptor : descriptors) {
+                putLittleEndian(hiberFile, descriptor, 8);
+            }
+            hiberFile.insert(hiberFile.end(), compressed.begin(), compressed.end());
+        }
+    }
+
+    hiberFile.resize(hiberFile.size() + PAGE_SIZE, 0xff);
+    return hiberFile;
+}
+
+TEST_CASE("Test xpressDecompress")
+{
+    std::vector<uint8_t> data = patternData(0x3000);
+    std::fill(data.begin() + 0x100, data.begin() + 0x2100, 0x41);
+    data[0x2200] = data[0x2201] = data[0x2202] = data[0x2203] = 0;
+
+    std::vector<uint8_t> compressed = xpressCompress(data);
+    REQUIRE_LT(compressed.size(), data.size());
+    std::vector<uint8_t> output(data.size());
+    REQUIRE(xpressDecompress(compressed.data(), compressed.size(), output.data(), output.size()));
+    REQUIRE(output == data);
+
+    REQUIRE_FALSE(xpressDecompress(compressed.data(), compressed.size() / 2, output.data(), output.size()));
+    // A match reaching before the start of the output
+    uint8_t invalid[] = {0x00, 0x00, 0x00, 0x80, 0x08, 0x00};
+    REQUIRE_FALSE(xpressDecompress(invalid, sizeof(invalid), output.data(), 4));
+
+    // Plain LZ77 examples of MS-XCA: the alphabet in literals, and "abc" 100 times as 3 literals and one long match
+    std::string alphabet = "abcdefghijklmnopqrstuvwxyz";
+    std::vector<uint8_t> literals = {0x3f, 0x00, 0x00, 0x00};
+    literals.insert(literals.end(), alphabet.begin(), alphabet.end());
+    REQUIRE(xpressDecompress(literals.data(), literals.size(), output.data(), alphabet.size()));
+    REQUIRE_EQ(std::string(output.begin(), output.begin() + alphabet.size()), alphabet);
+
+    std::string repeated;
+    for (int i = 0; i < 100; i++) {
+        repeated += "abc";
+    }
+    uint8_t match[] = {0xff, 0xff, 0xff, 0x1f, 0x61, 0x62, 0x63, 0x17, 0x00, 0x0f, 0xff, 0x26, 0x01};
+    REQUIRE(xpressDecompress(match, sizeof(match), output.data(), repeated.size()));
+    REQUIRE_EQ(std::string(output.begin(), output.begin() + repeated.size()), repeated);
+}
+
+TEST_CASE("Test xpressHuffmanDecompress")
+{
+    // Two chunks, with long runs and a repeated 16 byte pattern
+    std::vector<uint8_t> data = patternData(0x14000);
+    std::fill(data.begin() + 0x100, data.begin() + 0x2100, 0x41);
+    std::fill(data.begin() + 0x3000, data.begin() + 0x3040, 0x42);
+    for (size_t i = 0x5000; i < 0x9000; i++) {
+        data[i] = data[0x5000 + i % 16];
+    }
+
+    std::vector<uint8_t> compressed = xpressHuffmanCompress(data);
+    REQUIRE_LT(compressed.size(), data.size());
+    std::vector<uint8_t> output(data.size());
+    REQUIRE(xpressHuffmanDecompress(compressed.data(), compressed.size(), output.data(), output.size()));
+    REQUIRE(output == data);
+
+    REQUIRE_FALSE(xpressHuffmanDecompress(compressed.data(), compressed.size() / 2, output.data(), output.size()));
+    // Code lengths that don't make a complete prefix code
+    std::vector<uint8_t> invalid = compressed;
+    invalid[0] = 0x88;
+    REQUIRE_FALSE(xpressHuffmanDecompress(invalid.data(), invalid.size(), output.data(), output.size()));
+
+    // LZ77+Huffman examples of MS-XCA, the code lengths of symbol 2n are in the low half of byte n
+    std::string alphabet = "abcdefghijklmnopqrstuvwxyz";
+    std::vector<uint8_t> literals(XPRESS_HUFFMAN_TABLE_SIZE, 0);
+    literals[0x30] = 0x50;
+    std::fill(literals.begin() + 0x31, literals.begin() + 0x3b, 0x55);
+    literals[0x3b] = 0x45;
+    literals[0x3c] = 0x44;
+    literals[0x3d] = 0x04;
+    literals[0x80] = 0x04;
+    uint8_t literalBits[] = {0xd8, 0x52, 0x3e, 0xd7, 0x94, 0x11, 0x5b, 0xe9, 0x19, 0x5f, 0xf9, 0xd6, 0x7c, 0xdf,
+                             0x8d, 0x04, 0x00, 0x00, 0x00, 0x00};
+    literals.insert(literals.end(), std::begin(literalBits), std::end(literalBits));
+    REQUIRE(xpressHuffmanDecompress(literals.data(), literals.size(), output.data(), alphabet.size()));
+    REQUIRE_EQ(std::string(output.begin(), output.begin() + alphabet.size()), alphabet);
+
+    std::string repeated;
+    for (int i = 0; i < 100; i++) {
+        repeated += "abc";
+    }
+    std::vector<uint8_t> match(XPRESS_HUFFMAN_TABLE_SIZE, 0);
+    match[0x30] = 0x30;
+    match[0x31] = 0x23;
+    match[0x80] = 0x02;
+    match[0x8f] = 0x20;
+    uint8_t matchBits[] = {0xa8, 0xdc, 0x00, 0x00, 0xff, 0x26, 0x01};
+    match.insert(match.end(), std::begin(matchBits), std::end(matchBits));
+    REQUIRE(xpressHuffmanDecompress(match.data(), match.size(), output.data(), repeated.size()));
+    REQUIRE_EQ(std::string(output.begin(), output.begin() + repeated.size()), repeated);
+}
+
+TEST_CASE("Test hibernation file")
+{
+    ProcessFixture fixture;
+
+    // Page 0x100 isn't in the file, block 7 spans two ranges and block 20 is stored as is
+    std::vector<uint8_t> hiberData = hiberFixture(fixture.data, {{{0, 0x78}, {0x78, 0x100}, {0x101, 0x200}},
+                                                                 {{0x200, 0x400}}}, 20);
+    std::string hiberPath = writeFixture("hiberfil.sys", hiberData);
+
+    DumpLayout layout = openDumpLayout(hiberPath);
+    REQUIRE(layout.format == DumpFormat::Hibernation);
+    REQUIRE(layout.compressed != nullptr);
+    REQUIRE_EQ(layout.runs->end(), FIXTURE_SIZE);
+    REQUIRE_FALSE(layout.physical->isPresent(0x100000));
+    REQUIRE_EQ(layout.physical->presentBytes(), FIXTURE_SIZE - PAGE_SIZE);
+    auto hiberFile = std::static_pointer_cast<HiberFile>(layout.compressed);
+    REQUIRE_EQ(hiberFile->blocks().size(), 64);
+    REQUIRE_EQ(hiberFile->blocks()[20].compressedSize, XPRESS_MAX_PAGES * PAGE_SIZE);
+    REQUIRE_EQ(hiberFile->blocks()[31].pageCount, 15);
+    REQUIRE_EQ(hiberFile->blocks()[32].set, 1);
+
+    CachedDumpStream file(hiberPath, std::make_shared<PageCache>(0x100000), layout);
+    std::vector<uint8_t> buffer(0x20000);
+    REQUIRE(readPhysicalMemory(0xf0000, buffer.data(), 0x8000, file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0xf0000], 0x8000), 0);
+    REQUIRE(readPhysicalMemory(0x101000, buffer.data(), buffer.size(), file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0x101000], buffer.size()), 0);
+    REQUIRE(readPhysicalMemory(0x141000, buffer.data(), XPRESS_MAX_PAGES * PAGE_SIZE, file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0x141000], XPRESS_MAX_PAGES * PAGE_SIZE), 0);
+    REQUIRE(readPhysicalMemory(0x250000, buffer.data(), buffer.size(), file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0x250000], buffer.size()), 0);
+    uint64_t value;
+    REQUIRE_FALSE(readPhysicalMemory(0x100800, &value, sizeof(uint64_t), file));
+
+    // The following blocks of the set are decompressed along with the block read, up to the end of the set
+    uint64_t misses = hiberFile->misses();
+    REQUIRE(readPhysicalMemory(0x380000, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(hiberFile->misses(), misses + 8);
+    REQUIRE(readPhysicalMemory(0x3f0000, &value, sizeof(uint64_t), file));
+    REQUIRE_EQ(hiberFile->misses(), misses + 8);
+
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(detected.offsets.systemDirectoryTableBase, _CR3);
+
+    requireWorkerFindsLsass(hiberPath);
+
+    // A corrupted block header fails the whole index
+    hiberData[2 * PAGE_SIZE] ^= 0xff;
+    writeFixture("hiberfil.sys", hiberData);
+    REQUIRE(openDumpLayout(hiberPath).format == DumpFormat::Raw);
+}
+
+TEST_CASE("Test Windows 8 hibernation file")
+{
+    ProcessFixture fixture;
+
+    // The loader pages 0x20 to 0x48 are in the boot set and page 0x100 isn't in the file. Block 3 is stored
+    // as is and block 4 is plain LZ77, block 5 holds pages 0x48 to 0x58 of the kernel set
+    std::vector<uint64_t> bootPages;
+    std::vector<uint64_t> kernelPages;
+    for (uint64_t page = 0; page < FIXTURE_SIZE / PAGE_SIZE; page++) {
+        if (page != 0x100) {
+            (page >= 0x20 && page < 0x48 ? bootPages : kernelPages).push_back(page);
+        }
+    }
+    std::vector<uint8_t> hiberData = restoreSetFixture(fixture.data, bootPages, kernelPages, 3, 4);
+    std::string hiberPath = writeFixture("hiberfil8.sys", hiberData);
+
+    DumpLayout layout = openDumpLayout(hiberPath);
+    REQUIRE(layout.format == DumpFormat::Hibernation);
+    REQUIRE_EQ(layout.runs->end(), FIXTURE_SIZE);
+    REQUIRE_FALSE(layout.physical->isPresent(0x100000));
+    REQUIRE_EQ(layout.physical->presentBytes(), FIXTURE_SIZE - PAGE_SIZE);
+    auto hiberFile = std::static_pointer_cast<HiberFile>(layout.compressed);
+    REQUIRE_EQ(hiberFile->blocks().size(), 65);
+    REQUIRE_EQ(hiberFile->blocks()[2].set, HIBER_BOOT_SET);
+    REQUIRE_EQ(hiberFile->blocks()[3].set, HIBER_KERNEL_SET);
+    REQUIRE_EQ(hiberFile->blocks()[3].compressedSize, XPRESS_MAX_PAGES * PAGE_SIZE);
+    REQUIRE_FALSE(hiberFile->blocks()[4].huffman);
+    REQUIRE(hiberFile->blocks()[5].huffman);
+    REQUIRE_EQ(hiberFile->blocks()[64].pageCount, 7);
+
+    CachedDumpStream file(hiberPath, std::make_shared<PageCache>(0x100000), layout);
+    std::vector<uint8_t> buffer(0x40000);
+    REQUIRE(readPhysicalMemory(0x18000, buffer.data(), buffer.size(), file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0x18000], buffer.size()), 0);
+    REQUIRE(readPhysicalMemory(0x101000, buffer.data(), buffer.size(), file));
+    REQUIRE_EQ(std::memcmp(buffer.data(), &fixture.data[0x101000], buffer.size()), 0);
+    uint64_t value;
+    REQUIRE_FALSE(readPhysicalMemory(0x100800, &value, sizeof(uint64_t), file));
+
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+
+    requireWorkerFindsLsass(hiberPath);
+
+    // The boot set has a page count, a compression set missing from it fails the whole index
+    hiberData[PAGE_SIZE] = 0;
+    writeFixture("hiberfil8.sys", hiberData);
+    REQUIRE(openDumpLayout(hiberPath).format == DumpFormat::Raw);
+}
+
+TEST_CASE("Test PhysicalAddressSpace")
+{
+    ProcessFixture fixture;
+    mapFixtureUserPage(fixture);
+
+    DumpLayout rawLayout = openDumpLayout(writeFixture("physical.raw", fixture.data));
+    REQUIRE(rawLayout.physical != nullptr);
+    REQUIRE_EQ(rawLayout.physical->runs().size(), 1);
+    REQUIRE_EQ(rawLayout.physical->presentBytes(), FIXTURE_SIZE);
+    REQUIRE_FALSE(rawLayout.physical->isPresent(FIXTURE_SIZE));
+
+    // Pages 0x100 to 0x103 aren't in the dump, they make a whole cell of the memory map
+    std::vector<uint8_t> lime;
+    appendLimeRange(lime, fixture.data, 0, 0x100000);
+    appendLimeRange(lime, fixture.data, 0x104000, FIXTURE_SIZE);
+    std::string path = writeFixture("physical.lime", lime);
+
+    DumpLayout layout = openDumpLayout(path);
+    const PhysicalAddressSpace& physical = *layout.physical;
+    REQUIRE_EQ(physical.runs().size(), 2);
+    REQUIRE_EQ(physical.end(), FIXTURE_SIZE);
+    REQUIRE_EQ(physical.presentBytes(), FIXTURE_SIZE - 4 * PAGE_SIZE);
+    REQUIRE(physical.isPagePresent(0xff));
+    REQUIRE_FALSE(physical.isPagePresent(0x100));
+    REQUIRE_FALSE(physical.isPresent(0x103fff));
+    REQUIRE(physical.isPresent(0x104000));
+    REQUIRE_FALSE(physical.isPagePresent(FIXTURE_SIZE >> PAGE_4KB_SHIFT));
+
+    // The System scan only reads the runs
+    CachedDumpStream file(path, std::make_shared<PageCache>(0x100000), layout);
+    AnalysisProgress progress;
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected, &progress), fixture.processes[0].kProcess);
+    REQUIRE_EQ(progress.totalBytes.load(), physical.presentBytes());
+
+    MemoryView view(path, std::make_shared<PageCache>(0x10000), layout);
+    REQUIRE_EQ(view.lastPage(), (FIXTURE_SIZE >> PAGE_4KB_SHIFT) - 1);
+    uint8_t page[PAGE_SIZE];
+    REQUIRE_EQ(view.readPage(0x104, page), PAGE_SIZE);
+    REQUIRE_EQ(std::memcmp(page, &fixture.data[0x104000], PAGE_SIZE), 0);
+    REQUIRE_EQ(view.readPage(0x101, page), 0);
+    REQUIRE_EQ(view.translate(0x101000), 0);
+    REQUIRE_EQ(view.translate(0x104010), 0x104010);
+
+    // Reads reaching into the hole fail without going through the stream
+    AccessCounters counters;
+    RecordingStream recording(static_cast<std::istream&>(file).rdbuf());
+    AddressSpace space(recording, 0, OffsetsProfile(), &counters, layout.physical);
+    uint64_t value;
+    REQUIRE_FALSE(space.readPhysical(0x101000, &value, sizeof(uint64_t)));
+    REQUIRE_FALSE(space.readPhysical(0xffffc, &value, sizeof(uint64_t)));
+    REQUIRE_EQ(counters.failedReads.load(), 2);
+    REQUIRE(recording.pages().empty());
+    REQUIRE(space.readPhysical(0x104000, &value, sizeof(uint64_t)));
+    REQUIRE_EQ(recording.pages().size(), 1);
+
+    std::vector<Process> processes;
+    for (auto& process : fixture.processes) {
+        processes.push_back({process.kProcess, process.directoryTableBase, process.name, {}});
+    }
+    MemoryMap map;
+    REQUIRE(map.start(path, processes, 256));
+    while (map.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(map.cellClass(0x100 / 4) == PageClass::Unscanned);
+    REQUIRE(map.cellClass(0x10 / 4) == PageClass::Kernel);
+    REQUIRE(map.cellClass(0x200 / 4) == PageClass::Process);
+}
+
+TEST_CASE("Test segmented dump")
+{
+    ProcessFixture fixture;
+
+    // dd-style split, the second segment ends in the middle of a page
+    std::string directory = std::filesystem::temp_directory_path().string();
+    size_t splits[] = {0, 0x155000, 0x2aa800, FIXTURE_SIZE};
+    for (int i = 0; i < 3; i++) {
+        std::vector<uint8_t> segment(fixture.data.begin() + splits[i], fixture.data.begin() + splits[i + 1]);
+        writeFixture("split.raw.00" + std::to_string(i + 1), segment);
+    }
+    std::filesystem::remove(directory + "/split.raw.004");
+    std::string path = directory + "/split.raw.001";
+
+    DumpLayout layout = openDumpLayout(path);
+    REQUIRE(layout.format == DumpFormat::Segmented);
+    REQUIRE_EQ(layout.mappings.size(), 3);
+    REQUIRE_EQ(layout.runs->runs().size(), 3);
+    REQUIRE_EQ(layout.runs->runs()[1].start, 0x155000);
+    REQUIRE_EQ(layout.runs->runs()[1].size, 0x2aa800 - 0x155000);
+    REQUIRE_EQ(layout.runs->runs()[2].start, 0x2aa800);
+    REQUIRE_EQ(layout.runs->runs()[2].fileOffset, 0);
+    REQUIRE_EQ(layout.runs->runs()[2].source, 2);
+    REQUIRE_EQ(layout.physical->end(), FIXTURE_SIZE);
+
+    // Reads straddling the segments
+    CachedDumpStream file(path, std::make_shared<PageCache>(0x100000), layout);
+    uint8_t small[0x20];
+    REQUIRE(readPhysicalMemory(0x2aa800 - 0x10, small, sizeof(small), file));
+    REQUIRE_EQ(std::memcmp(small, &fixture.data[0x2aa800 - 0x10], sizeof(small)), 0);
+    std::vector<uint8_t> large(0x200000);
+    REQUIRE(readPhysicalMemory(0x100000, large.data(), large.size(), file));
+    REQUIRE_EQ(std::memcmp(large.data(), &fixture.data[0x100000], large.size()), 0);
+    REQUIRE_FALSE(readPhysicalMemory(FIXTURE_SIZE - 4, small, 8, file));
+
+    requireWorkerFindsLsass(path);
+
+    // One file per physical range, page 0x100 isn't in any of them
+    writeFixture("range_low.bin", std::vector<uint8_t>(fixture.data.begin(), fixture.data.begin() + 0x100000));
+    writeFixture("range_high.bin", std::vector<uint8_t>(fixture.data.begin() + 0x101000, fixture.data.end()));
+    std::string manifest = "# start file\n0x101000 range_high.bin\n\n0 range_low.bin\n";
+    std::string manifestPath = writeFixture("ranges.segments", std::vector<uint8_t>(manifest.begin(), manifest.end()));
+
+    DumpLayout rangeLayout = openDumpLayout(manifestPath);
+    REQUIRE(rangeLayout.format == DumpFormat::Segmented);
+    REQUIRE_EQ(rangeLayout.runs->runs()[0].source, 1);
+    REQUIRE_FALSE(rangeLayout.physical->isPagePresent(0x100));
+
+    CachedDumpStream rangeFile(manifestPath, std::make_shared<PageCache>(0x100000), rangeLayout);
+    uint64_t value;
+    REQUIRE_FALSE(readPhysicalMemory(0x100800, &value, sizeof(uint64_t), rangeFile));
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(rangeFile, rangeLayout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+
+    // Overlapping ranges are rejected
+    manifest += "0xff000 range_high.bin\n";
+    writeFixture("ranges.segments", std::vector<uint8_t>(manifest.begin(), manifest.end()));
+    REQUIRE(openDumpLayout(manifestPath).format == DumpFormat::Raw);
+}
+
+TEST_CASE("Test streamDump")
+{
+    ProcessFixture fixture;
+
+    // Pool headers in front of the _EPROCESS and VAD allocations, as the kernel pool would put them
+    for (const FixtureProcess& process : fixture.processes) {
+        std::memcpy(&fixture.data[process.kProcess - 0x80 + POOL_TAG_OFFSET], "Proc", 4);
+    }
+    for (uint64_t node = 0x30000; node < 0x30000 + 9 * 0x40; node += 0x40) {
+        std::memcpy(&fixture.data[node - POOL_HEADER_ALIGNMENT + POOL_TAG_OFFSET], "VadS", 4);
+    }
+
+    // Second chunk, with a VAD allocation crossing the chunk boundary
+    fixture.data.resize(STREAM_CHUNK_SIZE + 0x3000);
+    std::memcpy(&fixture.data[STREAM_CHUNK_SIZE - POOL_HEADER_ALIGNMENT + POOL_TAG_OFFSET], "VadS", 4);
+    fixture.data[STREAM_CHUNK_SIZE + 0x10] = 0x42;
+    std::string path = writeFixture("stream.raw", fixture.data);
+
+    std::istringstream input(std::string(fixture.data.begin(), fixture.data.end()));
+    SystemProcessScanner scanner;
+    StreamedDump dump;
+    REQUIRE(streamDump(input, StreamOptions(), scanner, dump));
+    REQUIRE_EQ(dump.size, fixture.data.size());
+    // The 5 tables, and the lsass _EPROCESS and VAD pages whose small odd values pass for present entries
+    REQUIRE_EQ(dump.pageClasses[static_cast<size_t>(PageClass::PageTable)], 7);
+
+    DumpHashManifest manifest;
+    REQUIRE(hashDump(path, manifest));
+    REQUIRE_EQ(dump.manifest.chunks.size(), 2);
+    REQUIRE_EQ(dump.manifest.sha256Root(), manifest.sha256Root());
+    REQUIRE_EQ(dump.manifest.blake3Root(), manifest.blake3Root());
+
+    // Only the tables and the flagged allocations are kept
+    REQUIRE_LT(dump.pages->size(), 20);
+    REQUIRE(dump.pages->page(_CR3 >> PAGE_4KB_SHIFT) != nullptr);
+    REQUIRE(dump.pages->page((STREAM_CHUNK_SIZE >> PAGE_4KB_SHIFT) - 1) != nullptr);
+    REQUIRE_EQ(dump.pages->page(STREAM_CHUNK_SIZE >> PAGE_4KB_SHIFT)[0x10], 0x42);
+    REQUIRE(dump.pages->page(0x100) == nullptr);
+
+    RetainedPageStream file(dump.pages);
+    REQUIRE_EQ(scanner.result(file), fixture.processes[0].kProcess);
+    std::vector<Process> processList = getProcessList(fixture.processes[0].kProcess, _CR3, file);
+    REQUIRE_EQ(processList.size(), 4);
+    REQUIRE_EQ(processList[2].ProcessName, "lsass.exe");
+    REQUIRE_EQ(processList[2].VadTree.size(), 5);
+
+    // Through the analysis, from a stream without the pool tags: the walk stops after System
+    ProcessFixture untagged;
+    std::istringstream untaggedInput(std::string(untagged.data.begin(), untagged.data.end()));
+    std::ostringstream output;
+    NdjsonWriter writer(output);
+    AnalysisResult result = analyzeStream(untaggedInput, "-", AnalysisOptions(), writer);
+    REQUIRE(result.succeeded);
+    REQUIRE_EQ(result.systemKProcessAddress, untagged.processes[0].kProcess);
+    REQUIRE_EQ(result.processCount, 1);
+    REQUIRE_NE(output.str().find("\"type\":\"stream\""), std::string::npos);
+}
+
+TEST_CASE("Test GrowingFile")
+{
+    std::string path = std::filesystem::temp_directory_path().string() + "/reopened.raw";
+    std::ofstream writer(path, std::ios::binary | std::ios::trunc);
+    std::vector<uint8_t> data = patternData(2 * PAGE_SIZE);
+    writer.write(reinterpret_cast<const char *>(data.data()), PAGE_SIZE);
+    writer.flush();
+    GrowingFile growing(path);
+
+    // Closed, then reopened by the writer and appended to, it's still growing
+    writer.close();
+    writer.open(path, std::ios::binary | std::ios::app);
+    writer.write(reinterpret_cast<const char *>(data.data()) + PAGE_SIZE, PAGE_SIZE);
+    writer.flush();
+    REQUIRE_EQ(growing.waitForGrowth(PAGE_SIZE, 2000), 2 * PAGE_SIZE);
+    REQUIRE_EQ(growing.waitForGrowth(2 * PAGE_SIZE, GROWING_FILE_POLL_MS / 2), 2 * PAGE_SIZE);
+    REQUIRE_FALSE(growing.writerClosed());
+
+    // Done once closed and left alone for a poll interval
+    writer.close();
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_EQ(growing.waitForGrowth(2 * PAGE_SIZE, 4 * GROWING_FILE_POLL_MS), 2 * PAGE_SIZE);
+#ifdef __linux__
+    REQUIRE(growing.writerClosed());
+    REQUIRE_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(GROWING_FILE_POLL_MS));
+    REQUIRE_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(4 * GROWING_FILE_POLL_MS));
+#endif
+}
+
+TEST_CASE("Test following a growing dump")
+{
+    ProcessFixture fixture;
+    std::string path = std::filesystem::temp_directory_path().string() + "/growing.raw";
+    std::ofstream writer(path, std::ios::binary | std::ios::trunc);
+
+    // System's _EPROCESS is written, the page tables its links and VAD tree go through aren't
+    writer.write(reinterpret_cast<const char *>(fixture.data.data()), 0x11000);
+    writer.flush();
+
+    DumpSession session(path);
+    session.startAnalysis(true);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (session.processes().empty() && std::chrono::steady_clock::now() < deadline) {
+        session.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(session.worker().isFollowing());
+    REQUIRE_EQ(session.processes().size(), 1);
+    REQUIRE(session.processes()[0].VadTree.empty());
+    size_t generation = session.processGeneration();
+    size_t layoutGeneration = session.layoutGeneration();
+    REQUIRE_FALSE(session.layout().physical->isPresent(0x200000));
+
+    // The acquisition tool closes the dump and reopens it before writing the rest
+    writer.close();
+    writer.open(path, std::ios::binary | std::ios::app);
+    writer.write(reinterpret_cast<const char *>(fixture.data.data()) + 0x11000, FIXTURE_SIZE - 0x11000);
+    writer.close();
+    while (session.worker().isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    session.update();
+    REQUIRE(session.worker().state() == AnalysisState::Done);
+    REQUIRE_FALSE(session.worker().isFollowing());
+    REQUIRE_EQ(session.processes().size(), 4);
+    REQUIRE_EQ(session.processes()[0].VadTree.size(), 1);
+    REQUIRE_EQ(session.processes()[2].VadTree.size(), 5);
+    // System's VAD tree was filled in, the list was fetched again
+    REQUIRE_GT(session.processGeneration(), generation);
+    // The physical address space shown by the views grew with the dump
+    REQUIRE_GT(session.layoutGeneration(), layoutGeneration);
+    REQUIRE_EQ(session.layout().physical->end(), FIXTURE_SIZE);
+    REQUIRE(session.layout().physical->isPresent(0x200000));
+}
+
+TEST_CASE("Test writeTriageDump")
+{
+    ProcessFixture fixture;
+    mapFixtureUserPage(fixture);
+    // PsActiveProcessHead, between the last process and System
+    uint64_t head = 0x3f000;
+    fixture.write64(head, ProcessFixture::kernelAddress(fixture.processes[0].kProcess + ACTIVE_PROCESS_LINKS_FLINK));
+    fixture.write64(fixture.processes[0].kProcess + ACTIVE_PROCESS_LINKS_BLINK, ProcessFixture::kernelAddress(head));
+    // The first VAD of smss.exe, at 0x10000 in the large page
+    std::vector<uint8_t> pattern = patternData(2 * PAGE_SIZE);
+    std::memcpy(&fixture.data[0x210000], pattern.data(), pattern.size());
+    std::string path = writeFixture("triage.raw", fixture.data);
+    std::string outputPath = std::filesystem::temp_directory_path().string() + "/triage.dmp";
+
+    TriageOptions options;
+    options.profiles = builtinProfiles();
+    options.processes = {"missing.exe"};
+    TriageSummary summary;
+    REQUIRE_FALSE(writeTriageDump(path, outputPath, options, summary));
+
+    options.processes = {"smss.exe", "1"};
+    REQUIRE(writeTriageDump(path, outputPath, options, summary));
+    REQUIRE_EQ(summary.processes.size(), 1);
+    // The pages of the first VAD only, the rest of the large page and the other VADs aren't mapped
+    REQUIRE_EQ(summary.dataPages, 2);
+    REQUIRE_EQ(summary.missingPages, 0);
+    REQUIRE_LT(std::filesystem::file_size(outputPath), FIXTURE_SIZE / 16);
+
+    DumpLayout layout = openDumpLayout(outputPath);
+    REQUIRE(layout.format == DumpFormat::CrashDump);
+    REQUIRE_EQ(layout.directoryTableBase, _CR3);
+    REQUIRE_EQ(layout.activeProcessHead, ProcessFixture::kernelAddress(head));
+
+    CachedDumpStream file(outputPath, std::make_shared<PageCache>(0x100000), layout);
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    std::vector<Process> processList = AddressSpace(file, _CR3, detected.offsets).processList(fixture.processes[0].kProcess);
+    REQUIRE_EQ(processList.size(), 4);
+    REQUIRE_EQ(processList[1].ProcessName, "smss.exe");
+    REQUIRE_EQ(processList[1].VadTree.size(), 3);
+
+    std::vector<uint8_t> page(2 * PAGE_SIZE);
+    AddressSpace smss(file, fixture.processes[1].directoryTableBase, detected.offsets);
+    REQUIRE(smss.read(0x10000, page.data(), page.size()));
+    REQUIRE_EQ(page, pattern);
+    REQUIRE_FALSE(readPhysicalMemory(0x200000, page.data(), PAGE_SIZE, file));
+}
+
+TEST_CASE("Test page store")
+{
+    std::string store = std::filesystem::temp_directory_path().string() + "/page_store";
+    std::filesystem::remove_all(store);
+
+    ProcessFixture fixture;
+    mapFixtureUserPage(fixture);
+    std::string firstPath = writeFixture("capture1.raw", fixture.data);
+    IngestSummary summary;
+    REQUIRE(ingestDump(firstPath, store, "capture1", summary));
+    REQUIRE_EQ(summary.dumpPages, FIXTURE_SIZE >> PAGE_4KB_SHIFT);
+    // Most of the fixture is zeros, they're stored once
+    REQUIRE_LT(summary.newPages, 64);
+    uint64_t firstPackPages = summary.packPages;
+
+    // The second capture differs by one page
+    fixture.data[0x300010] = 0x42;
+    std::string secondPath = writeFixture("capture2.raw", fixture.data);
+    REQUIRE(ingestDump(secondPath, store, "capture2", summary));
+    REQUIRE_EQ(summary.newPages, 1);
+    REQUIRE_EQ(summary.packPages, firstPackPages + 1);
+    REQUIRE_EQ(std::filesystem::file_size(store + "/" PAGE_STORE_PACK), (firstPackPages + 1) * PAGE_SIZE);
+
+    DumpLayout layout = openDumpLayout(summary.indexPath);
+    REQUIRE(layout.format == DumpFormat::PageStore);
+    REQUIRE_EQ(layout.physical->end(), FIXTURE_SIZE);
+    CachedDumpStream file(summary.indexPath, std::make_shared<PageCache>(0x100000), layout);
+    std::vector<uint8_t> data(PAGE_CACHE_BYPASS_SIZE);
+    for (uint64_t offset : {0x0ull, 0x1a0000ull, 0x200000ull, 0x2f8000ull, 0x3f0000ull}) {
+        REQUIRE(readPhysicalMemory(offset, data.data(), data.size(), file));
+        REQUIRE_EQ(std::memcmp(data.data(), &fixture.data[offset], data.size()), 0);
+    }
+
+    WindowsProfile detected;
+    REQUIRE_EQ(detectProfile(file, layout, builtinProfiles(), detected), fixture.processes[0].kProcess);
+    REQUIRE_EQ(AddressSpace(file, _CR3, detected.offsets).processList(fixture.processes[0].kProcess).size(), 4);
+
+    DumpLayout firstLayout = openDumpLayout(store + "/capture1" PAGE_INDEX_EXTENSION);
+    CachedDumpStream firstFile(store + "/capture1" PAGE_INDEX_EXTENSION, std::make_shared<PageCache>(0x100000), firstLayout);
+    uint8_t value;
+    REQUIRE(readPhysicalMemory(0x300010, &value, 1, firstFile));
+    REQUIRE_EQ(value, 0);
+
+    // An ingest interrupted after writing part of a page leaves the pack longer than its digests
+    {
+        std::ofstream pack(store + "/" PAGE_STORE_PACK, std::ios::binary | std::ios::app);
+        pack.write(reinterpret_cast<const char *>(data.data()), 100);
+    }
+    fixture.data[0x300010] = 0x43;
+    std::string thirdPath = writeFixture("capture3.raw", fixture.data);
+    REQUIRE(ingestDump(thirdPath, store, "capture3", summary));
+    REQUIRE_EQ(summary.packPages, firstPackPages + 2);
+    REQUIRE_EQ(std::filesystem::file_size(store + "/" PAGE_STORE_PACK), (firstPackPages + 2) * PAGE_SIZE);
+    CachedDumpStream thirdFile(summary.indexPath, std::make_shared<PageCache>(0x100000), openDumpLayout(summary.indexPath));
+    REQUIRE(readPhysicalMemory(0x300010, &value, 1, thirdFile));
+    REQUIRE_EQ(value, 0x43);
+
+    // Names are file names, an index can't be written outside the store
+    std::string outside = std::filesystem::temp_directory_path().string() + "/outside";
+    std::filesystem::remove(outside + PAGE_INDEX_EXTENSION);
+    for (const std::string& name : {std::string("../outside"), outside, std::string("a/b"), std::string(".."),
+                                    std::string("")}) {
+        REQUIRE_FALSE(ingestDump(thirdPath, store, name, summary));
+    }
+    REQUIRE_FALSE(std::filesystem::exists(outside + PAGE_INDEX_EXTENSION));
+}
@@ -0,0 +1,330 @@
+#include "memorymap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "memory.h"
+#include "pagecache.h"
+#include "physicalspace.h"
+#include "threadpool.h"
+
+
+/**
+ * @param pageClass: class of a page
+ * @return: name of the class shown to the user
+ */
+const char *pageClassName(PageClass pageClass)
+{
+    switch (pageClass) {
+        case PageClass::Zero:
+            return "Zero";
+        case PageClass::PageTable:
+            return "Page table";
+        case PageClass::Process:
+            return "Process";
+        case PageClass::Kernel:
+            return "Kernel";
+        case PageClass::HighEntropy:
+            return "High entropy";
+        case PageClass::Data:
+            return "Data";
+        default:
+            return "Not scanned";
+    }
+}
+
+/**
+ * Classify a page by its content only.
+ *
+ * @param page: content of the page
+ * @param size: number of valid bytes
+ * @return: Zero, HighEntropy or Data
+ */
+PageClass classifyPage(const uint8_t *page, size_t size)
+{
+    uint32_t histogram[256] = {0};
+    for (size_t i = 0; i < size; i++) {
+        histogram[page[i]]++;
+    }
+
+    if (histogram[0] == size) {
+        return PageClass::Zero;
+    }
+
+    double entropy = 0;
+    for (uint32_t count : histogram) {
+        if (count != 0) {
+            double probability = static_cast<double>(count) / size;
+            entropy -= probability * std::log2(probability);
+        }
+    }
+
+    return entropy >= HIGH_ENTROPY_BITS ? PageClass::HighEntropy : PageClass::Data;
+}
+
+/**
+ * Reverse the low bits of a sample number, so that consecutive samples are spread over the cell.
+ */
+static uint64_t reverseBits(uint64_t value, int bits)
+{
+    uint64_t reversed = 0;
+    for (int i = 0; i < bits; i++) {
+        reversed = (reversed << 1) | ((value >> i) & 1);
+    }
+    return reversed;
+}
+
+MemoryMap::~MemoryMap()
+{
+    cancel();
+}
+
+/**
+ * Start building the map of a dump, cancelling the one in progress if there is one.
+ *
+ * @param path: path to the dump
+ * @param processes: processes of the dump, their page tables tell who owns which page
+ * @param cellCount: upper bound of the number of cells
+ * @param layout: layout of the dump, opened from the path when it is the default one
+ * @return: false if the dump can't be read
+ */
+bool MemoryMap::start(const std::string& path, const std::vector<Process>& processes, size_t cellCount,
+                      const DumpLayout& layout)
+{
+    cancel();
+
+    dumpLayout = layout.physical ? layout : openDumpLayout(path);
+    uint64_t end = dumpLayout.physical->end();
+    if (end == 0) {
+        return false;
+    }
+
+    totalPages = (end + PAGE_SIZE - 1) >> PAGE_4KB_SHIFT;
+    cellPages = std::max<uint64_t>(1, (totalPages + cellCount - 1) / cellCount);
+    cells = static_cast<size_t>((totalPages + cellPages - 1) / cellPages);
+    rows = (cells + MEMORY_MAP_WIDTH - 1) / MEMORY_MAP_WIDTH;
+
+    sampleBits = 0;
+    while ((1ULL << sampleBits) < cellPages) {
+        sampleBits++;
+    }
+    passes = sampleBits + 1;
+
+    counts.assign(cells, {});
+    classes = std::make_unique<std::atomic<uint8_t>[]>(rows * MEMORY_MAP_WIDTH);
+    owners = std::make_unique<std::atomic<uint16_t>[]>(rows * MEMORY_MAP_WIDTH);
+    for (size_t i = 0; i < rows * MEMORY_MAP_WIDTH; i++) {
+        classes[i] = static_cast<uint8_t>(PageClass::Unscanned);
+        owners[i] = NO_OWNER;
+    }
+
+    std::vector<uint64_t> directoryTableBases;
+    for (auto& process : processes) {
+        directoryTableBases.push_back(process.DirectoryTableBase);
+    }
+
+    cancelled = false;
+    completedPasses = 0;
+    running = true;
+    thread = std::thread(&MemoryMap::run, this, path, std::move(directoryTableBases));
+    return true;
+}
+
+/**
+ * Stop building the map and wait for it. The cells computed so far are kept.
+ */
+void MemoryMap::cancel()
+{
+    cancelled = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool MemoryMap::isRunning() const
+{
+    return running;
+}
+
+size_t MemoryMap::width() const
+{
+    return MEMORY_MAP_WIDTH;
+}
+
+size_t MemoryMap::height() const
+{
+    return rows;
+}
+
+uint64_t MemoryMap::pagesPerCell() const
+{
+    return cellPages;
+}
+
+size_t MemoryMap::passesDone() const
+{
+    return completedPasses;
+}
+
+size_t MemoryMap::passCount() const
+{
+    return passes;
+}
+
+/**
+ * Copy the class of every cell, row by row. The cells past the end of the dump are Unscanned.
+ *
+ * @param cellClasses: receives width() * height() PageClass values
+ */
+void MemoryMap::snapshot(std::vector<uint8_t>& cellClasses) const
+{
+    cellClasses.resize(rows * MEMORY_MAP_WIDTH);
+    for (size_t i = 0; i < cellClasses.size(); i++) {
+        cellClasses[i] = classes[i];
+    }
+}
+
+PageClass MemoryMap::cellClass(size_t cell) const
+{
+    return cell < cells ? static_cast<PageClass>(classes[cell].load()) : PageClass::Unscanned;
+}
+
+/**
+ * @return: index of a process owning pages of the cell in the process list given to start, -1 if there is none
+ */
+int MemoryMap::cellOwner(size_t cell) const
+{
+    if (cell >= cells) {
+        return -1;
+    }
+
+    uint16_t owner = owners[cell];
+    return owner == NO_OWNER || owner >= PAGE_TABLE_OWNER ? -1 : owner - 1;
+}
+
+void MemoryMap::run(std::string path, std::vector<uint64_t> directoryTableBases)
+{
+    {
+        CachedDumpStream file(path, std::make_shared<PageCache>(0), dumpLayout);
+        buildOwners(file, directoryTableBases);
+    }
+
+    ThreadPool& pool = ThreadPool::global();
+    size_t tiles = (rows + MEMORY_MAP_TILE_ROWS - 1) / MEMORY_MAP_TILE_ROWS;
+
+    for (size_t pass = 0; pass < passes && !cancelled; pass++) {
+        pool.parallelFor(tiles, [&](size_t tile) {
+            scanTile(path, tile, pass);
+            notify();
+        });
+
+        if (!cancelled) {
+            completedPasses = pass + 1;
+        }
+    }
+
+    running = false;
+    notify();
+}
+
+/**
+ * Mark the pages mapped by the processes and the pages holding their page tables. The kernel half
+ * of the address space is shared, it's only walked for the first process (System) and after the
+ * user halves, so that process memory also mapped by the kernel stays attributed to the process.
+ */
+void MemoryMap::buildOwners(std::ifstream& file, const std::vector<uint64_t>& directoryTableBases)
+{
+    pageOwners.assign(directoryTableBases.empty() ? 0 : totalPages, NO_OWNER);
+
+    auto onTable = [&](uint64_t tableAddress) {
+        pageOwners[tableAddress >> PAGE_4KB_SHIFT] = PAGE_TABLE_OWNER;
+    };
+
+    auto markPages = [&](const PageMapping& mapping, uint16_t owner) {
+        uint64_t first = mapping.physicalAddress >> PAGE_4KB_SHIFT;
+        uint64_t last = std::min(totalPages, first + (mapping.size >> PAGE_4KB_SHIFT));
+        for (uint64_t page = first; page < last; page++) {
+            if (pageOwners[page] == NO_OWNER) {
+                pageOwners[page] = owner;
+            }
+        }
+    };
+
+    for (size_t i = 0; i < directoryTableBases.size() && !cancelled; i++) {
+        uint16_t owner = static_cast<uint16_t>(std::min<size_t>(i + 1, PAGE_TABLE_OWNER - 1));
+        walkPageTables(directoryTableBases[i], 0, USER_SPACE_END, file,
+                       [&](const PageMapping& mapping) { markPages(mapping, owner); }, onTable);
+    }
+
+    if (!directoryTableBases.empty() && !cancelled) {
+        walkPageTables(directoryTableBases[0], KERNEL_SPACE_START, 0, file,
+                       [&](const PageMapping& mapping) { markPages(mapping, KERNEL_OWNER); }, onTable);
+    }
+}
+
+/**
+ * Sample the pages of one pass in the cells of a tile. Pass 0 samples the first page of every cell,
+ * pass n > 0 the 2^(n-1) pages halfway between the pages sampled by the previous passes.
+ */
+void MemoryMap::scanTile(const std::string& path, size_t tile, size_t pass)
+{
+    CachedDumpStream file(path, std::make_shared<PageCache>(0), dumpLayout);
+    if (!file.is_open()) {
+        return;
+    }
+
+    uint64_t firstSample = pass == 0 ? 0 : 1ULL << (pass - 1);
+    uint64_t lastSample = 1ULL << pass;
+    size_t firstCell = tile * MEMORY_MAP_TILE_ROWS * MEMORY_MAP_WIDTH;
+    size_t lastCell = std::min(cells, firstCell + MEMORY_MAP_TILE_ROWS * MEMORY_MAP_WIDTH);
+    uint8_t page[PAGE_SIZE];
+
+    for (size_t cell = firstCell; cell < lastCell && !cancelled; cell++) {
+        auto& cellCounts = counts[cell];
+        uint16_t cellOwner = owners[cell];
+
+        for (uint64_t sample = firstSample; sample < lastSample; sample++) {
+            uint64_t offset = reverseBits(sample, sampleBits);
+            uint64_t pageNumber = cell * cellPages + offset;
+            if (offset >= cellPages || pageNumber >= totalPages || !dumpLayout.physical->isPagePresent(pageNumber)) {
+                continue;
+            }
+
+            uint16_t owner = pageOwners.empty() ? NO_OWNER : pageOwners[pageNumber];
+            PageClass pageClass;
+
+            if (owner == PAGE_TABLE_OWNER) {
+                pageClass = PageClass::PageTable;
+            } else {
+                file.seekg(static_cast<std::streamoff>(pageNumber << PAGE_4KB_SHIFT), std::ios::beg);
+                file.read(reinterpret_cast<char *>(page), PAGE_SIZE);
+                size_t size = static_cast<size_t>(file.gcount());
+                file.clear();
+
+                pageClass = classifyPage(page, size);
+                if (pageClass != PageClass::Zero && owner == KERNEL_OWNER) {
+                    pageClass = PageClass::Kernel;
+                } else if (pageClass != PageClass::Zero && owner != NO_OWNER) {
+                    pageClass = PageClass::Process;
+                    cellOwner = owner;
+                }
+            }
+
+            cellCounts[static_cast<size_t>(pageClass)]++;
+        }
+
+        auto dominant = std::max_element(cellCounts.begin() + 1, cellCounts.end());
+        if (*dominant != 0) {
+            classes[cell] = static_cast<uint8_t>(dominant - cellCounts.begin());
+        }
+        owners[cell] = cellOwner;
+    }
+}
+
+void MemoryMap::notify()
+{
+    if (onUpdate) {
+        onUpdate();
+    }
+}
@@ -0,0 +1,93 @@
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dumpformat.h"
+#include "structs.h"
+
+#ifndef DUDEDUMPER_MEMORYMAP_H
+#define DUDEDUMPER_MEMORYMAP_H
+
+#define MEMORY_MAP_WIDTH 256
+#define MEMORY_MAP_CELLS 0x10000
+#define MEMORY_MAP_TILE_ROWS 8
+#define HIGH_ENTROPY_BITS 7.0
+
+enum class PageClass : uint8_t {
+    Unscanned,
+    Zero,
+    PageTable,
+    Process,
+    Kernel,
+    HighEntropy,
+    Data,
+    Count
+};
+
+const char *pageClassName(PageClass pageClass);
+PageClass classifyPage(const uint8_t *page, size_t size);
+
+/*
+ * Downsampled map of the physical memory of a dump: every cell covers pagesPerCell() pages and
+ * holds the class seen most often among the pages sampled in it. Pages missing from the dump aren't
+ * sampled, cells entirely in holes stay Unscanned. The map is refined in passes,
+ * each pass doubles the number of sampled pages per cell, so a coarse picture of the whole dump
+ * is available after the first pass. The passes are computed in tiles of MEMORY_MAP_TILE_ROWS rows
+ * on the global ThreadPool, the cells may be read from any thread while the map is being built.
+ */
+class MemoryMap {
+public:
+    ~MemoryMap();
+
+    bool start(const std::string& path, const std::vector<Process>& processes, size_t cellCount = MEMORY_MAP_CELLS,
+               const DumpLayout& layout = DumpLayout());
+    void cancel();
+    bool isRunning() const;
+
+    size_t width() const;
+    size_t height() const;
+    uint64_t pagesPerCell() const;
+    size_t passesDone() const;
+    size_t passCount() const;
+
+    void snapshot(std::vector<uint8_t>& cellClasses) const;
+    PageClass cellClass(size_t cell) const;
+    int cellOwner(size_t cell) const;
+
+    std::function<void()> onUpdate;
+
+private:
+    static constexpr uint16_t NO_OWNER = 0;
+    static constexpr uint16_t KERNEL_OWNER = 0xffff;
+    static constexpr uint16_t PAGE_TABLE_OWNER = 0xfffe;
+
+    void run(std::string path, std::vector<uint64_t> directoryTableBases);
+    void buildOwners(std::ifstream& file, const std::vector<uint64_t>& directoryTableBases);
+    void scanTile(const std::string& path, size_t tile, size_t pass);
+    void notify();
+
+    DumpLayout dumpLayout;
+    uint64_t totalPages = 0;
+    uint64_t cellPages = 1;
+    size_t cells = 0;
+    size_t rows = 0;
+    size_t passes = 0;
+    int sampleBits = 0;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> cancelled{false};
+    std::atomic<size_t> completedPasses{0};
+
+    std::vector<uint16_t> pageOwners;
+    std::vector<std::array<uint32_t, static_cast<size_t>(PageClass::Count)>> counts;
+    std::unique_ptr<std::atomic<uint8_t>[]> classes;
+    std::unique_ptr<std::atomic<uint16_t>[]> owners;
+};
+
+#endif //DUDEDUMPER_MEMORYMAP_H
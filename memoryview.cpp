@@ -0,0 +1,135 @@
+#include "memoryview.h"
+
+#include "memory.h"
+
+
+/**
+ * @param path: path to the dump
+ * @param cacheBytes: upper bound of the cached dump pages
+ */
+MemoryView::MemoryView(const std::string& path, size_t cacheBytes)
+    : MemoryView(path, std::make_shared<PageCache>(cacheBytes))
+{
+}
+
+/**
+ * @param path: path to the dump
+ * @param cache: page cache shared with the other readers of the dump
+ * @param layout: layout of the dump, opened from the path when it is the default one
+ */
+MemoryView::MemoryView(const std::string& path, std::shared_ptr<PageCache> cache, const DumpLayout& layout)
+    : pageCache(std::move(cache)),
+      dumpLayout(layout.physical ? layout : openDumpLayout(path)),
+      file(path, pageCache, dumpLayout)
+{
+}
+
+bool MemoryView::isOpen() const
+{
+    return file.is_open();
+}
+
+/**
+ * Replace the physical address space of the dump, e.g. once a followed dump grew.
+ *
+ * @param physical: physical address space of the dump
+ */
+void MemoryView::setPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical)
+{
+    dumpLayout.physical = std::move(physical);
+}
+
+/**
+ * Address the physical memory, page numbers are physical addresses shifted by PAGE_4KB_SHIFT.
+ */
+void MemoryView::setPhysical()
+{
+    virtualSpace = false;
+    processDirectoryTableBase = 0;
+}
+
+/**
+ * Address the virtual memory of a process.
+ *
+ * @param directoryTableBase: DirectoryTableBase of the process
+ */
+void MemoryView::setVirtual(uint64_t directoryTableBase)
+{
+    virtualSpace = true;
+    processDirectoryTableBase = directoryTableBase;
+}
+
+bool MemoryView::isVirtual() const
+{
+    return virtualSpace;
+}
+
+uint64_t MemoryView::directoryTableBase() const
+{
+    return processDirectoryTableBase;
+}
+
+/**
+ * @return: highest page number of the current address space
+ */
+uint64_t MemoryView::lastPage() const
+{
+    if (virtualSpace) {
+        return VIRTUAL_SPACE_LAST_PAGE;
+    }
+    uint64_t end = dumpLayout.physical->end();
+    return end == 0 ? 0 : (end - 1) >> PAGE_4KB_SHIFT;
+}
+
+/**
+ * Read a page of the current address space.
+ *
+ * @param pageNumber: address of the page shifted by PAGE_4KB_SHIFT
+ * @param page: buffer of PAGE_SIZE bytes receiving the page
+ * @return: number of valid bytes, 0 if the page isn't mapped or isn't in the dump
+ */
+size_t MemoryView::readPage(uint64_t pageNumber, uint8_t *page)
+{
+    if (!virtualSpace) {
+        return readPhysicalPage(pageNumber, page);
+    }
+
+    uint64_t physicalAddress = translate(pageNumber << PAGE_4KB_SHIFT);
+    if (physicalAddress == 0) {
+        return 0;
+    }
+
+    return readPhysicalPage(physicalAddress >> PAGE_4KB_SHIFT, page);
+}
+
+/**
+ * @param address: address in the current address space
+ * @return: physical address, 0 if the address isn't mapped
+ */
+uint64_t MemoryView::translate(uint64_t address)
+{
+    if (!virtualSpace) {
+        return dumpLayout.physical->isPresent(address) ? address : 0;
+    }
+    return virtualToPhysicalAddress(address, processDirectoryTableBase, file, true);
+}
+
+const PageCache& MemoryView::cache() const
+{
+    return *pageCache;
+}
+
+size_t MemoryView::readPhysicalPage(uint64_t pageNumber, uint8_t *page)
+{
+    if (!dumpLayout.physical->isPagePresent(pageNumber)) {
+        return 0;
+    }
+
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(pageNumber << PAGE_4KB_SHIFT), std::ios::beg);
+    file.read(reinterpret_cast<char *>(page), PAGE_SIZE);
+    size_t size = static_cast<size_t>(file.gcount());
+    file.clear();
+
+    return size;
+}
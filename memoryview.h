@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "pagecache.h"
+#include "physicalspace.h"
+
+#ifndef DUDEDUMPER_MEMORYVIEW_H
+#define DUDEDUMPER_MEMORYVIEW_H
+
+#define MEMORY_VIEW_CACHE_SIZE 0x1000000
+#define VIRTUAL_SPACE_LAST_PAGE 0xfffffffffffff
+
+/*
+ * Page granular access to either the physical memory of a dump or the virtual address space
+ * of one process, for viewers that only ever look at a few pages at a time. All the reads,
+ * page tables included, go through a bounded PageCache. Physical pages missing from the dump
+ * are rejected by the page bitmap of its physical address space without reading.
+ */
+class MemoryView {
+public:
+    explicit MemoryView(const std::string& path, size_t cacheBytes = MEMORY_VIEW_CACHE_SIZE);
+    MemoryView(const std::string& path, std::shared_ptr<PageCache> cache, const DumpLayout& layout = DumpLayout());
+
+    bool isOpen() const;
+    void setPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical);
+    void setPhysical();
+    void setVirtual(uint64_t directoryTableBase);
+    bool isVirtual() const;
+    uint64_t directoryTableBase() const;
+    uint64_t lastPage() const;
+    size_t readPage(uint64_t pageNumber, uint8_t *page);
+    uint64_t translate(uint64_t address);
+    const PageCache& cache() const;
+
+private:
+    size_t readPhysicalPage(uint64_t pageNumber, uint8_t *page);
+
+    std::shared_ptr<PageCache> pageCache;
+    DumpLayout dumpLayout;
+    CachedDumpStream file;
+    bool virtualSpace = false;
+    uint64_t processDirectoryTableBase = 0;
+};
+
+#endif //DUDEDUMPER_MEMORYVIEW_H
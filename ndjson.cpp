@@ -0,0 +1,179 @@
+#include "ndjson.h"
+
+#include <cstdio>
+
+
+/**
+ * @param value: string holding the sequence
+ * @param start: index of the lead byte, at least 0x80
+ * @return: length of the well-formed UTF-8 sequence at start, 0 if it's invalid, overlong, a surrogate
+ * or above U+10FFFF
+ */
+static size_t utf8SequenceLength(const std::string& value, size_t start)
+{
+    auto lead = static_cast<unsigned char>(value[start]);
+    size_t length;
+    uint32_t codePoint, minimum;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+        codePoint = lead & 0x1f;
+        minimum = 0x80;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        codePoint = lead & 0x0f;
+        minimum = 0x800;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        codePoint = lead & 0x07;
+        minimum = 0x10000;
+    } else {
+        return 0;
+    }
+
+    if (value.size() - start < length) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; i++) {
+        auto next = static_cast<unsigned char>(value[start + i]);
+        if ((next & 0xc0) != 0x80) {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3f);
+    }
+
+    if (codePoint < minimum || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+        return 0;
+    }
+    return length;
+}
+
+/**
+ * Well-formed UTF-8 sequences are copied as is. Other bytes from 0x80 on, e.g. ANSI names or junk read
+ * from the dump, are written as \u00XX (their Latin-1 character), so the output stays valid UTF-8.
+ *
+ * @param value: string to quote
+ * @return: value as a quoted JSON string
+ */
+std::string jsonEscape(const std::string& value)
+{
+    std::string escaped = "\"";
+
+    for (size_t i = 0; i < value.size(); i++) {
+        auto c = static_cast<unsigned char>(value[i]);
+        switch (c) {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (c >= 0x80) {
+                    size_t length = utf8SequenceLength(value, i);
+                    if (length != 0) {
+                        escaped.append(value, i, length);
+                        i += length - 1;
+                        break;
+                    }
+                }
+                if (c < 0x20 || c >= 0x7f) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped.push_back(static_cast<char>(c));
+                }
+        }
+    }
+
+    escaped += "\"";
+    return escaped;
+}
+
+/**
+ * @param value: number to format
+ * @return: value as a quoted "0x..." JSON string
+ */
+std::string jsonHex(uint64_t value)
+{
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "\"0x%llx\"", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+/**
+ * @param type: value of the "type" field every record starts with
+ */
+JsonRecord::JsonRecord(const std::string& type)
+    : body("\"type\":" + jsonEscape(type))
+{
+}
+
+JsonRecord& JsonRecord::add(const std::string& key, const std::string& value)
+{
+    return addRaw(key, jsonEscape(value));
+}
+
+JsonRecord& JsonRecord::add(const std::string& key, const char *value)
+{
+    return addRaw(key, jsonEscape(value));
+}
+
+JsonRecord& JsonRecord::add(const std::string& key, uint64_t value)
+{
+    return addRaw(key, std::to_string(value));
+}
+
+JsonRecord& JsonRecord::add(const std::string& key, int64_t value)
+{
+    return addRaw(key, std::to_string(value));
+}
+
+JsonRecord& JsonRecord::add(const std::string& key, double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+    return addRaw(key, buffer);
+}
+
+JsonRecord& JsonRecord::add(const std::string& key, bool value)
+{
+    return addRaw(key, value ? "true" : "false");
+}
+
+JsonRecord& JsonRecord::addHex(const std::string& key, uint64_t value)
+{
+    return addRaw(key, jsonHex(value));
+}
+
+/**
+ * @param key: field name
+ * @param json: already serialized JSON value
+ * @return: this record
+ */
+JsonRecord& JsonRecord::addRaw(const std::string& key, const std::string& json)
+{
+    body += "," + jsonEscape(key) + ":" + json;
+    return *this;
+}
+
+/**
+ * @return: the record as a JSON object
+ */
+std::string JsonRecord::str() const
+{
+    return "{" + body + "}";
+}
+
+NdjsonWriter::NdjsonWriter(std::ostream& stream)
+    : stream(stream)
+{
+}
+
+void NdjsonWriter::write(const JsonRecord& record)
+{
+    std::string line = record.str();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stream << line << '\n';
+    stream.flush();
+}
@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#ifndef DUDEDUMPER_NDJSON_H
+#define DUDEDUMPER_NDJSON_H
+
+/*
+ * Single JSON object, built field by field. Addresses are written as hex strings
+ * because JSON numbers can't hold 64-bit values exactly.
+ */
+class JsonRecord {
+public:
+    explicit JsonRecord(const std::string& type);
+
+    JsonRecord& add(const std::string& key, const std::string& value);
+    JsonRecord& add(const std::string& key, const char *value);
+    JsonRecord& add(const std::string& key, uint64_t value);
+    JsonRecord& add(const std::string& key, int64_t value);
+    JsonRecord& add(const std::string& key, double value);
+    JsonRecord& add(const std::string& key, bool value);
+    JsonRecord& addHex(const std::string& key, uint64_t value);
+    JsonRecord& addRaw(const std::string& key, const std::string& json);
+
+    std::string str() const;
+
+private:
+    std::string body;
+};
+
+/*
+ * Writes one record per line and flushes it, so consumers see results as they are produced.
+ * Safe to use from several threads.
+ */
+class NdjsonWriter {
+public:
+    explicit NdjsonWriter(std::ostream& stream);
+
+    void write(const JsonRecord& record);
+
+private:
+    std::ostream& stream;
+    std::mutex mutex;
+};
+
+std::string jsonEscape(const std::string& value);
+std::string jsonHex(uint64_t value);
+
+#endif //DUDEDUMPER_NDJSON_H
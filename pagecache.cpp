@@ -0,0 +1,451 @@
+#include "pagecache.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+/**
+ * @param capacityBytes: upper bound of the memory used by all the caches attached to the budget
+ */
+CacheBudget::CacheBudget(size_t capacityBytes)
+    : capacityBytes(capacityBytes)
+{
+}
+
+/**
+ * Account one more page, evicting pages of the largest caches first if the budget is exhausted.
+ * Must not be called while holding a shard lock.
+ */
+void CacheBudget::reserve()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    while (usedBytes + PAGE_SIZE > capacityBytes) {
+        PageCache *largest = nullptr;
+        for (PageCache *cache : caches) {
+            if (largest == nullptr || cache->size() > largest->size()) {
+                largest = cache;
+            }
+        }
+
+        if (largest == nullptr || !largest->evictOne()) {
+            break;
+        }
+    }
+    usedBytes += PAGE_SIZE;
+}
+
+size_t CacheBudget::capacity() const
+{
+    return capacityBytes;
+}
+
+/**
+ * @return: bytes held by all the attached caches
+ */
+size_t CacheBudget::used() const
+{
+    return usedBytes;
+}
+
+void CacheBudget::attach(PageCache *cache)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    caches.push_back(cache);
+}
+
+/**
+ * Give back a page reserved but not allocated, e.g. when another reader cached it first.
+ * Doesn't take the budget lock, so it can be called while holding a shard lock.
+ */
+void CacheBudget::release()
+{
+    usedBytes -= PAGE_SIZE;
+}
+
+void CacheBudget::detach(PageCache *cache)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    caches.erase(std::remove(caches.begin(), caches.end(), cache), caches.end());
+    usedBytes -= cache->size() * PAGE_SIZE;
+}
+
+/**
+ * @param capacityBytes: upper bound of the cached data, 0 disables caching
+ * @param budget: budget shared with other caches, the cache holds at most the smaller of both
+ */
+PageCache::PageCache(size_t capacityBytes, std::shared_ptr<CacheBudget> budget)
+    : capacityPages(capacityBytes / PAGE_SIZE),
+      shardCapacityPages((capacityBytes / PAGE_SIZE + PAGE_CACHE_SHARDS - 1) / PAGE_CACHE_SHARDS),
+      budget(std::move(budget))
+{
+    if (this->budget) {
+        this->budget->attach(this);
+    }
+}
+
+PageCache::~PageCache()
+{
+    if (budget) {
+        budget->detach(this);
+    }
+}
+
+/**
+ * Copy a page out of the cache, loading it on a miss. The loader runs without holding any lock.
+ *
+ * @param pageNumber: physical address of the page shifted by PAGE_4KB_SHIFT
+ * @param page: buffer of PAGE_SIZE bytes receiving the page
+ * @param loader: reads the page on a miss and returns the number of valid bytes
+ * @return: number of valid bytes in the page, less than PAGE_SIZE at the end of the file
+ */
+size_t PageCache::readPage(uint64_t pageNumber, uint8_t *page, const PageLoader& loader)
+{
+    if (capacityPages == 0) {
+        missCount++;
+        return loader(pageNumber, page);
+    }
+
+    Shard& shard = shards[pageNumber % PAGE_CACHE_SHARDS];
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(pageNumber);
+        if (found != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+            std::memcpy(page, found->second->data.get(), found->second->size);
+            hitCount++;
+            return found->second->size;
+        }
+    }
+
+    missCount++;
+    size_t size = loader(pageNumber, page);
+    // A short page is the end of the file, which may still be growing
+    if (size < PAGE_SIZE) {
+        return size;
+    }
+
+    // Only a new page is reserved in the budget, a full shard recycles its least recently used one
+    bool reserved = false;
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (budget && shard.lru.size() < shardCapacityPages && !shard.index.contains(pageNumber)) {
+        lock.unlock();
+        budget->reserve();
+        reserved = true;
+        lock.lock();
+    }
+
+    // The shard may have changed while reserving
+    bool cached = shard.index.contains(pageNumber);
+    bool allocate = !cached && shard.lru.size() < shardCapacityPages;
+    if (reserved && !allocate) {
+        budget->release();
+    }
+    if (cached) {
+        return size;
+    }
+
+    Entry entry{pageNumber, size, nullptr};
+    if (allocate) {
+        entry.data = std::make_unique<uint8_t[]>(PAGE_SIZE);
+        cachedPages++;
+    } else {
+        entry.data = std::move(shard.lru.back().data);
+        shard.index.erase(shard.lru.back().pageNumber);
+        shard.lru.pop_back();
+    }
+
+    std::memcpy(entry.data.get(), page, size);
+    shard.lru.push_front(std::move(entry));
+    shard.index[pageNumber] = shard.lru.begin();
+
+    return size;
+}
+
+/**
+ * @return: capacity of the cache in bytes
+ */
+size_t PageCache::capacity() const
+{
+    return capacityPages * PAGE_SIZE;
+}
+
+/**
+ * @return: number of cached pages
+ */
+size_t PageCache::size() const
+{
+    return cachedPages;
+}
+
+/**
+ * Drop the least recently used page of the next non-empty shard, called by the budget.
+ *
+ * @return: false if the cache is empty
+ */
+bool PageCache::evictOne()
+{
+    for (size_t i = 0; i < PAGE_CACHE_SHARDS; i++) {
+        Shard& shard = shards[nextEviction++ % PAGE_CACHE_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.lru.empty()) {
+            continue;
+        }
+
+        shard.index.erase(shard.lru.back().pageNumber);
+        shard.lru.pop_back();
+        cachedPages--;
+        budget->usedBytes -= PAGE_SIZE;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @return: number of pages served from the cache
+ */
+uint64_t PageCache::hits() const
+{
+    return hitCount;
+}
+
+/**
+ * @return: number of pages which had to be loaded
+ */
+uint64_t PageCache::misses() const
+{
+    return missCount;
+}
+
+/**
+ * @param file: opened file buffer the pages are loaded from
+ * @param cache: cache shared with the other streams of the same file
+ * @param layout: where the physical memory is stored in the file
+ */
+CachedFileBuf::CachedFileBuf(std::filebuf *file, std::shared_ptr<PageCache> cache, const DumpLayout& layout)
+    : file(file), cache(std::move(cache)), runs(layout.runs),
+      mappings(runs ? layout.mappings : std::vector<std::shared_ptr<const MappedFile>>()),
+      compressed(layout.compressed)
+{
+    setg(nullptr, nullptr, nullptr);
+}
+
+/**
+ * Make the page holding the current position the get area.
+ *
+ * @return: character at the current position, eof past the end of the file
+ */
+CachedFileBuf::int_type CachedFileBuf::underflow()
+{
+    if (gptr() != nullptr && gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    uint64_t current = currentPosition();
+    if (!mappings.empty()) {
+        return mapRun(current);
+    }
+    if (compressed) {
+        return loadBlock(current);
+    }
+
+    uint64_t pageNumber = current >> PAGE_4KB_SHIFT;
+
+    size_t size = cache->readPage(pageNumber, reinterpret_cast<uint8_t *>(page), [this](uint64_t number, uint8_t *data) {
+        return static_cast<size_t>(readFile(number << PAGE_4KB_SHIFT, reinterpret_cast<char *>(data), PAGE_SIZE));
+    });
+
+    size_t pageOffset = PAGE_4KB_OFFSET(current);
+    if (pageOffset >= size) {
+        setg(nullptr, nullptr, nullptr);
+        position = current;
+        return traits_type::eof();
+    }
+
+    pageBase = pageNumber << PAGE_4KB_SHIFT;
+    setg(page, page + pageOffset, page + size);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/**
+ * Read through the cache, or straight from the file for large reads.
+ *
+ * @param buffer: buffer to store the read data
+ * @param size: number of bytes to read
+ * @return: number of bytes read
+ */
+std::streamsize CachedFileBuf::xsgetn(char *buffer, std::streamsize size)
+{
+    if (size < PAGE_CACHE_BYPASS_SIZE || !mappings.empty() || compressed) {
+        return std::streambuf::xsgetn(buffer, size);
+    }
+
+    uint64_t current = currentPosition();
+    setg(nullptr, nullptr, nullptr);
+
+    std::streamsize read = readFile(current, buffer, size);
+    position = current + read;
+
+    return read;
+}
+
+CachedFileBuf::pos_type CachedFileBuf::seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which)
+{
+    off_type base = 0;
+
+    if (direction == std::ios::cur) {
+        base = static_cast<off_type>(currentPosition());
+    } else if (direction == std::ios::end && runs) {
+        base = static_cast<off_type>(runs->end());
+    } else if (direction == std::ios::end && compressed) {
+        base = static_cast<off_type>(compressed->size());
+    } else if (direction == std::ios::end) {
+        base = file->pubseekoff(0, std::ios::end, std::ios::in);
+        if (base < 0) {
+            return pos_type(off_type(-1));
+        }
+    }
+
+    return seekpos(pos_type(base + offset), which);
+}
+
+CachedFileBuf::pos_type CachedFileBuf::seekpos(pos_type target, std::ios::openmode which)
+{
+    if (!(which & std::ios::in) || off_type(target) < 0) {
+        return pos_type(off_type(-1));
+    }
+
+    uint64_t absolute = static_cast<uint64_t>(off_type(target));
+
+    if (gptr() != nullptr && absolute >= pageBase && absolute < pageBase + (egptr() - eback())) {
+        setg(eback(), eback() + (absolute - pageBase), egptr());
+    } else {
+        setg(nullptr, nullptr, nullptr);
+        position = absolute;
+    }
+
+    return target;
+}
+
+uint64_t CachedFileBuf::currentPosition() const
+{
+    if (gptr() != nullptr) {
+        return pageBase + (gptr() - eback());
+    }
+    return position;
+}
+
+/**
+ * Read from the file, run by run for dumps with a run table. Reads stop at the first hole.
+ *
+ * @param physicalAddress: physical address to read from
+ * @param buffer: buffer to store the read data
+ * @param size: number of bytes to read
+ * @return: number of bytes read
+ */
+std::streamsize CachedFileBuf::readFile(uint64_t physicalAddress, char *buffer, std::streamsize size)
+{
+    if (!runs) {
+        if (file->pubseekpos(static_cast<off_type>(physicalAddress), std::ios::in) == pos_type(off_type(-1))) {
+            return 0;
+        }
+        return std::max<std::streamsize>(file->sgetn(buffer, size), 0);
+    }
+
+    std::streamsize done = 0;
+    while (done < size) {
+        uint64_t fileOffset, available;
+        if (!runs->locate(physicalAddress + done, fileOffset, available)
+            || file->pubseekpos(static_cast<off_type>(fileOffset), std::ios::in) == pos_type(off_type(-1))) {
+            break;
+        }
+
+        std::streamsize chunk = static_cast<std::streamsize>(std::min<uint64_t>(available, size - done));
+        std::streamsize read = std::max<std::streamsize>(file->sgetn(buffer + done, chunk), 0);
+        done += read;
+        if (read < chunk) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * Make the rest of the run holding the address the get area, reads of a run copy straight out of the mapping.
+ *
+ * @param physicalAddress: physical address to read from
+ * @return: character at the address, eof in holes and past the end of the file
+ */
+CachedFileBuf::int_type CachedFileBuf::mapRun(uint64_t physicalAddress)
+{
+    uint64_t fileOffset, available;
+    uint32_t source;
+    if (!runs->locate(physicalAddress, fileOffset, available, &source) || source >= mappings.size()
+        || fileOffset >= mappings[source]->size()) {
+        setg(nullptr, nullptr, nullptr);
+        position = physicalAddress;
+        return traits_type::eof();
+    }
+
+    const MappedFile& mapping = *mappings[source];
+    available = std::min(available, mapping.size() - fileOffset);
+    // The get area is never written to
+    char *run = const_cast<char *>(reinterpret_cast<const char *>(mapping.data() + fileOffset));
+    pageBase = physicalAddress;
+    setg(run, run, run + available);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/**
+ * Make the rest of the decompressed block holding the address the get area, up to the end of its run
+ * for dumps with a run table.
+ *
+ * @param physicalAddress: physical address to read from
+ * @return: character at the address, eof in holes and past the end of the dump
+ */
+CachedFileBuf::int_type CachedFileBuf::loadBlock(uint64_t physicalAddress)
+{
+    uint64_t offset = physicalAddress;
+    uint64_t available = UINT64_MAX;
+    if (runs && !runs->locate(physicalAddress, offset, available)) {
+        setg(nullptr, nullptr, nullptr);
+        position = physicalAddress;
+        return traits_type::eof();
+    }
+
+    uint64_t index = offset / compressed->blockSize();
+    uint64_t blockOffset = offset - index * compressed->blockSize();
+    DecompressedBlock block = compressed->block(index);
+    if (!block || blockOffset >= block->size()) {
+        setg(nullptr, nullptr, nullptr);
+        position = physicalAddress;
+        return traits_type::eof();
+    }
+
+    // The block may be evicted from the dump's cache, keep it alive while it is the get area
+    currentBlock = block;
+    char *data = const_cast<char *>(reinterpret_cast<const char *>(block->data())) + blockOffset;
+    pageBase = physicalAddress;
+    setg(data, data, data + std::min<uint64_t>(block->size() - blockOffset, available));
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/**
+ * Open the dump and route all the reads through the cache.
+ *
+ * @param path: path to the dump
+ * @param cache: cache shared with the other streams of the same dump
+ * @param layout: layout of the dump, from openDumpLayout
+ */
+CachedDumpStream::CachedDumpStream(const std::string& path, std::shared_ptr<PageCache> cache, const DumpLayout& layout)
+    : std::ifstream(path, std::ios::binary),
+      cachedBuffer(std::ifstream::rdbuf(), std::move(cache), layout)
+{
+    std::ios::rdbuf(&cachedBuffer);
+}
@@ -0,0 +1,143 @@
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compresseddump.h"
+#include "dumpformat.h"
+#include "structs.h"
+
+#ifndef DUDEDUMPER_PAGECACHE_H
+#define DUDEDUMPER_PAGECACHE_H
+
+#define PAGE_CACHE_SHARDS 16
+#define PAGE_CACHE_BYPASS_SIZE 0x10000
+
+class PageCache;
+
+/*
+ * Memory budget shared by several PageCaches, e.g. the caches of all the dumps opened at the same time.
+ * A cache about to allocate a page first reserves it, making room in the budget by evicting the least
+ * recently used page of the largest cache. Caches recycling their own pages don't reserve anything.
+ */
+class CacheBudget {
+public:
+    explicit CacheBudget(size_t capacityBytes);
+
+    void reserve();
+    size_t capacity() const;
+    size_t used() const;
+
+private:
+    friend class PageCache;
+
+    void attach(PageCache *cache);
+    void detach(PageCache *cache);
+    void release();
+
+    std::mutex mutex;
+    std::vector<PageCache *> caches;
+    size_t capacityBytes;
+    std::atomic<size_t> usedBytes{0};
+};
+
+/*
+ * Bounded LRU cache of PAGE_SIZE pages of one dump. It is split into shards with their own lock,
+ * so it can be shared by all the streams reading the same dump from different threads.
+ */
+class PageCache {
+public:
+    using PageLoader = std::function<size_t(uint64_t pageNumber, uint8_t *page)>;
+
+    explicit PageCache(size_t capacityBytes, std::shared_ptr<CacheBudget> budget = nullptr);
+    ~PageCache();
+
+    size_t readPage(uint64_t pageNumber, uint8_t *page, const PageLoader& loader);
+    size_t capacity() const;
+    size_t size() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Entry {
+        uint64_t pageNumber;
+        size_t size;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    };
+
+    friend class CacheBudget;
+
+    bool evictOne();
+
+    size_t capacityPages;
+    size_t shardCapacityPages;
+    std::array<Shard, PAGE_CACHE_SHARDS> shards;
+    std::shared_ptr<CacheBudget> budget;
+    std::atomic<size_t> cachedPages{0};
+    std::atomic<size_t> nextEviction{0};
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+};
+
+/*
+ * Stream buffer serving small reads of a file through a PageCache.
+ * Reads of PAGE_CACHE_BYPASS_SIZE bytes or more go straight to the file.
+ * Positions are physical addresses, mapped to file offsets by the run table of the dump if it has one.
+ * Mapped dumps bypass the cache: the get area is the run itself, inside the mapping of its file,
+ * so reads spanning several files copy straight out of each mapping.
+ * Compressed dumps do too: the get area is the decompressed block, held until the next one is loaded.
+ */
+class CachedFileBuf : public std::streambuf {
+public:
+    CachedFileBuf(std::filebuf *file, std::shared_ptr<PageCache> cache, const DumpLayout& layout = DumpLayout());
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char *buffer, std::streamsize size) override;
+    pos_type seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which) override;
+    pos_type seekpos(pos_type position, std::ios::openmode which) override;
+
+private:
+    uint64_t currentPosition() const;
+    std::streamsize readFile(uint64_t physicalAddress, char *buffer, std::streamsize size);
+    int_type mapRun(uint64_t physicalAddress);
+    int_type loadBlock(uint64_t physicalAddress);
+
+    std::filebuf *file;
+    std::shared_ptr<PageCache> cache;
+    std::shared_ptr<const RunTable> runs;
+    std::vector<std::shared_ptr<const MappedFile>> mappings;
+    std::shared_ptr<BlockCompressedDump> compressed;
+    DecompressedBlock currentBlock;
+    uint64_t pageBase = 0;
+    uint64_t position = 0;
+    char page[PAGE_SIZE];
+};
+
+/*
+ * std::ifstream whose reads go through a shared PageCache, so it can be passed
+ * to every function in memory.h unchanged.
+ */
+class CachedDumpStream : public std::ifstream {
+public:
+    CachedDumpStream(const std::string& path, std::shared_ptr<PageCache> cache, const DumpLayout& layout = DumpLayout());
+
+private:
+    CachedFileBuf cachedBuffer;
+};
+
+#endif //DUDEDUMPER_PAGECACHE_H
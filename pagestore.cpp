@@ -0,0 +1,356 @@
+#include "pagestore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "pagecache.h"
+#include "physicalspace.h"
+
+
+/*
+ * The digests are BLAKE3, their first bytes are as good as any hash of them.
+ */
+struct DigestHash {
+    size_t operator()(const Digest& digest) const
+    {
+        size_t hash;
+        std::memcpy(&hash, digest.data(), sizeof(size_t));
+        return hash;
+    }
+};
+
+/**
+ * @param file: file stream
+ * @return: true if the file starts with the magic of a page index
+ */
+bool isPageIndex(std::istream& file)
+{
+    char magic[PAGE_INDEX_MAGIC_SIZE];
+    file.clear();
+    file.seekg(0, std::ios::beg);
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, PAGE_INDEX_MAGIC, PAGE_INDEX_MAGIC_SIZE) == 0;
+}
+
+/**
+ * Map the pack of the store holding a page index, each run of the index is a run of the pack.
+ *
+ * @param path: path to the page index
+ * @param runs: receives the runs of the dump, finalized, their file offsets are offsets in the pack
+ * @param mappings: receives the mapping of the pack
+ * @param header: receives the header of the index
+ * @return: true if the index is valid and every run is in the pack, false otherwise
+ */
+bool openPageIndex(const std::string& path, RunTable& runs, std::vector<std::shared_ptr<const MappedFile>>& mappings,
+                   PageIndexHeader& header)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, PAGE_INDEX_MAGIC, PAGE_INDEX_MAGIC_SIZE) != 0
+        || header.version != PAGE_INDEX_VERSION || header.pageSize != PAGE_SIZE) {
+        std::cerr << "Invalid page index: " << path << "\n";
+        return false;
+    }
+
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (error || header.runCount > (fileSize - sizeof(header)) / sizeof(PageIndexRun)) {
+        std::cerr << "Truncated page index: " << path << "\n";
+        return false;
+    }
+
+    std::vector<PageIndexRun> indexRuns(header.runCount);
+    if (!file.read(reinterpret_cast<char *>(indexRuns.data()),
+                   static_cast<std::streamsize>(indexRuns.size() * sizeof(PageIndexRun)))) {
+        std::cerr << "Truncated page index: " << path << "\n";
+        return false;
+    }
+
+    std::string packPath = (std::filesystem::path(path).parent_path() / PAGE_STORE_PACK).string();
+    auto pack = std::make_shared<MappedFile>(packPath);
+    if (!pack->isOpen()) {
+        std::cerr << "Failed to map the pack of " << path << "\n";
+        return false;
+    }
+
+    uint64_t packPages = pack->size() / PAGE_SIZE;
+    for (const PageIndexRun& run : indexRuns) {
+        if (run.packPage > packPages || run.pageCount > packPages - run.packPage) {
+            std::cerr << "Page index " << path << " refers to pages past the end of " << packPath << "\n";
+            return false;
+        }
+        runs.add(run.physicalPage << PAGE_4KB_SHIFT, run.pageCount << PAGE_4KB_SHIFT, run.packPage << PAGE_4KB_SHIFT);
+    }
+    runs.finalize();
+    mappings.push_back(pack);
+
+    return true;
+}
+
+/**
+ * Read the digests of the pages of the pack, in pack order. An ingest interrupted before writing its
+ * index may leave a pack and a digest file of different lengths, both are cut to the pages they agree on:
+ * no index refers to the pages past them.
+ *
+ * @param packPath: path to the pack
+ * @param digestsPath: path to the digests of the pack
+ * @param digests: receives the digests
+ * @return: true if the digests were read, false otherwise
+ */
+static bool loadPackDigests(const std::string& packPath, const std::string& digestsPath, std::vector<Digest>& digests)
+{
+    auto fileSize = [](const std::string& path) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(path, error);
+        return error ? 0 : size;
+    };
+    uint64_t packBytes = fileSize(packPath);
+    uint64_t digestBytes = fileSize(digestsPath);
+
+    uint64_t pages = std::min<uint64_t>(packBytes / PAGE_SIZE, digestBytes / sizeof(Digest));
+    std::error_code error;
+    if (packBytes != pages * PAGE_SIZE) {
+        std::filesystem::resize_file(packPath, pages * PAGE_SIZE, error);
+    }
+    if (!error && digestBytes != pages * sizeof(Digest)) {
+        std::filesystem::resize_file(digestsPath, pages * sizeof(Digest), error);
+    }
+    if (error) {
+        std::cerr << "Failed to repair the page store: " << error.message() << "\n";
+        return false;
+    }
+
+    digests.resize(pages);
+    std::ifstream file(digestsPath, std::ios::binary);
+    if (pages != 0 && !file.read(reinterpret_cast<char *>(digests.data()), static_cast<std::streamsize>(pages * sizeof(Digest)))) {
+        std::cerr << "Failed to read " << digestsPath << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Read the pages of a batch the dump holds, a span of present pages at a time. Pages that fail to read
+ * are marked missing, the part of a page past the end of the dump reads as zeros.
+ */
+static void readBatch(std::ifstream& input, uint64_t firstPage, size_t count, uint64_t dumpSize,
+                      std::vector<char>& batch, std::vector<uint8_t>& present)
+{
+    size_t i = 0;
+    while (i < count) {
+        if (!present[i]) {
+            i++;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < count && present[end]) {
+            end++;
+        }
+
+        uint64_t offset = (firstPage + i) << PAGE_4KB_SHIFT;
+        uint64_t size = std::min<uint64_t>((end - i) * PAGE_SIZE, dumpSize - offset);
+        std::memset(batch.data() + i * PAGE_SIZE + size, 0, (end - i) * PAGE_SIZE - size);
+        input.clear();
+        input.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        if (!input.read(&batch[i * PAGE_SIZE], static_cast<std::streamsize>(size))) {
+            for (size_t page = i; page < end; page++) {
+                uint64_t pageSize = std::min<uint64_t>(PAGE_SIZE, dumpSize - ((firstPage + page) << PAGE_4KB_SHIFT));
+                input.clear();
+                input.seekg(static_cast<std::streamoff>((firstPage + page) << PAGE_4KB_SHIFT), std::ios::beg);
+                present[page] = static_cast<bool>(input.read(&batch[page * PAGE_SIZE], static_cast<std::streamsize>(pageSize)));
+            }
+        }
+
+        i = end;
+    }
+}
+
+/**
+ * Append a page to the runs of an index, merged with the last run when it continues it in memory and in the pack.
+ */
+static void appendIndexPage(std::vector<PageIndexRun>& runs, uint64_t physicalPage, uint64_t packPage)
+{
+    if (!runs.empty()) {
+        PageIndexRun& last = runs.back();
+        if (last.physicalPage + last.pageCount == physicalPage && last.packPage + last.pageCount == packPage) {
+            last.pageCount++;
+            return;
+        }
+    }
+
+    runs.push_back(PageIndexRun{physicalPage, 1, packPage});
+}
+
+/**
+ * @param name: name of a dump in the store
+ * @return: true if the name is a plain file name, its index can't land outside the store
+ */
+static bool isValidDumpName(const std::string& name)
+{
+    std::filesystem::path path(name);
+    return !name.empty() && name != "." && name != ".." && name.find_first_of("/\\") == std::string::npos
+           && !path.has_root_path() && path.filename() == path;
+}
+
+/**
+ * Add a dump to a page store. The dump is read in batches of pages which are hashed in parallel, the pages
+ * missing from the pack are appended to it in order, and the index mapping the pages of the dump to
+ * the pack is written once the pack holds all of them. Holes of the dump stay holes.
+ * A store must only be written by one ingest at a time.
+ *
+ * @param inputPath: path to the dump, in any supported format
+ * @param storeDirectory: directory of the store, created if needed
+ * @param name: name of the dump in the store, its index is name.ddpages. Names holding a directory are refused
+ * @param summary: receives the path of the index and the page counts
+ * @param pool: pool the pages are hashed on
+ * @param progress: optional token, totalBytes is the size of the dump
+ * @return: true if the dump was stored, false otherwise
+ */
+bool ingestDump(const std::string& inputPath, const std::string& storeDirectory, const std::string& name,
+                IngestSummary& summary, ThreadPool& pool, AnalysisProgress *progress)
+{
+    if (!isValidDumpName(name)) {
+        std::cerr << "Invalid dump name, it must be a file name: " << name << "\n";
+        return false;
+    }
+
+    DumpLayout layout = openDumpLayout(inputPath);
+    CachedDumpStream input(inputPath, std::make_shared<PageCache>(0), layout);
+    if (!input.is_open()) {
+        std::cerr << "Failed to open file: " << inputPath << "\n";
+        return false;
+    }
+
+    input.seekg(0, std::ios::end);
+    std::streamoff end = input.tellg();
+    if (end <= 0) {
+        std::cerr << "Empty dump: " << inputPath << "\n";
+        return false;
+    }
+    uint64_t dumpSize = static_cast<uint64_t>(end);
+    uint64_t dumpPages = (dumpSize + PAGE_SIZE - 1) >> PAGE_4KB_SHIFT;
+
+    std::error_code error;
+    std::filesystem::create_directories(storeDirectory, error);
+    std::filesystem::path directory(storeDirectory);
+    std::string packPath = (directory / PAGE_STORE_PACK).string();
+    std::string digestsPath = (directory / PAGE_STORE_DIGESTS).string();
+
+    std::vector<Digest> digests;
+    if (!loadPackDigests(packPath, digestsPath, digests)) {
+        return false;
+    }
+    std::unordered_map<Digest, uint64_t, DigestHash> packIndex;
+    packIndex.reserve(digests.size());
+    for (uint64_t page = 0; page < digests.size(); page++) {
+        packIndex.emplace(digests[page], page);
+    }
+    uint64_t packPages = digests.size();
+
+    std::ofstream pack(packPath, std::ios::binary | std::ios::app);
+    std::ofstream digestFile(digestsPath, std::ios::binary | std::ios::app);
+    if (!pack.is_open() || !digestFile.is_open()) {
+        std::cerr << "Failed to write the page store " << storeDirectory << "\n";
+        return false;
+    }
+
+    if (progress != nullptr) {
+        progress->totalBytes = dumpSize;
+    }
+
+    std::vector<PageIndexRun> runs;
+    std::vector<char> batch(PAGE_STORE_BATCH_PAGES * PAGE_SIZE);
+    std::vector<uint8_t> present(PAGE_STORE_BATCH_PAGES);
+    std::vector<Digest> pageDigests(PAGE_STORE_BATCH_PAGES);
+    std::vector<char> newPages;
+    std::vector<Digest> newDigests;
+    summary.newPages = 0;
+
+    for (uint64_t first = 0; first < dumpPages; first += PAGE_STORE_BATCH_PAGES) {
+        if (progress != nullptr && progress->cancelled) {
+            return false;
+        }
+
+        size_t count = std::min<uint64_t>(PAGE_STORE_BATCH_PAGES, dumpPages - first);
+        for (size_t i = 0; i < count; i++) {
+            present[i] = layout.physical->isPagePresent(first + i);
+        }
+        readBatch(input, first, count, dumpSize, batch, present);
+
+        pool.parallelFor(count, [&](size_t i) {
+            if (present[i]) {
+                pageDigests[i] = blake3Digest(&batch[i * PAGE_SIZE], PAGE_SIZE);
+            }
+        });
+
+        // Pages repeated within the batch are found too, the pack index is updated in page order
+        newPages.clear();
+        newDigests.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (!present[i]) {
+                continue;
+            }
+
+            auto [entry, inserted] = packIndex.try_emplace(pageDigests[i], packPages);
+            if (inserted) {
+                newPages.insert(newPages.end(), &batch[i * PAGE_SIZE], &batch[(i + 1) * PAGE_SIZE]);
+                newDigests.push_back(pageDigests[i]);
+                packPages++;
+            }
+            appendIndexPage(runs, first + i, entry->second);
+        }
+
+        pack.write(newPages.data(), static_cast<std::streamsize>(newPages.size()));
+        digestFile.write(reinterpret_cast<const char *>(newDigests.data()),
+                         static_cast<std::streamsize>(newDigests.size() * sizeof(Digest)));
+        summary.newPages += newDigests.size();
+
+        if (progress != nullptr) {
+            progress->bytesScanned += count * PAGE_SIZE;
+        }
+    }
+
+    // The pages go to disk before the index refers to them
+    pack.flush();
+    digestFile.flush();
+    if (!pack.good() || !digestFile.good()) {
+        std::cerr << "Failed to write the page store " << storeDirectory << "\n";
+        return false;
+    }
+
+    PageIndexHeader header{};
+    std::memcpy(header.magic, PAGE_INDEX_MAGIC, PAGE_INDEX_MAGIC_SIZE);
+    header.version = PAGE_INDEX_VERSION;
+    header.pageSize = PAGE_SIZE;
+    header.runCount = runs.size();
+    header.dumpPages = dumpPages;
+    header.directoryTableBase = layout.directoryTableBase;
+    header.activeProcessHead = layout.activeProcessHead;
+
+    // Written aside and renamed, a dump is either fully stored or not at all
+    std::string indexPath = (directory / (name + PAGE_INDEX_EXTENSION)).string();
+    std::string partialPath = indexPath + ".partial";
+    std::ofstream index(partialPath, std::ios::binary | std::ios::trunc);
+    index.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    index.write(reinterpret_cast<const char *>(runs.data()), static_cast<std::streamsize>(runs.size() * sizeof(PageIndexRun)));
+    index.close();
+    if (!index.good()) {
+        std::cerr << "Failed to write " << partialPath << "\n";
+        return false;
+    }
+    std::filesystem::rename(partialPath, indexPath, error);
+    if (error) {
+        std::cerr << "Failed to write " << indexPath << ": " << error.message() << "\n";
+        return false;
+    }
+
+    summary.indexPath = indexPath;
+    summary.dumpPages = dumpPages;
+    summary.packPages = packPages;
+    return true;
+}
@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dumpformat.h"
+#include "hashing.h"
+#include "mappedfile.h"
+#include "memory.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_PAGESTORE_H
+#define DUDEDUMPER_PAGESTORE_H
+
+// Files of a page store directory, the page indexes of the dumps sit next to them
+#define PAGE_STORE_PACK "pages.pack"
+#define PAGE_STORE_DIGESTS "pages.digests"
+#define PAGE_INDEX_EXTENSION ".ddpages"
+#define PAGE_INDEX_MAGIC "DDPAGES1"
+#define PAGE_INDEX_MAGIC_SIZE 8
+#define PAGE_INDEX_VERSION 1
+#define PAGE_STORE_BATCH_PAGES 0x1000
+
+/*
+ * First bytes of a page index. The runs follow it, the dump fields are the ones its format recorded.
+ */
+struct PageIndexHeader {
+    char magic[PAGE_INDEX_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t pageSize;
+    uint64_t runCount;
+    uint64_t dumpPages;
+    uint64_t directoryTableBase;
+    uint64_t activeProcessHead;
+};
+
+/*
+ * pageCount physical pages from physicalPage, stored one after the other in the pack from packPage.
+ */
+struct PageIndexRun {
+    uint64_t physicalPage;
+    uint64_t pageCount;
+    uint64_t packPage;
+};
+
+struct IngestSummary {
+    std::string indexPath;
+    uint64_t dumpPages = 0;
+    uint64_t newPages = 0;
+    uint64_t packPages = 0;
+};
+
+bool isPageIndex(std::istream& file);
+bool openPageIndex(const std::string& path, RunTable& runs, std::vector<std::shared_ptr<const MappedFile>>& mappings,
+                   PageIndexHeader& header);
+bool ingestDump(const std::string& inputPath, const std::string& storeDirectory, const std::string& name,
+                IngestSummary& summary, ThreadPool& pool = ThreadPool::global(), AnalysisProgress *progress = nullptr);
+
+#endif //DUDEDUMPER_PAGESTORE_H
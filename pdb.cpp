@@ -0,0 +1,606 @@
+#include "pdb.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+#define PDB_DBI_STREAM 3
+#define MSF_MAX_STREAMS 0x100000
+
+#define LF_FIELDLIST 0x1203
+#define LF_BCLASS 0x1400
+#define LF_INDEX 0x1404
+#define LF_VFUNCTAB 0x1409
+#define LF_ENUMERATE 0x1502
+#define LF_CLASS 0x1504
+#define LF_STRUCTURE 0x1505
+#define LF_UNION 0x1506
+#define LF_MEMBER 0x150d
+#define LF_STMEMBER 0x150e
+#define LF_METHOD 0x150f
+#define LF_NESTTYPE 0x1510
+#define LF_ONEMETHOD 0x1511
+
+#define LF_NUMERIC 0x8000
+#define LF_CHAR 0x8000
+#define LF_SHORT 0x8001
+#define LF_USHORT 0x8002
+#define LF_LONG 0x8003
+#define LF_ULONG 0x8004
+#define LF_QUADWORD 0x8009
+#define LF_UQUADWORD 0x800a
+
+#define CV_PROP_FWDREF 0x80
+#define CV_PROP_HASUNIQUENAME 0x200
+
+struct MsfSuperBlock {
+    char magic[MSF_MAGIC_SIZE];
+    uint32_t blockSize;
+    uint32_t freeBlockMapBlock;
+    uint32_t numBlocks;
+    uint32_t numDirectoryBytes;
+    uint32_t unknown;
+    uint32_t blockMapAddress;
+};
+
+struct TpiHeader {
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t typeIndexBegin;
+    uint32_t typeIndexEnd;
+    uint32_t typeRecordBytes;
+};
+
+/**
+ * @return: GUID and age as written in symbol server paths, e.g. 3844DBB920174967BE7AA4A2C20430FA1
+ */
+std::string PdbInfo::key() const
+{
+    uint32_t data1;
+    uint16_t data2, data3;
+    std::memcpy(&data1, guid, sizeof(uint32_t));
+    std::memcpy(&data2, guid + 4, sizeof(uint16_t));
+    std::memcpy(&data3, guid + 6, sizeof(uint16_t));
+
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%08X%04X%04X", data1, data2, data3);
+    for (int i = 8; i < 16; i++) {
+        length += snprintf(text + length, sizeof(text) - length, "%02X", guid[i]);
+    }
+    snprintf(text + length, sizeof(text) - length, "%X", age);
+
+    return text;
+}
+
+/**
+ * Read the superblock and the stream directory.
+ *
+ * @param path: path to the PDB
+ */
+MsfFile::MsfFile(const std::string& path)
+    : file(path, std::ios::binary)
+{
+    MsfSuperBlock superBlock;
+    if (!file.read(reinterpret_cast<char *>(&superBlock), sizeof(superBlock))
+        || std::memcmp(superBlock.magic, MSF_MAGIC, MSF_MAGIC_SIZE) != 0) {
+        return;
+    }
+
+    blockSize = superBlock.blockSize;
+    if (blockSize != 512 && blockSize != 1024 && blockSize != 2048 && blockSize != 4096) {
+        return;
+    }
+
+    uint32_t directoryBlockCount = (superBlock.numDirectoryBytes + blockSize - 1) / blockSize;
+    std::vector<uint32_t> directoryBlocks(directoryBlockCount);
+    file.seekg(static_cast<uint64_t>(superBlock.blockMapAddress) * blockSize);
+    if (!file.read(reinterpret_cast<char *>(directoryBlocks.data()), directoryBlockCount * sizeof(uint32_t))) {
+        file.clear();
+        return;
+    }
+
+    std::vector<uint8_t> directory;
+    if (!readBlocks(directoryBlocks, superBlock.numDirectoryBytes, directory) || directory.size() < sizeof(uint32_t)) {
+        return;
+    }
+
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(directory.data());
+    size_t wordCount = directory.size() / sizeof(uint32_t);
+    uint32_t streamCount = words[0];
+    if (streamCount > MSF_MAX_STREAMS || 1 + streamCount > wordCount) {
+        return;
+    }
+
+    streamSizes.assign(words + 1, words + 1 + streamCount);
+    size_t next = 1 + streamCount;
+    for (uint32_t size : streamSizes) {
+        // Deleted streams have a size of -1 and no blocks
+        uint32_t blockCount = size == UINT32_MAX ? 0 : (size + blockSize - 1) / blockSize;
+        if (next + blockCount > wordCount) {
+            return;
+        }
+        streamBlocks.emplace_back(words + next, words + next + blockCount);
+        next += blockCount;
+    }
+
+    valid = true;
+}
+
+bool MsfFile::isOpen() const
+{
+    return valid;
+}
+
+size_t MsfFile::streamCount() const
+{
+    return streamSizes.size();
+}
+
+/**
+ * @param index: index of the stream
+ * @param data: receives the content of the stream
+ * @param maxSize: read at most this many bytes
+ * @return: true if the stream exists and was read, false otherwise
+ */
+bool MsfFile::readStream(size_t index, std::vector<uint8_t>& data, size_t maxSize)
+{
+    if (!valid || index >= streamSizes.size() || streamSizes[index] == UINT32_MAX) {
+        return false;
+    }
+
+    uint32_t size = static_cast<uint32_t>(std::min<size_t>(streamSizes[index], maxSize));
+    std::vector<uint32_t> blocks(streamBlocks[index].begin(),
+                                 streamBlocks[index].begin() + (size + blockSize - 1) / blockSize);
+    return readBlocks(blocks, size, data);
+}
+
+bool MsfFile::readBlocks(const std::vector<uint32_t>& blocks, uint32_t size, std::vector<uint8_t>& data)
+{
+    data.resize(size);
+
+    size_t done = 0;
+    for (uint32_t block : blocks) {
+        size_t chunk = std::min<size_t>(blockSize, size - done);
+        file.seekg(static_cast<uint64_t>(block) * blockSize);
+        if (!file.read(reinterpret_cast<char *>(data.data() + done), static_cast<std::streamsize>(chunk))) {
+            file.clear();
+            return false;
+        }
+        done += chunk;
+    }
+
+    return done == size;
+}
+
+/**
+ * Read the GUID of the PDB info stream and the age of the DBI stream, which is the one debuggers match.
+ *
+ * @param msf: the PDB
+ * @param info: receives the identity of the PDB
+ * @return: true if the info stream was read, false otherwise
+ */
+bool readPdbInfo(MsfFile& msf, PdbInfo& info)
+{
+    std::vector<uint8_t> stream;
+    if (!msf.readStream(PDB_INFO_STREAM, stream, 28) || stream.size() < 28) {
+        return false;
+    }
+
+    std::memcpy(&info.age, &stream[8], sizeof(uint32_t));
+    std::memcpy(info.guid, &stream[12], sizeof(info.guid));
+
+    if (msf.readStream(PDB_DBI_STREAM, stream, 12) && stream.size() >= 12) {
+        std::memcpy(&info.age, &stream[8], sizeof(uint32_t));
+    }
+
+    return true;
+}
+
+/*
+ * Type records of a TPI stream, indexed by type index.
+ */
+class TypeTable {
+public:
+    struct Record {
+        uint16_t kind;
+        const uint8_t *data;
+        const uint8_t *end;
+    };
+
+    bool load(const std::vector<uint8_t>& tpi)
+    {
+        if (tpi.size() < sizeof(TpiHeader)) {
+            return false;
+        }
+        TpiHeader header;
+        std::memcpy(&header, tpi.data(), sizeof(header));
+        if (header.typeIndexEnd < header.typeIndexBegin
+            || static_cast<uint64_t>(header.headerSize) + header.typeRecordBytes > tpi.size()) {
+            return false;
+        }
+
+        firstIndex = header.typeIndexBegin;
+        records.reserve(header.typeIndexEnd - header.typeIndexBegin);
+
+        const uint8_t *position = tpi.data() + header.headerSize;
+        const uint8_t *end = position + header.typeRecordBytes;
+        while (position + 4 <= end) {
+            uint16_t length, kind;
+            std::memcpy(&length, position, sizeof(uint16_t));
+            std::memcpy(&kind, position + 2, sizeof(uint16_t));
+            if (length < 2 || position + 2 + length > end) {
+                return false;
+            }
+            records.push_back({kind, position + 4, position + 2 + length});
+            position += 2 + length;
+        }
+
+        return true;
+    }
+
+    const Record *get(uint32_t typeIndex) const
+    {
+        if (typeIndex < firstIndex || typeIndex - firstIndex >= records.size()) {
+            return nullptr;
+        }
+        return &records[typeIndex - firstIndex];
+    }
+
+    uint32_t begin() const
+    {
+        return firstIndex;
+    }
+
+    uint32_t end() const
+    {
+        return firstIndex + static_cast<uint32_t>(records.size());
+    }
+
+private:
+    uint32_t firstIndex = 0;
+    std::vector<Record> records;
+};
+
+static bool readNumeric(const uint8_t *& position, const uint8_t *end, uint64_t& value)
+{
+    if (position + 2 > end) {
+        return false;
+    }
+    uint16_t leaf;
+    std::memcpy(&leaf, position, sizeof(uint16_t));
+    position += 2;
+
+    if (leaf < LF_NUMERIC) {
+        value = leaf;
+        return true;
+    }
+
+    size_t size;
+    switch (leaf) {
+        case LF_CHAR: size = 1; break;
+        case LF_SHORT: case LF_USHORT: size = 2; break;
+        case LF_LONG: case LF_ULONG: size = 4; break;
+        case LF_QUADWORD: case LF_UQUADWORD: size = 8; break;
+        default: return false;
+    }
+    if (position + size > end) {
+        return false;
+    }
+
+    value = 0;
+    std::memcpy(&value, position, size);
+    position += size;
+    return true;
+}
+
+static bool readName(const uint8_t *& position, const uint8_t *end, std::string& name)
+{
+    const uint8_t *terminator = static_cast<const uint8_t *>(std::memchr(position, 0, end - position));
+    if (terminator == nullptr) {
+        return false;
+    }
+    name.assign(reinterpret_cast<const char *>(position), terminator - position);
+    position = terminator + 1;
+    return true;
+}
+
+/*
+ * Layout part of LF_STRUCTURE, LF_CLASS and LF_UNION records.
+ */
+struct AggregateType {
+    uint16_t properties;
+    uint32_t fieldList;
+    std::string name;
+    std::string uniqueName;
+};
+
+static bool readAggregate(const TypeTable::Record& record, AggregateType& aggregate)
+{
+    if (record.kind != LF_STRUCTURE && record.kind != LF_CLASS && record.kind != LF_UNION) {
+        return false;
+    }
+
+    const uint8_t *position = record.data;
+    size_t fixedSize = record.kind == LF_UNION ? 8 : 16;
+    if (position + fixedSize > record.end) {
+        return false;
+    }
+    std::memcpy(&aggregate.properties, position + 2, sizeof(uint16_t));
+    std::memcpy(&aggregate.fieldList, position + 4, sizeof(uint32_t));
+    position += fixedSize;
+
+    uint64_t size;
+    if (!readNumeric(position, record.end, size) || !readName(position, record.end, aggregate.name)) {
+        return false;
+    }
+    aggregate.uniqueName.clear();
+    if (aggregate.properties & CV_PROP_HASUNIQUENAME) {
+        readName(position, record.end, aggregate.uniqueName);
+    }
+    return true;
+}
+
+/*
+ * Collects the member offsets of the structures the profiles need. Members of anonymous unions and
+ * structures are reported with their offset in the enclosing structure.
+ */
+class MemberCollector {
+public:
+    explicit MemberCollector(const TypeTable& types) : types(types)
+    {
+        for (uint32_t index = types.begin(); index < types.end(); index++) {
+            AggregateType aggregate;
+            if (!readAggregate(*types.get(index), aggregate) || (aggregate.properties & CV_PROP_FWDREF)) {
+                continue;
+            }
+            definitions.emplace(aggregate.name, index);
+            if (!aggregate.uniqueName.empty()) {
+                definitions.emplace("#" + aggregate.uniqueName, index);
+            }
+        }
+    }
+
+    bool collect(const std::string& structure, std::map<std::string, uint64_t>& members)
+    {
+        auto definition = definitions.find(structure);
+        if (definition == definitions.end()) {
+            std::cerr << "Structure " << structure << " not found in the PDB\n";
+            return false;
+        }
+        collectAggregate(definition->second, 0, members, 0);
+        return true;
+    }
+
+private:
+    static bool isAnonymous(const std::string& name)
+    {
+        return name.empty() || name.rfind("<unnamed-", 0) == 0 || name.rfind("__unnamed", 0) == 0;
+    }
+
+    // Forward references point to the definition through the unique name, or the name for named types
+    uint32_t resolve(uint32_t typeIndex, AggregateType& aggregate) const
+    {
+        const TypeTable::Record *record = types.get(typeIndex);
+        if (record == nullptr || !readAggregate(*record, aggregate)) {
+            return 0;
+        }
+        if (!(aggregate.properties & CV_PROP_FWDREF)) {
+            return typeIndex;
+        }
+
+        auto definition = definitions.end();
+        if (!aggregate.uniqueName.empty()) {
+            definition = definitions.find("#" + aggregate.uniqueName);
+        } else if (!isAnonymous(aggregate.name)) {
+            definition = definitions.find(aggregate.name);
+        }
+        if (definition == definitions.end() || !readAggregate(*types.get(definition->second), aggregate)) {
+            return 0;
+        }
+        return definition->second;
+    }
+
+    void collectAggregate(uint32_t typeIndex, uint64_t baseOffset, std::map<std::string, uint64_t>& members, int depth)
+    {
+        AggregateType aggregate;
+        if (depth > 8 || resolve(typeIndex, aggregate) == 0) {
+            return;
+        }
+        collectFieldList(aggregate.fieldList, baseOffset, members, depth);
+    }
+
+    void collectFieldList(uint32_t fieldList, uint64_t baseOffset, std::map<std::string, uint64_t>& members, int depth)
+    {
+        const TypeTable::Record *record = types.get(fieldList);
+        if (record == nullptr || record->kind != LF_FIELDLIST) {
+            return;
+        }
+
+        const uint8_t *position = record->data;
+        const uint8_t *end = record->end;
+        while (position + 2 <= end) {
+            // Sub-records are aligned on 4 bytes with LF_PAD bytes
+            if (*position >= 0xf0) {
+                position += *position & 0x0f;
+                continue;
+            }
+
+            uint16_t kind;
+            std::memcpy(&kind, position, sizeof(uint16_t));
+            position += 2;
+
+            uint32_t type = 0;
+            uint64_t offset = 0;
+            std::string name;
+            if (position + 6 <= end) {
+                std::memcpy(&type, position + 2, sizeof(uint32_t));
+            }
+
+            switch (kind) {
+                case LF_MEMBER: {
+                    position += 6;
+                    if (!readNumeric(position, end, offset) || !readName(position, end, name)) {
+                        return;
+                    }
+                    if (isAnonymous(name)) {
+                        collectAggregate(type, baseOffset + offset, members, depth + 1);
+                    } else {
+                        members.emplace(name, baseOffset + offset);
+                    }
+                    break;
+                }
+                case LF_STMEMBER:
+                case LF_NESTTYPE:
+                    position += 6;
+                    if (!readName(position, end, name)) {
+                        return;
+                    }
+                    break;
+                case LF_BCLASS:
+                    position += 6;
+                    if (!readNumeric(position, end, offset)) {
+                        return;
+                    }
+                    break;
+                case LF_ENUMERATE:
+                    position += 2;
+                    if (!readNumeric(position, end, offset) || !readName(position, end, name)) {
+                        return;
+                    }
+                    break;
+                case LF_VFUNCTAB:
+                    position += 6;
+                    break;
+                case LF_INDEX:
+                    // The list continues in another LF_FIELDLIST
+                    collectFieldList(type, baseOffset, members, depth + 1);
+                    return;
+                case LF_METHOD:
+                    position += 6;
+                    if (!readName(position, end, name)) {
+                        return;
+                    }
+                    break;
+                case LF_ONEMETHOD: {
+                    uint16_t attributes;
+                    std::memcpy(&attributes, position, sizeof(uint16_t));
+                    uint16_t methodProperty = (attributes >> 2) & 7;
+                    // Introducing virtual methods carry their vtable offset
+                    position += 6 + (methodProperty == 4 || methodProperty == 6 ? 4 : 0);
+                    if (!readName(position, end, name)) {
+                        return;
+                    }
+                    break;
+                }
+                default:
+                    return;
+            }
+        }
+    }
+
+    const TypeTable& types;
+    std::unordered_map<std::string, uint32_t> definitions;
+};
+
+static bool requireMember(const std::map<std::string, uint64_t>& members, const char *structure, const char *member,
+                          uint64_t& offset)
+{
+    auto found = members.find(member);
+    if (found == members.end()) {
+        std::cerr << "Field " << structure << "." << member << " not found in the PDB\n";
+        return false;
+    }
+    offset = found->second;
+    return true;
+}
+
+/**
+ * Fill the offsets used by the analysis from the type records of a kernel PDB.
+ *
+ * @param tpi: content of the TPI stream
+ * @param offsets: receives the offsets, systemDirectoryTableBase is left unchanged
+ * @return: true if every field was found, false otherwise
+ */
+bool buildProfileFromTypes(const std::vector<uint8_t>& tpi, OffsetsProfile& offsets)
+{
+    TypeTable types;
+    if (!types.load(tpi)) {
+        std::cerr << "Malformed TPI stream\n";
+        return false;
+    }
+
+    MemberCollector collector(types);
+    std::map<std::string, uint64_t> eprocess, kprocess, balancedNode, vad;
+    if (!collector.collect("_EPROCESS", eprocess) || !collector.collect("_KPROCESS", kprocess)
+        || !collector.collect("_RTL_BALANCED_NODE", balancedNode) || !collector.collect("_MMVAD_SHORT", vad)) {
+        return false;
+    }
+
+    OffsetsProfile parsed = offsets;
+    bool found = requireMember(eprocess, "_EPROCESS", "ImageFileName", parsed.imageFileName)
+                 && requireMember(eprocess, "_EPROCESS", "ActiveProcessLinks", parsed.activeProcessLinksFlink)
+                 && requireMember(eprocess, "_EPROCESS", "VadRoot", parsed.vadRoot)
+                 && requireMember(kprocess, "_KPROCESS", "DirectoryTableBase", parsed.directoryTableBase)
+                 && requireMember(balancedNode, "_RTL_BALANCED_NODE", "Right", parsed.rightChild)
+                 && requireMember(balancedNode, "_RTL_BALANCED_NODE", "ParentValue", parsed.parentValue)
+                 && requireMember(vad, "_MMVAD_SHORT", "StartingVpn", parsed.startingVpn)
+                 && requireMember(vad, "_MMVAD_SHORT", "EndingVpn", parsed.endingVpn)
+                 && requireMember(vad, "_MMVAD_SHORT", "StartingVpnHigh", parsed.startingVpnHigh)
+                 && requireMember(vad, "_MMVAD_SHORT", "EndingVpnHigh", parsed.endingVpnHigh);
+    if (!found) {
+        return false;
+    }
+
+    // _LIST_ENTRY: Flink then Blink
+    parsed.activeProcessLinksBlink = parsed.activeProcessLinksFlink + 8;
+    offsets = parsed;
+    return true;
+}
+
+/**
+ * Make the profile of an ntoskrnl PDB. Profiles are cached by GUID and age, so a PDB is parsed once.
+ *
+ * @param pdbPath: path to the PDB, e.g. ntkrnlmp.pdb
+ * @param profile: receives the profile, named after the PDB and its key
+ * @param cacheDirectory: directory of the cached profiles, empty to parse the PDB every time
+ * @return: true if the profile was made, false otherwise
+ */
+bool profileFromPdb(const std::string& pdbPath, WindowsProfile& profile, const std::string& cacheDirectory)
+{
+    MsfFile msf(pdbPath);
+    PdbInfo info;
+    if (!msf.isOpen() || !readPdbInfo(msf, info)) {
+        std::cerr << "Not a PDB: " << pdbPath << "\n";
+        return false;
+    }
+
+    std::string key = info.key();
+    std::filesystem::path cachePath;
+    if (!cacheDirectory.empty()) {
+        cachePath = std::filesystem::path(cacheDirectory) / (key + ".json");
+        std::error_code error;
+        if (std::filesystem::exists(cachePath, error) && loadProfile(cachePath.string(), profile)) {
+            return true;
+        }
+    }
+
+    std::vector<uint8_t> tpi;
+    WindowsProfile parsed;
+    parsed.name = std::filesystem::path(pdbPath).stem().string() + "-" + key;
+    if (!msf.readStream(PDB_TPI_STREAM, tpi) || !buildProfileFromTypes(tpi, parsed.offsets)) {
+        std::cerr << "Failed to read the types of " << pdbPath << "\n";
+        return false;
+    }
+
+    if (!cachePath.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+        saveProfile(cachePath.string(), parsed);
+    }
+
+    profile = parsed;
+    return true;
+}
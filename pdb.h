@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "profile.h"
+
+#ifndef DUDEDUMPER_PDB_H
+#define DUDEDUMPER_PDB_H
+
+#define MSF_MAGIC "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0\0"
+#define MSF_MAGIC_SIZE 32
+#define PDB_INFO_STREAM 1
+#define PDB_TPI_STREAM 2
+
+/*
+ * Identity of a PDB, the same key the symbol servers use.
+ */
+struct PdbInfo {
+    uint8_t guid[16];
+    uint32_t age;
+
+    std::string key() const;
+};
+
+/*
+ * Multi-stream file (MSF 7.0) container of a PDB, streams are read block by block on demand.
+ */
+class MsfFile {
+public:
+    explicit MsfFile(const std::string& path);
+
+    bool isOpen() const;
+    size_t streamCount() const;
+    bool readStream(size_t index, std::vector<uint8_t>& data, size_t maxSize = SIZE_MAX);
+
+private:
+    bool readBlocks(const std::vector<uint32_t>& blocks, uint32_t size, std::vector<uint8_t>& data);
+
+    std::ifstream file;
+    bool valid = false;
+    uint32_t blockSize = 0;
+    std::vector<uint32_t> streamSizes;
+    std::vector<std::vector<uint32_t>> streamBlocks;
+};
+
+bool readPdbInfo(MsfFile& msf, PdbInfo& info);
+bool buildProfileFromTypes(const std::vector<uint8_t>& tpi, OffsetsProfile& offsets);
+bool profileFromPdb(const std::string& pdbPath, WindowsProfile& profile, const std::string& cacheDirectory = "");
+
+#endif //DUDEDUMPER_PDB_H
@@ -0,0 +1,110 @@
+#include "physicalspace.h"
+
+#include "compresseddump.h"
+
+
+/**
+ * Build the run map of a dump and its page bitmap.
+ *
+ * @param layout: layout of the dump, from openDumpLayout
+ * @param fileSize: size of the dump file, the size of the only run of raw dumps
+ */
+PhysicalAddressSpace::PhysicalAddressSpace(const DumpLayout& layout, uint64_t fileSize)
+{
+    if (layout.runs) {
+        for (auto& run : layout.runs->runs()) {
+            table.add(run.start, run.size, run.fileOffset, run.source);
+        }
+    } else if (layout.compressed) {
+        table.add(0, layout.compressed->size(), 0);
+    } else {
+        table.add(0, fileSize, 0);
+    }
+    table.finalize();
+
+    for (auto& run : table.runs()) {
+        present += run.size;
+    }
+
+    uint64_t pages = (table.end() + PAGE_SIZE - 1) >> PAGE_4KB_SHIFT;
+    if (pages > PHYSICAL_BITMAP_MAX_PAGES) {
+        return;
+    }
+
+    bitmap.assign((pages + 63) / 64, 0);
+    for (auto& run : table.runs()) {
+        uint64_t first = run.start >> PAGE_4KB_SHIFT;
+        uint64_t last = (run.start + run.size + PAGE_SIZE - 1) >> PAGE_4KB_SHIFT;
+        for (uint64_t page = first; page < last;) {
+            // Whole words at once inside the run
+            if (page % 64 == 0 && last - page >= 64) {
+                bitmap[page / 64] = UINT64_MAX;
+                page += 64;
+            } else {
+                bitmap[page / 64] |= 1ULL << (page % 64);
+                page++;
+            }
+        }
+    }
+}
+
+/**
+ * @return: runs of the dump sorted by physical address
+ */
+const std::vector<PhysicalRun>& PhysicalAddressSpace::runs() const
+{
+    return table.runs();
+}
+
+/**
+ * @return: physical address following the last run
+ */
+uint64_t PhysicalAddressSpace::end() const
+{
+    return table.end();
+}
+
+/**
+ * @return: number of bytes held by the runs
+ */
+uint64_t PhysicalAddressSpace::presentBytes() const
+{
+    return present;
+}
+
+/**
+ * @param pageNumber: physical address shifted by PAGE_4KB_SHIFT
+ * @return: true if the dump holds the page, even partially
+ */
+bool PhysicalAddressSpace::isPagePresent(uint64_t pageNumber) const
+{
+    if (!bitmap.empty() || table.runs().empty()) {
+        return pageNumber / 64 < bitmap.size() && (bitmap[pageNumber / 64] >> (pageNumber % 64)) & 1;
+    }
+
+    uint64_t fileOffset, available;
+    return pageNumber <= (UINT64_MAX >> PAGE_4KB_SHIFT)
+           && table.locate(pageNumber << PAGE_4KB_SHIFT, fileOffset, available);
+}
+
+/**
+ * @param physicalAddress: physical address to look up
+ * @return: true if the dump holds the page of the address
+ */
+bool PhysicalAddressSpace::isPresent(uint64_t physicalAddress) const
+{
+    return isPagePresent(physicalAddress >> PAGE_4KB_SHIFT);
+}
+
+/**
+ * @param path: path to the dump
+ * @param layout: layout of the dump, opened from the path when it is the default one
+ * @return: physical address space of the dump
+ */
+std::shared_ptr<const PhysicalAddressSpace> physicalSpace(const std::string& path, const DumpLayout& layout)
+{
+    if (layout.physical) {
+        return layout.physical;
+    }
+    return openDumpLayout(path).physical;
+}
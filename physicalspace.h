@@ -0,0 +1,39 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dumpformat.h"
+
+#ifndef DUDEDUMPER_PHYSICALSPACE_H
+#define DUDEDUMPER_PHYSICALSPACE_H
+
+// 1 TB of physical address space, a 32 MB bitmap
+#define PHYSICAL_BITMAP_MAX_PAGES (1ULL << 28)
+
+/*
+ * Physical memory held by a dump, whatever its format: the runs of memory it holds, sorted, with the
+ * holes between them. A run's fileOffset is where the format stores it (the file offset, or the
+ * offset in the decompressed blocks) and its source the file holding it. Raw dumps are a single run
+ * the size of the file. Page presence is looked up in a bitmap when the address space is at most
+ * PHYSICAL_BITMAP_MAX_PAGES pages, and in the run table otherwise.
+ */
+class PhysicalAddressSpace {
+public:
+    PhysicalAddressSpace(const DumpLayout& layout, uint64_t fileSize);
+
+    const std::vector<PhysicalRun>& runs() const;
+    uint64_t end() const;
+    uint64_t presentBytes() const;
+    bool isPagePresent(uint64_t pageNumber) const;
+    bool isPresent(uint64_t physicalAddress) const;
+
+private:
+    RunTable table;
+    std::vector<uint64_t> bitmap;
+    uint64_t present = 0;
+};
+
+std::shared_ptr<const PhysicalAddressSpace> physicalSpace(const std::string& path, const DumpLayout& layout);
+
+#endif //DUDEDUMPER_PHYSICALSPACE_H
@@ -0,0 +1,296 @@
+#include "plots.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#include "memory.h"
+#include "threadpool.h"
+
+#define ADDRESS_SPACE_STRIP_HEIGHT 140.f
+
+static const ImVec4 pageClassColors[static_cast<int>(PageClass::Count)] = {
+	ImVec4(0.20f, 0.20f, 0.20f, 1.f), // Unscanned
+	ImVec4(0.00f, 0.00f, 0.00f, 1.f), // Zero
+	ImVec4(0.95f, 0.60f, 0.10f, 1.f), // PageTable
+	ImVec4(0.25f, 0.75f, 0.30f, 1.f), // Process
+	ImVec4(0.25f, 0.45f, 0.95f, 1.f), // Kernel
+	ImVec4(0.90f, 0.20f, 0.20f, 1.f), // HighEntropy
+	ImVec4(0.65f, 0.65f, 0.65f, 1.f), // Data
+};
+
+/**
+ * Sets the dump the map is built for, the map is started by Draw once the processes are known
+ */
+void MemoryMapWindow::Open(const std::string& dumpPath, const DumpLayout& physicalLayout)
+{
+	map.cancel();
+	path = dumpPath;
+	dumpLayout = physicalLayout;
+	started = false;
+	resetView = true;
+	cells.clear();
+}
+
+void MemoryMapWindow::Close()
+{
+	map.cancel();
+	path.clear();
+	dumpLayout = DumpLayout();
+	started = false;
+	cells.clear();
+}
+
+/**
+ * Follows the physical memory of a dump that grew, used by the next build of the map
+ */
+void MemoryMapWindow::SetPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical)
+{
+	dumpLayout.physical = std::move(physical);
+}
+
+/**
+ * Sets the function called from the map threads whenever cells change
+ */
+void MemoryMapWindow::SetUpdateCallback(std::function<void()> callback)
+{
+	map.onUpdate = std::move(callback);
+}
+
+void MemoryMapWindow::DrawLegend()
+{
+	for (int i = 1; i < static_cast<int>(PageClass::Count); i++)
+	{
+		if (i > 1)
+			ImGui::SameLine();
+		ImGui::ColorButton(pageClassName(static_cast<PageClass>(i)), pageClassColors[i],
+			ImGuiColorEditFlags_NoTooltip | ImGuiColorEditFlags_NoBorder, ImVec2(12.f, 12.f));
+		ImGui::SameLine();
+		ImGui::TextUnformatted(pageClassName(static_cast<PageClass>(i)));
+	}
+}
+
+void MemoryMapWindow::DrawTooltip(const std::vector<Process>& processList)
+{
+	ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+	if (mouse.x < 0 || mouse.y < 0 || mouse.x >= map.width() || mouse.y >= map.height())
+		return;
+
+	// The first row of the heatmap is drawn at the top
+	size_t row = map.height() - 1 - static_cast<size_t>(mouse.y);
+	size_t cell = row * map.width() + static_cast<size_t>(mouse.x);
+	uint64_t start = cell * map.pagesPerCell() * PAGE_SIZE;
+	uint64_t end = start + map.pagesPerCell() * PAGE_SIZE;
+
+	ImGui::BeginTooltip();
+	ImGui::Text("%llx - %llx", static_cast<unsigned long long>(start), static_cast<unsigned long long>(end));
+	ImGui::TextUnformatted(pageClassName(map.cellClass(cell)));
+	int owner = map.cellOwner(cell);
+	if (owner >= 0 && owner < static_cast<int>(processList.size()))
+		ImGui::Text("Owned by %s", processList[owner].ProcessName.c_str());
+	ImGui::EndTooltip();
+}
+
+/**
+ * Draws the map window
+ * processesReady tells that the analysis is done, the map uses the processes to attribute pages
+ */
+void MemoryMapWindow::Draw(const std::vector<Process>& processList, bool processesReady, bool* open)
+{
+	if (!ImGui::Begin("Memory map", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	if (path.empty())
+	{
+		ImGui::TextUnformatted("No dump opened");
+		ImGui::End();
+		return;
+	}
+
+	if (!started && processesReady)
+		started = map.start(path, processList, MEMORY_MAP_CELLS, dumpLayout);
+
+	if (!started)
+	{
+		ImGui::TextUnformatted("Waiting for the analysis to finish");
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("%llu KB per cell, pass %zu / %zu", static_cast<unsigned long long>(map.pagesPerCell() * PAGE_SIZE >> 10),
+		map.passesDone(), map.passCount());
+	if (!map.isRunning())
+	{
+		ImGui::SameLine();
+		if (ImGui::Button("Rebuild"))
+			map.start(path, processList, MEMORY_MAP_CELLS, dumpLayout);
+	}
+	DrawLegend();
+
+	if (colormap == -1)
+		colormap = ImPlot::AddColormap("PageClasses", pageClassColors, static_cast<int>(PageClass::Count), true);
+
+	map.snapshot(cells);
+	int width = static_cast<int>(map.width());
+	int height = static_cast<int>(map.height());
+
+	ImPlot::PushColormap(colormap);
+	if (ImPlot::BeginPlot("##memorymap", ImVec2(-1, -1), ImPlotFlags_CanvasOnly))
+	{
+		ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_NoDecorations, ImPlotAxisFlags_NoDecorations);
+		ImPlot::SetupAxesLimits(0, width, 0, height, resetView ? ImPlotCond_Always : ImPlotCond_Once);
+		resetView = false;
+		ImPlot::PlotHeatmap("##cells", cells.data(), height, width, 0, static_cast<double>(PageClass::Count) - 1,
+			nullptr, ImPlotPoint(0, 0), ImPlotPoint(width, height));
+		if (ImPlot::IsPlotHovered())
+			DrawTooltip(processList);
+		ImPlot::EndPlot();
+	}
+	ImPlot::PopColormap();
+
+	ImGui::End();
+}
+
+/**
+ * Formats the axis ticks of the address space as hexadecimal addresses
+ */
+static int FormatAddress(double value, char* buffer, int size, void*)
+{
+	return snprintf(buffer, size, "%llx", static_cast<unsigned long long>(value < 0 ? 0 : value));
+}
+
+/**
+ * Sets the dump, the page tables are read through the cache if there is one
+ */
+void AddressSpaceStrip::Open(const std::string& dumpPath, std::shared_ptr<PageCache> dumpCache,
+                             const DumpLayout& physicalLayout)
+{
+	path = dumpPath;
+	cache = std::move(dumpCache);
+	dumpLayout = physicalLayout;
+	hasLayout = false;
+	layoutProcess = -1;
+	layoutGeneration = SIZE_MAX;
+	resetView = true;
+}
+
+/**
+ * Follows the physical memory of a dump that grew, the layout of the selected process is built again
+ */
+void AddressSpaceStrip::SetPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical)
+{
+	dumpLayout.physical = std::move(physical);
+	layoutGeneration = SIZE_MAX;
+}
+
+/**
+ * Sets the function called from the thread pool when a layout is ready
+ */
+void AddressSpaceStrip::SetUpdateCallback(std::function<void()> callback)
+{
+	onUpdate = std::move(callback);
+}
+
+void AddressSpaceStrip::DrawLane(const RangeLod& ranges, double lane, ImU32 color, const ImPlotRect& limits, uint64_t resolution)
+{
+	uint64_t start = static_cast<uint64_t>(std::max(0.0, limits.X.Min));
+	uint64_t end = static_cast<uint64_t>(std::max(0.0, limits.X.Max));
+	ranges.query(start, end, resolution, visible);
+
+	ImDrawList* drawList = ImPlot::GetPlotDrawList();
+	for (const AddressRange& range : visible)
+	{
+		ImVec2 topLeft = ImPlot::PlotToPixels(static_cast<double>(range.start), lane + 0.85);
+		ImVec2 bottomRight = ImPlot::PlotToPixels(static_cast<double>(range.end), lane + 0.15);
+		// Ranges smaller than a pixel are still visible
+		bottomRight.x = std::max(bottomRight.x, topLeft.x + 1.f);
+		drawList->AddRectFilled(topLeft, bottomRight, color);
+	}
+}
+
+/**
+ * Draws the strip of the selected process, the layout is rebuilt in the background when the selection changes
+ */
+void AddressSpaceStrip::Draw(const std::vector<Process>& processList, int selectedProcess, size_t processGeneration)
+{
+	if (path.empty() || selectedProcess < 0 || selectedProcess >= static_cast<int>(processList.size()))
+		return;
+
+	if (selectedProcess != layoutProcess || processGeneration != layoutGeneration)
+	{
+		layoutProcess = selectedProcess;
+		layoutGeneration = processGeneration;
+		hasLayout = false;
+
+		Process process = processList[selectedProcess];
+		std::string dumpPath = path;
+		std::function<void()> callback = onUpdate;
+		std::shared_ptr<PageCache> dumpCache = cache;
+		DumpLayout physicalLayout = dumpLayout;
+		pending = ThreadPool::global().submit([process, dumpPath, dumpCache, physicalLayout, callback]() {
+			std::unique_ptr<std::ifstream> file;
+			// Dumps with a run table are read through a stream mapping physical addresses, even uncached
+			if (dumpCache || physicalLayout.runs)
+				file = std::make_unique<CachedDumpStream>(dumpPath, dumpCache ? dumpCache : std::make_shared<PageCache>(0),
+				                                          physicalLayout);
+			else
+				file = std::make_unique<std::ifstream>(dumpPath, std::ios::binary);
+			ProcessLayout result = buildProcessLayout(process, *file);
+			if (callback)
+				callback();
+			return result;
+		});
+	}
+
+	if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		layout = pending.get();
+		hasLayout = true;
+	}
+
+	if (!hasLayout)
+	{
+		ImGui::TextUnformatted("Reading page tables...");
+		return;
+	}
+
+	ImGui::Text("%zu VADs, %zu present ranges, %llu MB present", layout.vads.size(), layout.presentPages.size(),
+		static_cast<unsigned long long>(layout.presentBytes >> 20));
+
+	static const double laneTicks[] = { 0.5, 1.5, 2.5 };
+	static const char* const laneLabels[] = { "Large", "Present", "VAD" };
+
+	if (ImPlot::BeginPlot("##addressspace", ImVec2(-1, ADDRESS_SPACE_STRIP_HEIGHT), ImPlotFlags_NoLegend | ImPlotFlags_NoMenus | ImPlotFlags_NoBoxSelect | ImPlotFlags_NoMouseText))
+	{
+		ImPlot::SetupAxis(ImAxis_X1, nullptr, ImPlotAxisFlags_NoGridLines);
+		ImPlot::SetupAxisFormat(ImAxis_X1, FormatAddress);
+		ImPlot::SetupAxisLimits(ImAxis_X1, 0, static_cast<double>(USER_SPACE_END), resetView ? ImPlotCond_Always : ImPlotCond_Once);
+		ImPlot::SetupAxisLimitsConstraints(ImAxis_X1, 0, static_cast<double>(USER_SPACE_END));
+		ImPlot::SetupAxisZoomConstraints(ImAxis_X1, 16 * PAGE_SIZE, static_cast<double>(USER_SPACE_END));
+		ImPlot::SetupAxis(ImAxis_Y1, nullptr, ImPlotAxisFlags_NoGridLines | ImPlotAxisFlags_Lock);
+		ImPlot::SetupAxisLimits(ImAxis_Y1, 0, 3, ImPlotCond_Always);
+		ImPlot::SetupAxisTicks(ImAxis_Y1, laneTicks, 3, laneLabels);
+		resetView = false;
+
+		ImPlotRect limits = ImPlot::GetPlotLimits();
+		float width = std::max(1.f, ImPlot::GetPlotSize().x);
+		uint64_t resolution = std::max<uint64_t>(1, static_cast<uint64_t>(limits.X.Size() / width));
+
+		ImPlot::PushPlotClipRect();
+		DrawLane(layout.vads, 2, IM_COL32(90, 160, 240, 255), limits, resolution);
+		DrawLane(layout.presentPages, 1, IM_COL32(80, 200, 100, 255), limits, resolution);
+		DrawLane(layout.largePages, 0, IM_COL32(240, 170, 60, 255), limits, resolution);
+		ImPlot::PopPlotClipRect();
+
+		if (ImPlot::IsPlotHovered())
+		{
+			ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+			ImGui::SetTooltip("%llx", static_cast<unsigned long long>(std::max(0.0, mouse.x)));
+		}
+		ImPlot::EndPlot();
+	}
+}
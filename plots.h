@@ -0,0 +1,68 @@
+#pragma once
+
+#include "imgui.h"
+#include "implot.h"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "structs.h"
+#include "memorymap.h"
+#include "layout.h"
+#include "pagecache.h"
+
+/*
+ * Heatmap of the physical memory of the dump, one cell per MemoryMap cell.
+ * The map is built in the background once the process list is known.
+ */
+class MemoryMapWindow {
+public:
+	void Open(const std::string& path, const DumpLayout& physicalLayout = DumpLayout());
+	void Close();
+	void SetPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical);
+	void Draw(const std::vector<Process>& processList, bool processesReady, bool* open);
+	void SetUpdateCallback(std::function<void()> callback);
+
+private:
+	void DrawLegend();
+	void DrawTooltip(const std::vector<Process>& processList);
+
+	MemoryMap map;
+	std::string path;
+	DumpLayout dumpLayout;
+	bool started = false;
+	bool resetView = true;
+	std::vector<uint8_t> cells;
+	ImPlotColormap colormap = -1;
+};
+
+/*
+ * Zoomable strip of the user address space of the selected process with its VADs, present pages
+ * and large pages. The layout is built on the thread pool when the selection changes and drawn
+ * through RangeLod, so the number of rectangles follows the plot width, not the number of regions.
+ */
+class AddressSpaceStrip {
+public:
+	void Open(const std::string& path, std::shared_ptr<PageCache> cache = nullptr,
+	          const DumpLayout& physicalLayout = DumpLayout());
+	void SetPhysicalSpace(std::shared_ptr<const PhysicalAddressSpace> physical);
+	void Draw(const std::vector<Process>& processList, int selectedProcess, size_t processGeneration);
+	void SetUpdateCallback(std::function<void()> callback);
+
+private:
+	void DrawLane(const RangeLod& ranges, double lane, ImU32 color, const ImPlotRect& limits, uint64_t resolution);
+
+	std::string path;
+	std::shared_ptr<PageCache> cache;
+	DumpLayout dumpLayout;
+	std::function<void()> onUpdate;
+	std::future<ProcessLayout> pending;
+	ProcessLayout layout;
+	bool hasLayout = false;
+	int layoutProcess = -1;
+	size_t layoutGeneration = SIZE_MAX;
+	bool resetView = true;
+	std::vector<AddressRange> visible;
+};
@@ -0,0 +1,341 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "ndjson.h"
+
+
+struct OffsetField {
+    const char *name;
+    uint64_t OffsetsProfile::*member;
+};
+
+// Fields stored in profile files, systemDirectoryTableBase belongs to a dump and not to a build
+static const OffsetField offsetFields[] = {
+        {"imageFileName", &OffsetsProfile::imageFileName},
+        {"activeProcessLinksFlink", &OffsetsProfile::activeProcessLinksFlink},
+        {"activeProcessLinksBlink", &OffsetsProfile::activeProcessLinksBlink},
+        {"directoryTableBase", &OffsetsProfile::directoryTableBase},
+        {"vadRoot", &OffsetsProfile::vadRoot},
+        {"rightChild", &OffsetsProfile::rightChild},
+        {"parentValue", &OffsetsProfile::parentValue},
+        {"startingVpn", &OffsetsProfile::startingVpn},
+        {"endingVpn", &OffsetsProfile::endingVpn},
+        {"startingVpnHigh", &OffsetsProfile::startingVpnHigh},
+        {"endingVpnHigh", &OffsetsProfile::endingVpnHigh},
+};
+
+static WindowsProfile makeProfile(const char *name, uint32_t build, uint64_t activeProcessLinks, uint64_t imageFileName,
+                                  uint64_t vadRoot)
+{
+    WindowsProfile profile;
+    profile.name = name;
+    profile.build = build;
+    profile.offsets.activeProcessLinksFlink = activeProcessLinks;
+    profile.offsets.activeProcessLinksBlink = activeProcessLinks + 8;
+    profile.offsets.imageFileName = imageFileName;
+    profile.offsets.vadRoot = vadRoot;
+    return profile;
+}
+
+/**
+ * Profiles compiled in, the first one is the layout of structs.h. They are probed in this order.
+ *
+ * @return: built-in profiles
+ */
+const std::vector<WindowsProfile>& builtinProfiles()
+{
+    // _KPROCESS, _RTL_BALANCED_NODE and _MMVAD_SHORT offsets are the same in all these builds
+    static const std::vector<WindowsProfile> profiles = {
+            makeProfile("win10-2004", 19041, ACTIVE_PROCESS_LINKS_FLINK, IMAGE_FILE_NAME, VAD_ROOT),
+            makeProfile("win11-24h2", 26100, 0x1d8, 0x338, 0x558),
+            makeProfile("win10-1903", 18362, 0x2f0, 0x450, 0x658),
+            makeProfile("win10-1809", 17763, 0x2e8, 0x450, 0x628),
+    };
+    return profiles;
+}
+
+/**
+ * @param profiles: profiles to search
+ * @param name: name of the profile
+ * @return: the profile, nullptr if there is none with that name
+ */
+const WindowsProfile *findProfile(const std::vector<WindowsProfile>& profiles, const std::string& name)
+{
+    auto found = std::find_if(profiles.begin(), profiles.end(), [&](const WindowsProfile& profile) {
+        return profile.name == name;
+    });
+    return found != profiles.end() ? &*found : nullptr;
+}
+
+/*
+ * Just enough JSON for profile files: objects, strings and numbers, collected into "object.key" paths.
+ */
+class ProfileJsonReader {
+public:
+    explicit ProfileJsonReader(const std::string& text) : text(text) {}
+
+    bool read(std::map<std::string, std::string>& values)
+    {
+        return readObject("", values) && (skipSpace(), position == text.size());
+    }
+
+private:
+    void skipSpace()
+    {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+    }
+
+    bool expect(char c)
+    {
+        skipSpace();
+        if (position >= text.size() || text[position] != c) {
+            return false;
+        }
+        position++;
+        return true;
+    }
+
+    bool readString(std::string& value)
+    {
+        if (!expect('"')) {
+            return false;
+        }
+        value.clear();
+        while (position < text.size() && text[position] != '"') {
+            if (text[position] == '\\' && position + 1 < text.size()) {
+                position++;
+            }
+            value += text[position++];
+        }
+        return expect('"');
+    }
+
+    bool readObject(const std::string& prefix, std::map<std::string, std::string>& values)
+    {
+        if (!expect('{')) {
+            return false;
+        }
+        skipSpace();
+        if (position < text.size() && text[position] == '}') {
+            position++;
+            return true;
+        }
+
+        do {
+            std::string key;
+            if (!readString(key) || !expect(':')) {
+                return false;
+            }
+            key = prefix + key;
+
+            skipSpace();
+            if (position >= text.size()) {
+                return false;
+            }
+            if (text[position] == '{') {
+                if (!readObject(key + ".", values)) {
+                    return false;
+                }
+            } else if (text[position] == '"') {
+                if (!readString(values[key])) {
+                    return false;
+                }
+            } else {
+                size_t end = text.find_first_of(",} \t\r\n", position);
+                if (end == std::string::npos || end == position) {
+                    return false;
+                }
+                values[key] = text.substr(position, end - position);
+                position = end;
+            }
+        } while (expect(','));
+
+        return expect('}');
+    }
+
+    const std::string& text;
+    size_t position = 0;
+};
+
+static bool parseNumber(const std::string& text, uint64_t& value)
+{
+    char *end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 0);
+    return !text.empty() && *end == '\0';
+}
+
+/**
+ * Parse a profile written by profileToJson. Offsets may be numbers or hex strings, missing ones
+ * keep the defaults of structs.h.
+ *
+ * @param json: the profile
+ * @param profile: receives the profile
+ * @return: true if the profile is valid, false otherwise
+ */
+bool parseProfile(const std::string& json, WindowsProfile& profile)
+{
+    std::map<std::string, std::string> values;
+    if (!ProfileJsonReader(json).read(values)) {
+        std::cerr << "Malformed profile\n";
+        return false;
+    }
+
+    auto name = values.find("name");
+    if (name == values.end() || name->second.empty()) {
+        std::cerr << "Profile without a name\n";
+        return false;
+    }
+
+    WindowsProfile parsed;
+    parsed.name = name->second;
+
+    uint64_t number;
+    auto build = values.find("build");
+    if (build != values.end()) {
+        if (!parseNumber(build->second, number)) {
+            std::cerr << "Invalid build in profile " << parsed.name << "\n";
+            return false;
+        }
+        parsed.build = static_cast<uint32_t>(number);
+    }
+
+    for (const OffsetField& field : offsetFields) {
+        auto value = values.find(std::string("offsets.") + field.name);
+        if (value == values.end()) {
+            continue;
+        }
+        if (!parseNumber(value->second, number)) {
+            std::cerr << "Invalid offset " << field.name << " in profile " << parsed.name << "\n";
+            return false;
+        }
+        parsed.offsets.*field.member = number;
+    }
+
+    profile = parsed;
+    return true;
+}
+
+/**
+ * @param profile: profile to write
+ * @return: the profile as a single line JSON object
+ */
+std::string profileToJson(const WindowsProfile& profile)
+{
+    std::string offsets = "{";
+    for (const OffsetField& field : offsetFields) {
+        if (offsets.size() > 1) {
+            offsets += ",";
+        }
+        offsets += "\"" + std::string(field.name) + "\":" + jsonHex(profile.offsets.*field.member);
+    }
+    offsets += "}";
+
+    return JsonRecord("profile")
+            .add("name", profile.name)
+            .add("build", static_cast<uint64_t>(profile.build))
+            .addRaw("offsets", offsets)
+            .str();
+}
+
+/**
+ * @param path: path to a profile file
+ * @param profile: receives the profile
+ * @return: true if the file was read and is a valid profile, false otherwise
+ */
+bool loadProfile(const std::string& path, WindowsProfile& profile)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open profile " << path << "\n";
+        return false;
+    }
+
+    std::stringstream json;
+    json << file.rdbuf();
+    return parseProfile(json.str(), profile);
+}
+
+/**
+ * @param path: path of the profile file, overwritten if it exists
+ * @param profile: profile to write
+ * @return: true if the file was written, false otherwise
+ */
+bool saveProfile(const std::string& path, const WindowsProfile& profile)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write profile " << path << "\n";
+        return false;
+    }
+
+    file << profileToJson(profile) << "\n";
+    return file.good();
+}
+
+/**
+ * Load every *.json profile of a directory, invalid files are reported and skipped.
+ *
+ * @param directory: directory holding the profiles
+ * @return: profiles sorted by name
+ */
+std::vector<WindowsProfile> loadProfiles(const std::string& directory)
+{
+    std::vector<WindowsProfile> profiles;
+    std::error_code error;
+    if (!std::filesystem::is_directory(directory, error)) {
+        return profiles;
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".json") {
+            continue;
+        }
+
+        WindowsProfile profile;
+        if (loadProfile(entry.path().string(), profile)) {
+            profiles.push_back(profile);
+        }
+    }
+
+    if (error) {
+        std::cerr << "Failed to read profile directory " << directory << ": " << error.message() << "\n";
+    }
+
+    std::sort(profiles.begin(), profiles.end(), [](const WindowsProfile& a, const WindowsProfile& b) {
+        return a.name < b.name;
+    });
+    return profiles;
+}
+
+/**
+ * Profiles to probe: the ones of the directory, then the built-in ones. A loaded profile replaces
+ * the built-in profile with the same name.
+ *
+ * @param directory: directory holding the profiles, may not exist
+ * @return: candidate profiles, in order of preference
+ */
+std::vector<WindowsProfile> candidateProfiles(const std::string& directory)
+{
+    std::vector<WindowsProfile> profiles = loadProfiles(directory);
+    size_t loaded = profiles.size();
+
+    for (const WindowsProfile& builtin : builtinProfiles()) {
+        if (std::none_of(profiles.begin(), profiles.begin() + loaded, [&](const WindowsProfile& profile) {
+            return profile.name == builtin.name;
+        })) {
+            profiles.push_back(builtin);
+        }
+    }
+
+    return profiles;
+}
@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "structs.h"
+
+#ifndef DUDEDUMPER_PROFILE_H
+#define DUDEDUMPER_PROFILE_H
+
+// Profiles loaded at startup, relative to the working directory
+#define PROFILE_DIRECTORY "profiles"
+
+/*
+ * Offsets of the kernel structures read by the analysis, the defaults are the ones of structs.h.
+ * It's a flat table copied into every AddressSpace, so the hot accessors read a member instead of
+ * looking the field up.
+ */
+struct OffsetsProfile {
+    uint64_t systemDirectoryTableBase = _CR3;
+    uint64_t imageFileName = IMAGE_FILE_NAME;
+    uint64_t activeProcessLinksFlink = ACTIVE_PROCESS_LINKS_FLINK;
+    uint64_t activeProcessLinksBlink = ACTIVE_PROCESS_LINKS_BLINK;
+    uint64_t directoryTableBase = DIRECTORY_TABLE_BASE;
+    uint64_t vadRoot = VAD_ROOT;
+    uint64_t rightChild = RIGHT_CHILD;
+    uint64_t parentValue = PARENT_VALUE;
+    uint64_t startingVpn = STARTING_VPN;
+    uint64_t endingVpn = ENDING_VPN;
+    uint64_t startingVpnHigh = STARTING_VPN_HIGH;
+    uint64_t endingVpnHigh = ENDING_VPN_HIGH;
+};
+
+/*
+ * Structure layout of one range of Windows builds. systemDirectoryTableBase isn't part of the
+ * layout, it's filled in when the profile is detected on a dump.
+ */
+struct WindowsProfile {
+    std::string name;
+    uint32_t build = 0;
+    OffsetsProfile offsets;
+};
+
+const std::vector<WindowsProfile>& builtinProfiles();
+const WindowsProfile *findProfile(const std::vector<WindowsProfile>& profiles, const std::string& name);
+
+bool parseProfile(const std::string& json, WindowsProfile& profile);
+std::string profileToJson(const WindowsProfile& profile);
+bool loadProfile(const std::string& path, WindowsProfile& profile);
+bool saveProfile(const std::string& path, const WindowsProfile& profile);
+std::vector<WindowsProfile> loadProfiles(const std::string& directory);
+std::vector<WindowsProfile> candidateProfiles(const std::string& directory);
+
+#endif //DUDEDUMPER_PROFILE_H
@@ -0,0 +1,131 @@
+#include "segmented.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+
+/**
+ * @param path: path to the dump
+ * @return: true if the path is the first file of a split dump (name.001) or a segment manifest
+ */
+bool isSegmentedDump(const std::string& path)
+{
+    std::string extension = std::filesystem::path(path).extension().string();
+    return extension == SEGMENT_FIRST_EXTENSION || extension == SEGMENT_MANIFEST_EXTENSION;
+}
+
+/**
+ * Files of a split dump: name.001, name.002, ... up to the first missing one, they follow each other in memory.
+ */
+static std::vector<std::pair<uint64_t, std::string>> numberedSegments(const std::string& path)
+{
+    std::vector<std::pair<uint64_t, std::string>> segments;
+    std::string base = path.substr(0, path.size() - std::string(SEGMENT_FIRST_EXTENSION).size());
+
+    uint64_t start = 0;
+    for (int number = 1; number <= SEGMENT_MAX_FILES; number++) {
+        char extension[8];
+        std::snprintf(extension, sizeof(extension), ".%03d", number);
+        std::string segment = base + extension;
+
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(segment, error);
+        if (error) {
+            break;
+        }
+
+        segments.emplace_back(start, segment);
+        start += size;
+    }
+
+    return segments;
+}
+
+/**
+ * Files listed by a segment manifest, one "<physical address> <path>" per line. Addresses may be
+ * hexadecimal with a 0x prefix, paths are relative to the manifest. Empty lines and lines starting
+ * with # are skipped.
+ */
+static bool manifestSegments(const std::string& path, std::vector<std::pair<uint64_t, std::string>>& segments)
+{
+    std::ifstream manifest(path);
+    if (!manifest.is_open()) {
+        return false;
+    }
+
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        char *end = nullptr;
+        uint64_t start = std::strtoull(line.c_str() + first, &end, 0);
+        size_t parsed = static_cast<size_t>(end - line.c_str());
+        size_t nameStart = line.find_first_not_of(" \t\r", parsed);
+        size_t nameEnd = line.find_last_not_of(" \t\r");
+        if (parsed == first || nameStart == std::string::npos || nameStart == parsed) {
+            std::cerr << "Invalid segment at line " << lineNumber << " of " << path << "\n";
+            return false;
+        }
+
+        std::filesystem::path segment = line.substr(nameStart, nameEnd - nameStart + 1);
+        if (segment.is_relative()) {
+            segment = directory / segment;
+        }
+        segments.emplace_back(start, segment.string());
+    }
+
+    return true;
+}
+
+/**
+ * Map every file of a segmented dump, each one is a run of the physical memory.
+ *
+ * @param path: first file of a split dump (name.001) or segment manifest
+ * @param runs: receives the runs of the files, finalized, their source is the index of the file
+ * @param mappings: receives the mappings of the files
+ * @return: true if every file was mapped and no two files overlap, false otherwise
+ */
+bool openSegmentedDump(const std::string& path, RunTable& runs, std::vector<std::shared_ptr<const MappedFile>>& mappings)
+{
+    std::vector<std::pair<uint64_t, std::string>> segments;
+    if (std::filesystem::path(path).extension() == SEGMENT_MANIFEST_EXTENSION) {
+        if (!manifestSegments(path, segments)) {
+            return false;
+        }
+    } else {
+        segments = numberedSegments(path);
+    }
+
+    if (segments.empty()) {
+        return false;
+    }
+
+    for (auto& [start, segment] : segments) {
+        auto mapping = std::make_shared<MappedFile>(segment);
+        if (!mapping->isOpen() || mapping->size() == 0) {
+            std::cerr << "Failed to map segment " << segment << "\n";
+            return false;
+        }
+
+        runs.add(start, mapping->size(), 0, static_cast<uint32_t>(mappings.size()));
+        mappings.push_back(mapping);
+    }
+    runs.finalize();
+
+    const std::vector<PhysicalRun>& sorted = runs.runs();
+    for (size_t i = 1; i < sorted.size(); i++) {
+        if (sorted[i - 1].start + sorted[i - 1].size > sorted[i].start) {
+            std::cerr << "Overlapping segments at physical address " << sorted[i].start << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
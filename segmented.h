@@ -0,0 +1,19 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dumpformat.h"
+#include "mappedfile.h"
+
+#ifndef DUDEDUMPER_SEGMENTED_H
+#define DUDEDUMPER_SEGMENTED_H
+
+#define SEGMENT_FIRST_EXTENSION ".001"
+#define SEGMENT_MANIFEST_EXTENSION ".segments"
+#define SEGMENT_MAX_FILES 999
+
+bool isSegmentedDump(const std::string& path);
+bool openSegmentedDump(const std::string& path, RunTable& runs, std::vector<std::shared_ptr<const MappedFile>>& mappings);
+
+#endif //DUDEDUMPER_SEGMENTED_H
@@ -0,0 +1,201 @@
+#include "session.h"
+
+#include <filesystem>
+
+#include "physicalspace.h"
+
+
+/**
+ * @param path: path to the dump
+ * @param budget: memory budget shared with the other sessions, may be null
+ * @param cacheSize: upper bound of the page cache of this dump
+ */
+DumpSession::DumpSession(const std::string& path, std::shared_ptr<CacheBudget> budget, size_t cacheSize)
+    : dumpPath(path),
+      pageCache(std::make_shared<PageCache>(cacheSize, std::move(budget))),
+      dumpLayout(openDumpLayout(path)),
+      stream(openStream())
+{
+}
+
+DumpSession::~DumpSession()
+{
+    analysisWorker.cancel();
+}
+
+const std::string& DumpSession::path() const
+{
+    return dumpPath;
+}
+
+/**
+ * @return: file name of the dump
+ */
+std::string DumpSession::name() const
+{
+    return std::filesystem::path(dumpPath).filename().string();
+}
+
+std::shared_ptr<PageCache> DumpSession::cache() const
+{
+    return pageCache;
+}
+
+/**
+ * @return: format, physical memory runs and mapping of the dump
+ */
+const DumpLayout& DumpSession::layout() const
+{
+    return dumpLayout;
+}
+
+/**
+ * @return: counter changed whenever the physical address space of the layout is replaced
+ */
+size_t DumpSession::layoutGeneration() const
+{
+    return layoutRevision;
+}
+
+/**
+ * @return: new stream over the dump reading through the session cache
+ */
+std::unique_ptr<CachedDumpStream> DumpSession::openStream() const
+{
+    return std::make_unique<CachedDumpStream>(dumpPath, pageCache, dumpLayout);
+}
+
+/**
+ * @return: reader owned by the session, only for the thread that owns the session
+ */
+std::ifstream& DumpSession::reader()
+{
+    return *stream;
+}
+
+const OffsetsProfile& DumpSession::profile() const
+{
+    return offsetsProfile;
+}
+
+/**
+ * Set the offsets used by the address spaces made afterwards.
+ *
+ * @param offsets: offsets of the kernel structures of the dumped system
+ */
+void DumpSession::setProfile(const OffsetsProfile& offsets)
+{
+    offsetsProfile = offsets;
+}
+
+/**
+ * Set the layouts the analysis probes, the profile it detects replaces the one of the session.
+ *
+ * @param profiles: candidate profiles, in order of preference
+ */
+void DumpSession::setProfiles(std::vector<WindowsProfile> profiles)
+{
+    analysisWorker.setProfiles(std::move(profiles));
+}
+
+/**
+ * @return: name of the profile detected by the analysis, empty until it found System
+ */
+const std::string& DumpSession::profileName() const
+{
+    return detectedProfile;
+}
+
+/**
+ * @return: reads and translations done by the address spaces of the session
+ */
+const AccessCounters& DumpSession::counters() const
+{
+    return accessCounters;
+}
+
+/**
+ * @param directoryTableBase: DirectoryTableBase of the process
+ * @return: address space of the process reading through the session reader
+ */
+AddressSpace DumpSession::addressSpace(uint64_t directoryTableBase)
+{
+    return AddressSpace(*stream, directoryTableBase, offsetsProfile, &accessCounters, dumpLayout.physical);
+}
+
+/**
+ * Address space for another thread, e.g. one reading through its own openStream().
+ *
+ * @param directoryTableBase: DirectoryTableBase of the process
+ * @param file: reader used by the address space, it must outlive it
+ * @return: address space of the process
+ */
+AddressSpace DumpSession::addressSpace(uint64_t directoryTableBase, std::ifstream& file)
+{
+    return AddressSpace(file, directoryTableBase, offsetsProfile, &accessCounters, dumpLayout.physical);
+}
+
+/**
+ * Start the analysis, or restart it, dropping the processes found so far.
+ *
+ * @param followGrowth: the dump is still being written, analyze it as it grows
+ */
+void DumpSession::startAnalysis(bool followGrowth)
+{
+    processList.clear();
+    detectedProfile.clear();
+    generation++;
+    analysisWorker.start(dumpPath, pageCache, followGrowth);
+    revision = analysisWorker.processRevision();
+}
+
+/**
+ * Collect the processes published by the analysis since the last call, the profile it detected and
+ * the size a followed dump reached.
+ *
+ * @return: number of new processes
+ */
+size_t DumpSession::update()
+{
+    // The profile is resolved once, as soon as the analysis found System
+    if (detectedProfile.empty() && analysisWorker.state() != AnalysisState::Scanning) {
+        WindowsProfile detected = analysisWorker.profile();
+        if (!detected.name.empty()) {
+            offsetsProfile = detected.offsets;
+            detectedProfile = detected.name;
+        }
+    }
+
+    // A followed raw dump holds the bytes written so far, its physical address space grows with it
+    uint64_t written = analysisWorker.progress().totalBytes;
+    if (dumpLayout.format == DumpFormat::Raw && !dumpLayout.compressed && written > dumpLayout.physical->end()) {
+        dumpLayout.physical = std::make_shared<PhysicalAddressSpace>(dumpLayout, written);
+        layoutRevision++;
+    }
+
+    // A followed dump may replace processes already fetched, e.g. once their VAD tree is written
+    size_t fetchedRevision = revision;
+    size_t fetched = analysisWorker.fetchProcesses(processList, &revision);
+    if (revision != fetchedRevision) {
+        generation++;
+    }
+    return fetched;
+}
+
+AnalysisWorker& DumpSession::worker()
+{
+    return analysisWorker;
+}
+
+const std::vector<Process>& DumpSession::processes() const
+{
+    return processList;
+}
+
+/**
+ * @return: counter changed whenever the process list is replaced
+ */
+size_t DumpSession::processGeneration() const
+{
+    return generation;
+}
@@ -0,0 +1,64 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "addressspace.h"
+#include "pagecache.h"
+#include "worker.h"
+
+#ifndef DUDEDUMPER_SESSION_H
+#define DUDEDUMPER_SESSION_H
+
+#define SESSION_CACHE_SIZE 0x40000000
+
+/*
+ * One opened dump: its page cache, shared by every reader of the dump, the background analysis
+ * and the processes it found. Several sessions can share a CacheBudget.
+ * The session also owns a reader for the calling thread, the offsets profile of the dump and the
+ * counters of the AddressSpaces it hands out.
+ */
+class DumpSession {
+public:
+    explicit DumpSession(const std::string& path, std::shared_ptr<CacheBudget> budget = nullptr,
+                         size_t cacheSize = SESSION_CACHE_SIZE);
+    ~DumpSession();
+
+    const std::string& path() const;
+    std::string name() const;
+    std::shared_ptr<PageCache> cache() const;
+    const DumpLayout& layout() const;
+    size_t layoutGeneration() const;
+    std::unique_ptr<CachedDumpStream> openStream() const;
+
+    std::ifstream& reader();
+    const OffsetsProfile& profile() const;
+    void setProfile(const OffsetsProfile& offsets);
+    void setProfiles(std::vector<WindowsProfile> profiles);
+    const std::string& profileName() const;
+    const AccessCounters& counters() const;
+    AddressSpace addressSpace(uint64_t directoryTableBase);
+    AddressSpace addressSpace(uint64_t directoryTableBase, std::ifstream& file);
+
+    void startAnalysis(bool followGrowth = false);
+    size_t update();
+    AnalysisWorker& worker();
+    const std::vector<Process>& processes() const;
+    size_t processGeneration() const;
+
+private:
+    std::string dumpPath;
+    std::shared_ptr<PageCache> pageCache;
+    DumpLayout dumpLayout;
+    std::unique_ptr<CachedDumpStream> stream;
+    OffsetsProfile offsetsProfile;
+    std::string detectedProfile;
+    AccessCounters accessCounters;
+    AnalysisWorker analysisWorker;
+    std::vector<Process> processList;
+    size_t generation = 0;
+    size_t revision = 0;
+    size_t layoutRevision = 0;
+};
+
+#endif //DUDEDUMPER_SESSION_H
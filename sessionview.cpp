@@ -0,0 +1,181 @@
+#include "sessionview.h"
+
+#include <cstdio>
+
+/**
+ * Opens the dump, the analysis begins with Start
+ */
+SessionView::SessionView(const std::string& path, std::shared_ptr<CacheBudget> budget, int id,
+	const std::vector<WindowsProfile>& profiles)
+	: session(path, std::move(budget))
+{
+	session.setProfiles(profiles);
+
+	// The id keeps the tabs of dumps with the same file name apart
+	tabLabel = session.name() + "###session" + std::to_string(id);
+
+	hexViewer.Open(path, session.cache(), session.layout());
+	memoryMapWindow.Open(path, session.layout());
+	addressSpaceStrip.Open(path, session.cache(), session.layout());
+}
+
+SessionView::~SessionView()
+{
+	hexViewer.Close();
+	memoryMapWindow.Close();
+}
+
+/**
+ * Sets the function called from background threads whenever the session has something new to show
+ */
+void SessionView::SetUpdateCallback(std::function<void()> callback)
+{
+	session.worker().onUpdate = callback;
+	memoryMapWindow.SetUpdateCallback(callback);
+	addressSpaceStrip.SetUpdateCallback(callback);
+}
+
+/**
+ * Starts analyzing the dump, the update callback must be set before.
+ * A followed dump is analyzed while it is still being written.
+ */
+void SessionView::Start(bool followGrowth)
+{
+	session.startAnalysis(followGrowth);
+}
+
+/**
+ * Collects the results of the analysis and the growth of a followed dump, called once per frame
+ */
+void SessionView::Update()
+{
+	session.update();
+
+	// The views of a followed dump show the pages written so far
+	if (session.layoutGeneration() != layoutGeneration)
+	{
+		layoutGeneration = session.layoutGeneration();
+		hexViewer.SetPhysicalSpace(session.layout().physical);
+		memoryMapWindow.SetPhysicalSpace(session.layout().physical);
+		addressSpaceStrip.SetPhysicalSpace(session.layout().physical);
+	}
+}
+
+const char* SessionView::TabLabel() const
+{
+	return tabLabel.c_str();
+}
+
+bool SessionView::IsRunning()
+{
+	return session.worker().isRunning();
+}
+
+/**
+ * Draws the analysis progress, the process list and the tables of the selected process
+ */
+void SessionView::DrawAnalyzer()
+{
+	AnalysisWorker& worker = session.worker();
+	const std::vector<Process>& processList = session.processes();
+	size_t processGeneration = session.processGeneration();
+
+	ImGui::Text("Current file: %s", session.path().c_str());
+
+	const AnalysisProgress& progress = worker.progress();
+	switch (worker.state())
+	{
+		case AnalysisState::Scanning:
+		{
+			uint64_t total = progress.totalBytes;
+			float fraction = total != 0 ? static_cast<float>(progress.bytesScanned) / total : 0.f;
+			char overlay[64];
+			snprintf(overlay, sizeof(overlay), "%llu / %llu MB",
+				static_cast<unsigned long long>(progress.bytesScanned >> 20),
+				static_cast<unsigned long long>(total >> 20));
+			ImGui::ProgressBar(fraction, ImVec2(-FLT_MIN, 0), overlay);
+			ImGui::Text("Searching for System: %.1f MB/s", worker.throughput() / (1 << 20));
+			break;
+		}
+		case AnalysisState::ReadingProcesses:
+			ImGui::ProgressBar(1.f, ImVec2(-FLT_MIN, 0), "Reading processes");
+			ImGui::Text("Profile: %s", session.profileName().c_str());
+			ImGui::Text("Processes found: %llu", static_cast<unsigned long long>(progress.processesFound.load()));
+			if (worker.isFollowing())
+				ImGui::Text("Following the dump, %llu MB written", static_cast<unsigned long long>(progress.totalBytes >> 20));
+			break;
+		case AnalysisState::Done:
+			ImGui::Text("Fingerprint: %s", worker.fingerprint().toString().c_str());
+			ImGui::Text("Format: %s", dumpFormatName(session.layout().format));
+			ImGui::Text("Profile: %s", session.profileName().c_str());
+			ImGui::Text("%zu processes, analyzed in %.2f s", processList.size(), worker.elapsedSeconds());
+			break;
+		case AnalysisState::Failed:
+			ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%s", worker.error().c_str());
+			break;
+		case AnalysisState::Cancelled:
+			ImGui::Text("Analysis cancelled");
+			break;
+		case AnalysisState::Idle:
+			break;
+	}
+
+	if (worker.isRunning())
+	{
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel"))
+			worker.cancel();
+	}
+	ImGui::Separator();
+
+	if (selectedProcess >= static_cast<int>(processList.size()))
+		selectedProcess = 0;
+
+	if (processList.empty())
+		return;
+
+	const char* combo_preview_value = processList[selectedProcess].ProcessName.c_str();
+	if (ImGui::BeginCombo("Process", combo_preview_value))
+	{
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(processList.size()));
+		clipper.ForceDisplayRangeByIndices(selectedProcess, selectedProcess + 1);
+		while (clipper.Step())
+		{
+			for (int n = clipper.DisplayStart; n < clipper.DisplayEnd; n++)
+			{
+				const bool is_selected = (selectedProcess == n);
+				ImGui::PushID(n);
+				if (ImGui::Selectable(processList[n].ProcessName.c_str(), is_selected))
+					selectedProcess = n;
+				ImGui::PopID();
+
+				if (is_selected)
+					ImGui::SetItemDefaultFocus();
+			}
+		}
+		ImGui::EndCombo();
+	}
+
+	processTable.Sync(processList, processGeneration);
+	processTable.Draw(selectedProcess);
+
+	ImGui::Separator();
+	ImGui::Text("VAD nodes:");
+	vadTable.SetProcess(&processList[selectedProcess], selectedProcess, processGeneration);
+	vadTable.Draw();
+
+	ImGui::Separator();
+	ImGui::Text("Address space:");
+	addressSpaceStrip.Draw(processList, selectedProcess, processGeneration);
+}
+
+void SessionView::DrawHexViewer(bool* open)
+{
+	hexViewer.Draw(session.processes(), open);
+}
+
+void SessionView::DrawMemoryMap(bool* open)
+{
+	memoryMapWindow.Draw(session.processes(), session.worker().state() == AnalysisState::Done, open);
+}
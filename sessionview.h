@@ -0,0 +1,46 @@
+#pragma once
+
+#include "imgui.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "session.h"
+#include "tables.h"
+#include "hexviewer.h"
+#include "plots.h"
+
+// Memory shared by the page caches of all the opened dumps
+#define GUI_CACHE_BUDGET 0x40000000
+
+/*
+ * Everything the GUI shows for one opened dump, hosted in a tab of the analyzer window.
+ */
+class SessionView {
+public:
+	SessionView(const std::string& path, std::shared_ptr<CacheBudget> budget, int id,
+		const std::vector<WindowsProfile>& profiles = builtinProfiles());
+	~SessionView();
+
+	void SetUpdateCallback(std::function<void()> callback);
+	void Start(bool followGrowth = false);
+	void Update();
+	void DrawAnalyzer();
+	void DrawHexViewer(bool* open);
+	void DrawMemoryMap(bool* open);
+
+	const char* TabLabel() const;
+	bool IsRunning();
+
+private:
+	DumpSession session;
+	std::string tabLabel;
+	int selectedProcess = 0;
+	size_t layoutGeneration = 0;
+	ProcessTable processTable;
+	VadTable vadTable;
+	HexViewer hexViewer;
+	MemoryMapWindow memoryMapWindow;
+	AddressSpaceStrip addressSpaceStrip;
+};
@@ -0,0 +1,409 @@
+#include "streaming.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <vector>
+
+
+/**
+ * @param capacityBytes: upper bound of the retained data
+ */
+RetainedPages::RetainedPages(size_t capacityBytes)
+    : capacityPages(capacityBytes / PAGE_SIZE)
+{
+}
+
+/**
+ * Keep a copy of a page, unless it is already kept or the limit is reached.
+ *
+ * @param pageNumber: physical page number
+ * @param data: content of the page
+ * @param size: valid bytes, the rest of the page reads as zeros
+ * @return: true if the page is kept, false if it was dropped
+ */
+bool RetainedPages::retain(uint64_t pageNumber, const uint8_t *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (pages.contains(pageNumber)) {
+        return true;
+    }
+    if (pages.size() >= capacityPages) {
+        droppedPages++;
+        return false;
+    }
+
+    auto copy = std::make_unique<uint8_t[]>(PAGE_SIZE);
+    std::memcpy(copy.get(), data, std::min<size_t>(size, PAGE_SIZE));
+    pages.emplace(pageNumber, std::move(copy));
+    return true;
+}
+
+/**
+ * @return: the retained page, nullptr if it wasn't retained
+ */
+const uint8_t *RetainedPages::page(uint64_t pageNumber) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = pages.find(pageNumber);
+    return found == pages.end() ? nullptr : found->second.get();
+}
+
+/**
+ * @return: number of retained pages
+ */
+size_t RetainedPages::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pages.size();
+}
+
+/**
+ * @return: number of pages dropped because the limit was reached
+ */
+uint64_t RetainedPages::dropped() const
+{
+    return droppedPages;
+}
+
+RetainedPageBuf::RetainedPageBuf(std::shared_ptr<const RetainedPages> pages)
+    : pages(std::move(pages))
+{
+}
+
+RetainedPageBuf::int_type RetainedPageBuf::underflow()
+{
+    if (gptr() != nullptr && gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    uint64_t current = currentPosition();
+    const uint8_t *page = pages->page(current >> PAGE_4KB_SHIFT);
+    if (page == nullptr) {
+        setg(nullptr, nullptr, nullptr);
+        position = current;
+        return traits_type::eof();
+    }
+
+    // The get area is never written to, pages are only added to RetainedPages
+    char *data = reinterpret_cast<char *>(const_cast<uint8_t *>(page));
+    pageBase = current & ~static_cast<uint64_t>(PAGE_SIZE - 1);
+    setg(data, data + PAGE_4KB_OFFSET(current), data + PAGE_SIZE);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+RetainedPageBuf::pos_type RetainedPageBuf::seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which)
+{
+    off_type base = 0;
+
+    if (direction == std::ios::cur) {
+        base = static_cast<off_type>(currentPosition());
+    } else if (direction == std::ios::end) {
+        return pos_type(off_type(-1));
+    }
+
+    return seekpos(pos_type(base + offset), which);
+}
+
+RetainedPageBuf::pos_type RetainedPageBuf::seekpos(pos_type target, std::ios::openmode which)
+{
+    if (!(which & std::ios::in) || off_type(target) < 0) {
+        return pos_type(off_type(-1));
+    }
+
+    uint64_t absolute = static_cast<uint64_t>(off_type(target));
+
+    if (gptr() != nullptr && absolute >= pageBase && absolute < pageBase + PAGE_SIZE) {
+        setg(eback(), eback() + (absolute - pageBase), egptr());
+    } else {
+        setg(nullptr, nullptr, nullptr);
+        position = absolute;
+    }
+
+    return target;
+}
+
+uint64_t RetainedPageBuf::currentPosition() const
+{
+    if (gptr() != nullptr) {
+        return pageBase + (gptr() - eback());
+    }
+    return position;
+}
+
+RetainedPageStream::RetainedPageStream(std::shared_ptr<const RetainedPages> pages)
+    : retainedBuffer(std::move(pages))
+{
+    std::ios::rdbuf(&retainedBuffer);
+}
+
+/*
+ * Pool allocations worth keeping when their tag is seen, and the bytes after the pool header they cover.
+ */
+struct FlaggedPoolTag {
+    char tag[5];
+    uint64_t span;
+};
+
+static const FlaggedPoolTag flaggedPoolTags[] = {
+        {"Proc", STREAM_PROCESS_SPAN},
+        {"Pro\xe3", STREAM_PROCESS_SPAN},
+        {"Vad ", STREAM_VAD_SPAN},
+        {"VadS", STREAM_VAD_SPAN},
+        {"VadF", STREAM_VAD_SPAN},
+        {"Vadl", STREAM_VAD_SPAN},
+        {"Vadm", STREAM_VAD_SPAN},
+};
+
+/*
+ * One STREAM_CHUNK_SIZE chunk of the input, with up to STREAM_LOOKAROUND bytes of its neighbours on both sides
+ * so structures crossing the chunk boundaries can be retained whole.
+ */
+struct StreamChunk {
+    std::vector<char> data = std::vector<char>(STREAM_LOOKAROUND + STREAM_CHUNK_SIZE + STREAM_LOOKAROUND);
+    uint64_t offset = 0;
+    size_t size = 0;
+    size_t before = 0;
+    size_t after = 0;
+    ChunkDigest digest{};
+    std::array<uint64_t, static_cast<size_t>(PageClass::Count)> pageClasses{};
+
+    char *core()
+    {
+        return data.data() + STREAM_LOOKAROUND;
+    }
+};
+
+/**
+ * Cheap page table test: at least one present entry, and every present entry points below
+ * PAGE_TABLE_MAX_PFN. Some data pages pass it too, it's meant to keep every table, not only tables.
+ *
+ * @param page: PAGE_SIZE bytes
+ * @return: true if the page may be a page table of any level
+ */
+bool looksLikePageTable(const uint8_t *page)
+{
+    size_t present = 0;
+
+    for (size_t i = 0; i < PAGE_TABLE_ENTRIES; i++) {
+        uint64_t entry;
+        std::memcpy(&entry, page + i * sizeof(uint64_t), sizeof(uint64_t));
+        if (!IS_PAGE_PRESENT(entry)) {
+            continue;
+        }
+
+        uint64_t pageFrameNumber = (entry & 0x000ffffffffff000) >> PAGE_4KB_SHIFT;
+        if (pageFrameNumber >= PAGE_TABLE_MAX_PFN) {
+            return false;
+        }
+        present++;
+    }
+
+    return present != 0;
+}
+
+/**
+ * Retain the pages of a physical range that the chunk and its lookaround hold.
+ */
+static void retainRange(StreamChunk& chunk, uint64_t start, uint64_t end, RetainedPages& pages)
+{
+    uint64_t viewStart = chunk.offset - chunk.before;
+    uint64_t viewEnd = chunk.offset + chunk.size + chunk.after;
+    const uint8_t *view = reinterpret_cast<const uint8_t *>(chunk.core() - chunk.before);
+
+    start = std::max(start, viewStart);
+    end = std::min(end, viewEnd);
+    if (start >= end) {
+        return;
+    }
+
+    for (uint64_t pageNumber = start >> PAGE_4KB_SHIFT; (pageNumber << PAGE_4KB_SHIFT) < end; pageNumber++) {
+        uint64_t pageStart = pageNumber << PAGE_4KB_SHIFT;
+        pages.retain(pageNumber, view + (pageStart - viewStart), std::min<uint64_t>(PAGE_SIZE, viewEnd - pageStart));
+    }
+}
+
+/**
+ * Everything the streaming pass does with one chunk: hash it, look for System, classify its pages and retain
+ * the page tables, _EPROCESS candidates and flagged pool allocations in it.
+ */
+static void processStreamChunk(StreamChunk& chunk, bool hash, SystemProcessScanner& scanner, RetainedPages& pages)
+{
+    const uint8_t *core = reinterpret_cast<const uint8_t *>(chunk.core());
+
+    if (hash) {
+        chunk.digest = ChunkDigest{chunk.offset, chunk.size, sha256Digest(core, chunk.size), blake3Digest(core, chunk.size)};
+    }
+
+    // A scanner of its own tells which candidates are in this chunk
+    SystemProcessScanner chunkScanner(scanner.profiles);
+    chunkScanner.scanChunk(DumpChunk{chunk.offset, chunk.core(), chunk.size, chunk.size + chunk.after});
+
+    std::vector<SystemCandidate> candidates = chunkScanner.validated;
+    candidates.insert(candidates.end(), chunkScanner.deferred.begin(), chunkScanner.deferred.end());
+    for (const SystemCandidate& candidate : candidates) {
+        retainRange(chunk, candidate.kProcess, candidate.kProcess + STREAM_PROCESS_SPAN, pages);
+    }
+
+    if (!candidates.empty()) {
+        std::lock_guard<std::mutex> lock(scanner.mutex);
+        scanner.validated.insert(scanner.validated.end(), chunkScanner.validated.begin(), chunkScanner.validated.end());
+        scanner.deferred.insert(scanner.deferred.end(), chunkScanner.deferred.begin(), chunkScanner.deferred.end());
+    }
+
+    for (size_t position = 0; position + POOL_TAG_OFFSET + 4 <= chunk.size; position += POOL_HEADER_ALIGNMENT) {
+        const char *tag = chunk.core() + position + POOL_TAG_OFFSET;
+        if (*tag != 'P' && *tag != 'V') {
+            continue;
+        }
+
+        for (const FlaggedPoolTag& flagged : flaggedPoolTags) {
+            if (std::memcmp(tag, flagged.tag, 4) == 0) {
+                retainRange(chunk, chunk.offset + position, chunk.offset + position + flagged.span, pages);
+                break;
+            }
+        }
+    }
+
+    for (size_t position = 0; position < chunk.size; position += PAGE_SIZE) {
+        size_t size = std::min<size_t>(PAGE_SIZE, chunk.size - position);
+        PageClass pageClass = classifyPage(core + position, size);
+
+        if (pageClass != PageClass::Zero && size == PAGE_SIZE && looksLikePageTable(core + position)) {
+            pageClass = PageClass::PageTable;
+            pages.retain((chunk.offset + position) >> PAGE_4KB_SHIFT, core + position, size);
+        }
+        chunk.pageClasses[static_cast<size_t>(pageClass)]++;
+    }
+}
+
+/**
+ * Read until the buffer is full or the input ends.
+ *
+ * @return: number of bytes read
+ */
+static size_t readInput(std::istream& input, char *buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size && input) {
+        input.read(buffer + done, static_cast<std::streamsize>(size - done));
+        done += static_cast<size_t>(input.gcount());
+    }
+    return done;
+}
+
+/**
+ * Analyze a dump read once, front to back, from an input that can't seek (a pipe, stdin, a socket).
+ * Chunks are hashed, scanned for System and their pages classified on the pool while the next ones are read.
+ * Only the pages the structure walks need later are retained: page table candidates, the pages around System
+ * candidates and the pool allocations tagged as processes or VADs. Walk them with a RetainedPageStream.
+ *
+ * @param input: the dump, read up to its end
+ * @param options: hashing and the retained pages limit
+ * @param scanner: receives the System candidates, call result() on a RetainedPageStream once the pass is done
+ * @param dump: receives the size, page classes, manifest and retained pages of the dump
+ * @param pool: pool the chunks are processed on
+ * @param progress: optional token counting the bytes read, the pass stops when it is cancelled
+ * @return: true if the input was read to its end, false otherwise
+ */
+bool streamDump(std::istream& input, const StreamOptions& options, SystemProcessScanner& scanner, StreamedDump& dump,
+                ThreadPool& pool, AnalysisProgress *progress)
+{
+    dump = StreamedDump();
+    dump.pages = std::make_shared<RetainedPages>(options.retainLimit);
+    dump.manifest.chunkSize = STREAM_CHUNK_SIZE;
+
+    struct InFlightChunk {
+        std::shared_ptr<StreamChunk> chunk;
+        std::future<void> done;
+    };
+
+    size_t maxInFlight = pool.size() + 1;
+    std::deque<InFlightChunk> inFlight;
+    std::vector<std::shared_ptr<StreamChunk>> freeChunks;
+
+    auto acquire = [&]() {
+        if (freeChunks.empty()) {
+            return std::make_shared<StreamChunk>();
+        }
+        std::shared_ptr<StreamChunk> chunk = freeChunks.back();
+        freeChunks.pop_back();
+        *chunk = StreamChunk{std::move(chunk->data)};
+        return chunk;
+    };
+
+    // Chunks are retired in input order, so the digests are appended in order too
+    auto retire = [&]() {
+        InFlightChunk& oldest = inFlight.front();
+        oldest.done.get();
+        if (options.hash) {
+            dump.manifest.chunks.push_back(oldest.chunk->digest);
+        }
+        for (size_t i = 0; i < dump.pageClasses.size(); i++) {
+            dump.pageClasses[i] += oldest.chunk->pageClasses[i];
+        }
+        freeChunks.push_back(oldest.chunk);
+        inFlight.pop_front();
+    };
+
+    std::shared_ptr<StreamChunk> current = acquire();
+    current->size = readInput(input, current->core(), STREAM_CHUNK_SIZE);
+    bool cancelled = false;
+
+    while (current->size != 0) {
+        if (progress != nullptr && progress->cancelled) {
+            cancelled = true;
+            break;
+        }
+
+        // The next chunk is read first, its head is the lookahead of the current one
+        std::shared_ptr<StreamChunk> next = acquire();
+        next->offset = current->offset + current->size;
+        if (current->size == STREAM_CHUNK_SIZE) {
+            next->size = readInput(input, next->core(), STREAM_CHUNK_SIZE);
+        }
+
+        current->after = std::min<size_t>(STREAM_LOOKAROUND, next->size);
+        std::memcpy(current->core() + current->size, next->core(), current->after);
+        next->before = std::min<size_t>(STREAM_LOOKAROUND, current->size);
+        std::memcpy(next->core() - next->before, current->core() + current->size - next->before, next->before);
+
+        if (inFlight.size() == maxInFlight) {
+            retire();
+        }
+
+        std::shared_ptr<StreamChunk> chunk = current;
+        inFlight.push_back(InFlightChunk{chunk, pool.submit([chunk, &options, &scanner, &dump]() {
+            processStreamChunk(*chunk, options.hash, scanner, *dump.pages);
+        })});
+
+        dump.size += current->size;
+        if (progress != nullptr) {
+            progress->bytesScanned += current->size;
+        }
+        current = next;
+    }
+
+    while (!inFlight.empty()) {
+        retire();
+    }
+
+    if (cancelled) {
+        return false;
+    }
+    if (input.bad()) {
+        std::cerr << "Failed to read the dump stream\n";
+        return false;
+    }
+
+    if (options.hash) {
+        dump.manifest.fileSize = dump.size;
+        dump.manifest.buildTrees();
+    }
+
+    return true;
+}
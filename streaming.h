@@ -0,0 +1,100 @@
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <unordered_map>
+
+#include "hashing.h"
+#include "memory.h"
+#include "memorymap.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_STREAMING_H
+#define DUDEDUMPER_STREAMING_H
+
+#define STREAM_CHUNK_SIZE HASH_CHUNK_SIZE
+#define STREAM_LOOKAROUND 0x2000
+#define STREAM_RETAIN_LIMIT 0x40000000
+#define STREAM_PROCESS_SPAN 0xc00
+#define STREAM_VAD_SPAN 0x100
+#define POOL_HEADER_ALIGNMENT 0x10
+#define POOL_TAG_OFFSET 0x4
+#define PAGE_TABLE_MAX_PFN (1ull << 28)
+
+/*
+ * Pages kept by a streaming pass for the structure walks run after it, by page number.
+ * The first copy of a page wins, pages past the limit are counted and dropped.
+ */
+class RetainedPages {
+public:
+    explicit RetainedPages(size_t capacityBytes = STREAM_RETAIN_LIMIT);
+
+    bool retain(uint64_t pageNumber, const uint8_t *data, size_t size);
+    const uint8_t *page(uint64_t pageNumber) const;
+    size_t size() const;
+    uint64_t dropped() const;
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<uint8_t[]>> pages;
+    size_t capacityPages;
+    std::atomic<uint64_t> droppedPages{0};
+};
+
+struct StreamOptions {
+    bool hash = true;
+    size_t retainLimit = STREAM_RETAIN_LIMIT;
+};
+
+/*
+ * What a streaming pass learned about the dump. The manifest is only filled when hashing was enabled.
+ */
+struct StreamedDump {
+    uint64_t size = 0;
+    DumpHashManifest manifest;
+    std::array<uint64_t, static_cast<size_t>(PageClass::Count)> pageClasses{};
+    std::shared_ptr<RetainedPages> pages;
+};
+
+/*
+ * Stream buffer over the retained pages of a streamed dump, positions are physical addresses.
+ * Pages that weren't retained read as holes.
+ */
+class RetainedPageBuf : public std::streambuf {
+public:
+    explicit RetainedPageBuf(std::shared_ptr<const RetainedPages> pages);
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which) override;
+    pos_type seekpos(pos_type position, std::ios::openmode which) override;
+
+private:
+    uint64_t currentPosition() const;
+
+    std::shared_ptr<const RetainedPages> pages;
+    uint64_t pageBase = 0;
+    uint64_t position = 0;
+};
+
+/*
+ * std::ifstream reading the retained pages, so the functions of memory.h and AddressSpace
+ * resolve structures of a streamed dump unchanged.
+ */
+class RetainedPageStream : public std::ifstream {
+public:
+    explicit RetainedPageStream(std::shared_ptr<const RetainedPages> pages);
+
+private:
+    RetainedPageBuf retainedBuffer;
+};
+
+bool looksLikePageTable(const uint8_t *page);
+bool streamDump(std::istream& input, const StreamOptions& options, SystemProcessScanner& scanner, StreamedDump& dump,
+                ThreadPool& pool = ThreadPool::global(), AnalysisProgress *progress = nullptr);
+
+#endif //DUDEDUMPER_STREAMING_H
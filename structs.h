@@ -43,6 +43,18 @@ struct Process {
     std::vector<VadNode> VadTree;
 };
 
+/*
+ * Part of the dump handed to the scanners during a sequential read pass.
+ * The bytes in [size, readSize) belong to the next chunk and are only there
+ * so that matches crossing the chunk boundary are not lost.
+ */
+struct DumpChunk {
+    uint64_t offset;
+    const char* data;
+    size_t size;
+    size_t readSize;
+};
+
 #define IS_LARGE_PAGE(x)    ((bool)((x >> 7) & 1) )
 #define IS_PAGE_PRESENT(x)  ((bool)(x & 1))
 
@@ -0,0 +1,260 @@
+#include "tables.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#define TABLE_HEIGHT_ROWS 20
+
+enum VadColumn {
+	VadColumn_Start,
+	VadColumn_End,
+	VadColumn_Size
+};
+
+enum ProcessColumn {
+	ProcessColumn_Index,
+	ProcessColumn_Name,
+	ProcessColumn_KProcess,
+	ProcessColumn_DirectoryTableBase,
+	ProcessColumn_VadCount
+};
+
+/**
+ * Returns the sort direction of the first sort spec as +1/-1, 0 if the table isn't sorted
+ */
+static int SortDirection(const ImGuiTableSortSpecs* sortSpecs, int& column)
+{
+	if (sortSpecs == nullptr || sortSpecs->SpecsCount == 0)
+		return 0;
+
+	column = sortSpecs->Specs[0].ColumnIndex;
+	return sortSpecs->Specs[0].SortDirection == ImGuiSortDirection_Descending ? -1 : 1;
+}
+
+/**
+ * Rebuilds the row cache when another process is selected or the process list was replaced
+ */
+void VadTable::SetProcess(const Process* process, size_t processIndex, size_t processGeneration)
+{
+	// The process list may have been reallocated since the last frame, so the pointer is always refreshed
+	nodes = process != nullptr ? &process->VadTree : nullptr;
+	if (processIndex == cachedProcess && processGeneration == cachedGeneration)
+		return;
+
+	cachedProcess = processIndex;
+	cachedGeneration = processGeneration;
+	rows.clear();
+	order.clear();
+
+	if (nodes == nullptr)
+		return;
+
+	rows.resize(nodes->size());
+	order.resize(nodes->size());
+	for (size_t i = 0; i < nodes->size(); i++)
+	{
+		const VadNode& node = (*nodes)[i];
+		snprintf(rows[i].start, sizeof(rows[i].start), "%llx", static_cast<unsigned long long>(node.startAddress));
+		snprintf(rows[i].end, sizeof(rows[i].end), "%llx", static_cast<unsigned long long>(node.endAddress));
+		snprintf(rows[i].size, sizeof(rows[i].size), "%llx", static_cast<unsigned long long>(node.endAddress - node.startAddress));
+		order[i] = static_cast<uint32_t>(i);
+	}
+
+	needsSort = true;
+}
+
+void VadTable::Sort(const ImGuiTableSortSpecs* sortSpecs)
+{
+	int column = VadColumn_Start;
+	int direction = SortDirection(sortSpecs, column);
+	if (direction == 0 || nodes == nullptr)
+		return;
+
+	const std::vector<VadNode>& vads = *nodes;
+	auto key = [&](uint32_t index) {
+		switch (column)
+		{
+		case VadColumn_End:
+			return vads[index].endAddress;
+		case VadColumn_Size:
+			return vads[index].endAddress - vads[index].startAddress;
+		default:
+			return vads[index].startAddress;
+		}
+	};
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {
+		return direction > 0 ? key(left) < key(right) : key(left) > key(right);
+	});
+}
+
+/**
+ * Draws the VAD nodes of the selected process, submitting only the visible rows
+ */
+void VadTable::Draw()
+{
+	ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable;
+	ImVec2 outerSize(0.0f, ImGui::GetTextLineHeightWithSpacing() * TABLE_HEIGHT_ROWS);
+
+	if (!ImGui::BeginTable("VadNodes", 3, flags, outerSize))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("StartAddress", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort);
+	ImGui::TableSetupColumn("EndAddress", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableHeadersRow();
+
+	ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+	if (sortSpecs != nullptr && (sortSpecs->SpecsDirty || needsSort))
+	{
+		Sort(sortSpecs);
+		sortSpecs->SpecsDirty = false;
+		needsSort = false;
+	}
+
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(order.size()));
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+		{
+			const Row& row = rows[order[i]];
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(VadColumn_Start);
+			ImGui::TextUnformatted(row.start);
+			ImGui::TableSetColumnIndex(VadColumn_End);
+			ImGui::TextUnformatted(row.end);
+			ImGui::TableSetColumnIndex(VadColumn_Size);
+			ImGui::TextUnformatted(row.size);
+		}
+	}
+
+	ImGui::EndTable();
+}
+
+/**
+ * Formats the rows of the processes added since the last call, or all of them if the list was replaced
+ */
+void ProcessTable::Sync(const std::vector<Process>& processList, size_t processGeneration)
+{
+	if (processGeneration != cachedGeneration)
+	{
+		cachedGeneration = processGeneration;
+		rows.clear();
+		order.clear();
+	}
+
+	processes = &processList;
+	if (rows.size() == processList.size())
+		return;
+
+	for (size_t i = rows.size(); i < processList.size(); i++)
+	{
+		const Process& process = processList[i];
+		Row row;
+		snprintf(row.name, sizeof(row.name), "%s", process.ProcessName.c_str());
+		snprintf(row.kProcess, sizeof(row.kProcess), "%llx", static_cast<unsigned long long>(process.KProcessAddress));
+		snprintf(row.directoryTableBase, sizeof(row.directoryTableBase), "%llx", static_cast<unsigned long long>(process.DirectoryTableBase));
+		snprintf(row.vadCount, sizeof(row.vadCount), "%zu", process.VadTree.size());
+		rows.push_back(row);
+		order.push_back(static_cast<uint32_t>(i));
+	}
+
+	needsSort = true;
+}
+
+void ProcessTable::Sort(const ImGuiTableSortSpecs* sortSpecs)
+{
+	int column = ProcessColumn_Index;
+	int direction = SortDirection(sortSpecs, column);
+	if (direction == 0 || processes == nullptr)
+		return;
+
+	const std::vector<Process>& list = *processes;
+	auto less = [&](uint32_t left, uint32_t right) {
+		switch (column)
+		{
+		case ProcessColumn_Name:
+			return list[left].ProcessName < list[right].ProcessName;
+		case ProcessColumn_KProcess:
+			return list[left].KProcessAddress < list[right].KProcessAddress;
+		case ProcessColumn_DirectoryTableBase:
+			return list[left].DirectoryTableBase < list[right].DirectoryTableBase;
+		case ProcessColumn_VadCount:
+			return list[left].VadTree.size() < list[right].VadTree.size();
+		default:
+			return left < right;
+		}
+	};
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {
+		return direction > 0 ? less(left, right) : less(right, left);
+	});
+}
+
+/**
+ * Draws the process list, submitting only the visible rows
+ * Returns true if a process was clicked, its index is stored in selectedProcess
+ */
+bool ProcessTable::Draw(int& selectedProcess)
+{
+	ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable;
+	ImVec2 outerSize(0.0f, ImGui::GetTextLineHeightWithSpacing() * TABLE_HEIGHT_ROWS);
+	bool clicked = false;
+
+	if (!ImGui::BeginTable("Processes", 5, flags, outerSize))
+		return false;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("#", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort);
+	ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+	ImGui::TableSetupColumn("_EPROCESS", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("DirectoryTableBase", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableSetupColumn("VADs", ImGuiTableColumnFlags_WidthFixed);
+	ImGui::TableHeadersRow();
+
+	ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+	if (sortSpecs != nullptr && (sortSpecs->SpecsDirty || needsSort))
+	{
+		Sort(sortSpecs);
+		sortSpecs->SpecsDirty = false;
+		needsSort = false;
+	}
+
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(order.size()));
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+		{
+			uint32_t index = order[i];
+			const Row& row = rows[index];
+
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(ProcessColumn_Index);
+			ImGui::PushID(static_cast<int>(index));
+			char label[12];
+			snprintf(label, sizeof(label), "%u", index);
+			if (ImGui::Selectable(label, selectedProcess == static_cast<int>(index), ImGuiSelectableFlags_SpanAllColumns))
+			{
+				selectedProcess = static_cast<int>(index);
+				clicked = true;
+			}
+			ImGui::PopID();
+
+			ImGui::TableSetColumnIndex(ProcessColumn_Name);
+			ImGui::TextUnformatted(row.name);
+			ImGui::TableSetColumnIndex(ProcessColumn_KProcess);
+			ImGui::TextUnformatted(row.kProcess);
+			ImGui::TableSetColumnIndex(ProcessColumn_DirectoryTableBase);
+			ImGui::TextUnformatted(row.directoryTableBase);
+			ImGui::TableSetColumnIndex(ProcessColumn_VadCount);
+			ImGui::TextUnformatted(row.vadCount);
+		}
+	}
+
+	ImGui::EndTable();
+	return clicked;
+}
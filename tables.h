@@ -0,0 +1,56 @@
+#pragma once
+
+#include "imgui.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "structs.h"
+
+/*
+ * Rows are formatted once into fixed buffers and only the visible ones are submitted to ImGui.
+ * Sorting reorders an index array, the process data itself is never moved.
+ */
+class VadTable {
+public:
+	void SetProcess(const Process* process, size_t processIndex, size_t processGeneration);
+	void Draw();
+
+private:
+	struct Row {
+		char start[20];
+		char end[20];
+		char size[20];
+	};
+
+	void Sort(const ImGuiTableSortSpecs* sortSpecs);
+
+	const std::vector<VadNode>* nodes = nullptr;
+	std::vector<Row> rows;
+	std::vector<uint32_t> order;
+	size_t cachedProcess = SIZE_MAX;
+	size_t cachedGeneration = SIZE_MAX;
+	bool needsSort = false;
+};
+
+class ProcessTable {
+public:
+	void Sync(const std::vector<Process>& processList, size_t processGeneration);
+	bool Draw(int& selectedProcess);
+
+private:
+	struct Row {
+		char name[16];
+		char kProcess[20];
+		char directoryTableBase[20];
+		char vadCount[12];
+	};
+
+	void Sort(const ImGuiTableSortSpecs* sortSpecs);
+
+	const std::vector<Process>* processes = nullptr;
+	std::vector<Row> rows;
+	std::vector<uint32_t> order;
+	size_t cachedGeneration = SIZE_MAX;
+	bool needsSort = false;
+};
@@ -0,0 +1,143 @@
+#include "threadpool.h"
+
+#include <atomic>
+
+static size_t globalThreadCount = 0;
+
+/**
+ * Start the worker threads.
+ *
+ * @param threadCount: number of workers, at least one worker is always started
+ */
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+/**
+ * Finish the queued tasks and join the workers.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Run body(0) ... body(count - 1) on the pool and wait for all of them.
+ * The calling thread takes part in the loop, so it is safe to call this from inside a pool task.
+ *
+ * @param count: number of iterations
+ * @param body: loop body, called concurrently with different indices
+ */
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0) {
+        return;
+    }
+
+    struct LoopState {
+        std::atomic<size_t> nextIndex{0};
+        std::atomic<size_t> finished{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    auto state = std::make_shared<LoopState>();
+    const std::function<void(size_t)>* loopBody = &body;
+
+    // Helpers which start after the loop is exhausted return without touching loopBody,
+    // so it is never used after parallelFor returns.
+    auto runLoop = [state, loopBody, count]() {
+        for (size_t i = state->nextIndex++; i < count; i = state->nextIndex++) {
+            (*loopBody)(i);
+
+            if (++state->finished == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, workers.size());
+    for (size_t i = 0; i < helpers; i++) {
+        enqueue(runLoop);
+    }
+
+    runLoop();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->finished == count; });
+}
+
+/**
+ * @return: number of worker threads
+ */
+size_t ThreadPool::size() const
+{
+    return workers.size();
+}
+
+/**
+ * Process-wide pool, sized to the number of hardware threads unless configureGlobal was called first.
+ *
+ * @return: the shared pool
+ */
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool(globalThreadCount != 0 ? globalThreadCount : std::thread::hardware_concurrency());
+    return pool;
+}
+
+/**
+ * Set the number of workers of the global pool. Has no effect once global() was called.
+ *
+ * @param threadCount: number of workers, 0 for the number of hardware threads
+ */
+void ThreadPool::configureGlobal(size_t threadCount)
+{
+    globalThreadCount = threadCount;
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (stopping && tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,56 @@
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef DUDEDUMPER_THREADPOOL_H
+#define DUDEDUMPER_THREADPOOL_H
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queue a task for execution on one of the workers.
+     *
+     * @param task: callable without arguments
+     * @return: future holding the result of the task
+     */
+    template<class F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<F>>
+    {
+        using Result = std::invoke_result_t<F>;
+        auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packagedTask->get_future();
+        enqueue([packagedTask]() { (*packagedTask)(); });
+        return result;
+    }
+
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+    size_t size() const;
+
+    static ThreadPool& global();
+    static void configureGlobal(size_t threadCount);
+
+private:
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+#endif //DUDEDUMPER_THREADPOOL_H
@@ -0,0 +1,404 @@
+#include "triage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "addressspace.h"
+#include "crashdump.h"
+#include "dumpformat.h"
+#include "pagecache.h"
+#include "physicalspace.h"
+
+
+/**
+ * @param source: buffer of the stream the reads are forwarded to, it must outlive this one
+ */
+RecordingBuf::RecordingBuf(std::streambuf *source)
+    : source(source)
+{
+}
+
+/**
+ * @return: numbers of the pages read so far, partially read pages included
+ */
+const std::unordered_set<uint64_t>& RecordingBuf::pages() const
+{
+    return touched;
+}
+
+RecordingBuf::int_type RecordingBuf::underflow()
+{
+    if (gptr() != nullptr && gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    uint64_t current = currentPosition();
+    uint64_t base = current & ~static_cast<uint64_t>(PAGE_SIZE - 1);
+    std::streamsize size = 0;
+    if (source->pubseekpos(static_cast<off_type>(base), std::ios::in) != pos_type(off_type(-1))) {
+        size = source->sgetn(page, PAGE_SIZE);
+    }
+
+    if (size <= static_cast<std::streamsize>(current - base)) {
+        setg(nullptr, nullptr, nullptr);
+        position = current;
+        return traits_type::eof();
+    }
+
+    touched.insert(base >> PAGE_4KB_SHIFT);
+    pageBase = base;
+    setg(page, page + (current - base), page + size);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+RecordingBuf::pos_type RecordingBuf::seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which)
+{
+    off_type base = 0;
+
+    if (direction == std::ios::cur) {
+        base = static_cast<off_type>(currentPosition());
+    } else if (direction == std::ios::end) {
+        base = off_type(source->pubseekoff(0, std::ios::end, std::ios::in));
+        if (base < 0) {
+            return pos_type(off_type(-1));
+        }
+    }
+
+    return seekpos(pos_type(base + offset), which);
+}
+
+RecordingBuf::pos_type RecordingBuf::seekpos(pos_type target, std::ios::openmode which)
+{
+    if (!(which & std::ios::in) || off_type(target) < 0) {
+        return pos_type(off_type(-1));
+    }
+
+    uint64_t absolute = static_cast<uint64_t>(off_type(target));
+
+    if (gptr() != nullptr && absolute >= pageBase && absolute < pageBase + (egptr() - eback())) {
+        setg(eback(), eback() + (absolute - pageBase), egptr());
+    } else {
+        setg(nullptr, nullptr, nullptr);
+        position = absolute;
+    }
+
+    return target;
+}
+
+uint64_t RecordingBuf::currentPosition() const
+{
+    if (gptr() != nullptr) {
+        return pageBase + (gptr() - eback());
+    }
+    return position;
+}
+
+RecordingStream::RecordingStream(std::streambuf *source)
+    : recordingBuffer(source)
+{
+    std::ios::rdbuf(&recordingBuffer);
+}
+
+const std::unordered_set<uint64_t>& RecordingStream::pages() const
+{
+    return recordingBuffer.pages();
+}
+
+/**
+ * @param processes: process list, in list order
+ * @param selection: names or indexes in the list
+ * @return: the processes matching an entry of the selection, each _EPROCESS once
+ */
+static std::vector<Process> selectProcesses(const std::vector<Process>& processes, const std::vector<std::string>& selection)
+{
+    std::vector<Process> selected;
+
+    for (size_t i = 0; i < processes.size(); i++) {
+        const Process& process = processes[i];
+        bool matches = std::any_of(selection.begin(), selection.end(), [&](const std::string& entry) {
+            return entry == process.ProcessName || entry == std::to_string(i);
+        });
+        bool listed = std::any_of(selected.begin(), selected.end(), [&](const Process& other) {
+            return other.KProcessAddress == process.KProcessAddress;
+        });
+
+        if (matches && !listed) {
+            selected.push_back(process);
+        }
+    }
+
+    return selected;
+}
+
+/*
+ * Pages one collection task needs in the triage dump: the structures its walk read, and the
+ * present pages of the VADs for the processes.
+ */
+struct TriagePages {
+    std::unordered_set<uint64_t> structures;
+    std::vector<uint64_t> data;
+};
+
+/**
+ * Walk the process list the way the analysis of the triage dump will, and find PsActiveProcessHead
+ * from the Blink of System so the dump header can point at it.
+ *
+ * @param kernelSpace: address space of System, over a RecordingStream
+ * @param systemKProcess: offset of _KPROCESS structure of System
+ * @return: virtual address of PsActiveProcessHead, 0 if it can't be read
+ */
+static uint64_t walkKernelStructures(AddressSpace& kernelSpace, uint64_t systemKProcess)
+{
+    kernelSpace.walkProcessList(systemKProcess, [](const Process&) {}, false);
+
+    const OffsetsProfile& offsets = kernelSpace.profile();
+    uint64_t head, firstLinks;
+    if (!kernelSpace.readPhysical(systemKProcess + offsets.activeProcessLinksBlink, &head, sizeof(uint64_t), true)) {
+        return 0;
+    }
+
+    // The head is only kept if it leads back to System
+    uint64_t headPhysical = kernelSpace.translate(head, true);
+    if (headPhysical == 0 || !kernelSpace.readPhysical(headPhysical, &firstLinks, sizeof(uint64_t), true)
+        || kernelSpace.translate(firstLinks, true) != systemKProcess + offsets.activeProcessLinksFlink) {
+        return 0;
+    }
+
+    return head;
+}
+
+/**
+ * Read the VAD tree of a process and list the present pages its VADs cover. Large pages are clipped
+ * to the VADs, only their 4KB pages inside a VAD are exported.
+ *
+ * @param space: address space of the process, over a RecordingStream
+ * @param process: process to export
+ * @param pages: receives the physical page numbers
+ */
+static void collectProcessPages(AddressSpace& space, const Process& process, std::vector<uint64_t>& pages)
+{
+    std::vector<VadNode> vads = space.readProcessVadTree(process.KProcessAddress);
+
+    for (const VadNode& vad : vads) {
+        if (vad.endAddress <= vad.startAddress) {
+            continue;
+        }
+
+        space.walk(vad.startAddress, vad.endAddress, [&](const PageMapping& mapping) {
+            uint64_t first = std::max(mapping.virtualAddress, vad.startAddress) & ~static_cast<uint64_t>(PAGE_SIZE - 1);
+            uint64_t last = std::min(mapping.virtualAddress + mapping.size, vad.endAddress);
+            for (uint64_t address = first; address < last; address += PAGE_SIZE) {
+                pages.push_back((mapping.physicalAddress + (address - mapping.virtualAddress)) >> PAGE_4KB_SHIFT);
+            }
+        });
+    }
+}
+
+template<typename T>
+static void putField(std::vector<uint8_t>& header, size_t offset, T value)
+{
+    std::memcpy(header.data() + offset, &value, sizeof(T));
+}
+
+/**
+ * Write the pages of a triage dump, read from the source in parallel a batch at a time and written in
+ * page order, consecutive pages with a single write.
+ *
+ * @param output: output file, positioned at the first page
+ * @param pages: sorted physical page numbers
+ * @param readers: one stream over the source dump per reading thread
+ * @param bitmap: receives a set bit for every page written
+ * @return: number of pages written, pages that fail to read are left out
+ */
+static uint64_t writeTriagePages(std::ofstream& output, const std::vector<uint64_t>& pages,
+                                 std::vector<std::unique_ptr<CachedDumpStream>>& readers, std::vector<uint64_t>& bitmap,
+                                 ThreadPool& pool, AnalysisProgress *progress)
+{
+    std::vector<char> batch(TRIAGE_BATCH_PAGES * PAGE_SIZE);
+    std::vector<uint8_t> readable(TRIAGE_BATCH_PAGES);
+    uint64_t written = 0;
+
+    for (size_t first = 0; first < pages.size(); first += TRIAGE_BATCH_PAGES) {
+        if (progress != nullptr && progress->cancelled) {
+            break;
+        }
+
+        size_t count = std::min<size_t>(TRIAGE_BATCH_PAGES, pages.size() - first);
+        size_t slices = std::min(readers.size(), count);
+        pool.parallelFor(slices, [&](size_t slice) {
+            AddressSpace physical(*readers[slice], 0);
+            for (size_t i = slice; i < count; i += slices) {
+                readable[i] = physical.readPhysical(pages[first + i] << PAGE_4KB_SHIFT, &batch[i * PAGE_SIZE], PAGE_SIZE, true);
+            }
+        });
+
+        size_t i = 0;
+        while (i < count) {
+            if (!readable[i]) {
+                i++;
+                continue;
+            }
+
+            size_t run = i;
+            while (run < count && readable[run]) {
+                bitmap[pages[first + run] / 64] |= 1ULL << (pages[first + run] % 64);
+                run++;
+            }
+            output.write(&batch[i * PAGE_SIZE], static_cast<std::streamsize>((run - i) * PAGE_SIZE));
+            written += run - i;
+            i = run;
+        }
+
+        if (progress != nullptr) {
+            progress->bytesScanned += count * PAGE_SIZE;
+        }
+    }
+
+    return written;
+}
+
+/**
+ * Export the processes selected from a dump as a bitmap kernel crash dump holding only what their
+ * analysis reads: the process list, their VAD trees and page tables, and the present pages of their VADs.
+ * The header points at the DirectoryTableBase of System and at PsActiveProcessHead, so the triage dump
+ * is opened like any other crash dump.
+ *
+ * @param inputPath: path to the dump
+ * @param outputPath: path of the triage dump
+ * @param options: processes to export and the profiles to find System with
+ * @param summary: receives the exported processes and the page counts
+ * @param pool: pool the pages are collected and read on
+ * @param progress: optional token, totalBytes is the size of the pages to write
+ * @return: true if the triage dump was written, false otherwise
+ */
+bool writeTriageDump(const std::string& inputPath, const std::string& outputPath, const TriageOptions& options,
+                     TriageSummary& summary, ThreadPool& pool, AnalysisProgress *progress)
+{
+    DumpLayout layout = openDumpLayout(inputPath);
+    auto cache = std::make_shared<PageCache>(options.cacheSize);
+    CachedDumpStream file(inputPath, cache, layout);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << inputPath << "\n";
+        return false;
+    }
+
+    WindowsProfile profile;
+    std::ptrdiff_t systemKProcess = detectProfile(file, layout, options.profiles, profile);
+    if (systemKProcess == 0) {
+        std::cerr << "System process not found in " << inputPath << "\n";
+        return false;
+    }
+
+    uint64_t systemDirectoryTableBase = profile.offsets.systemDirectoryTableBase;
+    std::vector<Process> processes;
+    AddressSpace(file, systemDirectoryTableBase, profile.offsets, nullptr, layout.physical).walkProcessList(systemKProcess, [&](const Process& process) {
+        processes.push_back(process);
+    }, false);
+
+    std::vector<Process> selected = selectProcesses(processes, options.processes);
+    if (selected.empty()) {
+        std::cerr << "None of the selected processes is in " << inputPath << "\n";
+        return false;
+    }
+
+    // Task 0 walks the kernel structures, task i + 1 the process i
+    std::vector<TriagePages> collected(selected.size() + 1);
+    uint64_t activeProcessHead = 0;
+    pool.parallelFor(collected.size(), [&](size_t task) {
+        CachedDumpStream source(inputPath, cache, layout);
+        RecordingStream recording(static_cast<std::istream&>(source).rdbuf());
+
+        if (task == 0) {
+            AddressSpace kernelSpace(recording, systemDirectoryTableBase, profile.offsets, nullptr, layout.physical);
+            activeProcessHead = walkKernelStructures(kernelSpace, systemKProcess);
+        } else {
+            const Process& process = selected[task - 1];
+            AddressSpace space(recording, process.DirectoryTableBase, profile.offsets, nullptr, layout.physical);
+            collectProcessPages(space, process, collected[task].data);
+        }
+
+        collected[task].structures = recording.pages();
+    });
+
+    std::vector<uint64_t> pages;
+    for (const TriagePages& task : collected) {
+        pages.insert(pages.end(), task.structures.begin(), task.structures.end());
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    if (pages.empty()) {
+        std::cerr << "Nothing to export from " << inputPath << "\n";
+        return false;
+    }
+    summary.structurePages = pages.size();
+
+    // Mappings may point past the memory the dump holds, these pages can't be exported
+    for (const TriagePages& task : collected) {
+        for (uint64_t page : task.data) {
+            if (layout.physical == nullptr || layout.physical->isPagePresent(page)) {
+                pages.push_back(page);
+            }
+        }
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    summary.dataPages = pages.size() - summary.structurePages;
+
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        std::cerr << "Failed to write " << outputPath << "\n";
+        return false;
+    }
+
+    if (progress != nullptr) {
+        progress->totalBytes = pages.size() * PAGE_SIZE;
+    }
+
+    uint64_t bitmapSize = (pages.back() + 64) & ~63ULL;
+    uint64_t firstPageOffset = (DUMP_HEADER64_SIZE + SUMMARY_DUMP_BITMAP + bitmapSize / 8 + PAGE_SIZE - 1)
+                               & ~static_cast<uint64_t>(PAGE_SIZE - 1);
+    std::vector<uint64_t> bitmap(bitmapSize / 64, 0);
+
+    std::vector<std::unique_ptr<CachedDumpStream>> readers;
+    for (size_t i = 0; i < std::max<size_t>(pool.size(), 1); i++) {
+        readers.push_back(std::make_unique<CachedDumpStream>(inputPath, cache, layout));
+    }
+
+    output.seekp(static_cast<std::streamoff>(firstPageOffset));
+    summary.pagesWritten = writeTriagePages(output, pages, readers, bitmap, pool, progress);
+    summary.missingPages = pages.size() - summary.pagesWritten;
+    if (progress != nullptr && progress->cancelled) {
+        return false;
+    }
+
+    // The header goes last, once the pages that failed to read are known
+    std::vector<uint8_t> header(firstPageOffset, 0);
+    putField<uint32_t>(header, 0, DUMP_SIGNATURE);
+    putField<uint32_t>(header, 4, DUMP_VALID_DUMP64);
+    putField<uint64_t>(header, DUMP_DIRECTORY_TABLE_BASE, systemDirectoryTableBase);
+    putField<uint64_t>(header, DUMP_PS_ACTIVE_PROCESS_HEAD, activeProcessHead);
+    putField<uint32_t>(header, DUMP_MACHINE_IMAGE_TYPE, DUMP_MACHINE_AMD64);
+    putField<uint32_t>(header, DUMP_TYPE, DUMP_TYPE_BITMAP_KERNEL);
+    putField<uint32_t>(header, DUMP_HEADER64_SIZE, SUMMARY_DUMP_SIGNATURE);
+    putField<uint32_t>(header, DUMP_HEADER64_SIZE + 4, SUMMARY_DUMP_VALID_DUMP);
+    putField<uint64_t>(header, DUMP_HEADER64_SIZE + SUMMARY_DUMP_HEADER_SIZE, firstPageOffset);
+    putField<uint64_t>(header, DUMP_HEADER64_SIZE + SUMMARY_DUMP_BITMAP_SIZE, bitmapSize);
+    putField<uint64_t>(header, DUMP_HEADER64_SIZE + SUMMARY_DUMP_PAGES, summary.pagesWritten);
+    std::memcpy(header.data() + DUMP_HEADER64_SIZE + SUMMARY_DUMP_BITMAP, bitmap.data(), bitmap.size() * sizeof(uint64_t));
+
+    output.seekp(0);
+    output.write(reinterpret_cast<const char *>(header.data()), static_cast<std::streamsize>(header.size()));
+    if (!output.good()) {
+        std::cerr << "Failed to write " << outputPath << "\n";
+        return false;
+    }
+
+    for (const Process& process : selected) {
+        summary.processes.push_back(process.ProcessName);
+    }
+
+    return true;
+}
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "memory.h"
+#include "profile.h"
+#include "threadpool.h"
+
+#ifndef DUDEDUMPER_TRIAGE_H
+#define DUDEDUMPER_TRIAGE_H
+
+#define TRIAGE_BATCH_PAGES 1024
+#define TRIAGE_CACHE_SIZE 0x4000000
+
+/*
+ * Stream buffer recording the pages read through it, by page number. Reads are forwarded to the
+ * buffer of another stream a page at a time, positions are physical addresses.
+ */
+class RecordingBuf : public std::streambuf {
+public:
+    explicit RecordingBuf(std::streambuf *source);
+
+    const std::unordered_set<uint64_t>& pages() const;
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type offset, std::ios::seekdir direction, std::ios::openmode which) override;
+    pos_type seekpos(pos_type position, std::ios::openmode which) override;
+
+private:
+    uint64_t currentPosition() const;
+
+    std::streambuf *source;
+    std::unordered_set<uint64_t> touched;
+    uint64_t pageBase = 0;
+    uint64_t position = 0;
+    char page[PAGE_SIZE];
+};
+
+/*
+ * std::ifstream recording the pages read by the functions of memory.h and AddressSpace,
+ * e.g. the pages of the kernel structures and page tables a walk goes through.
+ */
+class RecordingStream : public std::ifstream {
+public:
+    explicit RecordingStream(std::streambuf *source);
+
+    const std::unordered_set<uint64_t>& pages() const;
+
+private:
+    RecordingBuf recordingBuffer;
+};
+
+struct TriageOptions {
+    // Names or indexes in the process list, every process with a matching name is exported
+    std::vector<std::string> processes;
+    std::vector<WindowsProfile> profiles;
+    size_t cacheSize = TRIAGE_CACHE_SIZE;
+};
+
+struct TriageSummary {
+    std::vector<std::string> processes;
+    uint64_t structurePages = 0;
+    uint64_t dataPages = 0;
+    uint64_t pagesWritten = 0;
+    uint64_t missingPages = 0;
+};
+
+bool writeTriageDump(const std::string& inputPath, const std::string& outputPath, const TriageOptions& options,
+                     TriageSummary& summary, ThreadPool& pool = ThreadPool::global(), AnalysisProgress *progress = nullptr);
+
+#endif //DUDEDUMPER_TRIAGE_H
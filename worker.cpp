@@ -0,0 +1,391 @@
+#include "worker.h"
+
+#include <unordered_map>
+
+#include "addressspace.h"
+#include "growingfile.h"
+#include "pagecache.h"
+
+
+AnalysisWorker::~AnalysisWorker()
+{
+    cancel();
+}
+
+/**
+ * Start analyzing a dump, cancelling the analysis in progress if there is one.
+ *
+ * @param path: path to the dump
+ * @param cache: page cache of the dump shared with other readers, a private one is used if null
+ * @param followGrowth: the dump is a raw image still being written, follow it until its writer is done
+ */
+void AnalysisWorker::start(const std::string& path, std::shared_ptr<PageCache> cache, bool followGrowth)
+{
+    cancel();
+
+    analysisProgress.bytesScanned = 0;
+    analysisProgress.totalBytes = 0;
+    analysisProgress.processesFound = 0;
+    analysisProgress.cancelled = false;
+    finishedAfterMs = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        processes.clear();
+        errorMessage.clear();
+        dumpFingerprint = DumpFingerprint{};
+        detectedProfile = WindowsProfile{};
+    }
+
+    startTime = std::chrono::steady_clock::now();
+    currentState = AnalysisState::Scanning;
+    following = followGrowth;
+    thread = std::thread(followGrowth ? &AnalysisWorker::follow : &AnalysisWorker::run, this, path, std::move(cache),
+                         profileCandidates);
+}
+
+/**
+ * Stop the running analysis and wait for the worker thread. The processes read so far are kept.
+ */
+void AnalysisWorker::cancel()
+{
+    analysisProgress.cancelled = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+/**
+ * Set the layouts probed by the next analyses, the built-in profiles are used by default.
+ *
+ * @param profiles: candidate profiles, in order of preference
+ */
+void AnalysisWorker::setProfiles(std::vector<WindowsProfile> profiles)
+{
+    profileCandidates = std::move(profiles);
+}
+
+AnalysisState AnalysisWorker::state() const
+{
+    return currentState;
+}
+
+bool AnalysisWorker::isRunning() const
+{
+    AnalysisState state = currentState;
+    return state == AnalysisState::Scanning || state == AnalysisState::ReadingProcesses;
+}
+
+/**
+ * @return: true while a followed dump is still being written
+ */
+bool AnalysisWorker::isFollowing() const
+{
+    return following;
+}
+
+std::string AnalysisWorker::error() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return errorMessage;
+}
+
+DumpFingerprint AnalysisWorker::fingerprint() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return dumpFingerprint;
+}
+
+/**
+ * @return: profile detected on the dump, the name is empty until System was found
+ */
+WindowsProfile AnalysisWorker::profile() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return detectedProfile;
+}
+
+/**
+ * Append the processes published since the last call.
+ *
+ * @param processList: processes already fetched, the new ones are appended to it
+ * @param seenRevision: processRevision() the list was fetched at, if it changed since the list is
+ *                      fetched again from scratch and the new revision is stored
+ * @return: number of processes appended
+ */
+size_t AnalysisWorker::fetchProcesses(std::vector<Process>& processList, size_t *seenRevision) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (seenRevision != nullptr && *seenRevision != revision) {
+        processList.clear();
+        *seenRevision = revision;
+    }
+
+    size_t fetched = processList.size();
+    if (fetched >= processes.size()) {
+        return 0;
+    }
+
+    processList.insert(processList.end(), processes.begin() + fetched, processes.end());
+    return processes.size() - fetched;
+}
+
+/**
+ * @return: counter changed whenever processes already published were replaced, fetch them all again then
+ */
+size_t AnalysisWorker::processRevision() const
+{
+    return revision;
+}
+
+const AnalysisProgress& AnalysisWorker::progress() const
+{
+    return analysisProgress;
+}
+
+/**
+ * @return: seconds since the analysis started, frozen once it finished
+ */
+double AnalysisWorker::elapsedSeconds() const
+{
+    int64_t finishedMs = finishedAfterMs;
+    if (finishedMs >= 0) {
+        return finishedMs / 1000.0;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    return elapsed.count();
+}
+
+/**
+ * @return: scan throughput in bytes per second
+ */
+double AnalysisWorker::throughput() const
+{
+    double elapsed = elapsedSeconds();
+    return elapsed > 0 ? analysisProgress.bytesScanned / elapsed : 0;
+}
+
+void AnalysisWorker::run(std::string path, std::shared_ptr<PageCache> cache, std::vector<WindowsProfile> profiles)
+{
+    if (!cache) {
+        cache = std::make_shared<PageCache>(WORKER_CACHE_SIZE);
+    }
+    DumpLayout layout = openDumpLayout(path);
+    CachedDumpStream file(path, cache, layout);
+
+    if (!file.is_open()) {
+        fail("Failed to open file: " + path);
+        return;
+    }
+
+    WindowsProfile detected;
+    std::ptrdiff_t systemKProcessAddress = detectProfile(file, layout, profiles, detected, &analysisProgress);
+    if (analysisProgress.cancelled) {
+        setState(AnalysisState::Cancelled);
+        return;
+    }
+
+    if (systemKProcessAddress == 0) {
+        fail("Failed to find the System _EPROCESS");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        detectedProfile = detected;
+    }
+    setState(AnalysisState::ReadingProcesses);
+
+    AddressSpace systemSpace(file, detected.offsets.systemDirectoryTableBase, detected.offsets, nullptr, layout.physical);
+    systemSpace.walkProcessList(systemKProcessAddress, [&](const Process& process) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            processes.push_back(process);
+        }
+        notify();
+    }, true, &analysisProgress);
+
+    if (analysisProgress.cancelled) {
+        setState(AnalysisState::Cancelled);
+        return;
+    }
+
+    DumpFingerprint computed = computeDumpFingerprint(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dumpFingerprint = computed;
+    }
+
+    setState(AnalysisState::Done);
+}
+
+/**
+ * Analyze a raw dump while it is being written. Every round scans the bytes written since the previous one
+ * for System, until it is found, then walks the process list again from it. Structures whose pages aren't
+ * written yet are read again in the next round: the walk stops at the first missing _EPROCESS, and a VAD tree
+ * is only published once it was read without failed reads. The dump is complete when its writer closes it,
+ * or when it didn't grow for GROWING_FILE_IDLE_MS.
+ */
+void AnalysisWorker::follow(std::string path, std::shared_ptr<PageCache> cache, std::vector<WindowsProfile> profiles)
+{
+    if (!cache) {
+        cache = std::make_shared<PageCache>(WORKER_CACHE_SIZE);
+    }
+    GrowingFile growing(path);
+    CachedDumpStream file(path, cache);
+    std::ifstream scanFile(path, std::ios::binary);
+
+    if (!file.is_open() || !scanFile.is_open()) {
+        following = false;
+        fail("Failed to open file: " + path);
+        return;
+    }
+
+    SystemProcessScanner scanner(std::move(profiles));
+    std::vector<char> buffer(SCAN_CHUNK_SIZE + SCAN_CHUNK_OVERLAP);
+    std::ptrdiff_t systemKProcessAddress = 0;
+    WindowsProfile detected;
+    std::unordered_map<uint64_t, std::vector<VadNode>> completeVadTrees;
+    uint64_t scanned = 0;
+    uint64_t walkedSize = 0;
+    auto lastGrowth = std::chrono::steady_clock::now();
+
+    while (!analysisProgress.cancelled) {
+        uint64_t size = growing.size();
+        std::chrono::duration<double, std::milli> idle = std::chrono::steady_clock::now() - lastGrowth;
+        bool complete = growing.writerClosed() || idle.count() >= GROWING_FILE_IDLE_MS;
+        analysisProgress.totalBytes = size;
+
+        if (systemKProcessAddress == 0) {
+            // A "System" crossing the end of the file is found in the next round
+            uint64_t end = complete ? size : size - std::min<uint64_t>(size, SCAN_CHUNK_OVERLAP);
+            while (scanned < end && !analysisProgress.cancelled) {
+                size_t chunkSize = std::min<uint64_t>(SCAN_CHUNK_SIZE, end - scanned);
+                size_t readSize = std::min<uint64_t>(chunkSize + SCAN_CHUNK_OVERLAP, size - scanned);
+                if (!readPhysicalMemory(scanned, buffer.data(), readSize, scanFile)) {
+                    break;
+                }
+                scanner.scanChunk(DumpChunk{scanned, buffer.data(), chunkSize, readSize});
+                scanned += chunkSize;
+                analysisProgress.bytesScanned = scanned;
+            }
+
+            systemKProcessAddress = scanner.result(file, !complete);
+            if (systemKProcessAddress != 0) {
+                detected = scanner.detected;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    detectedProfile = detected;
+                }
+                setState(AnalysisState::ReadingProcesses);
+            }
+        }
+
+        if (systemKProcessAddress != 0 && size != walkedSize) {
+            std::vector<Process> walked;
+            AddressSpace systemSpace(file, detected.offsets.systemDirectoryTableBase, detected.offsets);
+            systemSpace.walkProcessList(systemKProcessAddress, [&](const Process& process) {
+                walked.push_back(process);
+            }, false);
+
+            for (Process& process : walked) {
+                auto known = completeVadTrees.find(process.KProcessAddress);
+                if (known != completeVadTrees.end()) {
+                    process.VadTree = known->second;
+                    continue;
+                }
+
+                AccessCounters counters;
+                AddressSpace processSpace(file, process.DirectoryTableBase, detected.offsets, &counters);
+                std::vector<VadNode> vadTree = processSpace.readProcessVadTree(process.KProcessAddress);
+                if (counters.failedReads == 0) {
+                    process.VadTree = vadTree;
+                    completeVadTrees.emplace(process.KProcessAddress, std::move(vadTree));
+                }
+            }
+
+            publishProcesses(std::move(walked));
+            walkedSize = size;
+        }
+
+        if (complete) {
+            break;
+        }
+        if (growing.waitForGrowth(size, GROWING_FILE_POLL_MS) != size) {
+            lastGrowth = std::chrono::steady_clock::now();
+        }
+    }
+
+    following = false;
+    if (analysisProgress.cancelled) {
+        setState(AnalysisState::Cancelled);
+        return;
+    }
+    if (systemKProcessAddress == 0) {
+        fail("Failed to find the System _EPROCESS");
+        return;
+    }
+
+    DumpFingerprint computed = computeDumpFingerprint(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dumpFingerprint = computed;
+    }
+
+    setState(AnalysisState::Done);
+}
+
+/**
+ * Replace the published processes with the result of a new walk. Readers fetching only the new processes
+ * are told to fetch them all again if the walk changed one they already have.
+ *
+ * @param walked: processes in list order
+ */
+void AnalysisWorker::publishProcesses(std::vector<Process> walked)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        bool extends = walked.size() >= processes.size();
+        for (size_t i = 0; extends && i < processes.size(); i++) {
+            extends = processes[i].KProcessAddress == walked[i].KProcessAddress &&
+                      processes[i].VadTree.size() == walked[i].VadTree.size();
+        }
+        if (!extends) {
+            revision++;
+        }
+
+        processes = std::move(walked);
+        analysisProgress.processesFound = processes.size();
+    }
+    notify();
+}
+
+void AnalysisWorker::fail(const std::string& message)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        errorMessage = message;
+    }
+    setState(AnalysisState::Failed);
+}
+
+void AnalysisWorker::setState(AnalysisState newState)
+{
+    if (newState != AnalysisState::Scanning && newState != AnalysisState::ReadingProcesses) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        finishedAfterMs = static_cast<int64_t>(elapsed.count());
+    }
+
+    currentState = newState;
+    notify();
+}
+
+void AnalysisWorker::notify()
+{
+    if (onUpdate) {
+        onUpdate();
+    }
+}
@@ -0,0 +1,83 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fingerprint.h"
+#include "memory.h"
+#include "pagecache.h"
+#include "profile.h"
+
+#ifndef DUDEDUMPER_WORKER_H
+#define DUDEDUMPER_WORKER_H
+
+#define WORKER_CACHE_SIZE 0x4000000
+
+enum class AnalysisState {
+    Idle,
+    Scanning,
+    ReadingProcesses,
+    Done,
+    Failed,
+    Cancelled
+};
+
+/*
+ * Runs System discovery and the process walk of one dump on a background thread.
+ * Processes are published one by one as they are read, so the GUI can show them while the walk goes on.
+ * The layout of the kernel structures is detected among the candidate profiles during discovery.
+ * A raw dump still being acquired can be followed: the worker scans what is written so far, and walks the
+ * processes again whenever the file grows, until its writer is done with it. A walk that changes processes
+ * already published, e.g. a VAD tree whose nodes were just written, bumps processRevision().
+ */
+class AnalysisWorker {
+public:
+    ~AnalysisWorker();
+
+    void start(const std::string& path, std::shared_ptr<PageCache> cache = nullptr, bool followGrowth = false);
+    void cancel();
+    void setProfiles(std::vector<WindowsProfile> profiles);
+
+    AnalysisState state() const;
+    bool isRunning() const;
+    bool isFollowing() const;
+    std::string error() const;
+    DumpFingerprint fingerprint() const;
+    WindowsProfile profile() const;
+    size_t fetchProcesses(std::vector<Process>& processList, size_t *seenRevision = nullptr) const;
+    size_t processRevision() const;
+
+    const AnalysisProgress& progress() const;
+    double elapsedSeconds() const;
+    double throughput() const;
+
+    std::function<void()> onUpdate;
+
+private:
+    void run(std::string path, std::shared_ptr<PageCache> cache, std::vector<WindowsProfile> profiles);
+    void follow(std::string path, std::shared_ptr<PageCache> cache, std::vector<WindowsProfile> profiles);
+    void publishProcesses(std::vector<Process> walked);
+    void fail(const std::string& message);
+    void setState(AnalysisState newState);
+    void notify();
+
+    std::thread thread;
+    std::atomic<AnalysisState> currentState{AnalysisState::Idle};
+    AnalysisProgress analysisProgress;
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<int64_t> finishedAfterMs{-1};
+    std::atomic<bool> following{false};
+    std::atomic<size_t> revision{0};
+
+    mutable std::mutex mutex;
+    std::vector<Process> processes;
+    std::string errorMessage;
+    DumpFingerprint dumpFingerprint{};
+    std::vector<WindowsProfile> profileCandidates = builtinProfiles();
+    WindowsProfile detectedProfile;
+};
+
+#endif //DUDEDUMPER_WORKER_H
@@ -0,0 +1,258 @@
+#include "xpress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+template<class T>
+static bool readLittleEndian(const uint8_t *input, size_t inputSize, size_t& position, T& value)
+{
+    if (position > inputSize || inputSize - position < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, input + position, sizeof(T));
+    position += sizeof(T);
+    return true;
+}
+
+/**
+ * Decompress a plain LZ77 Xpress stream (MS-XCA 2.4), as used by hibernation files since Windows XP.
+ * The stream must decompress to exactly outputSize bytes.
+ *
+ * @param input: compressed data
+ * @param inputSize: size of the compressed data
+ * @param output: buffer receiving the decompressed data
+ * @param outputSize: size of the decompressed data
+ * @return: true if the whole output was decompressed, false if the stream is corrupted
+ */
+bool xpressDecompress(const uint8_t *input, size_t inputSize, uint8_t *output, size_t outputSize)
+{
+    size_t inputPosition = 0;
+    size_t outputPosition = 0;
+    size_t halfBytePosition = 0;
+    bool halfByteUsed = false;
+    uint32_t flags = 0;
+    int flagCount = 0;
+
+    while (outputPosition < outputSize) {
+        if (flagCount == 0) {
+            if (!readLittleEndian(input, inputSize, inputPosition, flags)) {
+                return false;
+            }
+            flagCount = 32;
+        }
+        flagCount--;
+
+        if ((flags & (1u << flagCount)) == 0) {
+            if (inputPosition >= inputSize) {
+                return false;
+            }
+            output[outputPosition++] = input[inputPosition++];
+            continue;
+        }
+
+        uint16_t matchBytes;
+        if (!readLittleEndian(input, inputSize, inputPosition, matchBytes)) {
+            return false;
+        }
+        size_t matchLength = matchBytes & 7;
+        size_t matchOffset = (matchBytes >> 3) + 1;
+
+        if (matchLength == 7) {
+            // Length nibbles are packed by two, the second one is the high half of the first one's byte
+            if (!halfByteUsed) {
+                if (inputPosition >= inputSize) {
+                    return false;
+                }
+                halfBytePosition = inputPosition++;
+                matchLength = input[halfBytePosition] & 0xf;
+            } else {
+                matchLength = input[halfBytePosition] >> 4;
+            }
+            halfByteUsed = !halfByteUsed;
+
+            if (matchLength == 15) {
+                uint8_t lengthByte;
+                if (!readLittleEndian(input, inputSize, inputPosition, lengthByte)) {
+                    return false;
+                }
+                matchLength = lengthByte;
+                if (matchLength == 255) {
+                    uint16_t length16;
+                    if (!readLittleEndian(input, inputSize, inputPosition, length16)) {
+                        return false;
+                    }
+                    matchLength = length16;
+                    if (matchLength == 0) {
+                        uint32_t length32;
+                        if (!readLittleEndian(input, inputSize, inputPosition, length32)) {
+                            return false;
+                        }
+                        matchLength = length32;
+                    }
+                    if (matchLength < 15 + 7) {
+                        return false;
+                    }
+                    matchLength -= 15 + 7;
+                }
+                matchLength += 15;
+            }
+            matchLength += 7;
+        }
+        matchLength += 3;
+
+        if (matchOffset > outputPosition || matchLength > outputSize - outputPosition) {
+            return false;
+        }
+        // Byte by byte, matches may overlap their own output
+        for (size_t i = 0; i < matchLength; i++, outputPosition++) {
+            output[outputPosition] = output[outputPosition - matchOffset];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Build the canonical decoding table of a chunk: symbols are ordered by code length, then by value,
+ * and each one fills the entries of the 15-bit prefixes starting with its code.
+ *
+ * @param lengths: packed 4-bit code lengths of the symbols, the low half of a byte first
+ * @param bitLengths: receives the code length of each symbol
+ * @param table: receives the symbol of each 15-bit prefix
+ * @return: true if the code lengths describe a complete prefix code, false otherwise
+ */
+static bool buildHuffmanTable(const uint8_t *lengths, uint8_t *bitLengths, uint16_t *table)
+{
+    for (size_t symbol = 0; symbol < XPRESS_HUFFMAN_SYMBOLS; symbol++) {
+        bitLengths[symbol] = (lengths[symbol / 2] >> (4 * (symbol % 2))) & 0xf;
+    }
+
+    size_t entry = 0;
+    for (uint8_t bitLength = 1; bitLength <= XPRESS_HUFFMAN_MAX_BITS; bitLength++) {
+        for (size_t symbol = 0; symbol < XPRESS_HUFFMAN_SYMBOLS; symbol++) {
+            if (bitLengths[symbol] != bitLength) {
+                continue;
+            }
+            size_t entryCount = size_t(1) << (XPRESS_HUFFMAN_MAX_BITS - bitLength);
+            if (entry + entryCount > (size_t(1) << XPRESS_HUFFMAN_MAX_BITS)) {
+                return false;
+            }
+            std::fill(table + entry, table + entry + entryCount, static_cast<uint16_t>(symbol));
+            entry += entryCount;
+        }
+    }
+    return entry == (size_t(1) << XPRESS_HUFFMAN_MAX_BITS);
+}
+
+/**
+ * Decompress a LZ77+Huffman Xpress stream (MS-XCA 2.1), as used by hibernation files since Windows 8.
+ * Each 64K of output starts with the code length table of its symbols, followed by the bit stream,
+ * read as 16-bit little endian words. The bytes extending long match lengths sit between these words,
+ * where the decoder has read up to. The stream must decompress to exactly outputSize bytes.
+ *
+ * @param input: compressed data
+ * @param inputSize: size of the compressed data
+ * @param output: buffer receiving the decompressed data
+ * @param outputSize: size of the decompressed data
+ * @return: true if the whole output was decompressed, false if the stream is corrupted
+ */
+bool xpressHuffmanDecompress(const uint8_t *input, size_t inputSize, uint8_t *output, size_t outputSize)
+{
+    std::vector<uint16_t> table(size_t(1) << XPRESS_HUFFMAN_MAX_BITS);
+    uint8_t bitLengths[XPRESS_HUFFMAN_SYMBOLS];
+    size_t inputPosition = 0;
+    size_t outputPosition = 0;
+
+    while (outputPosition < outputSize) {
+        if (inputPosition > inputSize || inputSize - inputPosition < XPRESS_HUFFMAN_TABLE_SIZE
+            || !buildHuffmanTable(input + inputPosition, bitLengths, table.data())) {
+            return false;
+        }
+        inputPosition += XPRESS_HUFFMAN_TABLE_SIZE;
+
+        uint16_t highWord, lowWord;
+        if (!readLittleEndian(input, inputSize, inputPosition, highWord)
+            || !readLittleEndian(input, inputSize, inputPosition, lowWord)) {
+            return false;
+        }
+        uint32_t nextBits = (uint32_t(highWord) << 16) | lowWord;
+        int extraBitCount = 16;
+
+        // Consume up to 15 bits of the buffer, it always holds at least 16 of them
+        auto consume = [&](int bitCount) {
+            nextBits <<= bitCount;
+            extraBitCount -= bitCount;
+            if (extraBitCount < 0) {
+                uint16_t word;
+                if (!readLittleEndian(input, inputSize, inputPosition, word)) {
+                    return false;
+                }
+                nextBits |= uint32_t(word) << -extraBitCount;
+                extraBitCount += 16;
+            }
+            return true;
+        };
+
+        size_t chunkEnd = outputPosition + std::min<size_t>(XPRESS_HUFFMAN_CHUNK_SIZE, outputSize - outputPosition);
+        while (outputPosition < chunkEnd) {
+            uint16_t symbol = table[nextBits >> (32 - XPRESS_HUFFMAN_MAX_BITS)];
+            if (!consume(bitLengths[symbol])) {
+                return false;
+            }
+
+            if (symbol < 256) {
+                output[outputPosition++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            symbol -= 256;
+            size_t matchLength = symbol & 0xf;
+            int offsetBitCount = symbol >> 4;
+            if (matchLength == 15) {
+                uint8_t lengthByte;
+                if (!readLittleEndian(input, inputSize, inputPosition, lengthByte)) {
+                    return false;
+                }
+                matchLength = lengthByte;
+                if (matchLength == 255) {
+                    uint16_t length16;
+                    if (!readLittleEndian(input, inputSize, inputPosition, length16)) {
+                        return false;
+                    }
+                    matchLength = length16;
+                    if (matchLength == 0) {
+                        uint32_t length32;
+                        if (!readLittleEndian(input, inputSize, inputPosition, length32)) {
+                            return false;
+                        }
+                        matchLength = length32;
+                    }
+                    if (matchLength < 15) {
+                        return false;
+                    }
+                    matchLength -= 15;
+                }
+                matchLength += 15;
+            }
+            matchLength += 3;
+
+            size_t matchOffset = (size_t(1) << offsetBitCount)
+                                 | (offsetBitCount == 0 ? 0 : nextBits >> (32 - offsetBitCount));
+            if (!consume(offsetBitCount)) {
+                return false;
+            }
+
+            if (matchOffset > outputPosition || matchLength > outputSize - outputPosition) {
+                return false;
+            }
+            // Byte by byte, matches may overlap their own output
+            for (size_t i = 0; i < matchLength; i++, outputPosition++) {
+                output[outputPosition] = output[outputPosition - matchOffset];
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,16 @@
+#include <cstddef>
+#include <cstdint>
+
+#ifndef DUDEDUMPER_XPRESS_H
+#define DUDEDUMPER_XPRESS_H
+
+// LZ77+Huffman Xpress: 512 symbols with 4-bit code lengths, a new table every 64K of output
+#define XPRESS_HUFFMAN_SYMBOLS 512
+#define XPRESS_HUFFMAN_TABLE_SIZE (XPRESS_HUFFMAN_SYMBOLS / 2)
+#define XPRESS_HUFFMAN_MAX_BITS 15
+#define XPRESS_HUFFMAN_CHUNK_SIZE 0x10000
+
+bool xpressDecompress(const uint8_t *input, size_t inputSize, uint8_t *output, size_t outputSize);
+bool xpressHuffmanDecompress(const uint8_t *input, size_t inputSize, uint8_t *output, size_t outputSize);
+
+#endif //DUDEDUMPER_XPRESS_H